@@ -0,0 +1,56 @@
+// System
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+
+// Internal
+#include <itkLoopSubdivisionSurfaceMatrices.h>
+
+// The valences of the mesh's matrices, 3 to 25, all of which are set up on
+// construction: from these tables if compiled in, and calculated otherwise.
+using TMatrices = itk::LoopSubdivisionSurfaceMatrices<double, 3, 25>;
+
+int
+main(int argc, char** argv)
+{
+
+  if (2 != argc) {
+    std::cerr << "Usage: " << argv[0] << " <output.cxx>" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  FILE* out = std::fopen(argv[1], "w");
+  if (nullptr == out) {
+    std::cerr << "Could not open " << argv[1] << " for writing." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  const TMatrices matrices;
+
+  std::fprintf(out, "// Generated by dv-sissr-generate-tables; do not edit.\n\n");
+  std::fprintf(out, "#include <itkLoopSubdivisionSurfacePrecomputedTables.h>\n\n");
+  std::fprintf(out, "namespace itk\n{\nnamespace LoopSubdivisionSurfacePrecomputedTables\n{\n\n");
+
+  for (unsigned int n = TMatrices::MinimumValency; n <= TMatrices::MaximumValency; ++n) {
+    const auto data = matrices.SerializeValenceTables(n);
+    std::fprintf(out, "static const double Valence%u[%zu] = {\n", n, data.size());
+    for (size_t i = 0; i < data.size(); ++i) {
+      std::fprintf(out, "%.17g,%s", data[i], (7 == i % 8) ? "\n" : " ");
+    }
+    std::fprintf(out, "\n};\n\n");
+  }
+
+  std::fprintf(out, "const double* Get(const unsigned int &n)\n{\n  switch (n)\n    {\n");
+  for (unsigned int n = TMatrices::MinimumValency; n <= TMatrices::MaximumValency; ++n) {
+    std::fprintf(out, "    case %u: return Valence%u;\n", n, n);
+  }
+  std::fprintf(out, "    default: return nullptr;\n    }\n}\n\n");
+  std::fprintf(out, "} // namespace LoopSubdivisionSurfacePrecomputedTables\n} // namespace itk\n");
+
+  if (0 != std::fclose(out)) {
+    std::cerr << "Could not write " << argv[1] << "." << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -24,14 +24,45 @@ main(int argc, char** argv)
     ("weight-vc", po::value<double>(), "Velocity weight.")
     ("weight-el", po::value<double>(), "Edge length weight.")
     ("weight-ar", po::value<double>(), "Aspect ratio weight.")
+    ("weight-tg", po::value<double>(), "Tangential weight of point-to-plane residuals.")
+    ("weight-cm", po::value<double>(), "Candidate to model surface weight (default: 0, off).")
     ("registration-use-labels", "Use labels in registration.")
     ("registration-ignore-labels", "Ignore labels in registration.")
+    ("registration-use-triangles", "Match to candidate triangles (default).")
+    ("registration-use-points", "Match to candidate cell midpoints.")
+    ("point-to-plane", "Measure primary residuals along the candidate normals.")
+    ("symmetric-residual", "Measure primary residuals along the candidate and model normals.")
+    ("distance-transform", "Look closest points on the candidate triangles up in a precomputed grid.")
+    ("distance-transform-spacing", po::value<double>(), "Grid spacing of the distance transform.")
+    ("distance-transform-band", po::value<double>(), "Distance from the candidates covered by the grid.")
+    ("correspondence-interval", po::value<unsigned int>(), "Accepted iterations between closest point updates (default: 0, every evaluation).")
+    ("approximate-epsilon", po::value<double>(), "Start with closest points within 1 + epsilon of the closest (default: 0, exact).")
+    ("approximate-switch", po::value<double>(), "Relative cost change at which to switch to exact closest points.")
+    ("pyramid-levels", po::value<unsigned int>(), "Decimated candidate levels to match first (default: 0).")
+    ("pyramid-spacing", po::value<double>(), "Grid spacing of the finest decimated level (default: twice the mean edge length).")
+    ("pyramid-switch", po::value<double>(), "Relative cost change at which to move to a finer level.")
     ("registration-sampling-density", po::value<unsigned int>(), "Samples per triangle.")
     ("max-iterations", po::value<int>(), "Maximum number of solver iterations.")
     ("max-time", po::value<int>(), "Maximum solver time in seconds.")
     ("function-tolerance", po::value<double>(), "Function tolerance for convergence.")
     ("parameter-tolerance", po::value<double>(), "Parameter tolerance for convergence.")
     ("dynamic-sparsity", "Enable dynamic sparsity in solver.")
+    ("linear-solver", po::value<std::string>(), "Ceres linear solver type, or auto to probe (default: sparse_normal_cholesky).")
+    ("preconditioner", po::value<std::string>(), "Ceres preconditioner type for iterative solvers (default: jacobi).")
+    ("sparse-library", po::value<std::string>(), "Ceres sparse linear algebra library (default: Ceres' default).")
+    ("ordering", po::value<std::string>(), "Fill reducing ordering, amd or nesdis (default: amd).")
+    ("mixed-precision", "Factorize in single precision and refine in double.")
+    ("refinement-iterations", po::value<int>(), "Iterative refinement steps per linear solve (default: 0).")
+    ("probe-iterations", po::value<unsigned int>(), "Iterations per configuration probed by --linear-solver auto (default: 3).")
+    ("threads", po::value<unsigned int>(), "Number of threads used by the solver (default: CPU quota).")
+    ("batch-primary-residuals", "Use one primary residual block per cell rather than per sample.")
+    ("separate-regularizers", "Use one residual block per regularizer term and point, edge or cell.")
+    ("alternating", "Alternate closest point searches and linear solves with one cached factorization.")
+    ("matrix-free", "Solve by Gauss-Newton and conjugate gradients, without storing a Jacobian.")
+    ("pcg-iterations", po::value<unsigned int>(), "Conjugate gradient iterations per step of --matrix-free (default: 100).")
+    ("pcg-tolerance", po::value<double>(), "Relative residual ending the conjugate gradients of --matrix-free (default: 1e-3).")
+    ("ordering-cache", po::value<std::string>(), "Directory in which fill reducing orderings are saved and reused (default: the serialization directory).")
+    ("no-ordering-cache", "Compute the fill reducing ordering in every run.")
     ("register", po::value<int>(), "Register model to candidates.");
 
   po::variables_map vm;
@@ -74,6 +105,12 @@ main(int argc, char** argv)
   if (vm.count("weight-ar")) {
     algorithm.GetParameters().RegistrationWeights.TriangleAspectRatio = vm["weight-ar"].as<double>();
   }
+  if (vm.count("weight-tg")) {
+    algorithm.GetParameters().RegistrationWeights.Tangential = vm["weight-tg"].as<double>();
+  }
+  if (vm.count("weight-cm")) {
+    algorithm.GetParameters().RegistrationWeights.Candidate = vm["weight-cm"].as<double>();
+  }
   if (vm.count("registration-use-labels") && vm.count("registration-ignore-labels")) {
     std::cerr << "Setting both 'registration-use-labels' and 'registration-ignore-labels' is disallowed." << std::endl;
     return EXIT_FAILURE;
@@ -84,6 +121,57 @@ main(int argc, char** argv)
   if (vm.count("registration-ignore-labels")) {
     algorithm.GetParameters().RegistrationUseLabels = false;
   }
+  if (vm.count("registration-use-triangles") && vm.count("registration-use-points")) {
+    std::cerr << "Setting both 'registration-use-triangles' and 'registration-use-points' is disallowed." << std::endl;
+    return EXIT_FAILURE;
+  }
+  if (vm.count("registration-use-triangles")) {
+    algorithm.GetParameters().RegistrationUseTriangles = true;
+  }
+  if (vm.count("registration-use-points")) {
+    algorithm.GetParameters().RegistrationUseTriangles = false;
+  }
+  if (vm.count("point-to-plane")) {
+    algorithm.GetParameters().RegistrationUsePointToPlane = true;
+  }
+  if (vm.count("symmetric-residual")) {
+    algorithm.GetParameters().RegistrationUseSymmetricResidual = true;
+  }
+  if (vm.count("distance-transform")) {
+    if (vm.count("point-to-plane") || vm.count("symmetric-residual")) {
+      std::cerr << "Point-to-plane and symmetric residuals are disallowed with 'distance-transform'." << std::endl;
+      return EXIT_FAILURE;
+    }
+    if (vm.count("registration-use-points")) {
+      std::cerr << "Setting both 'distance-transform' and 'registration-use-points' is disallowed." << std::endl;
+      return EXIT_FAILURE;
+    }
+    algorithm.GetParameters().RegistrationUseDistanceTransform = true;
+  }
+  if (vm.count("distance-transform-spacing")) {
+    algorithm.GetParameters().DistanceTransformSpacing = vm["distance-transform-spacing"].as<double>();
+  }
+  if (vm.count("distance-transform-band")) {
+    algorithm.GetParameters().DistanceTransformBandWidth = vm["distance-transform-band"].as<double>();
+  }
+  if (vm.count("correspondence-interval")) {
+    algorithm.GetParameters().CorrespondenceUpdateInterval = vm["correspondence-interval"].as<unsigned int>();
+  }
+  if (vm.count("approximate-epsilon")) {
+    algorithm.GetParameters().ApproximateEpsilon = vm["approximate-epsilon"].as<double>();
+  }
+  if (vm.count("approximate-switch")) {
+    algorithm.GetParameters().ApproximateSwitchTolerance = vm["approximate-switch"].as<double>();
+  }
+  if (vm.count("pyramid-levels")) {
+    algorithm.GetParameters().PyramidLevels = vm["pyramid-levels"].as<unsigned int>();
+  }
+  if (vm.count("pyramid-spacing")) {
+    algorithm.GetParameters().PyramidSpacing = vm["pyramid-spacing"].as<double>();
+  }
+  if (vm.count("pyramid-switch")) {
+    algorithm.GetParameters().PyramidSwitchTolerance = vm["pyramid-switch"].as<double>();
+  }
   if (vm.count("registration-sampling-density")) {
     algorithm.GetParameters().RegistrationSamplingDensity = vm["registration-sampling-density"].as<unsigned int>();
   }
@@ -104,6 +192,54 @@ main(int argc, char** argv)
   if (vm.count("dynamic-sparsity")) {
     algorithm.GetParameters().DynamicSparsity = true;
   }
+  if (vm.count("linear-solver")) {
+    algorithm.GetParameters().LinearSolverType = vm["linear-solver"].as<std::string>();
+  }
+  if (vm.count("preconditioner")) {
+    algorithm.GetParameters().PreconditionerType = vm["preconditioner"].as<std::string>();
+  }
+  if (vm.count("sparse-library")) {
+    algorithm.GetParameters().SparseLinearAlgebraLibrary = vm["sparse-library"].as<std::string>();
+  }
+  if (vm.count("ordering")) {
+    algorithm.GetParameters().LinearSolverOrdering = vm["ordering"].as<std::string>();
+  }
+  if (vm.count("mixed-precision")) {
+    algorithm.GetParameters().UseMixedPrecisionSolves = true;
+  }
+  if (vm.count("refinement-iterations")) {
+    algorithm.GetParameters().MaxNumRefinementIterations = vm["refinement-iterations"].as<int>();
+  }
+  if (vm.count("probe-iterations")) {
+    algorithm.GetParameters().LinearSolverProbeIterations = vm["probe-iterations"].as<unsigned int>();
+  }
+  if (vm.count("threads")) {
+    algorithm.GetParameters().NumberOfThreads = vm["threads"].as<unsigned int>();
+  }
+  if (vm.count("batch-primary-residuals")) {
+    algorithm.GetParameters().BatchPrimaryResiduals = true;
+  }
+  if (vm.count("separate-regularizers")) {
+    algorithm.GetParameters().CollapseLinearRegularizers = false;
+  }
+  if (vm.count("alternating")) {
+    algorithm.GetParameters().UseAlternatingSolver = true;
+  }
+  if (vm.count("matrix-free")) {
+    algorithm.GetParameters().UseMatrixFreeSolver = true;
+  }
+  if (vm.count("pcg-iterations")) {
+    algorithm.GetParameters().MatrixFreeLinearIterations = vm["pcg-iterations"].as<unsigned int>();
+  }
+  if (vm.count("pcg-tolerance")) {
+    algorithm.GetParameters().MatrixFreeLinearTolerance = vm["pcg-tolerance"].as<double>();
+  }
+  if (vm.count("ordering-cache")) {
+    algorithm.GetParameters().OrderingCacheDirectory = vm["ordering-cache"].as<std::string>();
+  }
+  if (vm.count("no-ordering-cache")) {
+    algorithm.GetParameters().CacheEliminationOrdering = false;
+  }
 
 
   // Misc
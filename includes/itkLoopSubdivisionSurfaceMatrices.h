@@ -2,9 +2,20 @@
 #define itk_LoopSubdivisionSurfaceMatrices_h
 
 // STD
+#include <algorithm>
+#include <string>
 #include <complex>
 #include <map>
 #include <array>
+#include <vector>
+#include <mutex>
+#include <tuple>
+
+// Eigen
+#include <Eigen/Core>
+
+// ITK
+#include "itkMacro.h"
 
 // VNL
 #include "vnl/vnl_matrix.hxx"
@@ -72,11 +83,86 @@ static_assert(MaxN >= 6,
   using Self = LoopSubdivisionSurfaceMatrices;
   using TPickers = std::array<vnl_matrix<TReal>, 3>;
 
+public:
+
+  using TEigenMatrix = Eigen::Matrix<TReal, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>;
+  using TEigenView = Eigen::Map<const TEigenMatrix, Eigen::Aligned16>;
+
+private:
+
+  /*
+   * Matrices packed back to back in one aligned buffer, row-major (as in
+   * vnl), each starting on a 16-byte boundary.  Entries are addressed by
+   * position, which for the per-valence tables is N - MinN.
+   */
+  class EigenStorage
+  {
+  public:
+    void Append(const vnl_matrix<TReal> &m)
+      {
+      constexpr size_t align = (16 / sizeof(TReal)) > 0 ? (16 / sizeof(TReal)) : 1;
+      const size_t offset = ((this->m_Data.size() + align - 1) / align) * align;
+      this->m_Data.resize(offset + m.size(), TReal(0));
+      std::copy(m.data_block(), m.data_block() + m.size(), this->m_Data.begin() + offset);
+      this->m_Offsets.push_back(offset);
+      this->m_Rows.push_back(m.rows());
+      this->m_Cols.push_back(m.cols());
+      }
+
+    TEigenView Get(const size_t &i) const
+      {
+      return TEigenView(this->m_Data.data() + this->m_Offsets[i], this->m_Rows[i], this->m_Cols[i]);
+      }
+
+  private:
+    std::vector<TReal, Eigen::aligned_allocator<TReal>> m_Data;
+    std::vector<size_t> m_Offsets;
+    std::vector<size_t> m_Rows;
+    std::vector<size_t> m_Cols;
+  };
+
+  /* Everything which depends on the valence. */
+  struct ValenceTables
+  {
+    vnl_matrix<TReal> S;
+    vnl_matrix<TReal> A;
+    vnl_matrix<TReal> B;
+    TPickers          P;
+
+    vnl_vector<TReal> SEigenvalues;
+    vnl_vector<TReal> AEigenvalues;
+    vnl_matrix<TReal> SEigenvectors;
+    vnl_matrix<TReal> AEigenvectors;
+
+    std::tuple<vnl_vector<unsigned int>,
+               vnl_matrix<TReal>,
+               vnl_matrix<TReal>> SortedEigensystem;
+
+    vnl_matrix<TReal> BSplineToBezier;
+
+    // Derived from the above when the tables are set up
+    vnl_matrix<TReal> ThinPlateOperator;
+    EigenStorage      Views; // Indexed by ViewIndex
+  };
+
+  enum ViewIndex : size_t
+  {
+    ViewS, ViewA, ViewB, ViewP, // 3 pickers
+    ViewBSplineToBezier = ViewP + 3,
+    ViewThinPlateOperator,
+    ViewEigenbasisProjection, // (P_k B V)^T, 3 child patches
+    ViewEigenbasisLeft = ViewEigenbasisProjection + 3,
+    ViewEigenbasisValues
+  };
+
 public:
 
   /* Constructor
-   * The matrices from MinN <= N <= MaxN are calculated and stored in a map.
-   * Getters are then supplied.
+   * The matrices for every valence MinN <= N <= MaxN are set up here, in
+   * full: loaded from the precomputed tables when these were compiled in
+   * (SISSR_USE_PRECOMPUTED_TABLES) and cover N, and calculated otherwise.
+   * There is no valence outside this range to set up later, so the getters
+   * only read, and are thread safe; they throw for other valences.
    */
   LoopSubdivisionSurfaceMatrices();
 
@@ -92,16 +178,35 @@ public:
 
   /* Get subdivision matrix. */
   const vnl_matrix<TReal>& GetS(const unsigned int &n) const
-    { return this->m_S_map.at(n); }
+    { return this->GetValenceTables(n).S; }
   /* Get extended subdivision matrix. */
   const vnl_matrix<TReal>& GetA(const unsigned int &n) const
-    { return this->m_A_map.at(n); }
+    { return this->GetValenceTables(n).A; }
   /* Get bigger subdivision matrix. */
   const vnl_matrix<TReal>& GetB(const unsigned int &n) const
-    { return this->m_B_map.at(n); }
+    { return this->GetValenceTables(n).B; }
   const vnl_matrix<TReal>& GetP(const unsigned int &n,
                                 const unsigned int &k) const
-    { return this->m_P_map.at(n)[k]; }
+    { return this->GetValenceTables(n).P[k]; }
+
+  ////////////////////////
+  // Access Eigen Views //
+  ////////////////////////
+
+  /* Views into each valence's contiguous storage: no map lookup, no copy. */
+
+  TEigenView GetSView(const unsigned int &n) const
+    { return this->GetValenceTables(n).Views.Get(ViewS); }
+  TEigenView GetAView(const unsigned int &n) const
+    { return this->GetValenceTables(n).Views.Get(ViewA); }
+  TEigenView GetBView(const unsigned int &n) const
+    { return this->GetValenceTables(n).Views.Get(ViewB); }
+  TEigenView GetPView(const unsigned int &n, const unsigned int &k) const
+    { return this->GetValenceTables(n).Views.Get(ViewP + k); }
+  TEigenView GetBSplineToBezierView(const unsigned int &n) const
+    { return this->GetValenceTables(n).Views.Get(ViewBSplineToBezier); }
+  TEigenView GetThinPlateOperatorView(const unsigned int &n) const
+    { return this->GetValenceTables(n).Views.Get(ViewThinPlateOperator); }
 
   ////////////////////////
   // Access Eigenvalues //
@@ -109,10 +214,10 @@ public:
 
   /* Get subdivision matrix eigenvalues. */
   const vnl_vector<TReal>& GetSEigenvalues(const unsigned int &n) const
-    {  return this->m_S_Eigenvalues_map.at(n); }
+    {  return this->GetValenceTables(n).SEigenvalues; }
   /* Get extended subdivision matrix eigenvalues. */
   const vnl_vector<TReal>& GetAEigenvalues(const unsigned int &n) const
-    {  return this->m_A_Eigenvalues_map.at(n); }
+    {  return this->GetValenceTables(n).AEigenvalues; }
 
   /////////////////////////
   // Access Eigenvectors //
@@ -120,15 +225,15 @@ public:
 
   /* Get subdivision matrix eigenvectors (columnwise). */
   const vnl_matrix<TReal>& GetSEigenvectors(const unsigned int &n) const
-    { return this->m_S_Eigenvectors_map.at(n); }
+    { return this->GetValenceTables(n).SEigenvectors; }
   /* Get extended subdivision matrix eigenvectors (columnwise). */
   const vnl_matrix<TReal>& GetAEigenvectors(const unsigned int &n) const
-    { return this->m_A_Eigenvectors_map.at(n); }
+    { return this->GetValenceTables(n).AEigenvectors; }
 
   const std::tuple<vnl_vector<unsigned int>,
                    vnl_matrix<TReal>,
                    vnl_matrix<TReal>>& GetSortedEigensystem(const unsigned int &n) const
-    { return this->m_Sorted_Eigensystem_map.at(n); }
+    { return this->GetValenceTables(n).SortedEigensystem; }
 
   /////////////////////////////////////////////////////
   // Uniform Quadratic B-Spline: Barycentric Weights //
@@ -150,6 +255,9 @@ public:
   static vnl_vector_fixed<TReal,12> CalculateBarycentricBSplineWeightsDS(const TParameters &p);
   static vnl_vector_fixed<TReal,12> CalculateBarycentricBSplineWeightsDT(const TParameters &p);
 
+  /* Partial derivatives of CalculateBarycentricBSplineWeights with respect to s and t. */
+  static void CalculateBarycentricBSplineWeightsGradient(const TParameters &p, TReal* ds, TReal* dt);
+
   static vnl_vector_fixed<TReal,12> CalculateBarycentricBezierWeights(const TParameters &p);
 
   ///////////////////////
@@ -178,7 +286,11 @@ public:
 
   // Conversion
   const vnl_matrix<TReal>& GetBSplineToBezier(const unsigned int &n) const
-    { return this->m_BSplineToBezier_map.at(n); }
+    { return this->GetValenceTables(n).BSplineToBezier; }
+
+  // Root of the Bezier energy times the conversion: 15 x (N+6).
+  const vnl_matrix<TReal>& GetThinPlateOperator(const unsigned int &n) const
+    { return this->GetValenceTables(n).ThinPlateOperator; }
 
   ///////////////////////
   // Utility Functions //
@@ -189,29 +301,135 @@ public:
   static TParameters TransformParametersToPatch(const TParameters &p);
   static bool        VerifyParameters(const TParameters &p);
 
+  ////////////////////
+  // Surface Points //
+  ////////////////////
+
+  /* Weights of the N+6 control points of a patch at parameters p. */
+  vnl_vector<TReal> CalculateSurfaceWeights(const unsigned int &n, const TParameters &p) const;
+
+  /*
+   * Weights of the N+6 control points for the limit point at p and, if
+   * ds/dt are not null, for its partial derivatives with respect to s and t.
+   * Near the extraordinary vertex, the l-1 subdivisions are applied in the
+   * eigenbasis of A (Stam):
+   *
+   *   w = W Lambda^(l-1) (P_k B V)^T b(p_t)
+   *
+   * so the cost is the same for every p.  Each output holds n+6 values.
+   * Derivatives are undefined at the extraordinary vertex itself.
+   */
+  void EvaluateSurfaceWeights(const unsigned int &n, const TParameters &p,
+                              TReal* w, TReal* ds = nullptr, TReal* dt = nullptr) const;
+
+  /* As CalculateSurfaceWeights, but by explicitly raising A to the (l-1)'th power. */
+  vnl_vector<TReal> CalculateSurfaceWeightsBySubdivision(const unsigned int &n, const TParameters &p) const;
+
+  /* Parameters at which each cell is sampled, for a given sample density. */
+  static std::vector<TParameters> CalculateSampleParameters(const unsigned int &density);
+
+  /*
+   * Surface weights for every valence and every sample of one density,
+   * calculated when the table is built.
+   * Since all cells are sampled at the same parameters, the weights only
+   * depend on (N, sample index); a point on the surface is then the dot
+   * product of N+6 weights with the patch control points.
+   */
+  class StencilTable
+  {
+  public:
+    StencilTable(const Self &matrices, const unsigned int &density) :
+      m_Matrices(matrices),
+      m_Parameters(Self::CalculateSampleParameters(density))
+      {
+      for (unsigned int n = MinN; n <= MaxN; ++n)
+        {
+        this->CalculateWeights(n);
+        }
+      }
+
+    /* Pointer to the N+6 weights for valence n, sample index i. */
+    const TReal* GetStencil(const unsigned int &n, const size_t &i) const
+      {
+      return this->GetWeights(n).data() + i * (n + 6);
+      }
+
+    /*
+     * The same weights in double precision, transposed for batch kernels:
+     * entry [j * GetTransposedStride() + i] weights control point j for
+     * sample i.  Padding samples have zero weight.
+     */
+    const double* GetTransposedStencils(const unsigned int &n) const
+      {
+      return this->m_Transposed[Self::ValenceIndex(n)].data();
+      }
+
+    /* Number of samples rounded up to a multiple of eight. */
+    size_t GetTransposedStride() const
+      { return (this->m_Parameters.size() + 7) / 8 * 8; }
+
+    const std::vector<TParameters>& GetParameters() const
+      { return this->m_Parameters; }
+    size_t GetNumberOfSamples() const
+      { return this->m_Parameters.size(); }
+
+  private:
+    const std::vector<TReal>& GetWeights(const unsigned int &n) const
+      {
+      return this->m_Weights[Self::ValenceIndex(n)];
+      }
+
+    void CalculateWeights(const unsigned int &n)
+      {
+      const size_t v = Self::ValenceIndex(n);
+      const size_t samples = this->m_Parameters.size();
+      const size_t stride = this->GetTransposedStride();
+      auto &weights = this->m_Weights[v];
+      auto &transposed = this->m_Transposed[v];
+      weights.reserve(samples * (n + 6));
+      transposed.assign(stride * (n + 6), 0.0);
+      for (size_t i = 0; i < samples; ++i)
+        {
+        const auto w = this->m_Matrices.CalculateSurfaceWeights(n, this->m_Parameters[i]);
+        weights.insert(weights.end(), w.begin(), w.end());
+        for (unsigned int j = 0; j < n + 6; ++j)
+          {
+          transposed[j * stride + i] = w[j];
+          }
+        }
+      }
+
+    const Self &m_Matrices;
+    std::vector<TParameters> m_Parameters;
+
+    // Per valence, indexed by N - MinN
+    std::array<std::vector<TReal>, MaxN - MinN + 1>  m_Weights;
+    std::array<std::vector<double>, MaxN - MinN + 1> m_Transposed;
+  };
+
+  /* Calculated on first request for each density; shared thereafter. */
+  const StencilTable& GetStencilTable(const unsigned int &density) const;
+
+  ////////////////////////
+  // Precomputed Tables //
+  ////////////////////////
+
+  /*
+   * The tables for valence n, flattened for the precomputed blob: n, the
+   * number of matrices, then each matrix as rows, columns and its row-major
+   * entries (vectors are single columns).
+   */
+  std::vector<double> SerializeValenceTables(const unsigned int &n) const;
+
 private:
 
   ////////////////////////////
   // Backing Datastructures //
   ////////////////////////////
 
-  // Matrices
-  std::map<unsigned int,vnl_matrix<TReal>> m_S_map;
-  std::map<unsigned int,vnl_matrix<TReal>> m_A_map;
-  std::map<unsigned int,vnl_matrix<TReal>> m_B_map;
-  std::map<unsigned int,TPickers>          m_P_map;
+  // Per-valence tables, indexed by N - MinN; set up by the constructor
+  std::array<ValenceTables, MaxN - MinN + 1> m_ValenceTables;
 
-  // Eigenvalues
-  std::map<unsigned int,vnl_vector<TReal>> m_S_Eigenvalues_map;
-  std::map<unsigned int,vnl_vector<TReal>> m_A_Eigenvalues_map;
-
-  // Eigenvectors
-  std::map<unsigned int,vnl_matrix<TReal>> m_S_Eigenvectors_map;
-  std::map<unsigned int,vnl_matrix<TReal>> m_A_Eigenvectors_map;
-
-  std::map<unsigned int,std::tuple<vnl_vector<unsigned int>,
-                                   vnl_matrix<TReal>,
-                                   vnl_matrix<TReal>>> m_Sorted_Eigensystem_map;
   // Thin plate bspline energy
   const vnl_matrix_fixed<TReal,12,12>      m_BSplineM;
   const vnl_matrix_fixed<TReal,36,36>      m_BSplineM_block;
@@ -224,8 +442,9 @@ private:
   const vnl_matrix_fixed<TReal,15,15>      m_BezierM_root;
   const vnl_matrix_fixed<TReal,45,45>      m_BezierM_root_block;
 
-  // Bezier
-  std::map<unsigned int,vnl_matrix<TReal>> m_BSplineToBezier_map;
+  // Stencil tables, by sample density
+  mutable std::map<unsigned int,StencilTable> m_StencilTable_map;
+  mutable std::mutex                          m_StencilTable_mutex;
 
   /////////////////////////
   // Static Calculations //
@@ -270,7 +489,55 @@ private:
   static vnl_matrix_fixed<TReal,15,15> CalculateBezierThinPlateEnergyMatrixRoot();
   static vnl_matrix_fixed<TReal,45,45> CalculateBezierThinPlateEnergyMatrixRootBlock();
 
+  // Per-valence setup
+  const ValenceTables& GetValenceTables(const unsigned int &n) const
+    { return this->m_ValenceTables[Self::ValenceIndex(n)]; }
+  void SetUpValenceTables(const unsigned int &n, ValenceTables &tables) const;
+  void CalculateValenceTables(const unsigned int &n, ValenceTables &tables) const;
+  void DeserializeValenceTables(const unsigned int &n, const double* data, ValenceTables &tables) const;
+  void CalculateDerivedValenceTables(const unsigned int &n, ValenceTables &tables) const;
+  template<typename TTables, typename TVisitor>
+  static void VisitValenceTables(TTables &tables, TVisitor &&visitor);
+
+  // Rows, columns, then row-major entries; vectors are single columns
+  template<typename T>
+  static void WriteTable(std::vector<double> &data, const vnl_matrix<T> &m)
+    {
+    data.push_back(m.rows());
+    data.push_back(m.cols());
+    data.insert(data.end(), m.begin(), m.end());
+    }
+  template<typename T>
+  static void WriteTable(std::vector<double> &data, const vnl_vector<T> &v)
+    {
+    data.push_back(v.size());
+    data.push_back(1);
+    data.insert(data.end(), v.begin(), v.end());
+    }
+  template<typename T>
+  static void ReadTable(const double* &data, vnl_matrix<T> &m)
+    {
+    m.set_size(size_t(data[0]), size_t(data[1]));
+    data += 2;
+    std::transform(data, data + m.size(), m.begin(), [](const double &x) { return T(x); });
+    data += m.size();
+    }
+  template<typename T>
+  static void ReadTable(const double* &data, vnl_vector<T> &v)
+    {
+    itkAssertOrThrowMacro(1 == size_t(data[1]), "Expected a column vector.");
+    v.set_size(size_t(data[0]));
+    data += 2;
+    std::transform(data, data + v.size(), v.begin(), [](const double &x) { return T(x); });
+    data += v.size();
+    }
+
   // Utility functions
+  static size_t ValenceIndex(const unsigned int &n)
+    {
+    itkAssertOrThrowMacro(MinN <= n && n <= MaxN, "Valence out of range: " + std::to_string(n));
+    return n - MinN;
+    }
   static TReal CalculateAlpha(const unsigned int &N);
   static TReal f(const unsigned int &k, const unsigned int &N);
   static TComplex E(const unsigned int &k, const unsigned int &N);
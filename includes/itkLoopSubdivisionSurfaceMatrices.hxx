@@ -22,6 +22,10 @@
 #include "sissrUtils.h"
 #include "dv_sylvester.h"
 
+#ifdef SISSR_USE_PRECOMPUTED_TABLES
+#include "itkLoopSubdivisionSurfacePrecomputedTables.h"
+#endif
+
 namespace itk
 {
 
@@ -41,29 +45,158 @@ LoopSubdivisionSurfaceMatrices<TReal,MinN,MaxN>
   m_BezierM_root(this->CalculateBezierThinPlateEnergyMatrixRoot()),
   m_BezierM_root_block(this->CalculateBezierThinPlateEnergyMatrixRootBlock())
 {
-
   for (unsigned int n = MinN; n <= MaxN; ++n)
     {
-    this->m_S_map.emplace(n, this->CalculateS(n));
-    this->m_A_map.emplace(n, this->CalculateA(n));
-    this->m_B_map.emplace(n, this->CalculateB(n));
+    this->SetUpValenceTables(n, this->m_ValenceTables[Self::ValenceIndex(n)]);
+    }
+}
+
+///////////////////////
+// Per-valence Setup //
+///////////////////////
+
+template< typename TReal, unsigned int MinN, unsigned int MaxN >
+void
+LoopSubdivisionSurfaceMatrices<TReal,MinN,MaxN>
+::SetUpValenceTables(const unsigned int &n, ValenceTables &tables) const
+{
+#ifdef SISSR_USE_PRECOMPUTED_TABLES
+  const double* data = LoopSubdivisionSurfacePrecomputedTables::Get(n);
+  if (nullptr != data)
+    {
+    this->DeserializeValenceTables(n, data, tables);
+    }
+  else
+    {
+    this->CalculateValenceTables(n, tables);
+    }
+#else
+  this->CalculateValenceTables(n, tables);
+#endif
+  this->CalculateDerivedValenceTables(n, tables);
+}
+
+template< typename TReal, unsigned int MinN, unsigned int MaxN >
+void
+LoopSubdivisionSurfaceMatrices<TReal,MinN,MaxN>
+::CalculateValenceTables(const unsigned int &n, ValenceTables &tables) const
+{
+  tables.S = Self::CalculateS(n);
+  tables.A = Self::CalculateA(n);
+  tables.B = Self::CalculateB(n);
+
+  for (unsigned int k = 0; k < 3; ++k)
+    {
+    tables.P.at(k) = Self::CalculateP(n,k);
+    }
 
-    typename Self::TPickers p;
-    p.at(0) = this->CalculateP(n,0);
-    p.at(1) = this->CalculateP(n,1);
-    p.at(2) = this->CalculateP(n,2);
-    this->m_P_map.emplace(n, p);
+  tables.SEigenvalues = Self::CalculateSEigenvalues(n);
+  tables.AEigenvalues = Self::CalculateAEigenvalues(n);
 
-    this->m_S_Eigenvalues_map.emplace(n, this->CalculateSEigenvalues(n));
-    this->m_A_Eigenvalues_map.emplace(n, this->CalculateAEigenvalues(n));
+  tables.SEigenvectors = Self::CalculateSEigenvectors(n);
+  tables.AEigenvectors = Self::CalculateAEigenvectors(n);
 
-    this->m_S_Eigenvectors_map.emplace(n, this->CalculateSEigenvectors(n));
-    this->m_A_Eigenvectors_map.emplace(n, this->CalculateAEigenvectors(n));
+  tables.SortedEigensystem = Self::CalculateSortedEigensystem(n);
 
-    this->m_Sorted_Eigensystem_map.emplace(n, this->CalculateSortedEigensystem(n));
+  tables.BSplineToBezier = Self::CalculateBSplineToBezierMatrix(n);
+}
 
-    this->m_BSplineToBezier_map.emplace(n, this->CalculateBSplineToBezierMatrix(n));
+template< typename TReal, unsigned int MinN, unsigned int MaxN >
+void
+LoopSubdivisionSurfaceMatrices<TReal,MinN,MaxN>
+::CalculateDerivedValenceTables(const unsigned int &n, ValenceTables &tables) const
+{
+  tables.ThinPlateOperator = this->m_BezierM_root.as_ref() * tables.BSplineToBezier;
+
+  // Appended in the order of ViewIndex
+  tables.Views.Append(tables.S);
+  tables.Views.Append(tables.A);
+  tables.Views.Append(tables.B);
+  for (const auto &picker : tables.P)
+    {
+    tables.Views.Append(picker);
+    }
+  tables.Views.Append(tables.BSplineToBezier);
+  tables.Views.Append(tables.ThinPlateOperator);
+
+  const auto &es = tables.SortedEigensystem;
+  const auto &V = std::get<1>(es);
+  for (const auto &picker : tables.P)
+    {
+    tables.Views.Append((picker * tables.B * V).transpose());
+    }
+  tables.Views.Append(std::get<2>(es));
+  vnl_matrix<TReal> sortedEigenvalues(n+6, 1);
+  for (unsigned int j = 0; j < n+6; ++j)
+    {
+    sortedEigenvalues(j, 0) = tables.AEigenvalues[std::get<0>(es)[j]];
+    }
+  tables.Views.Append(sortedEigenvalues);
+}
+
+////////////////////////
+// Precomputed Tables //
+////////////////////////
+
+template< typename TReal, unsigned int MinN, unsigned int MaxN >
+template< typename TTables, typename TVisitor >
+void
+LoopSubdivisionSurfaceMatrices<TReal,MinN,MaxN>
+::VisitValenceTables(TTables &tables, TVisitor &&visitor)
+{
+  visitor(tables.S);
+  visitor(tables.A);
+  visitor(tables.B);
+  for (auto &picker : tables.P)
+    {
+    visitor(picker);
     }
+  visitor(tables.SEigenvalues);
+  visitor(tables.AEigenvalues);
+  visitor(tables.SEigenvectors);
+  visitor(tables.AEigenvectors);
+  visitor(std::get<0>(tables.SortedEigensystem));
+  visitor(std::get<1>(tables.SortedEigensystem));
+  visitor(std::get<2>(tables.SortedEigensystem));
+  visitor(tables.BSplineToBezier);
+}
+
+template< typename TReal, unsigned int MinN, unsigned int MaxN >
+std::vector<double>
+LoopSubdivisionSurfaceMatrices<TReal,MinN,MaxN>
+::SerializeValenceTables(const unsigned int &n) const
+{
+  const auto &tables = this->GetValenceTables(n);
+
+  std::vector<double> data = {double(n), 0.0};
+  Self::VisitValenceTables(tables, [&data](const auto &m)
+    {
+    Self::WriteTable(data, m);
+    ++data[1];
+    });
+
+  return data;
+}
+
+template< typename TReal, unsigned int MinN, unsigned int MaxN >
+void
+LoopSubdivisionSurfaceMatrices<TReal,MinN,MaxN>
+::DeserializeValenceTables(const unsigned int &n, const double* data, ValenceTables &tables) const
+{
+  itkAssertOrThrowMacro(double(n) == data[0],
+                        "Precomputed tables do not match valence " + std::to_string(n) + ".");
+  const size_t count = size_t(data[1]);
+  data += 2;
+
+  size_t visited = 0;
+  Self::VisitValenceTables(tables, [&data, &visited](auto &m)
+    {
+    Self::ReadTable(data, m);
+    ++visited;
+    });
+
+  itkAssertOrThrowMacro(count == visited,
+                        "Precomputed tables have an unexpected layout.");
 }
 
 ///////////////
@@ -202,6 +335,200 @@ LoopSubdivisionSurfaceMatrices<TReal,MinN,MaxN>
 
 }
 
+////////////////////
+// Surface Points //
+////////////////////
+
+template< typename TReal, unsigned int MinN, unsigned int MaxN >
+vnl_vector<TReal>
+LoopSubdivisionSurfaceMatrices<TReal,MinN,MaxN>
+::CalculateSurfaceWeights(const unsigned int &n, const TParameters &p) const
+{
+  vnl_vector<TReal> w(n+6);
+  this->EvaluateSurfaceWeights(n, p, w.data_block());
+  return w;
+}
+
+template< typename TReal, unsigned int MinN, unsigned int MaxN >
+void
+LoopSubdivisionSurfaceMatrices<TReal,MinN,MaxN>
+::EvaluateSurfaceWeights(const unsigned int &n, const TParameters &p,
+                         TReal* w, TReal* ds, TReal* dt) const
+{
+
+  itkAssertOrThrowMacro(Self::VerifyParameters(p),
+                        "The parameters provided are invalid.");
+
+  const unsigned int K = n + 6;
+  using TVector = Eigen::Matrix<TReal, Eigen::Dynamic, 1, 0, MaxN + 6, 1>; // on the stack
+  using TOutput = Eigen::Map<Eigen::Matrix<TReal, Eigen::Dynamic, 1>>;
+  using TWeights = Eigen::Matrix<TReal, 12, 1>;
+
+  if (6 == n)
+    {
+    const auto b = Self::CalculateBarycentricBSplineWeights(p);
+    std::copy(b.begin(), b.end(), w);
+    if (nullptr != ds || nullptr != dt)
+      {
+      TReal bs[12], bt[12];
+      Self::CalculateBarycentricBSplineWeightsGradient(p, bs, bt);
+      if (nullptr != ds) std::copy(bs, bs + 12, ds);
+      if (nullptr != dt) std::copy(bt, bt + 12, dt);
+      }
+    return;
+    }
+
+  if ( std::abs( std::get<0>(p) ) <= 10e-6 && std::abs( std::get<1>(p) ) <= 10e-6 )
+    {
+    itkAssertOrThrowMacro(nullptr == ds && nullptr == dt,
+                          "Derivatives are not defined at the extraordinary vertex.");
+    const auto &es = this->GetSortedEigensystem(n);
+
+    const auto &sortedRightEigenvectors = std::get<1>(es);
+    const auto &sortedLeftEigenvectors = std::get<2>(es);
+
+    const auto v1R = sortedRightEigenvectors.get_column(0);
+    itkAssertOrThrowMacro(((v1R.sum() / v1R.size()) - v1R[0]) < 10e-6, "");
+    const auto v1L = sortedLeftEigenvectors.get_column(0) * v1R.get(0);
+    std::copy(v1L.begin(), v1L.end(), w);
+    return;
+    }
+
+  const auto p_t = Self::TransformParametersToPatch(p);
+  itkAssertOrThrowMacro(Self::VerifyParameters(p_t),
+                        "The transformed parameters are invalid.");
+  const unsigned int k = Self::CalculateChildIndex(p);
+  const unsigned int l = Self::CalculateNumberOfRequiredSubdivisions(p);
+
+  const auto &views = this->GetValenceTables(n).Views;
+  const auto Phi    = views.Get(ViewEigenbasisProjection + k);
+  const auto W      = views.Get(ViewEigenbasisLeft);
+  const auto lambda = views.Get(ViewEigenbasisValues);
+
+  // Lambda^(l-1), one entry per eigenvalue.
+  TVector scale(K);
+  for (unsigned int j = 0; j < K; ++j)
+    {
+    scale[j] = std::pow(lambda(j, 0), TReal(l - 1));
+    }
+
+  const auto b = Self::CalculateBarycentricBSplineWeights(p_t);
+  const TVector c = scale.cwiseProduct(Phi * Eigen::Map<const TWeights>(b.data_block()));
+  TOutput(w, K) = W * c;
+
+  if (nullptr == ds && nullptr == dt)
+    {
+    return;
+    }
+
+  // Chain rule through the patch transformation: p_t = +/- 2^l p + offset.
+  TReal bs[12], bt[12];
+  Self::CalculateBarycentricBSplineWeightsGradient(p_t, bs, bt);
+  const TReal dp = Self::BarycentricBSplineWeightScale(1, k, l);
+
+  if (nullptr != ds)
+    {
+    const TVector cs = scale.cwiseProduct(Phi * Eigen::Map<const TWeights>(bs)) * dp;
+    TOutput(ds, K) = W * cs;
+    }
+  if (nullptr != dt)
+    {
+    const TVector ct = scale.cwiseProduct(Phi * Eigen::Map<const TWeights>(bt)) * dp;
+    TOutput(dt, K) = W * ct;
+    }
+
+}
+
+template< typename TReal, unsigned int MinN, unsigned int MaxN >
+vnl_vector<TReal>
+LoopSubdivisionSurfaceMatrices<TReal,MinN,MaxN>
+::CalculateSurfaceWeightsBySubdivision(const unsigned int &n, const TParameters &p) const
+{
+
+  itkAssertOrThrowMacro(Self::VerifyParameters(p),
+                        "The parameters provided are invalid.");
+
+  if (6 == n)
+    {
+    return Self::CalculateBarycentricBSplineWeights(p).as_vector();
+    }
+
+  if ( std::abs( std::get<0>(p) ) > 10e-6 || std::abs( std::get<1>(p) ) > 10e-6 )
+    {
+    const auto p_t = Self::TransformParametersToPatch(p);
+    itkAssertOrThrowMacro(Self::VerifyParameters(p_t),
+                        "The transformed parameters are invalid.");
+    const unsigned int k = Self::CalculateChildIndex(p);
+    const unsigned int l = Self::CalculateNumberOfRequiredSubdivisions(p);
+    const auto wts = Self::CalculateBarycentricBSplineWeights(p_t);
+
+    // (P B A^(l-1))^T wts, applied right to left as matrix-vector products.
+    const auto A = this->GetAView(n);
+    const auto B = this->GetBView(n);
+    const auto P = this->GetPView(n,k);
+    Eigen::Matrix<TReal, Eigen::Dynamic, 1> w
+      = P.transpose() * Eigen::Map<const Eigen::Matrix<TReal, 12, 1>>(wts.data_block());
+    w = B.transpose() * w;
+    for (unsigned int i = 1; i < l; ++i)
+      {
+      w = A.transpose() * w;
+      }
+
+    return vnl_vector<TReal>(w.data(), w.size());
+    }
+  else // Deal with origin separately
+    {
+    const auto &es = this->GetSortedEigensystem(n);
+
+    const auto &sortedRightEigenvectors = std::get<1>(es);
+    const auto &sortedLeftEigenvectors = std::get<2>(es);
+
+    const auto v1R = sortedRightEigenvectors.get_column(0);
+    itkAssertOrThrowMacro(((v1R.sum() / v1R.size()) - v1R[0]) < 10e-6, "");
+    return sortedLeftEigenvectors.get_column(0) * v1R.get(0);
+    }
+
+}
+
+template< typename TReal, unsigned int MinN, unsigned int MaxN >
+std::vector<typename LoopSubdivisionSurfaceMatrices<TReal,MinN,MaxN>::TParameters>
+LoopSubdivisionSurfaceMatrices<TReal,MinN,MaxN>
+::CalculateSampleParameters(const unsigned int &density)
+{
+
+  itkAssertOrThrowMacro( density > 0,
+                         "Surface sample density must be greater than zero." );
+
+  std::vector<TParameters> parameters;
+
+  TReal StepSize = 1.0 / (TReal(density) + 1.0);
+
+  for (TReal s = StepSize/2; s < 1.0; s += StepSize)
+    {
+    for (TReal t = StepSize/2; t < 1.0-s; t += StepSize)
+      {
+      parameters.push_back(std::make_pair(s, t));
+      }
+    }
+
+  return parameters;
+
+}
+
+template< typename TReal, unsigned int MinN, unsigned int MaxN >
+const typename LoopSubdivisionSurfaceMatrices<TReal,MinN,MaxN>::StencilTable&
+LoopSubdivisionSurfaceMatrices<TReal,MinN,MaxN>
+::GetStencilTable(const unsigned int &density) const
+{
+  std::lock_guard<std::mutex> lock(this->m_StencilTable_mutex);
+  auto it = this->m_StencilTable_map.find(density);
+  if (this->m_StencilTable_map.end() == it)
+    {
+    it = this->m_StencilTable_map.try_emplace(density, *this, density).first;
+    }
+  return it->second;
+}
+
 template< typename TReal, unsigned int MinN, unsigned int MaxN >
 vnl_matrix<TReal>
 LoopSubdivisionSurfaceMatrices<TReal,MinN,MaxN>
@@ -435,6 +762,57 @@ LoopSubdivisionSurfaceMatrices<TReal,MinN,MaxN>
 
 }
 
+template< typename TReal, unsigned int MinN, unsigned int MaxN >
+void
+LoopSubdivisionSurfaceMatrices<TReal,MinN,MaxN>
+::CalculateBarycentricBSplineWeightsGradient(const TParameters &p, TReal* dws, TReal* dwt)
+{
+
+  const TReal s = p.first;
+  const TReal t = p.second;
+
+  const TReal s1 =     s;
+  const TReal s2 = pow(s,2);
+  const TReal s3 = pow(s,3);
+
+  const TReal t1 =     t;
+  const TReal t2 = pow(t,2);
+  const TReal t3 = pow(t,3);
+
+  dws[ 0] = -4*s3-6*s2*t1-2*t3+24*s2+24*s1*t1+12*t2-24*s1-12*t1;
+  dws[ 1] = -4*s3-6*s2*t1+4*t3-12*s2-12*s1*t1-12*t2+12*s1+6*t1+4;
+  dws[ 2] = 8*s3+12*s2*t1-2*t3-12*s2+6*t2-6*t1+2;
+  dws[ 3] = -4*s3-6*s2*t1+2*t3+6*s2-6*t2+6*t1-2;
+  dws[ 4] = 4*s3+6*s2*t1-2*t3-12*s2-12*s1*t1+12*s1+6*t1-4;
+  dws[ 5] = -4*s3-6*s2*t1+4*t3+6*s2+12*s1*t1-6*t1-2;
+  dws[ 6] = 8*s3+12*s2*t1-2*t3-12*s2-24*s1*t1-6*t2+6*t1+2;
+  dws[ 7] = -4*s3-6*s2*t1-2*t3+6*s2+12*s1*t1+6*t2;
+  dws[ 8] = 4*s3+6*s2*t1;
+  dws[ 9] = -4*s3-6*s2*t1+6*s2;
+  dws[10] = 2*t3;
+  dws[11] = -2*t3;
+
+  dwt[ 0] = -2*s3-6*s1*t2-4*t3+12*s2+24*s1*t1+24*t2-12*s1-24*t1;
+  dwt[ 1] = -2*s3+12*s1*t2+8*t3-6*s2-24*s1*t1-12*t2+6*s1+2;
+  dwt[ 2] = 4*s3-6*s1*t2-4*t3+12*s1*t1+6*t2-6*s1-2;
+  dwt[ 3] = -2*s3+6*s1*t2+4*t3-12*s1*t1-12*t2+6*s1+12*t1-4;
+  dwt[ 4] = 2*s3-6*s1*t2-4*t3-6*s2+6*t2+6*s1-2;
+  dwt[ 5] = -2*s3+12*s1*t2+8*t3+6*s2-12*t2-6*s1+2;
+  dwt[ 6] = 4*s3-6*s1*t2-4*t3-12*s2-12*s1*t1-12*t2+6*s1+12*t1+4;
+  dwt[ 7] = -2*s3-6*s1*t2-4*t3+6*s2+12*s1*t1+6*t2;
+  dwt[ 8] = 2*s3;
+  dwt[ 9] = -2*s3;
+  dwt[10] = 6*s1*t2+4*t3;
+  dwt[11] = -6*s1*t2-4*t3+6*t2;
+
+  for (unsigned int i = 0; i < 12; ++i)
+    {
+    dws[i] /= 12.;
+    dwt[i] /= 12.;
+    }
+
+}
+
 //////////////////////////
 // Subdivision Matrices //
 //////////////////////////
@@ -4,6 +4,8 @@
 // std
 #include <utility>
 #include <math.h>
+#include <array>
+#include <vector>
 
 // ITK
 #include "itkQuadEdgeMesh.h"
@@ -38,11 +40,9 @@ namespace itk
  * | S11 S12 |
  * | S21 S22 |
  * 
- * Possible Optimizations:
- * - Precalculate matrices for the desired Ns
- * - Use Eigen system
- * - NB: These optimizations are probably unnecessary unless
- *       the mesh is very large/has highly extraordinary points.
+ * Every cell is sampled at the same parameters, so the weights of the
+ * control points for each sample are looked up in a stencil table
+ * shared by all meshes of the same sample density.
  *
  * \author Davis Vigneault
  *
@@ -89,6 +89,7 @@ public:
   using TSurfaceParameter = std::pair<CellIdentifier, TParameters>;
   using TSurfaceParameterList = std::vector<TSurfaceParameter>;
   using TOneRingMap = std::map<CellIdentifier, vnl_vector<PointIdentifier>>;
+  using TStencilTable = typename TMatrices::StencilTable;
 
   /** Basic Object interface. */
   itkNewMacro(Self);
@@ -97,18 +98,43 @@ public:
   /** Calculates the valency map, the N map, and the surface parameter list. */
   void Setup();
   PointType GetPointOnSurface(const CellIdentifier &cellID, const TParameters &p) const;
+  /** The limit point at p together with its partial derivatives with respect to s and t. */
+  void GetPointAndTangentsOnSurface(const CellIdentifier &cellID,
+                                    const TParameters &p,
+                                    PointType &point,
+                                    typename PointType::VectorType &ds,
+                                    typename PointType::VectorType &dt) const;
   itkGetConstMacro(SurfaceParameterList, TSurfaceParameterList);
 
   vnl_vector<TReal> GetResidualBlock(const CellIdentifier &cellID, const TParameters &p) const;
 
+  /** The N+6 control point weights for the i'th entry of the surface parameter list. */
+  const TReal* GetStencil(const size_t &i) const
+    {
+    const auto &cellID = this->m_SurfaceParameterList[i].first;
+    return this->m_StencilTable->GetStencil(this->m_NMap.at(cellID),
+                                            i % this->m_StencilTable->GetNumberOfSamples());
+    }
+
+  /** Transposed stencils of regular (valence 6) cells, for sissr::RegularPatchKernel:
+   *  12 rows of GetRegularStencilStride() samples, in the order of each cell's entries. */
+  const double* GetRegularStencils() const
+    { return this->m_StencilTable->GetTransposedStencils(6); }
+  size_t GetRegularStencilStride() const
+    { return this->m_StencilTable->GetTransposedStride(); }
+
+  /** Entries of the surface parameter list per cell; consecutive entries share a cell. */
+  size_t GetNumberOfSamplesPerCell() const
+    { return this->m_StencilTable->GetNumberOfSamples(); }
+
   // Utility functions
-  vnl_vector<PointIdentifier> GetPointListForCell(const CellIdentifier &cellID) const
+  const vnl_vector<PointIdentifier>& GetPointListForCell(const CellIdentifier &cellID) const
     {
     return this->m_OneRingMap.at(cellID);
     }
 
-  TSurfaceParameter
-  GetSurfaceParameter(const size_t &i)
+  const TSurfaceParameter&
+  GetSurfaceParameter(const size_t &i) const
     {
     return this->m_SurfaceParameterList.at(i);
     }
@@ -116,6 +142,9 @@ public:
   // Matrices
   vnl_matrix<TReal> CalculateControlPointMatrix(const CellIdentifier &cellID) const;
   vnl_vector_fixed<TReal,45> CalculateThinPlateEnergyVectorForCell(const CellIdentifier &cellID) const;
+  /** As above, but for an explicit (N+6)x3 control point matrix rather than the mesh points. */
+  vnl_vector_fixed<TReal,45> CalculateThinPlateEnergyVectorForControlPoints(const CellIdentifier &cellID,
+                                                                            const vnl_matrix<TReal> &X) const;
   static const TMatrices m_Matrices;
   unsigned int GetNForCell(const CellIdentifier &cellID) const
     { return this->m_NMap.at(cellID); }
@@ -152,9 +181,21 @@ protected:
   TOneRingMap           m_OneRingMap;
   TSurfaceParameterList m_SurfaceParameterList;
   unsigned int          m_SurfaceSampleDensity = 2;
+  const TStencilTable*  m_StencilTable = nullptr;
 
 private:
 
+  /** Triangulated parameter grid used by CalculateSurfaceAreaForCell(),
+   *  with transposed regular patch stencils for the grid points. */
+  struct SurfaceAreaGrid
+  {
+    std::vector<TParameters>           Parameters;
+    std::vector<std::array<size_t, 3>> Triangles;
+    std::vector<double>                RegularStencils;
+    size_t                             RegularStencilStride = 0;
+  };
+  static const SurfaceAreaGrid& GetSurfaceAreaGrid();
+
   ITK_DISALLOW_COPY_AND_ASSIGN(LoopSubdivisionSurfaceMesh);
 
 };
@@ -10,6 +10,9 @@
 #include "itkTriangleHelper.h"
 #include "itkMacro.h"
 
+// SiSSR
+#include "sissrRegularPatchKernel.h"
+
 namespace itk
 {
 
@@ -40,6 +43,7 @@ void
 LoopSubdivisionSurfaceMesh<TReal,VDimension,TTraits>
 ::Setup()
 {
+  this->m_StencilTable         = &this->m_Matrices.GetStencilTable(this->m_SurfaceSampleDensity);
   this->m_VMap                 = this->CalculateValencyMap();
   this->m_NMap                 = this->CalculateNMap();
   this->m_SurfaceParameterList = this->CalculateParameterList();
@@ -114,23 +118,16 @@ LoopSubdivisionSurfaceMesh<TReal,VDimension,TTraits>
 {
   TSurfaceParameterList surfaceParameters;
 
-  itkAssertOrThrowMacro( this->m_SurfaceSampleDensity > 0,
-                         "Surface sample density must be greater than zero." );
-
-  TReal StepSize = 1.0 / (TReal(this->m_SurfaceSampleDensity) + 1.0);
+  // Entries are cell-major, with samples in stencil table order.
+  const auto &samples = this->m_StencilTable->GetParameters();
 
   for (auto it  = this->GetCells()->Begin();
             it != this->GetCells()->End();
           ++it)
     {
-    for (TReal s = StepSize/2; s < 1.0; s += StepSize)
+    for (const auto &p : samples)
       {
-      for (TReal t = StepSize/2; t < 1.0-s; t += StepSize)
-        {
-        const auto p = std::make_pair(s, t);
-        const auto u = std::make_pair(it.Index(), p);
-        surfaceParameters.push_back(u);
-        }
+      surfaceParameters.push_back(std::make_pair(it.Index(), p));
       }
     }
 
@@ -147,61 +144,60 @@ LoopSubdivisionSurfaceMesh<TReal,VDimension,TTraits>
 ::GetPointOnSurface(const CellIdentifier &cellID, const TParameters &p) const
 {
 
-  const auto C0 = this->CalculateControlPointMatrix(cellID);
-  vnl_matrix<TReal> C0_copy(C0.data_block(), C0.rows(), C0.cols());
-
+  const auto &L = this->GetPointListForCell(cellID);
   const auto R = this->GetResidualBlock(cellID,p);
-  const auto pointValues(C0_copy.transpose()*R);
-  const PointType point(pointValues.data_block());
+
+  PointType point;
+  point.Fill(0.0);
+  for (unsigned int i = 0; i < L.size(); ++i)
+    {
+    const auto &c = this->GetPoints()->GetElement(L[i]);
+    for (unsigned int d = 0; d < VDimension; ++d)
+      point[d] += R[i] * c[d];
+    }
 
   return point;
 
 }
 
 template< typename TReal, unsigned int VDimension, typename TTraits >
-vnl_vector< TReal >
+void
 LoopSubdivisionSurfaceMesh<TReal,VDimension,TTraits>
-::GetResidualBlock(const CellIdentifier &cellID, const TParameters &p) const
+::GetPointAndTangentsOnSurface(const CellIdentifier &cellID,
+                               const TParameters &p,
+                               PointType &point,
+                               typename PointType::VectorType &ds,
+                               typename PointType::VectorType &dt) const
 {
 
-  itkAssertOrThrowMacro(this->m_Matrices.VerifyParameters(p),
-                        "The parameters provided are invalid.");
+  constexpr unsigned int MaxK = TMatrices::MaximumValency + 6;
+  TReal w[MaxK], ws[MaxK], wt[MaxK];
 
-  const auto N = this->m_NMap.at(cellID);
+  const auto &L = this->GetPointListForCell(cellID);
+  this->m_Matrices.EvaluateSurfaceWeights(this->m_NMap.at(cellID), p, w, ws, wt);
 
-  if (6 == N)
+  point.Fill(0.0);
+  ds.Fill(0.0);
+  dt.Fill(0.0);
+  for (unsigned int i = 0; i < L.size(); ++i)
     {
-    return this->m_Matrices.CalculateBarycentricBSplineWeights(p).as_vector();
+    const auto &c = this->GetPoints()->GetElement(L[i]);
+    for (unsigned int d = 0; d < VDimension; ++d)
+      {
+      point[d] += w[i] * c[d];
+      ds[d] += ws[i] * c[d];
+      dt[d] += wt[i] * c[d];
+      }
     }
 
-  if ( std::abs( std::get<0>(p) ) > 10e-6 || std::abs( std::get<1>(p) ) > 10e-6 )
-    {
-    const auto p_t = this->m_Matrices.TransformParametersToPatch(p);
-    itkAssertOrThrowMacro(this->m_Matrices.VerifyParameters(p_t),
-                        "The transformed parameters are invalid.");
-    const auto A = this->m_Matrices.GetA(N);
-    const auto B = this->m_Matrices.GetB(N);
-    vnl_matrix<TReal> B_copy(B.data_block(), B.rows(), B.cols());
-    const unsigned int k = this->m_Matrices.CalculateChildIndex(p);
-    const unsigned int l = this->m_Matrices.CalculateNumberOfRequiredSubdivisions(p);
-    const auto wts = this->m_Matrices.CalculateBarycentricBSplineWeights(p_t);
-    const auto P = this->m_Matrices.GetP(N,k);
-    vnl_matrix<TReal> P_copy(P.data_block(), P.rows(), P.cols());
-  
-    return (P_copy*B_copy*vnl_power(A,l-1)).transpose()*wts;
-    }
-  else // Deal with origin separately
-    {
-    const auto es = this->m_Matrices.GetSortedEigensystem(N);
-
-    const auto sortedRightEigenvectors = std::get<1>(es);
-    const auto sortedLeftEigenvectors = std::get<2>(es);
-
-    const auto v1R = sortedRightEigenvectors.get_column(0);
-    itkAssertOrThrowMacro(((v1R.sum() / v1R.size()) - v1R[0]) < 10e-6, "");
-    return sortedLeftEigenvectors.get_column(0) * v1R.get(0);
-    }
+}
 
+template< typename TReal, unsigned int VDimension, typename TTraits >
+vnl_vector< TReal >
+LoopSubdivisionSurfaceMesh<TReal,VDimension,TTraits>
+::GetResidualBlock(const CellIdentifier &cellID, const TParameters &p) const
+{
+  return this->m_Matrices.CalculateSurfaceWeights(this->m_NMap.at(cellID), p);
 }
 
 template< typename TReal, unsigned int VDimension, typename TTraits >
@@ -344,20 +340,30 @@ vnl_vector_fixed<TReal,45>
 LoopSubdivisionSurfaceMesh<TReal,VDimension,TTraits>
 ::CalculateThinPlateEnergyVectorForCell(const CellIdentifier &cellID) const
 {
+  return this->CalculateThinPlateEnergyVectorForControlPoints(cellID, this->CalculateControlPointMatrix(cellID));
+}
 
-  const auto X = this->CalculateControlPointMatrix(cellID);
-  const vnl_matrix<TReal> X_copy(X.data_block(), X.rows(), X.cols());
+template< typename TReal, unsigned int VDimension, typename TTraits >
+vnl_vector_fixed<TReal,45>
+LoopSubdivisionSurfaceMesh<TReal,VDimension,TTraits>
+::CalculateThinPlateEnergyVectorForControlPoints(const CellIdentifier &cellID,
+                                                 const vnl_matrix<TReal> &X) const
+{
 
-  const auto N = this->GetNForCell(cellID);
-  const auto P = this->m_Matrices.GetBSplineToBezier(N);
-  const vnl_matrix<TReal> P_copy(P.data_block(), P.rows(), P.cols());
+  // Equivalent to the block root energy applied to the columnwise
+  // flattened Bezier control points.
+  using TEigenMatrix = typename TMatrices::TEigenMatrix;
+  const auto B = this->m_Matrices.GetThinPlateOperatorView(this->GetNForCell(cellID));
+  const Eigen::Map<const TEigenMatrix> C(X.data_block(), X.rows(), X.cols());
 
-  const auto B = (P_copy * X_copy).flatten_column_major();
-  const auto M = this->m_Matrices.GetBezierMRootBlock();
-  const vnl_matrix<TReal> M_copy(M.data_block(), M.rows(), M.cols());
+  const Eigen::Matrix<TReal, 15, 3> E = B * C;
+
+  vnl_vector_fixed<TReal,45> energy;
+  for (unsigned int d = 0; d < 3; ++d)
+    for (unsigned int r = 0; r < 15; ++r)
+      energy[15*d+r] = E(r,d);
+  return energy;
 
-  return M_copy * B;
-  
 }
 
 template< typename TReal, unsigned int VDimension, typename TTraits >
@@ -382,41 +388,109 @@ LoopSubdivisionSurfaceMesh<TReal,VDimension,TTraits>
 ::CalculateSurfaceAreaForCell(const CellIdentifier &cellID) const
 {
 
-  /*
-   * 1. Get the cell's control points.
-   * 2. Create a mesh.
-   * 3. Subdivide the specified number of times.
-   * 4. Sum the areas of all internal triangles.
-   */
+  const auto &grid = Self::GetSurfaceAreaGrid();
+  const size_t numberOfPoints = grid.Parameters.size();
+
+  std::vector<PointType> points(numberOfPoints);
+  if (6 == this->m_NMap.at(cellID))
+    {
+    const auto &L = this->GetPointListForCell(cellID);
+    double x[3 * sissr::RegularPatchKernel::K];
+    for (unsigned int i = 0; i < sissr::RegularPatchKernel::K; ++i)
+      {
+      const auto &c = this->GetPoints()->GetElement(L[i]);
+      for (unsigned int d = 0; d < 3; ++d) x[3 * i + d] = c[d];
+      }
+    std::vector<double> xyz(3 * numberOfPoints);
+    sissr::RegularPatchKernel::EvaluateGathered(grid.RegularStencils.data(),
+                                                grid.RegularStencilStride,
+                                                numberOfPoints, x, xyz.data());
+    for (size_t j = 0; j < numberOfPoints; ++j)
+      {
+      for (unsigned int d = 0; d < 3; ++d) points[j][d] = xyz[3 * j + d];
+      }
+    }
+  else
+    {
+    for (size_t j = 0; j < numberOfPoints; ++j)
+      {
+      points[j] = this->GetPointOnSurface(cellID, grid.Parameters[j]);
+      }
+    }
 
   TReal area = 0.0;
+  for (const auto &t : grid.Triangles)
+    {
+    area += itk::TriangleHelper<Self::PointType>::ComputeArea(points[t[0]], points[t[1]], points[t[2]]);
+    }
+
+  return area;
 
-  TReal StepSize = 0.04;
-  for (TReal s = 0.0; (s + StepSize) < 1.0; s += StepSize)
+}
+
+template< typename TReal, unsigned int VDimension, typename TTraits >
+const typename LoopSubdivisionSurfaceMesh<TReal,VDimension,TTraits>::SurfaceAreaGrid&
+LoopSubdivisionSurfaceMesh<TReal,VDimension,TTraits>
+::GetSurfaceAreaGrid()
+{
+
+  static const SurfaceAreaGrid grid = []()
     {
-    for (TReal t = 0.0; (t + StepSize) < (1.0 - s); t += StepSize)
+
+    /*
+     * Triangulate the parameter domain on a regular grid; every grid point
+     * is evaluated once and shared by the triangles around it.
+     */
+    SurfaceAreaGrid g;
+    std::map<std::pair<unsigned int, unsigned int>, size_t> indices;
+    const auto index = [&g, &indices](unsigned int i, unsigned int j, const TParameters &p)
+      {
+      const auto it = indices.try_emplace(std::make_pair(i, j), g.Parameters.size());
+      if (it.second) g.Parameters.push_back(p);
+      return it.first->second;
+      };
+
+    TReal StepSize = 0.04;
+    unsigned int i = 0;
+    for (TReal s = 0.0; (s + StepSize) < 1.0; s += StepSize, ++i)
       {
+      unsigned int j = 0;
+      for (TReal t = 0.0; (t + StepSize) < (1.0 - s); t += StepSize, ++j)
+        {
 
-      const auto p_a = std::make_pair(s           , t           );
-      const auto p_b = std::make_pair(s           , t + StepSize);
-      const auto p_c = std::make_pair(s + StepSize, t           );
+        const auto a = index(i    , j    , std::make_pair(s           , t           ));
+        const auto b = index(i    , j + 1, std::make_pair(s           , t + StepSize));
+        const auto c = index(i + 1, j    , std::make_pair(s + StepSize, t           ));
 
-      const auto a = this->GetPointOnSurface(cellID, p_a);
-      const auto b = this->GetPointOnSurface(cellID, p_b);
-      const auto c = this->GetPointOnSurface(cellID, p_c);
+        g.Triangles.push_back({{a, b, c}});
 
-      area += itk::TriangleHelper<Self::PointType>::ComputeArea(a, b, c);
+        if (( s + t + 2. * StepSize) < 1.0)
+          {
+          const auto d = index(i + 1, j + 1, std::make_pair(s + StepSize, t + StepSize));
+          g.Triangles.push_back({{d, b, c}});
+          }
+        }
+      }
 
-      if (( s + t + 2. * StepSize) < 1.0)
+    // Regular patch weights, transposed for the batch kernel
+    const size_t numberOfPoints = g.Parameters.size();
+    g.RegularStencilStride = numberOfPoints;
+    g.RegularStencils.resize(sissr::RegularPatchKernel::K * numberOfPoints);
+    for (size_t k = 0; k < numberOfPoints; ++k)
+      {
+      TReal w[sissr::RegularPatchKernel::K];
+      Self::m_Matrices.EvaluateSurfaceWeights(6, g.Parameters[k], w);
+      for (unsigned int l = 0; l < sissr::RegularPatchKernel::K; ++l)
         {
-        const auto p_d = std::make_pair(s + StepSize, t + StepSize);
-        const auto d = this->GetPointOnSurface(cellID, p_d);
-        area += itk::TriangleHelper<Self::PointType>::ComputeArea(d, b, c);
+        g.RegularStencils[l * numberOfPoints + k] = w[l];
         }
       }
-    }
 
-  return area;
+    return g;
+
+    }();
+
+  return grid;
 
 }
 
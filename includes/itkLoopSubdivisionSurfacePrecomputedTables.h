@@ -0,0 +1,21 @@
+#ifndef itk_LoopSubdivisionSurfacePrecomputedTables_h
+#define itk_LoopSubdivisionSurfacePrecomputedTables_h
+
+namespace itk
+{
+namespace LoopSubdivisionSurfacePrecomputedTables
+{
+
+/*
+ * Tables for valence n, in the layout of
+ * LoopSubdivisionSurfaceMatrices::SerializeValenceTables, or nullptr if
+ * valence n was not precomputed.
+ *
+ * The definition is generated at build time by dv-sissr-generate-tables.
+ */
+const double* Get(const unsigned int &n);
+
+} // namespace LoopSubdivisionSurfacePrecomputedTables
+} // namespace itk
+
+#endif
@@ -3,6 +3,7 @@
 
 #include <ceres/ceres.h>
 #include <limits>
+#include <sissrControlPointBuffer.h>
 #include <vnl/vnl_math.h>
 
 namespace sissr {
@@ -12,12 +13,9 @@ class AccelerationRegularizer : public ceres::CostFunction
 {
 
 public:
-  AccelerationRegularizer(
-    const typename std::vector<typename TMovingMesh::Pointer>& _movingVector,
-    const typename std::vector<typename TMovingMesh::PointsContainer::Pointer>&
-      _initialPointsVector,
-    unsigned int _frame,
-    unsigned int _index);
+  AccelerationRegularizer(const ControlPointBuffer& _buffer,
+                          unsigned int _frame,
+                          unsigned int _index);
 
   bool Evaluate(const double* const* parameters,
                 double* residuals,
@@ -31,9 +29,7 @@ private:
   unsigned int GetCurrentFrame() const;
   unsigned int GetNextFrame() const;
 
-  const typename std::vector<typename TMovingMesh::Pointer> movingVector;
-  const typename std::vector<typename TMovingMesh::PointsContainer::Pointer>&
-    initialPointsVector;
+  const ControlPointBuffer& buffer;
 
   const unsigned int frame;
   const unsigned int index;
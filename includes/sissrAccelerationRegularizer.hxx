@@ -8,13 +8,10 @@ namespace sissr {
 
 template<class TMovingMesh>
 AccelerationRegularizer<TMovingMesh>::AccelerationRegularizer(
-  const typename std::vector<typename TMovingMesh::Pointer>& _movingVector,
-  const typename std::vector<typename TMovingMesh::PointsContainer::Pointer>&
-    _initialPointsVector,
+  const ControlPointBuffer& _buffer,
   unsigned int _frame,
   unsigned int _index)
-  : movingVector(_movingVector)
-  , initialPointsVector(_initialPointsVector)
+  : buffer(_buffer)
   , frame(_frame)
   , index(_index)
 {
@@ -27,7 +24,7 @@ AccelerationRegularizer<TMovingMesh>::AccelerationRegularizer(
 
 template<class TMovingMesh>
 bool
-AccelerationRegularizer<TMovingMesh>::Evaluate(const double* const* parameters,
+AccelerationRegularizer<TMovingMesh>::Evaluate(const double* const* /*parameters*/,
                                                double* residuals,
                                                double** jacobians) const
 {
@@ -35,24 +32,9 @@ AccelerationRegularizer<TMovingMesh>::Evaluate(const double* const* parameters,
   const auto dim = TMovingMesh::PointType::Dimension;
 
   // Residuals
-  auto p0 =
-    this->initialPointsVector.at(this->GetPrevFrame())->ElementAt(this->index);
-  for (unsigned int i = 0; i < dim; ++i)
-    p0[i] += parameters[0][i];
-
-  auto p1 = this->initialPointsVector.at(this->GetCurrentFrame())
-              ->ElementAt(this->index);
-  for (unsigned int i = 0; i < dim; ++i)
-    p1[i] += parameters[1][i];
-
-  auto p2 =
-    this->initialPointsVector.at(this->GetNextFrame())->ElementAt(this->index);
-  for (unsigned int i = 0; i < dim; ++i)
-    p2[i] += parameters[2][i];
-
-  this->movingVector.at(this->GetPrevFrame())->SetPoint(this->index, p0);
-  this->movingVector.at(this->GetCurrentFrame())->SetPoint(this->index, p1);
-  this->movingVector.at(this->GetNextFrame())->SetPoint(this->index, p2);
+  const double* p0 = this->buffer.GetPoint(this->GetPrevFrame(), this->index);
+  const double* p1 = this->buffer.GetPoint(this->GetCurrentFrame(), this->index);
+  const double* p2 = this->buffer.GetPoint(this->GetNextFrame(), this->index);
 
   for (unsigned int i = 0; i < dim; ++i) {
     residuals[i] = p2[i] - 2.0 * p1[i] + p0[i];
@@ -72,9 +54,12 @@ AccelerationRegularizer<TMovingMesh>::Evaluate(const double* const* parameters,
 
   // Set the relevant Jacobians.
   for (unsigned int i = 0; i < dim; ++i) {
-    jacobians[0][i + i * dim] = 1;
-    jacobians[1][i + i * dim] = -2;
-    jacobians[2][i + i * dim] = 1;
+    if (nullptr != jacobians[0])
+      jacobians[0][i + i * dim] = 1;
+    if (nullptr != jacobians[1])
+      jacobians[1][i + i * dim] = -2;
+    if (nullptr != jacobians[2])
+      jacobians[2][i + i * dim] = 1;
   }
 
   return true;
@@ -84,7 +69,7 @@ template<class TMovingMesh>
 unsigned int
 AccelerationRegularizer<TMovingMesh>::GetNumberOfFrames() const
 {
-  return this->movingVector.size();
+  return this->buffer.GetNumberOfFrames();
 }
 
 template<class TMovingMesh>
@@ -0,0 +1,514 @@
+#ifndef sissr_AlternatingSolver_h
+#define sissr_AlternatingSolver_h
+
+// STD
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Ceres
+#include <ceres/ceres.h>
+
+// SuiteSparse
+#include <cholmod.h>
+
+// ITK
+#include <itkMacro.h>
+
+// SiSSR
+#include <sissrEliminationOrdering.h>
+
+namespace sissr {
+
+// Calls the options' iteration callbacks, as ceres::Solve would.  False if
+// one of them ended the solve; the summary then says why.
+inline bool
+NotifyIterationCallbacks(const ceres::Solver::Options &options,
+                         const ceres::IterationSummary &iteration,
+                         ceres::Solver::Summary *summary)
+{
+  for (const auto callback : options.callbacks)
+    {
+    const auto result = (*callback)(iteration);
+    if (ceres::SOLVER_TERMINATE_SUCCESSFULLY == result)
+      {
+      summary->termination_type = ceres::USER_SUCCESS;
+      summary->message = "User callback returned SOLVER_TERMINATE_SUCCESSFULLY.";
+      return false;
+      }
+    if (ceres::SOLVER_ABORT == result)
+      {
+      summary->termination_type = ceres::USER_FAILURE;
+      summary->message = "User callback returned SOLVER_ABORT.";
+      return false;
+      }
+    }
+  return true;
+}
+
+/*
+ ICP-style alternative to ceres::Solve for problems whose residuals are
+ linear in the parameters once the correspondences are held fixed: the
+ primary point-to-point residuals, whose Jacobians are stencil weights, and
+ the velocity, acceleration, edge length and thin plate terms.  Their
+ Jacobian J, with the loss scales applied, does not depend on the positions.
+
+ J is evaluated by Ceres once, and J^T J is analyzed and factorized by
+ CHOLMOD on the first solve, and again only if residual blocks have been
+ added to or removed from the problem since.  Each iteration then finds the correspondences
+ of the current positions (`search` is called before every evaluation),
+ evaluates the residuals r and takes the step solving J^T J dx = -J^T r by
+ back-substitution alone.
+
+ Each of these terms treats x, y and z alike: its Jacobian blocks are
+ scalars times the 3x3 identity.  When the whole of J is of that form, only
+ the scalar matrix S over the parameter blocks is stored, S^T S (a third of
+ the size, and about a ninth of the nonzeros, of J^T J) is factorized, and
+ the three coordinates are solved for as three right-hand sides at once.
+ Otherwise J^T J itself is factorized.
+
+ With fixed correspondences the step is exact, and new correspondences can
+ only be closer, so the cost never increases; an iteration which does not
+ lower it ends the solve.  The function and parameter tolerances, the
+ iteration and time limits and the iteration callbacks of the options are
+ honored, and the summary is filled in as far as it applies.
+
+ All parameter blocks must have size 3.  A tiny ridge, relative to the
+ largest diagonal entry, keeps J^T J positive definite when some parameter
+ is not constrained at all.
+ */
+class AlternatingSolver
+{
+
+public:
+
+  AlternatingSolver(ceres::Problem &_problem,
+                    std::vector<double*> _parameterBlocks,
+                    std::function<void()> _search) :
+    problem(_problem),
+    parameterBlocks(std::move(_parameterBlocks)),
+    search(std::move(_search))
+  {
+    itkAssertOrThrowMacro(!this->parameterBlocks.empty(), "No parameter blocks.");
+    for (const auto block : this->parameterBlocks)
+      itkAssertOrThrowMacro(3 == this->problem.ParameterBlockSize(block), "Parameter blocks must have size 3.");
+    cholmod_start(&this->common);
+  }
+
+  ~AlternatingSolver()
+  {
+    if (nullptr != this->factor) cholmod_free_factor(&this->factor, &this->common);
+    if (nullptr != this->JT) cholmod_free_sparse(&this->JT, &this->common);
+    cholmod_finish(&this->common);
+  }
+
+  AlternatingSolver(const AlternatingSolver&) = delete;
+  AlternatingSolver& operator=(const AlternatingSolver&) = delete;
+
+  void Solve(const ceres::Solver::Options &options, ceres::Solver::Summary *summary)
+  {
+    const auto start = std::chrono::steady_clock::now();
+    const auto since = [](const std::chrono::steady_clock::time_point &t) {
+      return std::chrono::duration<double>(std::chrono::steady_clock::now() - t).count();
+    };
+
+    *summary = ceres::Solver::Summary();
+    summary->minimizer_type = ceres::TRUST_REGION;
+    summary->linear_solver_type_given = ceres::SPARSE_NORMAL_CHOLESKY;
+    summary->linear_solver_type_used = ceres::SPARSE_NORMAL_CHOLESKY;
+    summary->sparse_linear_algebra_library_type = ceres::SUITE_SPARSE;
+    summary->num_threads_given = options.num_threads;
+    summary->num_threads_used = options.num_threads;
+    summary->num_parameter_blocks = this->parameterBlocks.size();
+    summary->num_parameters = 3 * this->parameterBlocks.size();
+    summary->num_residual_blocks = this->problem.NumResidualBlocks();
+    summary->num_residuals = this->problem.NumResiduals();
+
+    auto structure = CalculateBlockStructure(this->problem, this->parameterBlocks);
+    if (nullptr == this->factor || structure != this->structure)
+      {
+      this->structure = std::move(structure);
+      this->Factorize(options.num_threads, summary);
+      if (ceres::FAILURE == summary->termination_type)
+        {
+        summary->total_time_in_seconds = since(start);
+        return;
+        }
+      summary->preprocessor_time_in_seconds = since(start);
+      }
+    const auto minimizerStart = std::chrono::steady_clock::now();
+
+    const size_t n = 3 * this->parameterBlocks.size();
+    std::vector<double> residuals, step(n), previous(n);
+    double cost = this->Evaluate(options.num_threads, residuals, summary);
+    summary->initial_cost = cost;
+    summary->termination_type = ceres::NO_CONVERGENCE;
+    summary->message = "Maximum number of iterations reached.";
+
+    ceres::IterationSummary first;
+    first.cost = cost;
+    first.step_is_valid = first.step_is_successful = true;
+    first.iteration_time_in_seconds = first.cumulative_time_in_seconds = since(start);
+    summary->iterations.push_back(first);
+    if (!NotifyIterationCallbacks(options, first, summary))
+      {
+      summary->final_cost = cost;
+      summary->total_time_in_seconds = since(start);
+      summary->minimizer_time_in_seconds = since(minimizerStart);
+      return;
+      }
+
+    for (int iteration = 1; iteration <= options.max_num_iterations; ++iteration)
+      {
+      const auto iterationStart = std::chrono::steady_clock::now();
+      if (since(start) > options.max_solver_time_in_seconds)
+        {
+        summary->message = "Maximum solver time reached.";
+        break;
+        }
+
+      // g = J^T r; the step solves J^T J dx = -g.
+      const auto solverStart = std::chrono::steady_clock::now();
+      std::vector<double> gradient(n, 0.0);
+      this->MultiplyTransposed(residuals, gradient);
+      double gradientMax = 0.0;
+      for (const auto g : gradient) gradientMax = std::max(gradientMax, std::abs(g));
+      if (gradientMax <= options.gradient_tolerance)
+        {
+        summary->termination_type = ceres::CONVERGENCE;
+        summary->message = "Gradient tolerance reached.";
+        break;
+        }
+      this->BackSubstitute(gradient, step);
+      summary->linear_solver_time_in_seconds += since(solverStart);
+
+      double stepNorm = 0.0, parameterNorm = 0.0;
+      for (size_t b = 0; b < this->parameterBlocks.size(); ++b)
+        for (unsigned int d = 0; d < 3; ++d)
+          {
+          double &x = this->parameterBlocks[b][d];
+          previous[3 * b + d] = x;
+          parameterNorm += x * x;
+          stepNorm += step[3 * b + d] * step[3 * b + d];
+          x -= step[3 * b + d];
+          }
+      stepNorm = std::sqrt(stepNorm);
+      parameterNorm = std::sqrt(parameterNorm);
+
+      const double candidate = this->Evaluate(options.num_threads, residuals, summary);
+
+      ceres::IterationSummary current;
+      current.iteration = iteration;
+      current.step_is_valid = std::isfinite(candidate);
+      current.step_is_successful = current.step_is_valid && candidate < cost;
+      current.cost_change = cost - candidate;
+      current.gradient_max_norm = gradientMax;
+      current.step_norm = stepNorm;
+      current.linear_solver_iterations = 1;
+
+      if (!current.step_is_successful)
+        {
+        // Back to the last point, with its correspondences
+        for (size_t b = 0; b < this->parameterBlocks.size(); ++b)
+          std::copy(previous.begin() + 3 * b, previous.begin() + 3 * b + 3, this->parameterBlocks[b]);
+        this->Evaluate(options.num_threads, residuals, summary);
+        current.cost = cost;
+        ++summary->num_unsuccessful_steps;
+        }
+      else
+        {
+        current.cost = candidate;
+        ++summary->num_successful_steps;
+        }
+      current.iteration_time_in_seconds = since(iterationStart);
+      current.cumulative_time_in_seconds = since(start);
+      summary->iterations.push_back(current);
+
+      if (!current.step_is_successful)
+        {
+        summary->termination_type = ceres::CONVERGENCE;
+        summary->message = "The cost did not decrease.";
+        break;
+        }
+      const double before = cost;
+      cost = candidate;
+      if (!NotifyIterationCallbacks(options, current, summary)) break;
+      if (current.cost_change <= options.function_tolerance * before)
+        {
+        summary->termination_type = ceres::CONVERGENCE;
+        summary->message = "Function tolerance reached.";
+        break;
+        }
+      if (stepNorm <= options.parameter_tolerance * (parameterNorm + options.parameter_tolerance))
+        {
+        summary->termination_type = ceres::CONVERGENCE;
+        summary->message = "Parameter tolerance reached.";
+        break;
+        }
+      }
+
+    summary->final_cost = cost;
+    summary->minimizer_time_in_seconds = since(minimizerStart);
+    summary->total_time_in_seconds = since(start);
+  }
+
+  // Elimination order of the parameter blocks, as indices into the blocks
+  // given to the constructor, for CHOLMOD to use instead of its own
+  void SetOrdering(std::vector<int> _ordering)
+  {
+    itkAssertOrThrowMacro(_ordering.size() == this->parameterBlocks.size(),
+                          "The ordering does not match the parameter blocks.");
+    this->ordering = std::move(_ordering);
+  }
+
+  double GetFactorizationTimeInSeconds() const { return this->FactorizationTimeInSeconds; }
+  // Times J^T J has been factorized: once, plus once per change of the
+  // residual blocks between solves
+  unsigned int GetNumberOfFactorizations() const { return this->NumberOfFactorizations; }
+  // The part of the factorization time spent ordering and analyzing J^T J
+  double GetAnalysisTimeInSeconds() const { return this->AnalysisTimeInSeconds; }
+  // Whether J^T J was factorized as one scalar system for x, y and z
+  bool GetKronecker() const { return 3 == this->Width; }
+  size_t GetNumberOfFactorNonZeros() const
+    {
+    if (nullptr == this->factor) return 0;
+    return this->factor->is_super ? this->factor->xsize : this->factor->nzmax;
+    }
+
+private:
+
+  // The (constant) Jacobian, with the correspondences of the current point
+  // found first, and the factorization of J^T J
+  void Factorize(const int threads, ceres::Solver::Summary *summary)
+  {
+    const auto start = std::chrono::steady_clock::now();
+    if (nullptr != this->factor) cholmod_free_factor(&this->factor, &this->common);
+    if (nullptr != this->JT) cholmod_free_sparse(&this->JT, &this->common);
+    ++this->NumberOfFactorizations;
+
+    ceres::CRSMatrix J;
+    ceres::Problem::EvaluateOptions evaluateOptions;
+    evaluateOptions.parameter_blocks = this->parameterBlocks;
+    evaluateOptions.num_threads = threads;
+    this->search();
+    this->problem.Evaluate(evaluateOptions, nullptr, nullptr, nullptr, &J);
+    summary->jacobian_evaluation_time_in_seconds +=
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    const auto factorizationStart = std::chrono::steady_clock::now();
+
+    // J in compressed rows is J^T in compressed columns, which CHOLMOD
+    // factorizes as J^T (J^T)^T.  If J is a scalar matrix S times the 3x3
+    // identity, up to the order of its rows, only the nonzeros of S are
+    // kept: Ceres stores each residual and parameter block pair densely,
+    // so a row of S comes with explicit zeros for the other coordinates.
+    this->Width = 1;
+    if (this->SplitAxes(J)) this->Width = 3;
+    else for (auto &axis : this->axisRows) std::vector<int>().swap(axis);
+    const size_t rows = (3 == this->Width) ? this->axisRows[0].size() : size_t(J.num_rows);
+    const size_t columns = J.num_cols / this->Width;
+    size_t nonZeros = J.values.size();
+    if (3 == this->Width)
+      {
+      nonZeros = 0;
+      for (const int row : this->axisRows[0])
+        for (int k = J.rows[row]; k < J.rows[row + 1]; ++k) nonZeros += (0.0 != J.values[k]);
+      }
+    this->JT = cholmod_allocate_sparse(columns, rows, nonZeros,
+                                       false, true, 0, CHOLMOD_REAL, &this->common);
+    itkAssertOrThrowMacro(nullptr != this->JT, "Could not allocate the Jacobian.");
+    int* p = static_cast<int*>(this->JT->p);
+    int* i = static_cast<int*>(this->JT->i);
+    double* x = static_cast<double*>(this->JT->x);
+    p[0] = 0;
+    for (size_t r = 0; r < rows; ++r)
+      {
+      const int row = (3 == this->Width) ? this->axisRows[0][r] : int(r);
+      p[r + 1] = p[r];
+      for (int k = J.rows[row]; k < J.rows[row + 1]; ++k)
+        {
+        if (3 == this->Width && 0.0 == J.values[k]) continue;
+        *i++ = J.cols[k] / this->Width;
+        *x++ = J.values[k];
+        ++p[r + 1];
+        }
+      }
+    J = ceres::CRSMatrix(); // Not needed for the factorization
+    cholmod_sort(this->JT, &this->common);
+
+    std::vector<double> diagonal(columns, 0.0);
+    for (int k = 0; k < p[rows]; ++k)
+      {
+      const double value = static_cast<double*>(this->JT->x)[k];
+      diagonal[static_cast<int*>(this->JT->i)[k]] += value * value;
+      }
+    double ridge[2] = {1e-12 * std::max(1.0, *std::max_element(diagonal.begin(), diagonal.end())), 0.0};
+
+    // A given block ordering is expanded to the coordinates of the full
+    // system, and used as is.
+    const auto analysisStart = std::chrono::steady_clock::now();
+    if (this->ordering.empty())
+      {
+      this->factor = cholmod_analyze(this->JT, &this->common);
+      }
+    else
+      {
+      std::vector<int> permutation;
+      permutation.reserve(columns);
+      for (const auto b : this->ordering)
+        for (unsigned int d = 0; d < 3 / this->Width; ++d) permutation.push_back(3 / this->Width * b + d);
+      const int methods = this->common.nmethods;
+      const int method = this->common.method[0].ordering;
+      this->common.nmethods = 1;
+      this->common.method[0].ordering = CHOLMOD_GIVEN;
+      this->factor = cholmod_analyze_p(this->JT, permutation.data(), nullptr, 0, &this->common);
+      this->common.nmethods = methods;
+      this->common.method[0].ordering = method;
+      }
+    this->AnalysisTimeInSeconds =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - analysisStart).count();
+    if (nullptr != this->factor)
+      {
+      cholmod_factorize_p(this->JT, ridge, nullptr, 0, this->factor, &this->common);
+      }
+    if (nullptr == this->factor || CHOLMOD_OK != this->common.status || this->factor->minor < this->factor->n)
+      {
+      summary->termination_type = ceres::FAILURE;
+      summary->message = "CHOLMOD could not factorize J^T J (status " + std::to_string(this->common.status) + ").";
+      if (nullptr != this->factor) cholmod_free_factor(&this->factor, &this->common);
+      }
+
+    this->FactorizationTimeInSeconds =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - factorizationStart).count();
+    summary->linear_solver_time_in_seconds += this->FactorizationTimeInSeconds;
+  }
+
+  // Rows of J acting on x, y and z respectively, in order, if the nonzeros
+  // of every row act on one coordinate only and the k-th rows of the three
+  // coordinates have the same nonzero coefficients for the same parameter
+  // blocks.  Then J^T J = S^T S (x) I, with S the x rows of J on the
+  // parameter blocks.  Rows without nonzeros only add to the cost and are
+  // left out.
+  bool SplitAxes(const ceres::CRSMatrix &J)
+  {
+    for (auto &rows : this->axisRows) rows.clear();
+    for (int r = 0; r < J.num_rows; ++r)
+      {
+      int d = -1;
+      for (int k = J.rows[r]; k < J.rows[r + 1]; ++k)
+        {
+        if (0.0 == J.values[k]) continue;
+        if (d < 0) d = J.cols[k] % 3;
+        else if (d != J.cols[k] % 3) return false;
+        }
+      if (d >= 0) this->axisRows[d].push_back(r);
+      }
+
+    const auto &x = this->axisRows[0];
+    if (x.size() != this->axisRows[1].size() || x.size() != this->axisRows[2].size()) return false;
+    // The next nonzero of row r at or after k
+    const auto next = [&J](const int r, int k) {
+      while (k < J.rows[r + 1] && 0.0 == J.values[k]) ++k;
+      return k;
+    };
+    for (unsigned int d = 1; d < 3; ++d)
+      for (size_t r = 0; r < x.size(); ++r)
+        {
+        const int a = x[r], b = this->axisRows[d][r];
+        int u = next(a, J.rows[a]), v = next(b, J.rows[b]);
+        for (; u < J.rows[a + 1] && v < J.rows[b + 1]; u = next(a, u + 1), v = next(b, v + 1))
+          {
+          if (J.cols[u] / 3 != J.cols[v] / 3) return false;
+          if (std::abs(J.values[u] - J.values[v]) > 1e-12 * std::max(std::abs(J.values[u]), std::abs(J.values[v])))
+            return false;
+          }
+        if (u < J.rows[a + 1] || v < J.rows[b + 1]) return false;
+        }
+    return true;
+  }
+
+  // Cost and residuals at the current parameters, against their closest
+  // candidates
+  double Evaluate(const int threads, std::vector<double> &residuals, ceres::Solver::Summary *summary)
+  {
+    const auto start = std::chrono::steady_clock::now();
+    ceres::Problem::EvaluateOptions evaluateOptions;
+    evaluateOptions.parameter_blocks = this->parameterBlocks;
+    evaluateOptions.num_threads = threads;
+    double cost = 0.0;
+    this->search();
+    this->problem.Evaluate(evaluateOptions, &cost, &residuals, nullptr, nullptr);
+    summary->residual_evaluation_time_in_seconds +=
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return cost;
+  }
+
+  // g = J^T r, for the scalar system one column per coordinate
+  void MultiplyTransposed(const std::vector<double> &r, std::vector<double> &g)
+  {
+    std::vector<double> R;
+    if (3 == this->Width)
+      {
+      const size_t rows = this->axisRows[0].size();
+      R.resize(3 * rows);
+      for (unsigned int d = 0; d < 3; ++d)
+        for (size_t k = 0; k < rows; ++k) R[d * rows + k] = r[this->axisRows[d][k]];
+      }
+    else
+      {
+      R = r;
+      }
+    cholmod_dense X = this->Wrap(R, this->Width), Y = this->Wrap(g, this->Width);
+    double alpha[2] = {1.0, 0.0}, beta[2] = {0.0, 0.0};
+    cholmod_sdmult(this->JT, 0, alpha, beta, &X, &Y, &this->common);
+  }
+
+  // (J^T J)^-1 g, with the coordinates of each parameter block together
+  void BackSubstitute(std::vector<double> &g, std::vector<double> &step)
+  {
+    cholmod_dense B = this->Wrap(g, this->Width);
+    cholmod_dense* X = cholmod_solve(CHOLMOD_A, this->factor, &B, &this->common);
+    itkAssertOrThrowMacro(nullptr != X, "CHOLMOD could not solve the normal equations.");
+    const double* values = static_cast<const double*>(X->x);
+    const size_t n = X->nrow;
+    for (size_t j = 0; j < n; ++j)
+      for (unsigned int d = 0; d < this->Width; ++d) step[this->Width * j + d] = values[d * n + j];
+    cholmod_free_dense(&X, &this->common);
+  }
+
+  // Column-major columns over existing storage
+  static cholmod_dense Wrap(std::vector<double> &v, const unsigned int columns)
+  {
+    cholmod_dense d = {};
+    d.nrow = d.d = v.size() / columns;
+    d.ncol = columns;
+    d.nzmax = v.size();
+    d.x = v.data();
+    d.xtype = CHOLMOD_REAL;
+    d.dtype = CHOLMOD_DOUBLE;
+    return d;
+  }
+
+  ceres::Problem &problem;
+  const std::vector<double*> parameterBlocks;
+  const std::function<void()> search;
+
+  mutable cholmod_common common;
+  cholmod_sparse* JT = nullptr;
+  cholmod_factor* factor = nullptr;
+  unsigned int Width = 1; // Right-hand sides per solve: 3 for the scalar system
+  std::vector<int> axisRows[3];
+  std::vector<int> ordering; // Given elimination order of the blocks, if any
+  std::vector<std::vector<int>> structure; // Residual blocks factorized for
+  unsigned int NumberOfFactorizations = 0;
+  double FactorizationTimeInSeconds = 0.0;
+  double AnalysisTimeInSeconds = 0.0;
+
+}; // end class
+
+} // namespace sissr
+
+#endif
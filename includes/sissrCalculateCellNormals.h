@@ -0,0 +1,55 @@
+#ifndef sissr_CalculateCellNormals_h
+#define sissr_CalculateCellNormals_h
+
+// System
+#include <cmath>
+#include <vector>
+
+// SiSSR
+#include <sissrUtils.h>
+
+namespace sissr {
+
+// Unit normal of every cell, 3 values per cell in the order of the cells
+// container, by Newell's method so that cells with more than three points
+// are handled as well.  Zero for degenerate cells.  The normals are only
+// oriented as consistently as the cells are.
+template<typename TMesh>
+std::vector<double>
+CalculateCellNormals(TMesh* mesh, const unsigned int &threads = 1) {
+
+  std::vector<const typename TMesh::CellType*> cells;
+  for (auto it = mesh->GetCells()->Begin();
+       it != mesh->GetCells()->End();
+       ++it) {
+    cells.push_back(it.Value());
+  }
+
+  std::vector<double> normals(3 * cells.size(), 0.0);
+
+  ParallelFor(cells.size(), threads, [&](size_t begin, size_t end) {
+    for (size_t c = begin; c < end; ++c) {
+      const auto ids = cells[c]->GetPointIds();
+      const unsigned int n = cells[c]->GetNumberOfPoints();
+      double* normal = normals.data() + 3 * c;
+      for (unsigned int k = 0; k < n; ++k) {
+        const auto a = mesh->GetPoint(ids[k]);
+        const auto b = mesh->GetPoint(ids[(k + 1) % n]);
+        normal[0] += (double(a[1]) - b[1]) * (double(a[2]) + b[2]);
+        normal[1] += (double(a[2]) - b[2]) * (double(a[0]) + b[0]);
+        normal[2] += (double(a[0]) - b[0]) * (double(a[1]) + b[1]);
+      }
+      const double length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+      if (length > 0.0) {
+        for (unsigned int d = 0; d < 3; ++d) normal[d] /= length;
+      }
+    }
+  });
+
+  return normals;
+
+}
+
+} // namespace sissr
+
+#endif
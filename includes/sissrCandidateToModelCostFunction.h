@@ -0,0 +1,51 @@
+#ifndef sissr_CandidateToModelCostFunction_h
+#define sissr_CandidateToModelCostFunction_h
+
+#include <cstdint>
+
+#include <ceres/ceres.h>
+#include <itkMacro.h>
+#include <sissrLimitSurfaceProjector.h>
+
+namespace sissr {
+
+// Offset from a candidate point to its closest point on the limit surface,
+// as last projected by the projector.  The projection's parameters are held
+// fixed in the Jacobian; at the closest point the offset is orthogonal to the
+// surface, so the gradient of the squared distance is still exact.  There is
+// one parameter block per control point of the patch the candidate was
+// projected onto at construction; once the projection has moved onto another
+// patch, the block has to be built again, and evaluating it fails.
+template<class TMesh>
+class CandidateToModelCostFunction : public ceres::CostFunction
+{
+
+public:
+  using TProjector = LimitSurfaceProjector<TMesh>;
+
+  CandidateToModelCostFunction(const TProjector& _projector,
+                               size_t _index);
+
+  bool Evaluate(const double* const* parameters,
+                double* residuals,
+                double** jacobians) const;
+
+  ~CandidateToModelCostFunction() {}
+
+  // The patch whose control points are the parameter blocks
+  std::uint32_t GetPatch() const { return this->patch; }
+
+private:
+  const TProjector& projector;
+
+  size_t index;
+
+  std::uint32_t patch;
+
+}; // end class
+
+} // namespace sissr
+
+#include <sissrCandidateToModelCostFunction.hxx>
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef sissr_CandidateToModelCostFunction_hxx
+#define sissr_CandidateToModelCostFunction_hxx
+
+namespace sissr {
+
+template<class TMesh>
+CandidateToModelCostFunction<TMesh>::CandidateToModelCostFunction(
+  const TProjector& _projector,
+  size_t _index)
+  : projector(_projector)
+  , index(_index)
+{
+  itkAssertOrThrowMacro(this->index < this->projector.GetNumberOfCandidates(),
+                        "Candidate index out of range.");
+  this->patch = this->projector.GetCandidateProjection(this->index).patch;
+  for (unsigned int i = 0; i < this->projector.GetNumberOfControlPoints(this->patch); ++i) {
+    this->mutable_parameter_block_sizes()->push_back(3);
+  }
+  this->set_num_residuals(3);
+}
+
+template<class TMesh>
+bool
+CandidateToModelCostFunction<TMesh>::Evaluate(const double* const* /*parameters*/,
+                                              double* residuals,
+                                              double** jacobians) const
+{
+
+  // Only the control points of the block's patch are parameters.
+  const auto &projection = this->projector.GetCandidateProjection(this->index);
+  if (projection.patch != this->patch) {
+    return false;
+  }
+
+  // Residuals
+  const double* candidate = this->projector.GetCandidate(this->index);
+  for (unsigned int d = 0; d < 3; ++d) {
+    residuals[d] = projection.point[d] - candidate[d];
+  }
+
+  // Return if Jacobian wasn't requested.
+  if (nullptr == jacobians) {
+    return true;
+  }
+
+  // Each control point moves the projection by its weight.
+  const auto w = this->projector.GetCandidateWeights(this->index);
+  const auto K = this->projector.GetNumberOfControlPoints(projection.patch);
+  for (unsigned int i = 0; i < K; ++i) {
+    if (nullptr == jacobians[i]) continue;
+    ceres::MatrixRef(jacobians[i], 3, 3).setZero();
+    for (unsigned int d = 0; d < 3; ++d) {
+      jacobians[i][d + 3 * d] = w[i];
+    }
+  }
+
+  return true;
+}
+
+} // namespace sissr
+
+#endif
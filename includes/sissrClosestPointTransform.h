@@ -0,0 +1,363 @@
+#ifndef sissr_ClosestPointTransform_h
+#define sissr_ClosestPointTransform_h
+
+// STD
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+// ITK
+#include <itkObject.h>
+#include <itkObjectFactory.h>
+#include <itkMacro.h>
+
+// SiSSR
+#include <sissrTriangleBVH.h>
+#include <sissrUtils.h>
+
+namespace sissr {
+
+/*
+ Narrow-band closest point transform of a triangulated candidate surface.
+
+ Every grid point near the surface stores its exact closest point on the
+ surface, found with the TriangleBVH.  A lookup is then a trilinear
+ interpolation of the eight surrounding grid points, which also yields the
+ derivative of the closest point with respect to the query; near the
+ surface, I minus this derivative approaches the projection onto the normal.
+ Grid points are stored up to one cell diagonal beyond BandWidth, so that
+ every query within BandWidth is interpolated; other queries fall back to the
+ exact search.
+
+ The grid is stored sparsely, in bricks of 8 x 8 x 8 grid points which are
+ only allocated where the band reaches.
+ */
+template<typename TMesh>
+class ClosestPointTransform : public itk::Object
+{
+
+public:
+
+  using Self = ClosestPointTransform;
+  using Superclass = itk::Object;
+  using Pointer = itk::SmartPointer<Self>;
+  using ConstPointer = itk::SmartPointer<const Self>;
+
+  itkNewMacro(Self);
+  itkTypeMacro(ClosestPointTransform, Object);
+
+  using TTriangles = TriangleBVH<TMesh>;
+  using TTrianglesPointer = typename TTriangles::Pointer;
+
+  static constexpr unsigned int BrickSize = 8;
+  static constexpr unsigned int BrickVolume = BrickSize * BrickSize * BrickSize;
+
+  itkSetMacro(Spacing, double);
+  itkGetConstMacro(Spacing, double);
+  itkSetMacro(BandWidth, double);
+  itkGetConstMacro(BandWidth, double);
+  itkSetMacro(NumberOfThreads, unsigned int);
+  itkGetConstMacro(NumberOfThreads, unsigned int);
+
+  void SetTriangles(TTriangles* triangles)
+    {
+    this->m_Triangles = triangles;
+    this->Modified();
+    }
+
+  TTriangles* GetTriangles() const
+    { return this->m_Triangles.GetPointer(); }
+
+  /* Bytes which Initialize() will allocate for the current settings. */
+  size_t CalculateMemoryEstimate() const
+    {
+    const auto bricks = this->CalculateBricks();
+    const size_t allocated = std::count(bricks.begin(), bricks.end(), std::uint8_t(1));
+    return allocated * BrickVolume * 3 * sizeof(float) + bricks.size() * sizeof(std::int32_t);
+    }
+
+  void Initialize();
+
+  /*
+   queries: count xyz triplets, ideally in spatial order; points: count xyz
+   results.  jacobians, if not null: 9 (row-major) per query, the derivative
+   of (query - closest point) with respect to the query; the identity for
+   queries answered by the exact search.
+   */
+  void FindClosestPoints(const double* queries, const size_t &count,
+                         double* points, double* jacobians = nullptr) const;
+
+  size_t GetNumberOfAllocatedBricks() const
+    { return this->m_Values.size() / (3 * BrickVolume); }
+
+protected:
+
+  ClosestPointTransform() = default;
+  ~ClosestPointTransform() override = default;
+
+private:
+
+  // Sets up the grid geometry; 1 for each brick which the band reaches.
+  std::vector<std::uint8_t> CalculateBricks() const;
+
+  // Stored distance from the surface
+  double GetStoredBandWidth() const
+    { return this->m_BandWidth + std::sqrt(3.0) * this->m_Spacing; }
+
+  // First value of the brick containing a grid point, or null if the brick
+  // is not allocated.  The index must lie within the grid.
+  const float* GetBrick(const std::int64_t* index) const
+    {
+    const std::int64_t b = ((index[2] / BrickSize) * this->m_Bricks[1] + index[1] / BrickSize) * this->m_Bricks[0]
+                         + index[0] / BrickSize;
+    const std::int32_t slot = this->m_BrickSlots[b];
+    return (slot < 0) ? nullptr : this->m_Values.data() + 3 * BrickVolume * size_t(slot);
+    }
+
+  // Offset of a grid point within its brick
+  static size_t GetOffset(const std::int64_t* index)
+    {
+    return 3 * size_t(((index[2] % BrickSize) * BrickSize + index[1] % BrickSize) * BrickSize + index[0] % BrickSize);
+    }
+
+  bool Interpolate(const double* q, double* point, double* jacobian) const;
+
+  TTrianglesPointer m_Triangles;
+  double m_Spacing = 1.0;
+  double m_BandWidth = 4.0;
+  unsigned int m_NumberOfThreads = 1;
+
+  // Geometry, set by CalculateBricks
+  mutable std::array<double, 3> m_Origin = {{0.0, 0.0, 0.0}};
+  mutable std::array<std::int64_t, 3> m_Bricks = {{0, 0, 0}};
+
+  std::vector<std::int32_t> m_BrickSlots; // -1: not allocated
+  std::vector<float> m_Values;            // [slot][z][y][x][xyz]; NaN beyond the stored band
+
+};
+
+template<typename TMesh>
+std::vector<std::uint8_t>
+ClosestPointTransform<TMesh>
+::CalculateBricks() const
+{
+
+  itkAssertOrThrowMacro(nullptr != this->m_Triangles, "No triangles were set.");
+  itkAssertOrThrowMacro(this->m_Spacing > 0.0, "Grid spacing must be positive.");
+  itkAssertOrThrowMacro(this->m_BandWidth >= 0.0, "Band width must not be negative.");
+
+  const size_t n = this->m_Triangles->GetNumberOfTriangles();
+  itkAssertOrThrowMacro(n > 0, "The triangles are empty or were not initialized.");
+
+  // Bounding box, padded by the band and one grid point
+  std::array<double, 3> lower, upper;
+  lower.fill(std::numeric_limits<double>::max());
+  upper.fill(std::numeric_limits<double>::lowest());
+  for (size_t t = 0; t < n; ++t)
+    for (unsigned int k = 0; k < 3; ++k)
+      for (unsigned int d = 0; d < 3; ++d)
+        {
+        lower[d] = std::min(lower[d], this->m_Triangles->GetTriangle(t)[3 * k + d]);
+        upper[d] = std::max(upper[d], this->m_Triangles->GetTriangle(t)[3 * k + d]);
+        }
+  const double band = this->GetStoredBandWidth();
+  const double pad = band + this->m_Spacing;
+  for (unsigned int d = 0; d < 3; ++d)
+    {
+    this->m_Origin[d] = lower[d] - pad;
+    const auto points = std::int64_t(std::ceil((upper[d] + pad - this->m_Origin[d]) / this->m_Spacing)) + 1;
+    this->m_Bricks[d] = (points + BrickSize - 1) / BrickSize;
+    }
+
+  // Bricks overlapping each triangle's box, grown by the band
+  std::vector<std::uint8_t> bricks(this->m_Bricks[0] * this->m_Bricks[1] * this->m_Bricks[2], 0);
+  const double brickWidth = BrickSize * this->m_Spacing;
+  for (size_t t = 0; t < n; ++t)
+    {
+    const double* v = this->m_Triangles->GetTriangle(t);
+    std::int64_t first[3], last[3];
+    for (unsigned int d = 0; d < 3; ++d)
+      {
+      const double l = std::min({v[d], v[3 + d], v[6 + d]}) - band - this->m_Origin[d];
+      const double u = std::max({v[d], v[3 + d], v[6 + d]}) + band - this->m_Origin[d];
+      // A cell straddling a brick boundary needs the grid points on both sides.
+      first[d] = std::max<std::int64_t>(0, std::int64_t(std::floor(l / brickWidth - 1.0 / BrickSize)));
+      last[d] = std::min<std::int64_t>(this->m_Bricks[d] - 1, std::int64_t(std::floor(u / brickWidth + 1.0 / BrickSize)));
+      }
+    for (std::int64_t z = first[2]; z <= last[2]; ++z)
+      for (std::int64_t y = first[1]; y <= last[1]; ++y)
+        for (std::int64_t x = first[0]; x <= last[0]; ++x)
+          bricks[(z * this->m_Bricks[1] + y) * this->m_Bricks[0] + x] = 1;
+    }
+
+  return bricks;
+
+}
+
+template<typename TMesh>
+void
+ClosestPointTransform<TMesh>
+::Initialize()
+{
+
+  const auto bricks = this->CalculateBricks();
+
+  std::vector<size_t> allocated;
+  this->m_BrickSlots.assign(bricks.size(), -1);
+  for (size_t b = 0; b < bricks.size(); ++b)
+    {
+    if (0 == bricks[b]) continue;
+    itkAssertOrThrowMacro(allocated.size() < size_t(std::numeric_limits<std::int32_t>::max()),
+                          "Too many bricks; increase the grid spacing.");
+    this->m_BrickSlots[b] = std::int32_t(allocated.size());
+    allocated.push_back(b);
+    }
+  this->m_Values.assign(allocated.size() * BrickVolume * 3, std::numeric_limits<float>::quiet_NaN());
+
+  // Exact closest points, one brick at a time
+  const double band2 = this->GetStoredBandWidth() * this->GetStoredBandWidth();
+  ParallelFor(allocated.size(), std::max(1u, this->m_NumberOfThreads), [&](size_t begin, size_t end)
+    {
+    std::vector<double> queries(3 * BrickVolume), closest(3 * BrickVolume);
+    for (size_t slot = begin; slot < end; ++slot)
+      {
+      const size_t b = allocated[slot];
+      const std::int64_t brick[3] = {std::int64_t(b % this->m_Bricks[0]),
+                                     std::int64_t((b / this->m_Bricks[0]) % this->m_Bricks[1]),
+                                     std::int64_t(b / (this->m_Bricks[0] * this->m_Bricks[1]))};
+      size_t k = 0;
+      for (unsigned int z = 0; z < BrickSize; ++z)
+        for (unsigned int y = 0; y < BrickSize; ++y)
+          for (unsigned int x = 0; x < BrickSize; ++x, ++k)
+            {
+            const unsigned int local[3] = {x, y, z};
+            for (unsigned int d = 0; d < 3; ++d)
+              queries[3 * k + d] = this->m_Origin[d] + this->m_Spacing * double(BrickSize * brick[d] + local[d]);
+            }
+      this->m_Triangles->FindClosestPoints(queries.data(), BrickVolume, closest.data());
+      float* values = this->m_Values.data() + 3 * BrickVolume * slot;
+      for (k = 0; k < BrickVolume; ++k)
+        {
+        double dist = 0.0;
+        for (unsigned int d = 0; d < 3; ++d)
+          dist += (queries[3 * k + d] - closest[3 * k + d]) * (queries[3 * k + d] - closest[3 * k + d]);
+        if (dist > band2) continue;
+        for (unsigned int d = 0; d < 3; ++d) values[3 * k + d] = float(closest[3 * k + d]);
+        }
+      }
+    });
+
+}
+
+template<typename TMesh>
+bool
+ClosestPointTransform<TMesh>
+::Interpolate(const double* q, double* point, double* jacobian) const
+{
+
+  std::int64_t base[3];
+  double f[3];
+  for (unsigned int d = 0; d < 3; ++d)
+    {
+    const double g = (q[d] - this->m_Origin[d]) / this->m_Spacing;
+    if (!(g >= 0.0) || !(g < double(BrickSize * this->m_Bricks[d] - 1))) return false;
+    base[d] = std::int64_t(g);
+    f[d] = g - double(base[d]);
+    }
+
+  // The eight grid points; usually all in one brick
+  const float* values[8];
+  if (base[0] % BrickSize < BrickSize - 1 && base[1] % BrickSize < BrickSize - 1 && base[2] % BrickSize < BrickSize - 1)
+    {
+    const float* brick = this->GetBrick(base);
+    if (nullptr == brick) return false;
+    const float* first = brick + GetOffset(base);
+    for (unsigned int corner = 0; corner < 8; ++corner)
+      values[corner] = first + 3 * ((corner & 1u) + ((corner >> 1) & 1u) * BrickSize + ((corner >> 2) & 1u) * BrickSize * BrickSize);
+    }
+  else
+    {
+    for (unsigned int corner = 0; corner < 8; ++corner)
+      {
+      const std::int64_t index[3] = {base[0] + (corner & 1u), base[1] + ((corner >> 1) & 1u), base[2] + ((corner >> 2) & 1u)};
+      const float* brick = this->GetBrick(index);
+      if (nullptr == brick) return false;
+      values[corner] = brick + GetOffset(index);
+      }
+    }
+
+  double c[3] = {0.0, 0.0, 0.0};
+  double dc[3][3] = {{0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}}; // dc[r][d] = d c_r / d g_d
+  for (unsigned int corner = 0; corner < 8; ++corner)
+    {
+    const float* value = values[corner];
+    if (std::isnan(value[0])) return false;
+
+    // Weight per dimension, and its derivative
+    const unsigned int o[3] = {corner & 1u, (corner >> 1) & 1u, (corner >> 2) & 1u};
+    double w[3], dw[3];
+    for (unsigned int d = 0; d < 3; ++d)
+      {
+      w[d] = o[d] ? f[d] : 1.0 - f[d];
+      dw[d] = o[d] ? 1.0 : -1.0;
+      }
+    const double weight = w[0] * w[1] * w[2];
+    const double dweight[3] = {dw[0] * w[1] * w[2], w[0] * dw[1] * w[2], w[0] * w[1] * dw[2]};
+    for (unsigned int r = 0; r < 3; ++r)
+      {
+      c[r] += weight * value[r];
+      for (unsigned int d = 0; d < 3; ++d) dc[r][d] += dweight[d] * value[r];
+      }
+    }
+
+  for (unsigned int r = 0; r < 3; ++r)
+    {
+    point[r] = c[r];
+    if (nullptr == jacobian) continue;
+    for (unsigned int d = 0; d < 3; ++d)
+      jacobian[3 * r + d] = ((r == d) ? 1.0 : 0.0) - dc[r][d] / this->m_Spacing;
+    }
+  return true;
+
+}
+
+template<typename TMesh>
+void
+ClosestPointTransform<TMesh>
+::FindClosestPoints(const double* queries, const size_t &count,
+                    double* points, double* jacobians) const
+{
+
+  itkAssertOrThrowMacro(!this->m_BrickSlots.empty(), "The transform was not initialized.");
+
+  std::vector<size_t> missed;
+  for (size_t i = 0; i < count; ++i)
+    {
+    double* J = (nullptr == jacobians) ? nullptr : jacobians + 9 * i;
+    if (!this->Interpolate(queries + 3 * i, points + 3 * i, J)) missed.push_back(i);
+    }
+
+  if (missed.empty()) return;
+
+  // Exact search outside the band, in the same order
+  std::vector<double> q(3 * missed.size()), p(3 * missed.size());
+  for (size_t k = 0; k < missed.size(); ++k)
+    for (unsigned int d = 0; d < 3; ++d)
+      q[3 * k + d] = queries[3 * missed[k] + d];
+  this->m_Triangles->FindClosestPoints(q.data(), missed.size(), p.data());
+  for (size_t k = 0; k < missed.size(); ++k)
+    {
+    for (unsigned int d = 0; d < 3; ++d) points[3 * missed[k] + d] = p[3 * k + d];
+    if (nullptr == jacobians) continue;
+    double* J = jacobians + 9 * missed[k];
+    for (unsigned int e = 0; e < 9; ++e) J[e] = (0 == e % 4) ? 1.0 : 0.0;
+    }
+
+}
+
+} // namespace sissr
+
+#endif
@@ -0,0 +1,108 @@
+#ifndef sissr_ControlPointBuffer_h
+#define sissr_ControlPointBuffer_h
+
+// STD
+#include <vector>
+#include <cstddef>
+#include <functional>
+#include <utility>
+
+// ITK
+#include <itkMacro.h>
+
+// Ceres
+#include <ceres/evaluation_callback.h>
+
+namespace sissr {
+
+/*
+ Deformed positions of the control points of every frame, stored
+ contiguously as [frame][point][xyz].
+
+ The parameter blocks hold offsets from the initial positions.  Registered
+ as the problem's evaluation callback, the buffer recalculates all positions
+ (initial + offset) exactly once per new evaluation point, before Ceres
+ evaluates any residual block.  Cost functions then read their control points
+ from here; nothing is written during residual evaluation.
+ */
+class ControlPointBuffer : public ceres::EvaluationCallback
+{
+
+public:
+
+  /*
+   initialPositions: 3 * frames * points initial coordinates.
+   offsets: contiguous parameter storage of the same layout.
+   */
+  ControlPointBuffer(std::vector<double> _initialPositions,
+                     const double* _offsets,
+                     unsigned int _numberOfFrames,
+                     unsigned int _numberOfControlPoints) :
+    initialPositions(std::move(_initialPositions)),
+    offsets(_offsets),
+    positions(initialPositions.size()),
+    NumberOfFrames(_numberOfFrames),
+    NumberOfControlPoints(_numberOfControlPoints)
+  {
+    itkAssertOrThrowMacro(
+      this->initialPositions.size() == size_t(3) * this->NumberOfFrames * this->NumberOfControlPoints,
+      "Size of initial positions does not match the number of frames and control points.");
+    this->Update();
+  }
+
+  void PrepareForEvaluation(bool /*evaluate_jacobians*/,
+                            bool new_evaluation_point) override
+  {
+    if (new_evaluation_point) this->Update();
+  }
+
+  // Recalculate all positions from the current offsets.
+  void Update()
+  {
+    const size_t n = this->positions.size();
+    for (size_t i = 0; i < n; ++i)
+      {
+      this->positions[i] = this->initialPositions[i] + this->offsets[i];
+      }
+    ++this->NumberOfUpdates;
+    for (const auto &callback : this->updateCallbacks) callback();
+  }
+
+  // Called after every update, in order, e.g. to recalculate whatever is
+  // derived from the positions before residuals are evaluated.
+  void AddUpdateCallback(std::function<void()> callback)
+  {
+    this->updateCallbacks.push_back(std::move(callback));
+  }
+
+  // Pointer to the xyz coordinates of a control point.
+  const double* GetPoint(unsigned int frame, size_t id) const
+    {
+    return this->positions.data() + 3 * (size_t(frame) * this->NumberOfControlPoints + id);
+    }
+
+  const double* GetInitialPoint(unsigned int frame, size_t id) const
+    {
+    return this->initialPositions.data() + 3 * (size_t(frame) * this->NumberOfControlPoints + id);
+    }
+
+  unsigned int GetNumberOfFrames() const { return this->NumberOfFrames; }
+  unsigned int GetNumberOfControlPoints() const { return this->NumberOfControlPoints; }
+  size_t GetNumberOfUpdates() const { return this->NumberOfUpdates; }
+
+private:
+
+  const std::vector<double> initialPositions;
+  const double* const       offsets;
+  std::vector<double>       positions;
+  std::vector<std::function<void()>> updateCallbacks;
+
+  const unsigned int NumberOfFrames;
+  const unsigned int NumberOfControlPoints;
+  size_t NumberOfUpdates = 0;
+
+}; // end class
+
+} // namespace sissr
+
+#endif
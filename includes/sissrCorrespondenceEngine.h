@@ -0,0 +1,579 @@
+#ifndef sissr_CorrespondenceEngine_h
+#define sissr_CorrespondenceEngine_h
+
+// STD
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <string>
+#include <vector>
+
+// ITK
+#include <itkMacro.h>
+
+// SiSSR
+#include <sissrClosestPointTransform.h>
+#include <sissrControlPointBuffer.h>
+#include <sissrFlatKdTree.h>
+#include <sissrRegularPatchKernel.h>
+#include <sissrTriangleBVH.h>
+#include <sissrUtils.h>
+#include <sissrValenceKernels.h>
+
+namespace sissr {
+
+// Which part of the offset from its correspondence a primary residual
+// measures in full: all of it, or only its component along the candidate's
+// normal or along the mean of the candidate's and the model's normals.
+enum class PrimaryResidualType { PointToPoint, PointToPlane, Symmetric };
+
+/*
+ Surface points and closest candidate points for every sample of every
+ frame, recalculated together whenever the control points move.  The
+ candidates are either points (FlatKdTree), the candidate surface itself
+ (TriangleBVH) or its narrow-band closest point transform
+ (ClosestPointTransform).  The latter also provides the derivative of each
+ residual with respect to its surface point.
+
+ Update() is meant to be registered as a ControlPointBuffer update
+ callback.  For each frame it evaluates all surface samples (cells in
+ parallel), sorts the samples of each candidate index into Morton order
+ and answers them as batches, in parallel.  The primary residuals then
+ only read the results.
+
+ With an update interval, Update() only moves the surface points and the
+ correspondences are kept until UpdateCorrespondences() is called, e.g. by
+ a CorrespondenceIterationCallback after accepted iterations.
+
+ Either way, each search also finds the gap between the closest and the
+ second closest candidate point or triangle.  Until a sample has moved by
+ half that gap, its closest candidate cannot change, so it is projected
+ onto that candidate again instead of being searched for.  Late in a
+ registration, when the samples barely move, that is most of them.
+
+ With an approximation epsilon > 0, tree searches may return a candidate up
+ to 1 + epsilon times as far as the closest one.  Such answers are not
+ cached.  Closest point transforms ignore epsilon.
+
+ For point-to-plane and symmetric residuals, each correspondence also gets
+ a unit normal: that of the closest triangle or of the cell the closest
+ point stands for, flipped towards the model's normal.  The model's normal
+ is that of the sample's control triangle, which is cheap and close enough
+ to orient the plane; it is held fixed until the next search.
+ */
+template<typename TFixedMesh, typename TMovingMesh>
+class CorrespondenceEngine
+{
+
+public:
+
+  using TLocator = FlatKdTree<typename TFixedMesh::PointsContainer>;
+  using TLocatorVector = std::vector<typename TLocator::Pointer>;
+  using TLocatorMapVector = std::vector<std::map<size_t, typename TLocator::Pointer>>;
+  using TTriangleLocator = TriangleBVH<TFixedMesh>;
+  using TTriangleLocatorVector = std::vector<typename TTriangleLocator::Pointer>;
+  using TTriangleLocatorMapVector = std::vector<std::map<size_t, typename TTriangleLocator::Pointer>>;
+  using TTransform = ClosestPointTransform<TFixedMesh>;
+  using TTransformVector = std::vector<typename TTransform::Pointer>;
+  using TTransformMapVector = std::vector<std::map<size_t, typename TTransform::Pointer>>;
+  using TMovingVector = std::vector<typename TMovingMesh::Pointer>;
+  using TPointIdentifier = typename TMovingMesh::PointIdentifier;
+
+  using TKernels = ValenceKernelTable<typename TMovingMesh::RealType,
+                                      TPointIdentifier,
+                                      TMovingMesh::TMatrices::MinimumValency,
+                                      TMovingMesh::TMatrices::MaximumValency>;
+
+  CorrespondenceEngine(const TMovingVector &_movingVector,
+                       const ControlPointBuffer &_buffer,
+                       unsigned int _numberOfThreads) :
+    movingVector(_movingVector),
+    buffer(_buffer),
+    NumberOfThreads(std::max(1u, _numberOfThreads)),
+    NumberOfSamples(_movingVector.front()->GetSurfaceParameterList().size()),
+    SamplesPerCell(_movingVector.front()->GetNumberOfSamplesPerCell())
+  {
+    itkAssertOrThrowMacro(this->movingVector.size() == this->buffer.GetNumberOfFrames(),
+                          "Number of moving meshes does not match the control point buffer.");
+    const size_t size = size_t(3) * this->buffer.GetNumberOfFrames() * this->NumberOfSamples;
+    this->surfacePoints.resize(size);
+    this->correspondences.resize(size);
+    this->cacheAnchors.resize(size);
+    this->cacheGaps.resize(size / 3);
+    this->cachePoints.resize(size / 3);
+    this->cacheTriangles.resize(size / 3);
+
+    // Map lookups are done once, here, rather than on every update.
+    this->cells.resize(this->movingVector.size());
+    for (size_t f = 0; f < this->movingVector.size(); ++f)
+      {
+      const auto &moving = this->movingVector[f];
+      for (size_t first = 0; first < this->NumberOfSamples; first += this->SamplesPerCell)
+        {
+        const auto cellID = moving->GetSurfaceParameter(first).first;
+        Cell cell;
+        cell.first = first;
+        cell.N = moving->GetNForCell(cellID);
+        cell.L = moving->GetPointListForCell(cellID).data_block();
+        cell.kernel = TKernels::GetSurfacePointKernel(cell.N);
+        const auto ids = moving->GetCells()->ElementAt(cellID)->GetPointIds();
+        for (unsigned int k = 0; k < 3; ++k) cell.triangle[k] = ids[k];
+        this->cells[f].push_back(cell);
+        }
+      }
+  }
+
+  // One candidate index per frame, for all samples.
+  void SetLocators(const TLocatorVector &locators)
+    { this->SetUnlabeledLocators(locators); }
+  void SetLocators(const TTriangleLocatorVector &locators)
+    { this->SetUnlabeledLocators(locators); }
+  void SetLocators(const TTransformVector &locators)
+    { this->SetUnlabeledLocators(locators); }
+
+  // One candidate index per label and frame; samples query their cell's label.
+  void SetLocators(const TLocatorMapVector &locatorMaps)
+    { this->SetLabeledLocators(locatorMaps); }
+  void SetLocators(const TTriangleLocatorMapVector &locatorMaps)
+    { this->SetLabeledLocators(locatorMaps); }
+  void SetLocators(const TTransformMapVector &locatorMaps)
+    { this->SetLabeledLocators(locatorMaps); }
+
+  // 0: find correspondences on every update; k > 0: see the class comment.
+  void SetUpdateInterval(unsigned int interval) { this->UpdateInterval = interval; }
+  unsigned int GetUpdateInterval() const { return this->UpdateInterval; }
+
+  void Update()
+  {
+    itkAssertOrThrowMacro(!this->groups.empty(), "No locators were set.");
+    const auto start = std::chrono::steady_clock::now();
+    for (unsigned int f = 0; f < this->movingVector.size(); ++f) this->UpdateSurfacePoints(f);
+    if (0 == this->UpdateInterval || this->Stale)
+      {
+      this->FindCorrespondences();
+      }
+    else
+      {
+      ++this->NumberOfReuses;
+      }
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    this->UpdateTimeInSeconds += elapsed.count();
+    ++this->NumberOfUpdates;
+  }
+
+  // Closest candidates of the current surface points
+  void UpdateCorrespondences()
+  {
+    itkAssertOrThrowMacro(!this->groups.empty(), "No locators were set.");
+    const auto start = std::chrono::steady_clock::now();
+    this->FindCorrespondences();
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    this->UpdateTimeInSeconds += elapsed.count();
+  }
+
+  // The next Update() finds correspondences regardless of the interval.
+  void Invalidate() { this->Stale = true; }
+
+  void SetApproximation(double epsilon)
+  {
+    itkAssertOrThrowMacro(epsilon >= 0.0, "epsilon must not be negative.");
+    this->Epsilon = epsilon;
+  }
+  double GetApproximation() const { return this->Epsilon; }
+
+  void SetPrimaryResidualType(PrimaryResidualType type)
+  {
+    this->ResidualType = type;
+    this->normals.assign((PrimaryResidualType::PointToPoint == type) ? 0 : this->correspondences.size(), 0.0);
+    this->Stale = true;
+  }
+  PrimaryResidualType GetPrimaryResidualType() const { return this->ResidualType; }
+
+  const double* GetSurfacePoint(unsigned int frame, size_t index) const
+    { return this->surfacePoints.data() + 3 * (size_t(frame) * this->NumberOfSamples + index); }
+
+  const double* GetCorrespondence(unsigned int frame, size_t index) const
+    { return this->correspondences.data() + 3 * (size_t(frame) * this->NumberOfSamples + index); }
+
+  // Unit normal along which the residual is measured in full; null for
+  // point-to-point residuals.
+  const double* GetNormal(unsigned int frame, size_t index) const
+    {
+    if (this->normals.empty()) return nullptr;
+    return this->normals.data() + 3 * (size_t(frame) * this->NumberOfSamples + index);
+    }
+
+  // d(surface point - correspondence) / d(surface point), 9 doubles
+  // (row-major); null unless the locators are closest point transforms and
+  // the correspondences follow every update.
+  const double* GetResidualJacobian(unsigned int frame, size_t index) const
+    {
+    if (this->residualJacobians.empty() || this->UpdateInterval > 0) return nullptr;
+    return this->residualJacobians.data() + 9 * (size_t(frame) * this->NumberOfSamples + index);
+    }
+
+  bool GetUseLabels() const { return this->UseLabels; }
+  size_t GetNumberOfUpdates() const { return this->NumberOfUpdates; }
+  size_t GetNumberOfCorrespondenceUpdates() const { return this->NumberOfCorrespondenceUpdates; }
+  size_t GetNumberOfReuses() const { return this->NumberOfReuses; }
+  size_t GetNumberOfQueries() const { return this->NumberOfQueries; }
+  // Samples which kept their previous closest candidate without a search
+  size_t GetNumberOfCacheHits() const { return this->NumberOfCacheHits; }
+  double GetUpdateTimeInSeconds() const { return this->UpdateTimeInSeconds; }
+
+private:
+
+  struct Cell
+  {
+    size_t first;
+    unsigned int N;
+    const TPointIdentifier* L;
+    typename TKernels::TSurfacePointKernel kernel;
+    TPointIdentifier triangle[3]; // The control triangle
+  };
+
+  // Exactly one of the locators is set.
+  struct QueryGroup
+  {
+    const TLocator* locator = nullptr;
+    const TTriangleLocator* triangles = nullptr;
+    const TTransform* transform = nullptr;
+    std::vector<size_t> samples;
+  };
+
+  static void SetGroupLocator(QueryGroup &group, const TLocator* locator)
+    { group.locator = locator; }
+  static void SetGroupLocator(QueryGroup &group, const TTriangleLocator* triangles)
+    { group.triangles = triangles; }
+  static void SetGroupLocator(QueryGroup &group, const TTransform* transform)
+    { group.transform = transform; }
+
+  void AllocateResidualJacobians()
+  {
+    this->residualJacobians.clear();
+    for (const auto &frameGroups : this->groups)
+      for (const auto &group : frameGroups)
+        if (nullptr != group.transform)
+          {
+          this->residualJacobians.assign(size_t(9) * this->movingVector.size() * this->NumberOfSamples, 0.0);
+          return;
+          }
+  }
+
+  template<typename TLocatorPointer>
+  void SetUnlabeledLocators(const std::vector<TLocatorPointer> &locators)
+  {
+    itkAssertOrThrowMacro(locators.size() == this->movingVector.size(), "One locator per frame is required.");
+    this->UseLabels = false;
+    this->HasCache = false;
+    this->Stale = true;
+    this->groups.assign(this->movingVector.size(), {});
+    for (size_t f = 0; f < locators.size(); ++f)
+      {
+      QueryGroup group;
+      SetGroupLocator(group, locators[f].GetPointer());
+      group.samples.resize(this->NumberOfSamples);
+      for (size_t i = 0; i < this->NumberOfSamples; ++i) group.samples[i] = i;
+      this->groups[f].push_back(std::move(group));
+      }
+    this->AllocateResidualJacobians();
+  }
+
+  template<typename TLocatorMap>
+  void SetLabeledLocators(const std::vector<TLocatorMap> &locatorMaps)
+  {
+    itkAssertOrThrowMacro(locatorMaps.size() == this->movingVector.size(), "One locator map per frame is required.");
+    this->UseLabels = true;
+    this->HasCache = false;
+    this->Stale = true;
+    this->groups.assign(this->movingVector.size(), {});
+    for (size_t f = 0; f < locatorMaps.size(); ++f)
+      {
+      const auto &moving = this->movingVector[f];
+      std::map<size_t, QueryGroup> byLabel;
+      for (size_t i = 0; i < this->NumberOfSamples; ++i)
+        {
+        const auto cellID = moving->GetSurfaceParameter(i).first;
+        const size_t label = moving->GetCellData()->ElementAt(cellID);
+        auto &group = byLabel[label];
+        if (group.samples.empty())
+          {
+          const auto it = locatorMaps[f].find(label);
+          itkAssertOrThrowMacro(locatorMaps[f].end() != it,
+                                "No candidates for label " + std::to_string(label) + ".");
+          SetGroupLocator(group, it->second.GetPointer());
+          }
+        group.samples.push_back(i);
+        }
+      for (auto &group : byLabel) this->groups[f].push_back(std::move(group.second));
+      }
+    this->AllocateResidualJacobians();
+  }
+
+  void UpdateSurfacePoints(unsigned int frame)
+  {
+    const auto &moving = this->movingVector[frame];
+    const auto &frameCells = this->cells[frame];
+    const double* X = this->buffer.GetPoint(frame, 0);
+    double* out = this->surfacePoints.data() + 3 * size_t(frame) * this->NumberOfSamples;
+    const size_t S = this->SamplesPerCell;
+
+    ParallelFor(frameCells.size(), this->NumberOfThreads, [&](size_t begin, size_t end)
+      {
+      for (size_t c = begin; c < end; ++c)
+        {
+        const auto &cell = frameCells[c];
+        if (6 == cell.N)
+          {
+          RegularPatchKernel::Evaluate(moving->GetRegularStencils(), moving->GetRegularStencilStride(),
+                                       S, X, cell.L, out + 3 * cell.first);
+          }
+        else
+          {
+          for (size_t i = cell.first; i < cell.first + S; ++i)
+            cell.kernel(moving->GetStencil(i), X, cell.L, out + 3 * i);
+          }
+        }
+      });
+  }
+
+  void FindCorrespondences()
+  {
+    for (unsigned int f = 0; f < this->movingVector.size(); ++f)
+      for (auto &group : this->groups[f]) this->FindCorrespondences(f, group);
+    this->HasCache = true;
+    this->Stale = false;
+    ++this->NumberOfCorrespondenceUpdates;
+  }
+
+  void FindCorrespondences(unsigned int frame, QueryGroup &group)
+  {
+    const double* points = this->GetSurfacePoint(frame, 0);
+    const size_t offset = size_t(frame) * this->NumberOfSamples;
+    double* out = this->correspondences.data() + 3 * offset;
+
+    // Samples which moved less than half their gap since they were last
+    // searched for keep their closest point or triangle.
+    std::vector<size_t> misses;
+    if (this->HasCache && nullptr == group.transform)
+      {
+      std::vector<std::uint8_t> hit(group.samples.size(), 0);
+      ParallelFor(group.samples.size(), this->NumberOfThreads, [&](size_t begin, size_t end)
+        {
+        for (size_t k = begin; k < end; ++k)
+          {
+          const size_t i = group.samples[k];
+          const double* anchor = this->cacheAnchors.data() + 3 * (offset + i);
+          double moved = 0.0;
+          for (unsigned int d = 0; d < 3; ++d) moved += (points[3 * i + d] - anchor[d]) * (points[3 * i + d] - anchor[d]);
+          const double gap = this->cacheGaps[offset + i];
+          if (!(4.0 * moved < gap * gap)) continue;
+          hit[k] = 1;
+          if (nullptr != group.triangles)
+            {
+            group.triangles->FindClosestPointOnTriangle(points + 3 * i, this->cacheTriangles[offset + i], out + 3 * i);
+            }
+          else
+            {
+            const auto &p = group.locator->GetPoints()->ElementAt(this->cachePoints[offset + i]);
+            for (unsigned int d = 0; d < 3; ++d) out[3 * i + d] = p[d];
+            }
+          }
+        });
+      for (size_t k = 0; k < group.samples.size(); ++k)
+        if (0 == hit[k]) misses.push_back(group.samples[k]);
+      this->NumberOfCacheHits += group.samples.size() - misses.size();
+      }
+    else
+      {
+      misses = group.samples;
+      }
+
+    // Morton order over the bounding box of the remaining samples
+    double lower[3], upper[3];
+    std::fill(lower, lower + 3, std::numeric_limits<double>::max());
+    std::fill(upper, upper + 3, std::numeric_limits<double>::lowest());
+    for (const auto &i : misses)
+      for (unsigned int d = 0; d < 3; ++d)
+        {
+        lower[d] = std::min(lower[d], points[3 * i + d]);
+        upper[d] = std::max(upper[d], points[3 * i + d]);
+        }
+    std::vector<std::pair<std::uint64_t, size_t>> keys;
+    keys.reserve(misses.size());
+    for (const auto &i : misses)
+      keys.emplace_back(CalculateMortonCode(points + 3 * i, lower, upper), i);
+    std::sort(keys.begin(), keys.end());
+    for (size_t k = 0; k < keys.size(); ++k) misses[k] = keys[k].second;
+    this->NumberOfQueries += misses.size();
+
+    // Contiguous runs of the sorted samples per thread; gaps stay 0, i.e.
+    // not cached, for approximate answers.
+    const bool exact = (0.0 == this->Epsilon);
+    const auto &samples = misses;
+    ParallelFor(samples.size(), this->NumberOfThreads, [&](size_t begin, size_t end)
+      {
+      const size_t count = end - begin;
+      std::vector<double> queries(3 * count);
+      for (size_t k = 0; k < count; ++k)
+        for (unsigned int d = 0; d < 3; ++d)
+          queries[3 * k + d] = points[3 * samples[begin + k] + d];
+
+      std::vector<double> closest(3 * count), gaps(count);
+      if (nullptr != group.transform)
+        {
+        std::vector<double> jacobians(9 * count);
+        group.transform->FindClosestPoints(queries.data(), count, closest.data(), jacobians.data());
+        double* J = this->residualJacobians.data() + 9 * offset;
+        for (size_t k = 0; k < count; ++k)
+          std::copy(jacobians.data() + 9 * k, jacobians.data() + 9 * (k + 1), J + 9 * samples[begin + k]);
+        }
+      else if (nullptr != group.triangles)
+        {
+        std::vector<std::uint32_t> triangles(count);
+        group.triangles->FindClosestPoints(queries.data(), count, closest.data(), triangles.data(),
+                                           exact ? gaps.data() : nullptr, this->Epsilon);
+        for (size_t k = 0; k < count; ++k) this->cacheTriangles[offset + samples[begin + k]] = triangles[k];
+        }
+      else
+        {
+        std::vector<typename TLocator::PointIdentifier> ids(count);
+        group.locator->FindClosestPoints(queries.data(), count, ids.data(),
+                                         exact ? gaps.data() : nullptr, this->Epsilon);
+        for (size_t k = 0; k < count; ++k)
+          {
+          this->cachePoints[offset + samples[begin + k]] = ids[k];
+          const auto &p = group.locator->GetPoints()->ElementAt(ids[k]);
+          for (unsigned int d = 0; d < 3; ++d) closest[3 * k + d] = p[d];
+          }
+        }
+
+      for (size_t k = 0; k < count; ++k)
+        {
+        const size_t i = samples[begin + k];
+        for (unsigned int d = 0; d < 3; ++d)
+          {
+          out[3 * i + d] = closest[3 * k + d];
+          this->cacheAnchors[3 * (offset + i) + d] = queries[3 * k + d];
+          }
+        this->cacheGaps[offset + i] = gaps[k];
+        }
+      });
+
+    if (!this->normals.empty()) this->UpdateNormals(frame, group);
+  }
+
+  // From the closest triangle or point of every sample in the group
+  void UpdateNormals(unsigned int frame, const QueryGroup &group)
+  {
+    itkAssertOrThrowMacro(nullptr == group.transform,
+                          "Closest point transforms provide no normals.");
+    itkAssertOrThrowMacro(nullptr != group.triangles || nullptr != group.locator->GetNormals(),
+                          "The candidate points have no normals.");
+    const size_t offset = size_t(frame) * this->NumberOfSamples;
+    const double* X = this->buffer.GetPoint(frame, 0);
+    const auto &frameCells = this->cells[frame];
+    const bool symmetric = (PrimaryResidualType::Symmetric == this->ResidualType);
+
+    ParallelFor(group.samples.size(), this->NumberOfThreads, [&](size_t begin, size_t end)
+      {
+      for (size_t k = begin; k < end; ++k)
+        {
+        const size_t i = group.samples[k];
+        double candidate[3];
+        if (nullptr != group.triangles)
+          {
+          const double* n = group.triangles->GetNormal(this->cacheTriangles[offset + i]);
+          std::copy(n, n + 3, candidate);
+          }
+        else
+          {
+          const auto &n = group.locator->GetNormals()->ElementAt(this->cachePoints[offset + i]);
+          for (unsigned int d = 0; d < 3; ++d) candidate[d] = n[d];
+          }
+
+        const auto &cell = frameCells[i / this->SamplesPerCell];
+        const double* a = X + 3 * cell.triangle[0];
+        const double* b = X + 3 * cell.triangle[1];
+        const double* c = X + 3 * cell.triangle[2];
+        double e1[3], e2[3], model[3];
+        for (unsigned int d = 0; d < 3; ++d) e1[d] = b[d] - a[d], e2[d] = c[d] - a[d];
+        model[0] = e1[1] * e2[2] - e1[2] * e2[1];
+        model[1] = e1[2] * e2[0] - e1[0] * e2[2];
+        model[2] = e1[0] * e2[1] - e1[1] * e2[0];
+        const double length = std::sqrt(model[0] * model[0] + model[1] * model[1] + model[2] * model[2]);
+        if (length > 0.0) for (unsigned int d = 0; d < 3; ++d) model[d] /= length;
+
+        // Candidate normals are only as consistently oriented as the
+        // candidate triangles.
+        const double dot = candidate[0] * model[0] + candidate[1] * model[1] + candidate[2] * model[2];
+        const double sign = (dot < 0.0) ? -1.0 : 1.0;
+
+        double* normal = this->normals.data() + 3 * (offset + i);
+        for (unsigned int d = 0; d < 3; ++d)
+          normal[d] = symmetric ? sign * candidate[d] + model[d] : sign * candidate[d];
+        const double norm = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+        if (norm > 0.0) for (unsigned int d = 0; d < 3; ++d) normal[d] /= norm;
+        }
+      });
+  }
+
+  // 21 bits per dimension
+  static std::uint64_t CalculateMortonCode(const double* p, const double* lower, const double* upper)
+  {
+    std::uint64_t code = 0;
+    for (unsigned int d = 0; d < 3; ++d)
+      {
+      const double extent = upper[d] - lower[d];
+      const double t = (extent > 0.0) ? (p[d] - lower[d]) / extent : 0.0;
+      const std::uint64_t c = std::uint64_t(t * ((1u << 21) - 1));
+      for (unsigned int b = 0; b < 21; ++b) code |= ((c >> b) & 1u) << (3 * b + d);
+      }
+    return code;
+  }
+
+  const TMovingVector &movingVector;
+  const ControlPointBuffer &buffer;
+  const unsigned int NumberOfThreads;
+  const size_t NumberOfSamples;
+  const size_t SamplesPerCell;
+
+  std::vector<std::vector<Cell>> cells; // [frame][cell]
+
+  bool UseLabels = false;
+  std::vector<std::vector<QueryGroup>> groups; // [frame][group]
+
+  // [frame][sample][xyz]
+  std::vector<double> surfacePoints;
+  std::vector<double> correspondences;
+  std::vector<double> residualJacobians; // [frame][sample][3x3], if any
+  std::vector<double> normals;           // [frame][sample][xyz], if any
+
+  // Where each sample was last searched for, the gap found there and the
+  // closest candidate; [frame][sample]
+  bool HasCache = false;
+  std::vector<double> cacheAnchors;
+  std::vector<double> cacheGaps;
+  std::vector<typename TLocator::PointIdentifier> cachePoints;
+  std::vector<std::uint32_t> cacheTriangles;
+
+  unsigned int UpdateInterval = 0;
+  bool Stale = true;
+  double Epsilon = 0.0;
+  PrimaryResidualType ResidualType = PrimaryResidualType::PointToPoint;
+
+  size_t NumberOfUpdates = 0;
+  size_t NumberOfCorrespondenceUpdates = 0;
+  size_t NumberOfReuses = 0;
+  std::atomic<size_t> NumberOfQueries{0};
+  std::atomic<size_t> NumberOfCacheHits{0};
+  double UpdateTimeInSeconds = 0.0;
+
+}; // end class
+
+} // namespace sissr
+
+#endif
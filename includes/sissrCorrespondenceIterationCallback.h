@@ -0,0 +1,52 @@
+#ifndef sissr_CorrespondenceIterationCallback_h
+#define sissr_CorrespondenceIterationCallback_h
+
+// Ceres
+#include <ceres/iteration_callback.h>
+
+// ITK
+#include <itkMacro.h>
+
+namespace sissr {
+
+/*
+ Finds the correspondences of a CorrespondenceEngine again after every
+ `interval` accepted iterations.  The control point buffer then still holds
+ the accepted point, at which Ceres has just evaluated the Jacobian, so the
+ new correspondences belong to the current solution.  Trial steps in between
+ are evaluated against fixed correspondences.
+ */
+template<typename TCorrespondenceEngine>
+class CorrespondenceIterationCallback : public ceres::IterationCallback
+{
+
+public:
+
+  CorrespondenceIterationCallback(TCorrespondenceEngine &_correspondences,
+                                  unsigned int _interval) :
+    correspondences(_correspondences),
+    interval(_interval)
+  {
+    itkAssertOrThrowMacro(this->interval > 0, "The update interval must be positive.");
+  }
+
+  ceres::CallbackReturnType operator()(const ceres::IterationSummary &summary) override
+  {
+    if (summary.iteration > 0 && summary.step_is_successful && 0 == ++this->accepted % this->interval)
+      {
+      this->correspondences.UpdateCorrespondences();
+      }
+    return ceres::SOLVER_CONTINUE;
+  }
+
+private:
+
+  TCorrespondenceEngine &correspondences;
+  const unsigned int interval;
+  unsigned int accepted = 0;
+
+}; // end class
+
+} // namespace sissr
+
+#endif
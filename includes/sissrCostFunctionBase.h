@@ -2,14 +2,15 @@
 #define sissr_CostFunctionBase_h
 
 // STD
-#include <limits>
-
-// ITK
-#include <itkPointsLocator.h>
+#include <cmath>
+#include <vector>
 
 // Ceres
 #include <ceres/ceres.h>
 
+// SiSSR
+#include <sissrCorrespondenceEngine.h>
+
 namespace sissr {
 
 template<class TFixedMesh, class TMovingMesh>
@@ -28,20 +29,42 @@ public ceres::CostFunction
   using TMovingPoint = typename TMovingMesh::PointType;
   using TMovingLabel = typename TMovingMesh::MeshTraits::CellPixelType;
 
-  using TLocator = itk::PointsLocator< TFixedContainer >;
+  using TCorrespondenceEngine = CorrespondenceEngine<TFixedMesh, TMovingMesh>;
+  using TLocator = typename TCorrespondenceEngine::TLocator;
   using TLocatorPointer = typename TLocator::Pointer;
   using TLocatorMap = typename std::map<size_t, typename TLocator::Pointer>;
 
+  /*
+   Residuals for `count` consecutive entries of the surface parameter list,
+   starting at `index`.  All of them must lie in the same cell, so that they
+   share the cell's one-ring of parameter blocks; each contributes three
+   residuals, in order.
+
+   Surface points and their correspondences are read from the engine, which
+   recalculates them for all samples once per evaluation point.
+
+   If the engine provides a normal n for a sample, its offset e from the
+   correspondence is projected: r = (n n^T + t (I - n n^T)) e, with t the
+   square root of `tangentialWeight`.  Samples may then slide along the
+   candidate surface at a cost of only `tangentialWeight` times the
+   point-to-point one.
+   */
   CostFunctionBase(
     const TMovingMeshPointer &_moving,
-    const TMovingContainerPointer &_initialPoints,
-    unsigned int _index) :
+    const TCorrespondenceEngine &_correspondences,
+    unsigned int _frame,
+    unsigned int _index,
+    unsigned int _count = 1,
+    double _tangentialWeight = 1.0) :
     moving(_moving),
-    initialPoints(_initialPoints),
+    correspondences(_correspondences),
+    frame(_frame),
     index(_index),
-    param(this->moving->GetSurfaceParameterList().at(this->index)),
-    residual(this->moving->GetResidualBlock(this->param.first,this->param.second)),
-    L(this->moving->GetPointListForCell(this->param.first))
+    count(_count),
+    tangential(std::sqrt(_tangentialWeight)),
+    cellID(this->moving->GetSurfaceParameter(this->index).first),
+    L(this->moving->GetPointListForCell(this->cellID)),
+    label(this->moving->GetCellData()->ElementAt(this->cellID))
   {
     this->Setup();
   }
@@ -55,22 +78,35 @@ public ceres::CostFunction
 private:
 
   void Setup() {
+    itkAssertOrThrowMacro(this->label != 0, "Label == 0");
+    itkAssertOrThrowMacro(this->count > 0, "A residual block must contain at least one sample.");
+    itkAssertOrThrowMacro(this->tangential >= 0.0, "The tangential weight must not be negative.");
+    for (unsigned int s = 0; s < this->count; ++s)
+      {
+      itkAssertOrThrowMacro(this->moving->GetSurfaceParameter(this->index + s).first == this->cellID,
+                            "All samples in a residual block must lie in the same cell.");
+      this->stencils.push_back(this->moving->GetStencil(this->index + s));
+      }
     for (size_t i = 0; i < this->L.size(); ++i)
       {
       this->mutable_parameter_block_sizes()->push_back(3);
       }
-    this->set_num_residuals(3);
+    this->set_num_residuals(3 * this->count);
   }
 
   const typename TMovingMesh::Pointer &moving;
-  const typename TMovingContainer::Pointer &initialPoints;
+  const TCorrespondenceEngine &correspondences;
 
+  const unsigned int frame;
   const unsigned int index;
-  const typename TMovingMesh::TSurfaceParameter param;
-  const vnl_vector<typename TMovingMesh::RealType> residual;
+  const unsigned int count;
+  const double tangential;
+  const typename TMovingMesh::CellIdentifier cellID;
   const vnl_vector<typename TMovingMesh::PointIdentifier> L;
+  const TMovingLabel label;
 
-  virtual TFixedPoint GetClosestPoint(const TMovingPoint &point, const TMovingLabel &label) const = 0;
+  // N+6 weights per sample, owned by the mesh's stencil table.
+  std::vector<const typename TMovingMesh::RealType*> stencils;
 
 }; // end class
 
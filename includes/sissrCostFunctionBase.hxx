@@ -8,33 +8,27 @@ namespace sissr {
 template<class TFixedMesh, class TMovingMesh>
 bool
 CostFunctionBase<TFixedMesh, TMovingMesh>
-::Evaluate(const double* const* parameters,
+::Evaluate(const double* const* /*parameters*/,
            double* residuals,
            double** jacobians) const
 {
 
-  for (size_t i = 0; i < this->L.size(); ++i)
+  // Both are calculated once per evaluation point, before any residual block
+  // is evaluated; nothing is looked up or written here, so that residual
+  // blocks may be evaluated concurrently.
+  for (unsigned int s = 0; s < this->count; ++s)
     {
-    const auto initial = this->initialPoints->ElementAt(this->L[i]);
-    const auto difference = parameters[i];
-    typename TMovingMesh::PointType current;
-    for (unsigned int d = 0; d < 3; ++d)
+    const double* surfacePoint = this->correspondences.GetSurfacePoint(this->frame, this->index + s);
+    const double* fixedPoint = this->correspondences.GetCorrespondence(this->frame, this->index + s);
+    double* r = residuals + 3 * s;
+    for (unsigned int d = 0; d < 3; ++d) r[d] = surfacePoint[d] - fixedPoint[d];
+    const double* n = this->correspondences.GetNormal(this->frame, this->index + s);
+    if (nullptr != n)
       {
-      current[d] = initial[d] + difference[d];
+      const double along = (1.0 - this->tangential) * (n[0] * r[0] + n[1] * r[1] + n[2] * r[2]);
+      for (unsigned int d = 0; d < 3; ++d) r[d] = this->tangential * r[d] + along * n[d];
       }
-    this->moving->SetPoint( this->L[i], current );
-    }      
-
-  // Residuals
-  const auto movingPoint =
-    this->moving->GetPointOnSurface(this->param.first, this->param.second);
-  const auto cellID = std::get<0>(this->moving->GetSurfaceParameter(this->index));
-  const auto label = this->moving->GetCellData()->ElementAt(cellID);
-  itkAssertOrThrowMacro(label != 0, "Label == 0");
-  const auto fixedPoint = this->GetClosestPoint(movingPoint, label);
-  const auto error = movingPoint.GetVnlVector() - fixedPoint.GetVnlVector();
-
-  for (unsigned int d = 0; d < 3; ++d) residuals[d] = error[d];
+    }
 
   // Return if Jacobian wasn't requested.
   if (nullptr == jacobians)
@@ -42,17 +36,53 @@ CostFunctionBase<TFixedMesh, TMovingMesh>
     return true;
     }
 
-  // Set Jacobian to zero.
+  // Each (3 * count) x 3 block is diagonal within each sample's rows, unless
+  // the correspondences move with the surface point or the offset is
+  // projected; then it is the stencil weight times d(residual)/d(surface
+  // point).
   for (size_t i = 0; i < L.size(); ++i)
     {
 
     if (nullptr == jacobians[i]) continue;
 
-    ceres::MatrixRef(jacobians[i],3,3).setZero();
+    ceres::MatrixRef(jacobians[i],3 * this->count,3).setZero();
 
-    jacobians[i][0] = residual[i];
-    jacobians[i][4] = residual[i];
-    jacobians[i][8] = residual[i];
+    for (unsigned int s = 0; s < this->count; ++s)
+      {
+      double* J = jacobians[i] + 9 * s;
+      const double w = this->stencils[s][i];
+      const double* M = this->correspondences.GetResidualJacobian(this->frame, this->index + s);
+      const double* n = this->correspondences.GetNormal(this->frame, this->index + s);
+      if (nullptr == M && nullptr == n)
+        {
+        J[0] = w;
+        J[4] = w;
+        J[8] = w;
+        }
+      else if (nullptr == n)
+        {
+        for (unsigned int e = 0; e < 9; ++e) J[e] = w * M[e];
+        }
+      else
+        {
+        // w (t I + (1 - t) n n^T), times M if the correspondence moves
+        double P[9];
+        for (unsigned int r = 0; r < 3; ++r)
+          for (unsigned int c = 0; c < 3; ++c)
+            P[3 * r + c] = (1.0 - this->tangential) * n[r] * n[c] + ((r == c) ? this->tangential : 0.0);
+        for (unsigned int r = 0; r < 3; ++r)
+          for (unsigned int c = 0; c < 3; ++c)
+            {
+            double value = P[3 * r + c];
+            if (nullptr != M)
+              {
+              value = 0.0;
+              for (unsigned int k = 0; k < 3; ++k) value += P[3 * r + k] * M[3 * k + c];
+              }
+            J[3 * r + c] = w * value;
+            }
+        }
+      }
 
     }
 
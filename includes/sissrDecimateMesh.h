@@ -0,0 +1,123 @@
+#ifndef sissr_DecimateMesh_h
+#define sissr_DecimateMesh_h
+
+// System
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <set>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// ITK
+#include <itkMacro.h>
+#include <itkTriangleCell.h>
+
+namespace sissr {
+
+// Mean length of the cells' edges, or 0 for a mesh without edges.
+template<typename TMesh>
+double
+CalculateMeanEdgeLength(const TMesh* mesh) {
+
+  double total = 0.0;
+  size_t count = 0;
+  for (auto it = mesh->GetCells()->Begin();
+       it != mesh->GetCells()->End();
+       ++it) {
+    const auto ids = it.Value()->GetPointIds();
+    const unsigned int n = it.Value()->GetNumberOfPoints();
+    for (unsigned int k = 0; n > 1 && k < n; ++k) {
+      total += mesh->GetPoint(ids[k]).EuclideanDistanceTo(mesh->GetPoint(ids[(k + 1) % n]));
+      ++count;
+    }
+  }
+
+  return (count > 0) ? total / count : 0.0;
+
+}
+
+// Vertex clustering on a grid of the given spacing: the points within each
+// grid cell are replaced by their mean, and every cell is fanned into
+// triangles on the clustered points.  Triangles which collapse, or repeat
+// another of the same label, are dropped.  Cell data (the labels) is kept.
+// The result is a triangle soup, which is all the candidate locators need.
+template<typename TMesh>
+typename TMesh::Pointer
+DecimateMesh(const TMesh* mesh, const double &spacing) {
+
+  itkAssertOrThrowMacro(spacing > 0.0, "The spacing must be positive.");
+
+  using TKey = std::array<std::int64_t, 3>;
+  struct Hash {
+    size_t operator()(const TKey &key) const {
+      size_t h = 0;
+      for (const auto k : key) h = h * 1000003u ^ std::hash<std::int64_t>()(k);
+      return h;
+    }
+  };
+
+  // Cluster of each point, and the clusters' sums
+  std::unordered_map<TKey, size_t, Hash> clusters;
+  std::unordered_map<typename TMesh::PointIdentifier, size_t> pointToCluster;
+  std::vector<std::array<double, 4>> sums; // xyz, count
+  for (auto it = mesh->GetPoints()->Begin();
+       it != mesh->GetPoints()->End();
+       ++it) {
+    const auto &p = it.Value();
+    TKey key;
+    for (unsigned int d = 0; d < 3; ++d) key[d] = static_cast<std::int64_t>(std::floor(p[d] / spacing));
+    const auto inserted = clusters.emplace(key, sums.size());
+    if (inserted.second) sums.push_back({0.0, 0.0, 0.0, 0.0});
+    auto &sum = sums[inserted.first->second];
+    for (unsigned int d = 0; d < 3; ++d) sum[d] += p[d];
+    sum[3] += 1.0;
+    pointToCluster[it.Index()] = inserted.first->second;
+  }
+
+  const auto output = TMesh::New();
+  for (size_t c = 0; c < sums.size(); ++c) {
+    typename TMesh::PointType point;
+    for (unsigned int d = 0; d < 3; ++d) point[d] = sums[c][d] / sums[c][3];
+    output->SetPoint(c, point);
+  }
+
+  using TTriangle = itk::TriangleCell<typename TMesh::CellType>;
+  const bool labeled = (nullptr != mesh->GetCellData()) && (mesh->GetCellData()->Size() > 0);
+  std::set<std::pair<typename TMesh::CellPixelType, std::array<size_t, 3>>> seen;
+  typename TMesh::CellIdentifier next = 0;
+  for (auto it = mesh->GetCells()->Begin();
+       it != mesh->GetCells()->End();
+       ++it) {
+    const auto ids = it.Value()->GetPointIds();
+    const unsigned int n = it.Value()->GetNumberOfPoints();
+    const auto label = labeled ? mesh->GetCellData()->ElementAt(it.Index())
+                               : typename TMesh::CellPixelType();
+    for (unsigned int k = 2; k < n; ++k) {
+      const std::array<size_t, 3> triangle = {pointToCluster.at(ids[0]),
+                                              pointToCluster.at(ids[k - 1]),
+                                              pointToCluster.at(ids[k])};
+      if (triangle[0] == triangle[1] || triangle[1] == triangle[2] || triangle[0] == triangle[2]) continue;
+      auto sorted = triangle;
+      std::sort(sorted.begin(), sorted.end());
+      if (!seen.emplace(label, sorted).second) continue;
+
+      typename TMesh::CellAutoPointer cell;
+      cell.TakeOwnership(new TTriangle);
+      for (unsigned int v = 0; v < 3; ++v) cell->SetPointId(v, triangle[v]);
+      output->SetCell(next, cell);
+      if (labeled) output->SetCellData(next, label);
+      ++next;
+    }
+  }
+
+  return output;
+
+}
+
+} // namespace sissr
+
+#endif
@@ -5,6 +5,7 @@
 #include <ceres/ceres.h>
 #include <itkMacro.h>
 #include <limits>
+#include <sissrControlPointBuffer.h>
 
 namespace sissr {
 
@@ -17,7 +18,8 @@ public:
 
   EdgeLengthRegularizer(
     const typename TMesh::Pointer& _moving,
-    const typename TMesh::PointsContainer::Pointer& _initialPoints,
+    const ControlPointBuffer& _buffer,
+    unsigned int _frame,
     unsigned int _index);
 
   bool Evaluate(const double* const* parameters,
@@ -28,8 +30,9 @@ public:
 
 private:
   const typename TMesh::Pointer& moving;
-  const typename TMesh::PointsContainer::Pointer& initialPoints;
+  const ControlPointBuffer& buffer;
 
+  unsigned int frame;
   unsigned int index;
   std::array<unsigned int, 2> point_indices;
 
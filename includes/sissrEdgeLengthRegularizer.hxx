@@ -12,10 +12,12 @@ namespace sissr {
 template<class TMesh>
 EdgeLengthRegularizer<TMesh>::EdgeLengthRegularizer(
   const typename TMesh::Pointer& _moving,
-  const typename TMesh::PointsContainer::Pointer& _initialPoints,
+  const ControlPointBuffer& _buffer,
+  unsigned int _frame,
   unsigned int _index)
   : moving(_moving)
-  , initialPoints(_initialPoints)
+  , buffer(_buffer)
+  , frame(_frame)
   , index(_index)
 {
   const auto edge = this->moving->GetEdge(this->index);
@@ -32,32 +34,31 @@ EdgeLengthRegularizer<TMesh>::EdgeLengthRegularizer(
 
 template<class TMesh>
 bool
-EdgeLengthRegularizer<TMesh>::Evaluate(const double* const* parameters,
+EdgeLengthRegularizer<TMesh>::Evaluate(const double* const* /*parameters*/,
                                        double* residuals,
                                        double** jacobians) const
 {
 
   const auto dim = TMesh::PointType::Dimension;
 
-  //////////////////////////////////////////////////
-  // Ensure that the point positions are updated. //
-  //////////////////////////////////////////////////
+  ///////////////////////////////////////
+  // Point positions, from the buffer. //
+  ///////////////////////////////////////
 
+  std::array<typename TMesh::PointType, 2> points;
   for (unsigned int i = 0; i < this->point_indices.size(); ++i) {
-    const auto init = this->initialPoints->ElementAt(point_indices[i]);
-    typename TMesh::PointType current;
+    const double* point = this->buffer.GetPoint(this->frame, point_indices[i]);
     for (unsigned int d = 0; d < dim; ++d) {
-      current[d] = init[d] + parameters[i][d];
+      points[i][d] = point[d];
     }
-    this->moving->SetPoint(this->point_indices[i], current);
   }
 
   /////////////////////////
   // Calculate Residuals //
   /////////////////////////
 
-  const auto pt1 = this->moving->GetPoint(this->point_indices[0]);
-  const auto pt2 = this->moving->GetPoint(this->point_indices[1]);
+  const auto& pt1 = points[0];
+  const auto& pt2 = points[1];
 
   for (unsigned int i = 0; i < dim; ++i) {
     residuals[i] = pt2[i] - pt1[i];
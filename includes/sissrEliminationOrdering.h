@@ -0,0 +1,200 @@
+#ifndef sissr_EliminationOrdering_h
+#define sissr_EliminationOrdering_h
+
+// STD
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Ceres
+#include <ceres/ceres.h>
+
+// SuiteSparse
+#include <cholmod.h>
+
+// ITK
+#include <itkMacro.h>
+
+namespace sissr {
+
+/*
+ A fill reducing elimination ordering of J^T J depends only on which
+ parameter blocks each residual block acts on: for a given template, the
+ number of frames and the terms used.  These functions compute it once, on
+ that block structure, and save it under a hash of the structure, so that
+ registrations of other subjects with the same template can read it back
+ rather than order J^T J again.
+ */
+
+// For each residual block of the problem, in the problem's order, the
+// indices into blocks of its parameter blocks; blocks not listed are left
+// out.
+inline std::vector<std::vector<int>>
+CalculateBlockStructure(const ceres::Problem &problem, const std::vector<double*> &blocks)
+{
+  std::unordered_map<const double*, int> index;
+  for (size_t b = 0; b < blocks.size(); ++b) index.emplace(blocks[b], int(b));
+
+  std::vector<ceres::ResidualBlockId> residualBlocks;
+  problem.GetResidualBlocks(&residualBlocks);
+  std::vector<std::vector<int>> structure;
+  structure.reserve(residualBlocks.size());
+  std::vector<double*> parameters;
+  for (const auto &id : residualBlocks)
+    {
+    problem.GetParameterBlocksForResidualBlock(id, &parameters);
+    std::vector<int> columns;
+    for (const auto block : parameters)
+      {
+      const auto it = index.find(block);
+      if (index.end() != it) columns.push_back(it->second);
+      }
+    structure.emplace_back(std::move(columns));
+    }
+  return structure;
+}
+
+// 64-bit FNV-1a of the structure, the number of blocks and a salt (e.g. the
+// ordering method), in hexadecimal; stable across builds and platforms.
+inline std::string
+HashBlockStructure(const std::vector<std::vector<int>> &structure,
+                   const size_t &numberOfBlocks,
+                   const std::string &salt)
+{
+  std::uint64_t hash = 14695981039346656037ull;
+  const auto add = [&hash](std::uint64_t value) {
+    for (unsigned int byte = 0; byte < 8; ++byte, value >>= 8)
+      {
+      hash ^= (value & 0xff);
+      hash *= 1099511628211ull;
+      }
+  };
+  for (const auto c : salt) add(static_cast<unsigned char>(c));
+  add(numberOfBlocks);
+  add(structure.size());
+  for (const auto &columns : structure)
+    {
+    add(columns.size());
+    for (const auto c : columns) add(std::uint64_t(c));
+    }
+  std::ostringstream stream;
+  stream << std::hex << std::setw(16) << std::setfill('0') << hash;
+  return stream.str();
+}
+
+// Fill reducing order of the blocks for J^T J: entry k is the block to be
+// eliminated k-th.  CHOLMOD orders the block graph by approximate minimum
+// degree, or by nested dissection if asked and available.
+inline std::vector<int>
+CalculateEliminationOrdering(const std::vector<std::vector<int>> &structure,
+                             const size_t &numberOfBlocks,
+                             const ceres::LinearSolverOrderingType &type)
+{
+  cholmod_common common;
+  cholmod_start(&common);
+
+  // The block pattern of J^T, whose product with its transpose CHOLMOD
+  // orders
+  size_t nonZeros = 0;
+  for (const auto &columns : structure) nonZeros += columns.size();
+  cholmod_sparse* pattern = cholmod_allocate_sparse(numberOfBlocks, structure.size(), nonZeros,
+                                                    false, true, 0, CHOLMOD_PATTERN, &common);
+  itkAssertOrThrowMacro(nullptr != pattern, "Could not allocate the block structure.");
+  int* p = static_cast<int*>(pattern->p);
+  int* i = static_cast<int*>(pattern->i);
+  p[0] = 0;
+  for (size_t r = 0; r < structure.size(); ++r)
+    {
+    for (const auto c : structure[r]) *i++ = c;
+    p[r + 1] = p[r] + int(structure[r].size());
+    }
+  cholmod_sort(pattern, &common);
+
+  common.nmethods = 1;
+  common.method[0].ordering = (ceres::NESDIS == type) ? CHOLMOD_NESDIS : CHOLMOD_AMD;
+  common.postorder = true;
+  cholmod_factor* factor = cholmod_analyze(pattern, &common);
+  if (nullptr == factor && CHOLMOD_AMD != common.method[0].ordering)
+    {
+    common.status = CHOLMOD_OK;
+    common.method[0].ordering = CHOLMOD_AMD;
+    factor = cholmod_analyze(pattern, &common);
+    }
+  cholmod_free_sparse(&pattern, &common);
+
+  std::vector<int> ordering;
+  const int status = common.status;
+  if (nullptr != factor)
+    {
+    const int* perm = static_cast<const int*>(factor->Perm);
+    ordering.assign(perm, perm + numberOfBlocks);
+    cholmod_free_factor(&factor, &common);
+    }
+  cholmod_finish(&common);
+  itkAssertOrThrowMacro(ordering.size() == numberOfBlocks,
+                        "CHOLMOD could not order the block structure (status " + std::to_string(status) + ").");
+  return ordering;
+}
+
+// Reads an ordering written by WriteEliminationOrdering; false if there is
+// none, it is not a permutation of the given number of blocks, or anything
+// follows it.
+inline bool
+ReadEliminationOrdering(const std::string &fileName,
+                        const size_t &numberOfBlocks,
+                        std::vector<int> &ordering)
+{
+  std::ifstream stream(fileName);
+  size_t size = 0;
+  if (!(stream >> size) || size != numberOfBlocks) return false;
+  std::vector<int> candidate(size);
+  std::vector<bool> seen(size, false);
+  for (auto &b : candidate)
+    {
+    if (!(stream >> b) || b < 0 || size_t(b) >= size || seen[b]) return false;
+    seen[b] = true;
+    }
+  if (!(stream >> std::ws).eof()) return false;
+  ordering = std::move(candidate);
+  return true;
+}
+
+// Writes to a file of its own in the same directory, then renames it into
+// place, so that runs sharing the directory never see a partial file.
+inline void
+WriteEliminationOrdering(const std::string &fileName, const std::vector<int> &ordering)
+{
+  const auto directory = std::filesystem::path(fileName).parent_path();
+  if (!directory.empty()) std::filesystem::create_directories(directory);
+
+  std::random_device random;
+  std::ostringstream suffix;
+  suffix << ".tmp-" << std::hex << std::this_thread::get_id() << '-' << random() << random();
+  const std::string temporary = fileName + suffix.str();
+  bool written = false;
+  {
+  std::ofstream stream(temporary);
+  itkAssertOrThrowMacro(stream.good(), "Could not write the elimination ordering to " + temporary);
+  stream << ordering.size() << '\n';
+  for (const auto b : ordering) stream << b << '\n';
+  stream.close();
+  written = !stream.fail();
+  }
+
+  std::error_code error;
+  if (written) std::filesystem::rename(temporary, fileName, error);
+  if (!written || error) std::filesystem::remove(temporary, error);
+  itkAssertOrThrowMacro(written, "Could not write the elimination ordering to " + temporary);
+  itkAssertOrThrowMacro(std::filesystem::exists(fileName), "Could not move the elimination ordering to " + fileName);
+}
+
+} // namespace sissr
+
+#endif
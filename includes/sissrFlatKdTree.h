@@ -0,0 +1,516 @@
+#ifndef sissr_FlatKdTree_h
+#define sissr_FlatKdTree_h
+
+// STD
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <vector>
+
+// ITK
+#include <itkObject.h>
+#include <itkObjectFactory.h>
+#include <itkMacro.h>
+
+namespace sissr {
+
+/*
+ Nearest neighbour index with the interface of itk::PointsLocator
+ (SetPoints, Initialize, FindClosestPoint, GetPoints).
+
+ The tree is implicit: a complete binary tree stored breadth first (the
+ children of node i are 2i+1 and 2i+2), with a split dimension and value
+ per internal node and a float bounding box per node.  Each leaf holds a contiguous bucket of about
+ BucketSize points, stored as separate x, y and z arrays.
+
+ In a batch of queries, each query starts from the exact distance to the
+ previous query's answer.  Spatially sorted queries then prune most of
+ the tree from the outset.
+
+ SetRange restricts the tree to a contiguous run of point identifiers, so
+ that several trees can share one compact points container.
+
+ Coordinates are stored as floats or, with UseQuantization, as 16-bit
+ offsets within the bounding box, which quarters the memory of a double
+ layout.  Either way the stored coordinates are within a known bound of
+ the true ones, so candidates which might be closest are rechecked against
+ the points container and the result is exact.
+ */
+template<typename TPointsContainer>
+class FlatKdTree : public itk::Object
+{
+
+public:
+
+  using Self = FlatKdTree;
+  using Superclass = itk::Object;
+  using Pointer = itk::SmartPointer<Self>;
+  using ConstPointer = itk::SmartPointer<const Self>;
+
+  itkNewMacro(Self);
+  itkTypeMacro(FlatKdTree, Object);
+
+  using PointsContainer = TPointsContainer;
+  using PointsContainerPointer = typename TPointsContainer::Pointer;
+  using PointType = typename TPointsContainer::Element;
+  using PointIdentifier = typename TPointsContainer::ElementIdentifier;
+
+  static constexpr unsigned int Dimension = PointType::PointDimension;
+  static constexpr unsigned int BucketSize = 8;
+
+  static_assert(3 == Dimension, "FlatKdTree is only implemented for three dimensions.");
+
+  itkSetMacro(UseQuantization, bool);
+  itkGetConstMacro(UseQuantization, bool);
+  itkBooleanMacro(UseQuantization);
+
+  void SetPoints(TPointsContainer* points)
+    {
+    this->m_Points = points;
+    this->Modified();
+    }
+
+  TPointsContainer* GetPoints() const
+    { return this->m_Points.GetPointer(); }
+
+  /* Optional unit normals, stored as points with the same identifiers. */
+  void SetNormals(TPointsContainer* normals)
+    {
+    this->m_Normals = normals;
+    this->Modified();
+    }
+
+  TPointsContainer* GetNormals() const
+    { return this->m_Normals.GetPointer(); }
+
+  /* Index only the points with identifiers in [begin, end); by default, all. */
+  void SetRange(const PointIdentifier &begin, const PointIdentifier &end)
+    {
+    itkAssertOrThrowMacro(begin <= end, "Invalid range.");
+    this->m_RangeBegin = begin;
+    this->m_RangeEnd = end;
+    this->m_UseRange = true;
+    this->Modified();
+    }
+
+  void Initialize();
+
+  PointIdentifier FindClosestPoint(const PointType &query) const;
+
+  /*
+   queries: count xyz triplets, ideally in spatial order; ids: count results.
+   gaps, if not null: per query, the distance to the second closest point
+   minus the distance to the closest.  A query moved by less than half its
+   gap keeps its closest point.  epsilon > 0: each answer is at most 1 +
+   epsilon times as far as the closest point (no gaps then).
+   */
+  void FindClosestPoints(const double* queries, const size_t &count, PointIdentifier* ids,
+                         double* gaps = nullptr, const double &epsilon = 0.0) const;
+
+  size_t GetNumberOfPoints() const
+    { return this->m_Ids.size(); }
+
+protected:
+
+  FlatKdTree() = default;
+  ~FlatKdTree() override = default;
+
+private:
+
+  using TQuantized = std::uint16_t;
+
+  struct Best
+  {
+    double distance = std::numeric_limits<double>::max(); // Exact, squared
+    double bound = std::numeric_limits<double>::max();    // See CalculateBound
+    PointIdentifier id = PointIdentifier();
+    bool useSecond = false;                                // Also find the second closest
+    double second = std::numeric_limits<double>::max();   // Exact, squared
+    double scale = 1.0;                                    // (1 + epsilon)^2, for box distances
+  };
+
+  // Rounded outwards; siblings are adjacent in memory
+  struct Box
+  {
+    float lower[3];
+    float upper[3];
+  };
+
+  double CalculateExactDistance(const double* q, const size_t &j) const
+    {
+    const auto &p = this->m_Points->ElementAt(this->m_Ids[j]);
+    double dist = 0.0;
+    for (unsigned int d = 0; d < 3; ++d)
+      {
+      const double diff = q[d] - p[d];
+      dist += diff * diff;
+      }
+    return dist;
+    }
+
+  void Build(const size_t &node, const size_t &begin, const size_t &end,
+             std::vector<size_t> &order, const std::vector<double> &stored);
+  void SearchLeaf(const size_t &leaf, const double* q, Best &best) const;
+  void Search(const size_t &node, const double* q, Best &best) const;
+
+  // Squared distance from q to the bounding box of a node
+  double CalculateBoxDistance(const size_t &node, const double* q) const
+    {
+    double dist = 0.0;
+    for (unsigned int d = 0; d < 3; ++d)
+      {
+      const double below = double(this->m_Boxes[node].lower[d]) - q[d];
+      const double above = q[d] - double(this->m_Boxes[node].upper[d]);
+      const double gap = std::max(0.0, std::max(below, above));
+      dist += gap * gap;
+      }
+    return dist;
+    }
+
+  // Approximate squared distances at or above this bound cannot beat the
+  // exact squared distance `best`.
+  double CalculateBound(const double &best) const
+    {
+    const double bound = std::sqrt(best) + this->m_Tolerance;
+    return bound * bound;
+    }
+
+  PointsContainerPointer m_Points;
+  PointsContainerPointer m_Normals;
+  bool m_UseQuantization = false;
+  bool m_UseRange = false;
+  PointIdentifier m_RangeBegin = PointIdentifier();
+  PointIdentifier m_RangeEnd = PointIdentifier();
+
+  // Tree
+  size_t                     m_NumberOfLeaves = 0;
+  std::vector<std::uint8_t>  m_SplitDimension;
+  std::vector<double>        m_SplitValue;
+  std::vector<size_t>        m_LeafBegin; // Leaf l holds [m_LeafBegin[l], m_LeafBegin[l+1])
+  std::vector<Box>            m_Boxes;
+
+  // Points, in tree order
+  std::vector<PointIdentifier>            m_Ids;
+  std::array<std::vector<float>, 3>       m_Float;
+  std::array<std::vector<TQuantized>, 3>  m_Quantized;
+  std::array<double, 3>                   m_Origin = {{0.0, 0.0, 0.0}};
+  std::array<double, 3>                   m_Scale = {{1.0, 1.0, 1.0}};
+
+  // Bound on the distance between a stored point and the true one
+  double m_Tolerance = 0.0;
+
+};
+
+template<typename TPointsContainer>
+void
+FlatKdTree<TPointsContainer>
+::Initialize()
+{
+
+  itkAssertOrThrowMacro(nullptr != this->m_Points, "No points were set.");
+
+  if (this->m_UseRange)
+    {
+    itkAssertOrThrowMacro(this->m_RangeEnd <= this->m_Points->Size(), "Range exceeds the points container.");
+    }
+
+  const size_t n = this->m_UseRange ? size_t(this->m_RangeEnd - this->m_RangeBegin) : this->m_Points->Size();
+
+  // Gather the points and their bounding box
+  this->m_Ids.clear();
+  this->m_Ids.reserve(n);
+  std::vector<double> coordinates;
+  coordinates.reserve(3 * n);
+  std::array<double, 3> lower, upper;
+  lower.fill(std::numeric_limits<double>::max());
+  upper.fill(std::numeric_limits<double>::lowest());
+  const auto gather = [&](const PointIdentifier &id, const PointType &point)
+    {
+    this->m_Ids.push_back(id);
+    for (unsigned int d = 0; d < 3; ++d)
+      {
+      coordinates.push_back(point[d]);
+      lower[d] = std::min(lower[d], double(point[d]));
+      upper[d] = std::max(upper[d], double(point[d]));
+      }
+    };
+  if (this->m_UseRange)
+    {
+    for (auto id = this->m_RangeBegin; id < this->m_RangeEnd; ++id) gather(id, this->m_Points->ElementAt(id));
+    }
+  else
+    {
+    for (auto it = this->m_Points->Begin(); it != this->m_Points->End(); ++it) gather(it.Index(), it.Value());
+    }
+
+  // Storage precision, and the resulting tolerance
+  std::vector<double> stored(coordinates.size());
+  double coordinateError = 0.0;
+  if (this->m_UseQuantization)
+    {
+    constexpr double levels = std::numeric_limits<TQuantized>::max();
+    for (unsigned int d = 0; d < 3; ++d)
+      {
+      this->m_Origin[d] = (n > 0) ? lower[d] : 0.0;
+      const double extent = (n > 0) ? upper[d] - lower[d] : 0.0;
+      this->m_Scale[d] = (extent > 0.0) ? extent / levels : 1.0;
+      coordinateError = std::max(coordinateError, this->m_Scale[d]);
+      }
+    for (size_t i = 0; i < coordinates.size(); ++i)
+      {
+      const unsigned int d = i % 3;
+      const double q = std::round((coordinates[i] - this->m_Origin[d]) / this->m_Scale[d]);
+      stored[i] = this->m_Origin[d] + this->m_Scale[d] * q;
+      }
+    }
+  else
+    {
+    for (size_t i = 0; i < coordinates.size(); ++i)
+      {
+      stored[i] = double(float(coordinates[i]));
+      coordinateError = std::max(coordinateError, std::abs(stored[i] - coordinates[i]));
+      }
+    }
+  // Generous slack for rounding in the distance calculations
+  this->m_Tolerance = 2.0 * std::sqrt(3.0) * coordinateError
+                    + 1e-12 * (1.0 + std::max(std::abs(*std::max_element(upper.begin(), upper.end())),
+                                              std::abs(*std::min_element(lower.begin(), lower.end()))));
+
+  // Complete tree with enough leaves for buckets of at most BucketSize
+  this->m_NumberOfLeaves = 1;
+  while (this->m_NumberOfLeaves * BucketSize < n) this->m_NumberOfLeaves *= 2;
+  this->m_SplitDimension.assign(this->m_NumberOfLeaves - 1, 0);
+  this->m_SplitValue.assign(this->m_NumberOfLeaves - 1, 0.0);
+  this->m_LeafBegin.assign(this->m_NumberOfLeaves + 1, n);
+  this->m_Boxes.assign(2 * this->m_NumberOfLeaves - 1, Box());
+
+  std::vector<size_t> order(n);
+  std::iota(order.begin(), order.end(), 0);
+  this->Build(0, 0, n, order, stored);
+
+  // Reorder into tree order
+  std::vector<PointIdentifier> ids(n);
+  for (unsigned int d = 0; d < 3; ++d)
+    {
+    this->m_Float[d].clear();
+    this->m_Quantized[d].clear();
+    }
+  for (size_t j = 0; j < n; ++j)
+    {
+    const size_t i = order[j];
+    ids[j] = this->m_Ids[i];
+    for (unsigned int d = 0; d < 3; ++d)
+      {
+      if (this->m_UseQuantization)
+        {
+        const double q = (stored[3 * i + d] - this->m_Origin[d]) / this->m_Scale[d];
+        this->m_Quantized[d].push_back(TQuantized(std::lround(q)));
+        }
+      else
+        {
+        this->m_Float[d].push_back(float(stored[3 * i + d]));
+        }
+      }
+    }
+  this->m_Ids = std::move(ids);
+
+}
+
+template<typename TPointsContainer>
+void
+FlatKdTree<TPointsContainer>
+::Build(const size_t &node, const size_t &begin, const size_t &end,
+        std::vector<size_t> &order, const std::vector<double> &stored)
+{
+
+  // Bounding box; empty nodes get an inverted, infinite one
+  std::array<double, 3> lower, upper;
+  lower.fill(std::numeric_limits<double>::max());
+  upper.fill(std::numeric_limits<double>::lowest());
+  for (size_t j = begin; j < end; ++j)
+    for (unsigned int d = 0; d < 3; ++d)
+      {
+      lower[d] = std::min(lower[d], stored[3 * order[j] + d]);
+      upper[d] = std::max(upper[d], stored[3 * order[j] + d]);
+      }
+  for (unsigned int d = 0; d < 3; ++d)
+    {
+    float l = float(lower[d]);
+    float u = float(upper[d]);
+    if (double(l) > lower[d]) l = std::nextafter(l, -std::numeric_limits<float>::infinity());
+    if (double(u) < upper[d]) u = std::nextafter(u, std::numeric_limits<float>::infinity());
+    this->m_Boxes[node].lower[d] = l;
+    this->m_Boxes[node].upper[d] = u;
+    }
+
+  const size_t firstLeaf = this->m_NumberOfLeaves - 1;
+  if (node >= firstLeaf)
+    {
+    this->m_LeafBegin[node - firstLeaf] = begin;
+    return;
+    }
+
+  // Split the widest dimension at the median
+  unsigned int dim = 0;
+  for (unsigned int d = 1; d < 3; ++d)
+    if (upper[d] - lower[d] > upper[dim] - lower[dim]) dim = d;
+
+  const size_t mid = begin + (end - begin) / 2;
+  if (mid < end)
+    {
+    std::nth_element(order.begin() + begin, order.begin() + mid, order.begin() + end,
+                     [&stored, dim](const size_t &a, const size_t &b)
+                     { return stored[3 * a + dim] < stored[3 * b + dim]; });
+    this->m_SplitValue[node] = stored[3 * order[mid] + dim];
+    }
+  this->m_SplitDimension[node] = std::uint8_t(dim);
+
+  this->Build(2 * node + 1, begin, mid, order, stored);
+  this->Build(2 * node + 2, mid, end, order, stored);
+
+}
+
+template<typename TPointsContainer>
+typename FlatKdTree<TPointsContainer>::PointIdentifier
+FlatKdTree<TPointsContainer>
+::FindClosestPoint(const PointType &query) const
+{
+  itkAssertOrThrowMacro(!this->m_Ids.empty(), "The tree is empty or was not initialized.");
+
+  const double q[3] = {double(query[0]), double(query[1]), double(query[2])};
+  Best best;
+  this->Search(0, q, best);
+  return best.id;
+}
+
+template<typename TPointsContainer>
+void
+FlatKdTree<TPointsContainer>
+::Search(const size_t &node, const double* q, Best &best) const
+{
+
+  const size_t firstLeaf = this->m_NumberOfLeaves - 1;
+  if (node >= firstLeaf)
+    {
+    this->SearchLeaf(node - firstLeaf, q, best);
+    return;
+    }
+
+  // Nearer child first; each only if its box is close enough
+  const double left = this->CalculateBoxDistance(2 * node + 1, q);
+  const double right = this->CalculateBoxDistance(2 * node + 2, q);
+  const size_t nearChild = (left <= right) ? 2 * node + 1 : 2 * node + 2;
+  const size_t farChild = (left <= right) ? 2 * node + 2 : 2 * node + 1;
+
+  if (best.scale * std::min(left, right) < best.bound)
+    {
+    this->Search(nearChild, q, best);
+    }
+  if (best.scale * std::max(left, right) < best.bound)
+    {
+    this->Search(farChild, q, best);
+    }
+
+}
+
+template<typename TPointsContainer>
+void
+FlatKdTree<TPointsContainer>
+::SearchLeaf(const size_t &leaf, const double* q, Best &best) const
+{
+
+  const size_t begin = this->m_LeafBegin[leaf];
+  const size_t count = this->m_LeafBegin[leaf + 1] - begin;
+
+  // Distances to the stored coordinates, one dimension at a time
+  double approximate[BucketSize];
+  for (size_t k = 0; k < count; ++k) approximate[k] = 0.0;
+  for (unsigned int d = 0; d < 3; ++d)
+    {
+    if (this->m_UseQuantization)
+      {
+      const TQuantized* x = this->m_Quantized[d].data() + begin;
+      const double origin = this->m_Origin[d];
+      const double scale = this->m_Scale[d];
+      for (size_t k = 0; k < count; ++k)
+        {
+        const double diff = q[d] - (origin + scale * x[k]);
+        approximate[k] += diff * diff;
+        }
+      }
+    else
+      {
+      const float* x = this->m_Float[d].data() + begin;
+      for (size_t k = 0; k < count; ++k)
+        {
+        const double diff = q[d] - double(x[k]);
+        approximate[k] += diff * diff;
+        }
+      }
+    }
+
+  // Exact distances only for the candidates which might win
+  for (size_t k = 0; k < count; ++k)
+    {
+    if (approximate[k] >= best.bound) continue;
+    const double exact = this->CalculateExactDistance(q, begin + k);
+    if (exact < best.distance)
+      {
+      best.second = best.distance;
+      best.distance = exact;
+      best.id = this->m_Ids[begin + k];
+      }
+    else if (best.useSecond && exact < best.second && this->m_Ids[begin + k] != best.id)
+      {
+      best.second = exact;
+      }
+    else
+      {
+      continue;
+      }
+    best.bound = this->CalculateBound(best.useSecond ? best.second : best.distance);
+    }
+
+}
+
+template<typename TPointsContainer>
+void
+FlatKdTree<TPointsContainer>
+::FindClosestPoints(const double* queries, const size_t &count, PointIdentifier* ids,
+                    double* gaps, const double &epsilon) const
+{
+  itkAssertOrThrowMacro(!this->m_Ids.empty(), "The tree is empty or was not initialized.");
+  itkAssertOrThrowMacro(epsilon >= 0.0, "epsilon must not be negative.");
+  itkAssertOrThrowMacro(0.0 == epsilon || nullptr == gaps, "Gaps are only found by exact searches.");
+
+  for (size_t i = 0; i < count; ++i)
+    {
+    const double* q = queries + 3 * i;
+    Best best;
+    best.useSecond = (nullptr != gaps);
+    best.scale = (1.0 + epsilon) * (1.0 + epsilon);
+    if (i > 0)
+      {
+      // The previous answer bounds this one
+      const auto &p = this->m_Points->ElementAt(ids[i - 1]);
+      best.distance = 0.0;
+      for (unsigned int d = 0; d < 3; ++d)
+        {
+        const double diff = q[d] - p[d];
+        best.distance += diff * diff;
+        }
+      best.bound = best.useSecond ? std::numeric_limits<double>::max() : this->CalculateBound(best.distance);
+      best.id = ids[i - 1];
+      }
+    this->Search(0, q, best);
+    ids[i] = best.id;
+    if (best.useSecond) gaps[i] = std::sqrt(best.second) - std::sqrt(best.distance);
+    }
+}
+
+} // namespace sissr
+
+#endif
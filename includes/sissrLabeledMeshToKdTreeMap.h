@@ -2,11 +2,15 @@
 #define sissr_LabeledMeshToKdTreeMap_h
 
 // STD
+#include <iterator>
 #include <map>
 
 // ITK
 #include <itkPointSet.h>
-#include <itkPointsLocator.h>
+
+// SiSSR
+#include <sissrCalculateCellNormals.h>
+#include <sissrFlatKdTree.h>
 
 namespace sissr {
 
@@ -17,17 +21,48 @@ class LabeledMeshToKdTreeMap {
     using TCoordinate = typename TMesh::PixelType;
     static constexpr unsigned int Dimension = TMesh::PointDimension;
     using TPointSet = itk::PointSet<TCoordinate, Dimension>;
-    using TLocator = itk::PointsLocator<typename TPointSet::PointsContainer>;
+    using TLocator = FlatKdTree<typename TPointSet::PointsContainer>;
     using TLocatorMap = std::map<size_t, typename TLocator::Pointer>;
 
-    TLocatorMap Calculate(TMesh* mesh) {
+    // The cell midpoints of all labels share one points container, in which
+    // each label's points are contiguous; each label's tree indexes its own
+    // range.  The cells' normals share a second container, in the same order.
+    TLocatorMap Calculate(TMesh* mesh, const unsigned int &threads = 1) {
 
-      std::map<size_t, typename TPointSet::Pointer> pointset_map;
+      // Per-label offsets into the shared container
+      std::map<size_t, size_t> offsets;
 
       for (auto it = mesh->GetCells()->Begin();
            it != mesh->GetCells()->End();
            ++it) {
 
+        const auto label = mesh->GetCellData()->ElementAt( it.Index() );
+
+        itkAssertOrThrowMacro(label != 0, "Label == 0");
+
+        ++offsets[label];
+
+      }
+
+      size_t total = 0;
+      for (auto& offset : offsets) {
+        const size_t count = offset.second;
+        offset.second = total;
+        total += count;
+      }
+
+      const auto points = TPointSet::PointsContainer::New();
+      points->Reserve( total );
+      const auto normals = TPointSet::PointsContainer::New();
+      normals->Reserve( total );
+      const auto cellNormals = CalculateCellNormals(mesh, threads);
+
+      auto next = offsets;
+      size_t c = 0;
+      for (auto it = mesh->GetCells()->Begin();
+           it != mesh->GetCells()->End();
+           ++it, ++c) {
+
         const auto cell = it.Value();
 
         typename TMesh::PointType centroid;
@@ -38,23 +73,26 @@ class LabeledMeshToKdTreeMap {
 
         const auto label = mesh->GetCellData()->ElementAt( it.Index() );
 
-        itkAssertOrThrowMacro(label != 0, "Label == 0");
-
-        if (0 == pointset_map.count(label)) {
-          pointset_map[label] = TPointSet::New();
-        }
+        typename TPointSet::PointType normal;
+        for (unsigned int d = 0; d < Dimension; ++d) normal[d] = cellNormals[3 * c + d];
 
-        pointset_map[label]->SetPoint( it.Index(), centroid );
+        normals->SetElement( next[label], normal );
+        points->SetElement( next[label]++, centroid );
 
       }
 
       TLocatorMap locator_map;
 
-      for (const auto& pointset : pointset_map) {
+      for (auto it = offsets.begin(); it != offsets.end(); ++it) {
+
+        const auto following = std::next(it);
+        const size_t end = (offsets.end() == following) ? total : following->second;
 
-        locator_map[pointset.first] = TLocator::New();
-        locator_map[pointset.first]->SetPoints( pointset.second->GetPoints() );
-        locator_map[pointset.first]->Initialize();
+        locator_map[it->first] = TLocator::New();
+        locator_map[it->first]->SetPoints( points );
+        locator_map[it->first]->SetNormals( normals );
+        locator_map[it->first]->SetRange( it->second, end );
+        locator_map[it->first]->Initialize();
 
       }
 
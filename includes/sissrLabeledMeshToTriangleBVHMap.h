@@ -0,0 +1,56 @@
+#ifndef sissr_LabeledMeshToTriangleBVHMap_h
+#define sissr_LabeledMeshToTriangleBVHMap_h
+
+// STD
+#include <map>
+#include <vector>
+
+// SiSSR
+#include <sissrTriangleBVH.h>
+
+namespace sissr {
+
+template<typename TMesh>
+class LabeledMeshToTriangleBVHMap {
+  public:
+
+    using TLocator = TriangleBVH<TMesh>;
+    using TLocatorMap = std::map<size_t, typename TLocator::Pointer>;
+
+    TLocatorMap Calculate(TMesh* mesh, const unsigned int &threads = 1) {
+
+      std::map<size_t, std::vector<typename TMesh::CellIdentifier>> cell_map;
+
+      for (auto it = mesh->GetCells()->Begin();
+           it != mesh->GetCells()->End();
+           ++it) {
+
+        const auto label = mesh->GetCellData()->ElementAt( it.Index() );
+
+        itkAssertOrThrowMacro(label != 0, "Label == 0");
+
+        cell_map[label].push_back( it.Index() );
+
+      }
+
+      TLocatorMap locator_map;
+
+      for (const auto& cells : cell_map) {
+
+        locator_map[cells.first] = TLocator::New();
+        locator_map[cells.first]->SetMesh( mesh );
+        locator_map[cells.first]->SetCells( cells.second );
+        locator_map[cells.first]->SetNumberOfThreads( threads );
+        locator_map[cells.first]->Initialize();
+
+      }
+
+      return locator_map;
+
+    }
+
+};
+
+}
+
+#endif
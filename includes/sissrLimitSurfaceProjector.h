@@ -0,0 +1,521 @@
+#ifndef sissr_LimitSurfaceProjector_h
+#define sissr_LimitSurfaceProjector_h
+
+// STD
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+// ITK
+#include <itkMacro.h>
+
+// SiSSR
+#include <sissrControlPointBuffer.h>
+#include <sissrUtils.h>
+
+namespace sissr {
+
+/*
+ Closest points on the limit surface of one frame of a Loop subdivision
+ surface, for points given in space, e.g. candidate points.
+
+ Each patch lies within the convex hull of its N+6 control points, so the
+ bounding box of those points bounds the patch.  A hierarchy over these
+ boxes is built once; as the control points move, Refit() only recomputes
+ the boxes, bottom up.  Queries visit the nearer child first and skip
+ boxes which are no closer than the best point so far.  Within a patch,
+ the closest point is found by Gauss-Newton iterations on (s, t), started
+ from the best of a few seeds and kept within the parameter triangle, with
+ the limit point and tangent weights of the mesh's matrices.  Being local,
+ the iterations may settle on a point other than the patch's closest one
+ where a patch folds back on itself.
+
+ Candidates set with SetCandidates() are projected onto all patches by
+ ProjectCandidates().  Update(), meant as a ControlPointBuffer update
+ callback, refines each projection within its patch, so that residual
+ blocks on the patch's control points stay valid during a solve.  As the
+ surface moves, a candidate's closest point may move onto another patch;
+ ProjectCandidates() is therefore called again between solves, after which
+ the blocks of candidates on new patches are built again, and
+ ProjectCandidate() puts those which cannot be back onto their block's patch.
+ */
+template<typename TMesh>
+class LimitSurfaceProjector
+{
+
+public:
+
+  using TReal = typename TMesh::RealType;
+  using TParameters = typename TMesh::TParameters;
+  using CellIdentifier = typename TMesh::CellIdentifier;
+  using PointIdentifier = typename TMesh::PointIdentifier;
+
+  static constexpr unsigned int MaximumLeafSize = 4;
+  static constexpr unsigned int MaximumNumberOfIterations = 10;
+  static constexpr unsigned int MaximumNumberOfControlPoints = TMesh::TMatrices::MaximumValency + 6;
+
+  struct Projection
+  {
+    CellIdentifier cell = CellIdentifier();
+    std::uint32_t patch = 0;                              // Index into this projector's patches
+    double s = 1.0 / 3.0;
+    double t = 1.0 / 3.0;
+    double point[3] = {0.0, 0.0, 0.0};
+    double distance = std::numeric_limits<double>::max(); // Squared
+  };
+
+  // cells: the cells to project onto; empty: all.
+  LimitSurfaceProjector(const typename TMesh::Pointer &_moving,
+                        const ControlPointBuffer &_buffer,
+                        unsigned int _frame,
+                        unsigned int _numberOfThreads,
+                        std::vector<CellIdentifier> _cells = {}) :
+    moving(_moving),
+    buffer(_buffer),
+    frame(_frame),
+    NumberOfThreads(std::max(1u, _numberOfThreads))
+  {
+    if (_cells.empty())
+      {
+      for (auto it = this->moving->GetCells()->Begin(); it != this->moving->GetCells()->End(); ++it)
+        _cells.push_back(it.Index());
+      }
+    itkAssertOrThrowMacro(!_cells.empty(), "No cells to project onto.");
+    for (const auto &cellID : _cells)
+      {
+      Patch patch;
+      patch.cell = cellID;
+      patch.N = this->moving->GetNForCell(cellID);
+      patch.L = this->moving->GetPointListForCell(cellID).data_block();
+      this->patches.push_back(patch);
+      }
+    this->CalculatePatchBounds();
+
+    std::vector<std::uint32_t> order(this->patches.size());
+    std::iota(order.begin(), order.end(), 0);
+    this->nodes.assign(1, Node());
+    this->Build(0, order, 0, order.size());
+    this->order = std::move(order);
+    this->Refit();
+  }
+
+  // Patch and node bounds from the buffer's current control points
+  void Refit()
+  {
+    this->CalculatePatchBounds();
+    for (size_t i = this->nodes.size(); i-- > 0;)
+      {
+      Node &node = this->nodes[i];
+      std::fill(node.lower, node.lower + 3, std::numeric_limits<double>::max());
+      std::fill(node.upper, node.upper + 3, std::numeric_limits<double>::lowest());
+      const auto merge = [&node](const double* lower, const double* upper)
+        {
+        for (unsigned int d = 0; d < 3; ++d)
+          {
+          node.lower[d] = std::min(node.lower[d], lower[d]);
+          node.upper[d] = std::max(node.upper[d], upper[d]);
+          }
+        };
+      if (node.count > 0)
+        {
+        for (std::uint32_t j = node.index; j < node.index + node.count; ++j)
+          merge(this->patches[this->order[j]].lower, this->patches[this->order[j]].upper);
+        }
+      else
+        {
+        for (const auto child : {node.index, node.index + 1})
+          merge(this->nodes[child].lower, this->nodes[child].upper);
+        }
+      }
+  }
+
+  // count xyz queries; one projection each.  Refit() first if the control
+  // points have moved.
+  void FindClosestPoints(const double* queries, const size_t &count, Projection* projections) const
+  {
+    ParallelFor(count, this->NumberOfThreads, [&](size_t begin, size_t end)
+      {
+      for (size_t i = begin; i < end; ++i) this->FindClosestPoint(queries + 3 * i, projections[i]);
+      });
+  }
+
+  // Closest point to `query` within the projection's patch, starting from
+  // its current parameters.
+  void Refine(const double* query, Projection &projection) const
+    { this->Iterate(query, projection); }
+
+  size_t GetNumberOfPatches() const { return this->patches.size(); }
+  unsigned int GetNumberOfControlPoints(const std::uint32_t &patch) const { return this->patches[patch].N + 6; }
+  const PointIdentifier* GetControlPoints(const std::uint32_t &patch) const { return this->patches[patch].L; }
+
+  /////////////////////////
+  // Candidate residuals //
+  /////////////////////////
+
+  // xyz triplets
+  void SetCandidates(std::vector<double> points)
+  {
+    itkAssertOrThrowMacro(0 == points.size() % 3, "Candidates must be xyz triplets.");
+    this->candidates = std::move(points);
+    this->candidateProjections.assign(this->candidates.size() / 3, Projection());
+    this->candidateWeights.assign(this->candidates.size() / 3 * MaximumNumberOfControlPoints, TReal(0));
+  }
+
+  // Closest patches and points of all candidates
+  void ProjectCandidates()
+  {
+    this->Refit();
+    this->FindClosestPoints(this->candidates.data(), this->GetNumberOfCandidates(), this->candidateProjections.data());
+    this->UpdateCandidateWeights();
+  }
+
+  // Closest point of candidate j within the given patch
+  void ProjectCandidate(const size_t &j, const std::uint32_t &patch)
+  {
+    Projection &projection = this->candidateProjections[j];
+    projection = Projection();
+    projection.patch = patch;
+    projection.cell = this->patches[patch].cell;
+    this->Seed(this->GetCandidate(j), projection);
+    this->Iterate(this->GetCandidate(j), projection);
+    double point[3];
+    this->Evaluate(this->patches[patch], projection.s, projection.t, point, nullptr, nullptr,
+                   this->candidateWeights.data() + MaximumNumberOfControlPoints * j);
+  }
+
+  // Refines every candidate's projection within its patch.
+  void Update()
+  {
+    ParallelFor(this->GetNumberOfCandidates(), this->NumberOfThreads, [this](size_t begin, size_t end)
+      {
+      for (size_t j = begin; j < end; ++j)
+        this->Refine(this->GetCandidate(j), this->candidateProjections[j]);
+      });
+    this->UpdateCandidateWeights();
+  }
+
+  unsigned int GetFrame() const { return this->frame; }
+  size_t GetNumberOfCandidates() const { return this->candidateProjections.size(); }
+  const double* GetCandidate(const size_t &j) const { return this->candidates.data() + 3 * j; }
+  const Projection& GetCandidateProjection(const size_t &j) const { return this->candidateProjections[j]; }
+  // Weights of the patch's control points at the projection
+  const TReal* GetCandidateWeights(const size_t &j) const
+    { return this->candidateWeights.data() + MaximumNumberOfControlPoints * j; }
+
+private:
+
+  struct Patch
+  {
+    CellIdentifier cell;
+    unsigned int N;
+    const PointIdentifier* L;
+    double lower[3];
+    double upper[3];
+  };
+
+  struct Node
+  {
+    double lower[3];
+    double upper[3];
+    std::uint32_t index = 0; // Leaf: first entry of `order`; otherwise: left child (right is index + 1)
+    std::uint32_t count = 0; // Leaf: number of patches; otherwise 0
+  };
+
+  void CalculatePatchBounds()
+  {
+    const double* X = this->buffer.GetPoint(this->frame, 0);
+    ParallelFor(this->patches.size(), this->NumberOfThreads, [&](size_t begin, size_t end)
+      {
+      for (size_t p = begin; p < end; ++p)
+        {
+        Patch &patch = this->patches[p];
+        std::fill(patch.lower, patch.lower + 3, std::numeric_limits<double>::max());
+        std::fill(patch.upper, patch.upper + 3, std::numeric_limits<double>::lowest());
+        for (unsigned int i = 0; i < patch.N + 6; ++i)
+          for (unsigned int d = 0; d < 3; ++d)
+            {
+            patch.lower[d] = std::min(patch.lower[d], X[3 * patch.L[i] + d]);
+            patch.upper[d] = std::max(patch.upper[d], X[3 * patch.L[i] + d]);
+            }
+        }
+      });
+  }
+
+  // Median splits of the box centers along the widest extent
+  void Build(const std::uint32_t &node, std::vector<std::uint32_t> &ids, const size_t &begin, const size_t &end)
+  {
+    if (end - begin <= MaximumLeafSize)
+      {
+      this->nodes[node].index = std::uint32_t(begin);
+      this->nodes[node].count = std::uint32_t(end - begin);
+      return;
+      }
+    double lower[3], upper[3];
+    std::fill(lower, lower + 3, std::numeric_limits<double>::max());
+    std::fill(upper, upper + 3, std::numeric_limits<double>::lowest());
+    const auto center = [this](const std::uint32_t &p, const unsigned int &d)
+      { return this->patches[p].lower[d] + this->patches[p].upper[d]; };
+    for (size_t j = begin; j < end; ++j)
+      for (unsigned int d = 0; d < 3; ++d)
+        {
+        lower[d] = std::min(lower[d], center(ids[j], d));
+        upper[d] = std::max(upper[d], center(ids[j], d));
+        }
+    unsigned int axis = 0;
+    for (unsigned int d = 1; d < 3; ++d)
+      if (upper[d] - lower[d] > upper[axis] - lower[axis]) axis = d;
+    const size_t middle = begin + (end - begin) / 2;
+    std::nth_element(ids.begin() + begin, ids.begin() + middle, ids.begin() + end,
+                     [&](const std::uint32_t &a, const std::uint32_t &b) { return center(a, axis) < center(b, axis); });
+
+    const std::uint32_t left = std::uint32_t(this->nodes.size());
+    this->nodes[node].index = left;
+    this->nodes.resize(this->nodes.size() + 2);
+    this->Build(left, ids, begin, middle);
+    this->Build(left + 1, ids, middle, end);
+  }
+
+  double CalculateBoxDistance(const double* lower, const double* upper, const double* q) const
+  {
+    double dist = 0.0;
+    for (unsigned int d = 0; d < 3; ++d)
+      {
+      const double gap = std::max(0.0, std::max(lower[d] - q[d], q[d] - upper[d]));
+      dist += gap * gap;
+      }
+    return dist;
+  }
+
+  void FindClosestPoint(const double* q, Projection &best) const
+  {
+    best = Projection();
+    std::vector<std::pair<std::uint32_t, double>> stack;
+    stack.emplace_back(0, this->CalculateBoxDistance(this->nodes[0].lower, this->nodes[0].upper, q));
+    while (!stack.empty())
+      {
+      const auto top = stack.back();
+      stack.pop_back();
+      if (top.second >= best.distance) continue;
+      const Node &node = this->nodes[top.first];
+
+      if (node.count > 0)
+        {
+        for (std::uint32_t j = node.index; j < node.index + node.count; ++j)
+          {
+          const std::uint32_t p = this->order[j];
+          const Patch &patch = this->patches[p];
+          if (this->CalculateBoxDistance(patch.lower, patch.upper, q) >= best.distance) continue;
+          Projection candidate;
+          candidate.patch = p;
+          candidate.cell = patch.cell;
+          this->Seed(q, candidate);
+          this->Iterate(q, candidate);
+          if (candidate.distance < best.distance) best = candidate;
+          }
+        continue;
+        }
+
+      // Nearer child on top
+      const double left = this->CalculateBoxDistance(this->nodes[node.index].lower, this->nodes[node.index].upper, q);
+      const double right = this->CalculateBoxDistance(this->nodes[node.index + 1].lower, this->nodes[node.index + 1].upper, q);
+      if (left <= right)
+        {
+        stack.emplace_back(node.index + 1, right);
+        stack.emplace_back(node.index, left);
+        }
+      else
+        {
+        stack.emplace_back(node.index, left);
+        stack.emplace_back(node.index + 1, right);
+        }
+      }
+  }
+
+  // The parameter triangle, less a margin that keeps rounding to TReal
+  // inside it and, for irregular patches, away from the extraordinary
+  // vertex, where the tangents are undefined.
+  static void Clamp(const unsigned int &N, double &s, double &t)
+  {
+    constexpr double margin = 1e-5;
+    s = std::max(s, 0.0);
+    t = std::max(t, 0.0);
+    const double sum = s + t;
+    if (sum > 1.0 - margin)
+      {
+      s *= (1.0 - margin) / sum;
+      t *= (1.0 - margin) / sum;
+      }
+    else if (6 != N && sum < 4.0 * margin)
+      {
+      if (sum > 0.0)
+        {
+        s *= 4.0 * margin / sum;
+        t *= 4.0 * margin / sum;
+        }
+      else
+        {
+        s = t = 2.0 * margin;
+        }
+      }
+  }
+
+  // Limit point and, if not null, tangents at (s, t)
+  void Evaluate(const Patch &patch, const double &s, const double &t,
+                double* point, double* ds = nullptr, double* dt = nullptr, TReal* weights = nullptr) const
+  {
+    TReal w[MaximumNumberOfControlPoints], ws[MaximumNumberOfControlPoints], wt[MaximumNumberOfControlPoints];
+    const TParameters p(static_cast<TReal>(s), static_cast<TReal>(t));
+    TMesh::m_Matrices.EvaluateSurfaceWeights(patch.N, p, w,
+                                             (nullptr != ds) ? ws : nullptr,
+                                             (nullptr != dt) ? wt : nullptr);
+    const double* X = this->buffer.GetPoint(this->frame, 0);
+    std::fill(point, point + 3, 0.0);
+    if (nullptr != ds) std::fill(ds, ds + 3, 0.0);
+    if (nullptr != dt) std::fill(dt, dt + 3, 0.0);
+    for (unsigned int i = 0; i < patch.N + 6; ++i)
+      {
+      const double* c = X + 3 * patch.L[i];
+      for (unsigned int d = 0; d < 3; ++d)
+        {
+        point[d] += w[i] * c[d];
+        if (nullptr != ds) ds[d] += ws[i] * c[d];
+        if (nullptr != dt) dt[d] += wt[i] * c[d];
+        }
+      }
+    if (nullptr != weights) std::copy(w, w + patch.N + 6, weights);
+  }
+
+  static double SquaredDistance(const double* a, const double* b)
+  {
+    double dist = 0.0;
+    for (unsigned int d = 0; d < 3; ++d) dist += (a[d] - b[d]) * (a[d] - b[d]);
+    return dist;
+  }
+
+  // Starts from the closest of a few points spread over the patch.
+  void Seed(const double* q, Projection &projection) const
+  {
+    static constexpr double seeds[4][2] = {{1.0 / 3.0, 1.0 / 3.0}, {2.0 / 3.0, 1.0 / 6.0},
+                                           {1.0 / 6.0, 2.0 / 3.0}, {1.0 / 6.0, 1.0 / 6.0}};
+    const Patch &patch = this->patches[projection.patch];
+    double bestDistance = std::numeric_limits<double>::max();
+    for (const auto &seed : seeds)
+      {
+      double point[3];
+      this->Evaluate(patch, seed[0], seed[1], point);
+      const double dist = SquaredDistance(point, q);
+      if (dist < bestDistance)
+        {
+        bestDistance = dist;
+        projection.s = seed[0];
+        projection.t = seed[1];
+        }
+      }
+  }
+
+  // Gauss-Newton on |S(s, t) - q|^2 with step halving, from the
+  // projection's parameters.  Where the step leaves the parameter triangle,
+  // it is taken along the edges the point lies on instead.
+  void Iterate(const double* q, Projection &projection) const
+  {
+    const Patch &patch = this->patches[projection.patch];
+    double s = projection.s, t = projection.t;
+    Clamp(patch.N, s, t);
+    double point[3], ds[3], dt[3];
+    this->Evaluate(patch, s, t, point, ds, dt);
+    double dist = SquaredDistance(point, q);
+
+    for (unsigned int iteration = 0; iteration < MaximumNumberOfIterations; ++iteration)
+      {
+      double r[3];
+      for (unsigned int d = 0; d < 3; ++d) r[d] = point[d] - q[d];
+      const double a = ds[0] * ds[0] + ds[1] * ds[1] + ds[2] * ds[2];
+      const double b = ds[0] * dt[0] + ds[1] * dt[1] + ds[2] * dt[2];
+      const double c = dt[0] * dt[0] + dt[1] * dt[1] + dt[2] * dt[2];
+      const double gs = ds[0] * r[0] + ds[1] * r[1] + ds[2] * r[2];
+      const double gt = dt[0] * r[0] + dt[1] * r[1] + dt[2] * r[2];
+      const double det = a * c - b * b;
+      if (!(det > 1e-12 * (a * c))) break;
+
+      // The full step, then steps along each edge direction
+      double steps[4][2] = {{-(c * gs - b * gt) / det, -(a * gt - b * gs) / det},
+                            {0.0, 0.0}, {0.0, 0.0}, {0.0, 0.0}};
+      static constexpr double edges[3][2] = {{1.0, 0.0}, {0.0, 1.0}, {1.0, -1.0}};
+      for (unsigned int e = 0; e < 3; ++e)
+        {
+        const double curvature = a * edges[e][0] * edges[e][0] + 2.0 * b * edges[e][0] * edges[e][1]
+                               + c * edges[e][1] * edges[e][1];
+        const double lambda = -(gs * edges[e][0] + gt * edges[e][1]) / curvature;
+        steps[e + 1][0] = lambda * edges[e][0];
+        steps[e + 1][1] = lambda * edges[e][1];
+        }
+
+      bool accepted = false;
+      double nextS = s, nextT = t;
+      for (unsigned int k = 0; k < 4 && !accepted; ++k)
+        for (double lambda = 1.0; lambda > 1.0 / 16.0; lambda *= 0.5)
+          {
+          nextS = s + lambda * steps[k][0];
+          nextT = t + lambda * steps[k][1];
+          Clamp(patch.N, nextS, nextT);
+          double nextPoint[3], nextDs[3], nextDt[3];
+          this->Evaluate(patch, nextS, nextT, nextPoint, nextDs, nextDt);
+          const double nextDist = SquaredDistance(nextPoint, q);
+          if (nextDist < dist)
+            {
+            std::copy(nextPoint, nextPoint + 3, point);
+            std::copy(nextDs, nextDs + 3, ds);
+            std::copy(nextDt, nextDt + 3, dt);
+            dist = nextDist;
+            accepted = true;
+            break;
+            }
+          }
+      if (!accepted) break;
+      const double moved = std::abs(nextS - s) + std::abs(nextT - t);
+      s = nextS;
+      t = nextT;
+      if (moved < 1e-9) break;
+      }
+
+    projection.s = s;
+    projection.t = t;
+    std::copy(point, point + 3, projection.point);
+    projection.distance = dist;
+  }
+
+  void UpdateCandidateWeights()
+  {
+    ParallelFor(this->GetNumberOfCandidates(), this->NumberOfThreads, [this](size_t begin, size_t end)
+      {
+      for (size_t j = begin; j < end; ++j)
+        {
+        const Projection &projection = this->candidateProjections[j];
+        double point[3];
+        this->Evaluate(this->patches[projection.patch], projection.s, projection.t, point, nullptr, nullptr,
+                       this->candidateWeights.data() + MaximumNumberOfControlPoints * j);
+        }
+      });
+  }
+
+  const typename TMesh::Pointer &moving;
+  const ControlPointBuffer &buffer;
+  const unsigned int frame;
+  const unsigned int NumberOfThreads;
+
+  std::vector<Patch> patches;
+  std::vector<Node> nodes;
+  std::vector<std::uint32_t> order; // Patches in leaf order
+
+  std::vector<double> candidates;
+  std::vector<Projection> candidateProjections;
+  std::vector<TReal> candidateWeights; // MaximumNumberOfControlPoints per candidate
+
+}; // end class
+
+} // namespace sissr
+
+#endif
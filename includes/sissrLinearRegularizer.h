@@ -0,0 +1,42 @@
+#ifndef sissr_LinearRegularizer_h
+#define sissr_LinearRegularizer_h
+
+#include <ceres/ceres.h>
+#include <itkMacro.h>
+#include <sissrControlPointBuffer.h>
+#include <sissrLinearRegularizerOperator.h>
+
+namespace sissr {
+
+// One block of a LinearRegularizerOperator, with one parameter block per
+// column.  The Jacobian is the block's coefficients times the identity,
+// and is not recalculated from the positions.  Residuals are organized
+// columnwise, [x...y...z...], as in the thin plate regularizer.
+template<class TMesh>
+class LinearRegularizer : public ceres::CostFunction
+{
+
+public:
+  using TOperator = LinearRegularizerOperator<TMesh>;
+
+  LinearRegularizer(const TOperator& _linearOperator,
+                    const ControlPointBuffer& _buffer,
+                    size_t _index);
+
+  bool Evaluate(const double* const* parameters,
+                double* residuals,
+                double** jacobians) const;
+
+  ~LinearRegularizer() {}
+
+private:
+  const typename TOperator::Block& block;
+  const ControlPointBuffer& buffer;
+
+}; // end class
+
+} // namespace sissr
+
+#include <sissrLinearRegularizer.hxx>
+
+#endif
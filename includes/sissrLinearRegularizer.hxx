@@ -0,0 +1,64 @@
+#ifndef sissr_LinearRegularizer_hxx
+#define sissr_LinearRegularizer_hxx
+
+namespace sissr {
+
+template<class TMesh>
+LinearRegularizer<TMesh>::LinearRegularizer(
+  const TOperator& _linearOperator,
+  const ControlPointBuffer& _buffer,
+  size_t _index)
+  : block(_linearOperator.GetBlock(_index))
+  , buffer(_buffer)
+{
+  for (size_t k = 0; k < this->block.columns.size(); ++k) {
+    this->mutable_parameter_block_sizes()->push_back(3);
+  }
+  this->set_num_residuals(3 * this->block.rows);
+}
+
+template<class TMesh>
+bool
+LinearRegularizer<TMesh>::Evaluate(const double* const* /*parameters*/,
+                                   double* residuals,
+                                   double** jacobians) const
+{
+
+  const unsigned int R = this->block.rows;
+  const size_t K = this->block.columns.size();
+  const double* A = this->block.coefficients.data();
+
+  // Residuals; the columns index the buffer's [frame][point] layout.
+  const double* X = this->buffer.GetPoint(0, 0);
+  std::fill(residuals, residuals + 3 * R, 0.0);
+  for (size_t k = 0; k < K; ++k) {
+    const double* x = X + 3 * this->block.columns[k];
+    for (unsigned int r = 0; r < R; ++r) {
+      const double a = A[r * K + k];
+      for (unsigned int d = 0; d < 3; ++d) {
+        residuals[d * R + r] += a * x[d];
+      }
+    }
+  }
+
+  // Return if Jacobian wasn't requested.
+  if (nullptr == jacobians) {
+    return true;
+  }
+
+  for (size_t k = 0; k < K; ++k) {
+    if (nullptr == jacobians[k]) continue;
+    ceres::MatrixRef(jacobians[k], 3 * R, 3).setZero();
+    for (unsigned int d = 0; d < 3; ++d) {
+      for (unsigned int r = 0; r < R; ++r) {
+        jacobians[k][(d * R + r) * 3 + d] = A[r * K + k];
+      }
+    }
+  }
+
+  return true;
+}
+
+} // namespace sissr
+
+#endif
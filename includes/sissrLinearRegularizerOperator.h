@@ -0,0 +1,191 @@
+#ifndef sissr_LinearRegularizerOperator_h
+#define sissr_LinearRegularizerOperator_h
+
+// STD
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <utility>
+#include <vector>
+
+// ITK
+#include <itkMacro.h>
+
+namespace sissr {
+
+/*
+ The velocity, acceleration, edge length and thin plate regularizers as one
+ weighted sparse operator on the control point positions of all frames.
+
+ Each of these terms is linear in the positions and acts on x, y and z
+ alike, so the operator is stored once, as scalars: residual row r of
+ coordinate d is the sum over columns u of A(r, u) * position(u)[d], where
+ u = frame * NumberOfControlPoints + point.  The square root of each term's
+ weight is folded into its rows, so the rows need no loss function.
+
+ Rows are grouped into blocks which share their columns.  A control point's
+ velocity and acceleration rows in a frame form one block; a cell's thin
+ plate rows and the rows of the edges assigned to it form another.  Each
+ block is stored densely over its columns, and becomes one residual block.
+ */
+template<typename TMesh>
+class LinearRegularizerOperator
+{
+
+public:
+
+  struct Block
+  {
+    std::vector<size_t> columns; // Sorted unknowns
+    std::vector<double> coefficients; // rows x columns, row-major
+    unsigned int rows = 0;
+  };
+
+  explicit LinearRegularizerOperator(const std::vector<typename TMesh::Pointer> &_meshes) :
+    meshes(_meshes),
+    NumberOfFrames(_meshes.size()),
+    NumberOfControlPoints(_meshes.empty() ? 0 : _meshes.front()->GetNumberOfPoints()),
+    NumberOfCells(_meshes.empty() ? 0 : _meshes.front()->GetNumberOfCells()),
+    groups(size_t(NumberOfFrames) * (NumberOfControlPoints + NumberOfCells))
+  {
+    itkAssertOrThrowMacro(this->NumberOfFrames > 0, "At least one frame is required.");
+  }
+
+  // x(next) - x(frame), cyclic
+  void AddVelocity(const double &weight)
+  {
+    const double w = std::sqrt(weight);
+    for (unsigned int f = 0; f < this->NumberOfFrames; ++f)
+      {
+      const unsigned int next = (f + 1) % this->NumberOfFrames;
+      for (size_t i = 0; i < this->NumberOfControlPoints; ++i)
+        this->AddRow(this->PointGroup(f, i), {{this->Unknown(next, i), w}, {this->Unknown(f, i), -w}});
+      }
+  }
+
+  // x(prev) - 2 x(frame) + x(next), cyclic
+  void AddAcceleration(const double &weight)
+  {
+    const double w = std::sqrt(weight);
+    for (unsigned int f = 0; f < this->NumberOfFrames; ++f)
+      {
+      const unsigned int prev = (f + this->NumberOfFrames - 1) % this->NumberOfFrames;
+      const unsigned int next = (f + 1) % this->NumberOfFrames;
+      for (size_t i = 0; i < this->NumberOfControlPoints; ++i)
+        this->AddRow(this->PointGroup(f, i),
+                     {{this->Unknown(prev, i), w}, {this->Unknown(f, i), -2.0 * w}, {this->Unknown(next, i), w}});
+      }
+  }
+
+  // x(destination) - x(origin) of every edge, in the block of a cell which
+  // has the edge, if any
+  void AddEdgeLength(const double &weight)
+  {
+    const double w = std::sqrt(weight);
+    for (unsigned int f = 0; f < this->NumberOfFrames; ++f)
+      {
+      const auto &mesh = this->meshes[f];
+      std::map<std::pair<size_t, size_t>, size_t> edgeToCell;
+      for (size_t c = 0; c < this->NumberOfCells; ++c)
+        {
+        const auto ids = mesh->GetCells()->ElementAt(c)->GetPointIds();
+        for (unsigned int k = 0; k < 3; ++k)
+          {
+          const size_t a = ids[k], b = ids[(k + 1) % 3];
+          edgeToCell.emplace(std::make_pair(std::min(a, b), std::max(a, b)), c);
+          }
+        }
+      for (size_t e = 0; e < mesh->GetNumberOfEdges(); ++e)
+        {
+        const size_t origin = mesh->GetEdge(e)->GetOrigin();
+        const size_t destination = mesh->GetEdge(e)->GetDestination();
+        const auto it = edgeToCell.find(std::make_pair(std::min(origin, destination), std::max(origin, destination)));
+        const size_t group = (edgeToCell.end() != it) ? this->CellGroup(f, it->second) : this->PointGroup(f, origin);
+        this->AddRow(group, {{this->Unknown(f, destination), w}, {this->Unknown(f, origin), -w}});
+        }
+      }
+  }
+
+  // The 15 Bezier rows of every cell's thin plate operator
+  void AddThinPlate(const double &weight)
+  {
+    const double w = std::sqrt(weight);
+    for (unsigned int f = 0; f < this->NumberOfFrames; ++f)
+      {
+      const auto &mesh = this->meshes[f];
+      for (size_t c = 0; c < this->NumberOfCells; ++c)
+        {
+        const auto &L = mesh->GetPointListForCell(c);
+        const size_t K = L.size();
+        const auto B = mesh->m_Matrices.GetThinPlateOperatorView(mesh->GetNForCell(c)).data();
+        for (unsigned int r = 0; r < 15; ++r)
+          {
+          std::vector<std::pair<size_t, double>> row;
+          for (size_t k = 0; k < K; ++k) row.emplace_back(this->Unknown(f, L[k]), w * B[K * r + k]);
+          this->AddRow(this->CellGroup(f, c), std::move(row));
+          }
+        }
+      }
+  }
+
+  // Dense blocks from the rows added so far
+  void Finalize()
+  {
+    this->blocks.clear();
+    this->NumberOfRows = 0;
+    for (auto &group : this->groups)
+      {
+      if (group.empty()) continue;
+      Block block;
+      for (const auto &row : group)
+        for (const auto &entry : row) block.columns.push_back(entry.first);
+      std::sort(block.columns.begin(), block.columns.end());
+      block.columns.erase(std::unique(block.columns.begin(), block.columns.end()), block.columns.end());
+      block.rows = group.size();
+      block.coefficients.assign(size_t(block.rows) * block.columns.size(), 0.0);
+      for (unsigned int r = 0; r < block.rows; ++r)
+        for (const auto &entry : group[r])
+          {
+          const size_t k = std::lower_bound(block.columns.begin(), block.columns.end(), entry.first)
+                         - block.columns.begin();
+          block.coefficients[r * block.columns.size() + k] += entry.second;
+          }
+      this->NumberOfRows += block.rows;
+      this->blocks.push_back(std::move(block));
+      group.clear();
+      group.shrink_to_fit();
+      }
+  }
+
+  size_t GetNumberOfUnknowns() const { return size_t(this->NumberOfFrames) * this->NumberOfControlPoints; }
+  size_t GetNumberOfRows() const { return this->NumberOfRows; }
+  size_t GetNumberOfBlocks() const { return this->blocks.size(); }
+  const Block& GetBlock(const size_t &b) const { return this->blocks[b]; }
+
+private:
+
+  using Row = std::vector<std::pair<size_t, double>>;
+
+  size_t Unknown(const unsigned int &frame, const size_t &point) const
+    { return size_t(frame) * this->NumberOfControlPoints + point; }
+  size_t PointGroup(const unsigned int &frame, const size_t &point) const
+    { return this->Unknown(frame, point); }
+  size_t CellGroup(const unsigned int &frame, const size_t &cell) const
+    { return size_t(this->NumberOfFrames) * this->NumberOfControlPoints + size_t(frame) * this->NumberOfCells + cell; }
+
+  void AddRow(const size_t &group, Row row) { this->groups[group].emplace_back(std::move(row)); }
+
+  const std::vector<typename TMesh::Pointer> meshes;
+  const unsigned int NumberOfFrames;
+  const size_t NumberOfControlPoints;
+  const size_t NumberOfCells;
+
+  std::vector<std::vector<Row>> groups; // Rows not yet finalized
+  std::vector<Block> blocks;
+  size_t NumberOfRows = 0;
+
+}; // end class
+
+} // namespace sissr
+
+#endif
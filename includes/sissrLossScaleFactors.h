@@ -14,14 +14,18 @@ struct LossScaleFactors
                    const double _Acceleration,
                    const double _ThinPlate,
                    const double _TriangleAspectRatio,
-                   const double _EdgeLength) :
+                   const double _EdgeLength,
+                   const double _Tangential = 0.01,
+                   const double _Candidate = 0.0) :
     Primary(_Primary),
     EdgeWeight(_EdgeWeight),
     Velocity(_Velocity),
     Acceleration(_Acceleration),
     ThinPlate(_ThinPlate),
     TriangleAspectRatio(_TriangleAspectRatio),
-    EdgeLength(_EdgeLength) {};
+    EdgeLength(_EdgeLength),
+    Tangential(_Tangential),
+    Candidate(_Candidate) {};
   LossScaleFactors() :
     Primary(1.0),
     EdgeWeight(1.0),
@@ -29,7 +33,9 @@ struct LossScaleFactors
     Acceleration(0.0),
     ThinPlate(0.0),
     TriangleAspectRatio(0.0),
-    EdgeLength(0.0) {};
+    EdgeLength(0.0),
+    Tangential(0.01),
+    Candidate(0.0) {};
   double Primary;
   double EdgeWeight;
   double Velocity;
@@ -37,6 +43,12 @@ struct LossScaleFactors
   double ThinPlate;
   double TriangleAspectRatio;
   double EdgeLength;
+  // Point-to-plane and symmetric primary residuals: weight of the offset
+  // along the candidate surface, relative to the offset across it
+  double Tangential;
+  // Offsets from the candidates to their closest points on the limit
+  // surface; 0 leaves the data term one-sided
+  double Candidate;
 };
 
 } // namespace sissr
@@ -0,0 +1,597 @@
+#ifndef sissr_MatrixFreeSolver_h
+#define sissr_MatrixFreeSolver_h
+
+// STD
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <map>
+#include <set>
+#include <utility>
+#include <vector>
+
+// Ceres
+#include <ceres/ceres.h>
+
+// ITK
+#include <itkMacro.h>
+
+// SiSSR
+#include <sissrAlternatingSolver.h>
+#include <sissrControlPointBuffer.h>
+#include <sissrCorrespondenceEngine.h>
+#include <sissrLossScaleFactors.h>
+#include <sissrUtils.h>
+
+namespace sissr {
+
+/*
+ Gauss-Newton without a Jacobian, for passes too large for Ceres' Jacobian
+ and Cholesky factor.  The terms are those of the alternating solver: the
+ primary residuals (point-to-point, point-to-plane or symmetric) and the
+ velocity, acceleration, edge length and thin plate regularizers, with the
+ weights RegisterMeshToPointSet gives them.
+
+ Each iteration finds the correspondences of the current positions and
+ solves J^T J dx = -J^T r by conjugate gradients, preconditioned with the
+ inverse 3x3 diagonal blocks of J^T J (one per control point and frame).
+ The products with J^T J are applied straight from the subdivision stencils
+ and the correspondences' normals, and from the thin plate operators and
+ edges of the meshes, so the memory used is a few vectors over the
+ unknowns plus per-cell tables.
+
+ A step which does not lower the cost is halved, up to four times; then
+ the solve ends.  The options' tolerances, limits and iteration callbacks
+ are honored as by AlternatingSolver.
+ */
+template<typename TFixedMesh, typename TMovingMesh>
+class MatrixFreeSolver
+{
+
+public:
+
+  using TCorrespondenceEngine = CorrespondenceEngine<TFixedMesh, TMovingMesh>;
+  using TMovingVector = std::vector<typename TMovingMesh::Pointer>;
+  using TPointIdentifier = typename TMovingMesh::PointIdentifier;
+  using TReal = typename TMovingMesh::RealType;
+
+  unsigned int MaximumNumberOfLinearIterations = 100;
+  double LinearSolverTolerance = 1e-3; // Relative to the norm of the gradient
+
+  /*
+   offsets: the parameter storage the buffer adds to the initial positions,
+   [frame][point][xyz].  The border cells of the first frame have their
+   primary residuals weighted by EdgeWeight if labels are used, as in
+   RegisterMeshToPointSet.
+   */
+  MatrixFreeSolver(const TMovingVector &_movingVector,
+                   ControlPointBuffer &_buffer,
+                   TCorrespondenceEngine &_correspondences,
+                   double* _offsets,
+                   const LossScaleFactors &_weights,
+                   const std::set<unsigned int> &_borderCells,
+                   unsigned int _numberOfThreads) :
+    movingVector(_movingVector),
+    buffer(_buffer),
+    correspondences(_correspondences),
+    offsets(_offsets),
+    NumberOfFrames(_buffer.GetNumberOfFrames()),
+    NumberOfControlPoints(_buffer.GetNumberOfControlPoints()),
+    NumberOfThreads(std::max(1u, _numberOfThreads)),
+    tangential(std::sqrt(_weights.Tangential))
+  {
+    itkAssertOrThrowMacro(this->movingVector.size() == this->NumberOfFrames,
+                          "Number of moving meshes does not match the control point buffer.");
+    const auto enabled = [](const double &w) { return w > 1e-6; };
+    this->velocity = (enabled(_weights.Velocity) && this->NumberOfFrames > 1) ? std::sqrt(_weights.Velocity) : 0.0;
+    this->acceleration = (enabled(_weights.Acceleration) && this->NumberOfFrames > 2) ? std::sqrt(_weights.Acceleration) : 0.0;
+    this->thinPlate = enabled(_weights.ThinPlate) ? std::sqrt(_weights.ThinPlate) : 0.0;
+    this->edgeLength = enabled(_weights.EdgeLength) ? std::sqrt(_weights.EdgeLength) : 0.0;
+
+    const size_t samplesPerCell = this->movingVector.front()->GetNumberOfSamplesPerCell();
+    this->cells.resize(this->NumberOfFrames);
+    this->patches.resize(this->NumberOfFrames);
+    this->edges.resize(this->NumberOfFrames);
+    for (unsigned int f = 0; f < this->NumberOfFrames; ++f)
+      {
+      const auto &moving = this->movingVector[f];
+      const size_t samples = moving->GetSurfaceParameterList().size();
+      for (size_t first = 0; enabled(_weights.Primary) && first < samples; first += samplesPerCell)
+        {
+        const auto cellID = moving->GetSurfaceParameter(first).first;
+        const unsigned int N = moving->GetNForCell(cellID);
+        auto &stencils = this->stencilTables[N];
+        if (stencils.empty())
+          for (size_t s = 0; s < samplesPerCell; ++s) stencils.push_back(moving->GetStencil(first + s));
+        Cell cell;
+        cell.L = moving->GetPointListForCell(cellID).data_block();
+        cell.K = moving->GetPointListForCell(cellID).size();
+        cell.first = first;
+        cell.weight = _weights.Primary * (_borderCells.count(cellID) ? _weights.EdgeWeight : 1.0);
+        cell.stencils = stencils.data();
+        this->cells[f].push_back(cell);
+        }
+      for (size_t c = 0; this->thinPlate > 0.0 && c < moving->GetNumberOfCells(); ++c)
+        {
+        Patch patch;
+        patch.L = moving->GetPointListForCell(c).data_block();
+        patch.K = moving->GetPointListForCell(c).size();
+        patch.B = moving->m_Matrices.GetThinPlateOperatorView(moving->GetNForCell(c)).data();
+        this->patches[f].push_back(patch);
+        }
+      for (size_t e = 0; this->edgeLength > 0.0 && e < moving->GetNumberOfEdges(); ++e)
+        {
+        this->edges[f].emplace_back(moving->GetEdge(e)->GetOrigin(), moving->GetEdge(e)->GetDestination());
+        }
+      }
+    this->SamplesPerCell = samplesPerCell;
+  }
+
+  void Solve(const ceres::Solver::Options &options, ceres::Solver::Summary *summary)
+  {
+    const auto start = std::chrono::steady_clock::now();
+    const auto since = [](const std::chrono::steady_clock::time_point &t) {
+      return std::chrono::duration<double>(std::chrono::steady_clock::now() - t).count();
+    };
+
+    const size_t n = size_t(3) * this->NumberOfFrames * this->NumberOfControlPoints;
+    *summary = ceres::Solver::Summary();
+    summary->minimizer_type = ceres::TRUST_REGION;
+    summary->linear_solver_type_given = ceres::CGNR;
+    summary->linear_solver_type_used = ceres::CGNR;
+    summary->preconditioner_type_given = ceres::JACOBI;
+    summary->preconditioner_type_used = ceres::JACOBI;
+    summary->num_threads_given = options.num_threads;
+    summary->num_threads_used = this->NumberOfThreads;
+    summary->num_parameter_blocks = n / 3;
+    summary->num_parameters = n;
+    summary->num_effective_parameters = n;
+
+    std::vector<double> gradient(n), step(n), previous(n);
+    double cost = this->Evaluate(gradient, summary);
+    summary->initial_cost = cost;
+    summary->termination_type = ceres::NO_CONVERGENCE;
+    summary->message = "Maximum number of iterations reached.";
+
+    ceres::IterationSummary first;
+    first.cost = cost;
+    first.step_is_valid = first.step_is_successful = true;
+    first.iteration_time_in_seconds = first.cumulative_time_in_seconds = since(start);
+    summary->iterations.push_back(first);
+    const auto finish = [&]() {
+      summary->final_cost = cost;
+      summary->minimizer_time_in_seconds = summary->total_time_in_seconds = since(start);
+    };
+    if (!NotifyIterationCallbacks(options, first, summary))
+      {
+      finish();
+      return;
+      }
+
+    for (int iteration = 1; iteration <= options.max_num_iterations; ++iteration)
+      {
+      const auto iterationStart = std::chrono::steady_clock::now();
+      if (since(start) > options.max_solver_time_in_seconds)
+        {
+        summary->message = "Maximum solver time reached.";
+        break;
+        }
+
+      double gradientMax = 0.0;
+      for (const auto g : gradient) gradientMax = std::max(gradientMax, std::abs(g));
+      if (gradientMax <= options.gradient_tolerance)
+        {
+        summary->termination_type = ceres::CONVERGENCE;
+        summary->message = "Gradient tolerance reached.";
+        break;
+        }
+
+      const auto solverStart = std::chrono::steady_clock::now();
+      const unsigned int linearIterations = this->SolveNormalEquations(gradient, step);
+      summary->linear_solver_time_in_seconds += since(solverStart);
+
+      std::copy(this->offsets, this->offsets + n, previous.begin());
+      double parameterNorm = 0.0, stepNorm = 0.0;
+      for (size_t j = 0; j < n; ++j)
+        {
+        parameterNorm += previous[j] * previous[j];
+        stepNorm += step[j] * step[j];
+        }
+      parameterNorm = std::sqrt(parameterNorm);
+      stepNorm = std::sqrt(stepNorm);
+
+      // The step, halved until it lowers the cost
+      double scale = 1.0, candidate = cost;
+      bool successful = false;
+      for (unsigned int attempt = 0; attempt < 5 && !successful; ++attempt, scale *= 0.5)
+        {
+        for (size_t j = 0; j < n; ++j) this->offsets[j] = previous[j] + scale * step[j];
+        candidate = this->Evaluate(gradient, summary);
+        successful = std::isfinite(candidate) && candidate < cost;
+        }
+      if (successful) scale *= 2.0;
+
+      ceres::IterationSummary current;
+      current.iteration = iteration;
+      current.step_is_valid = successful;
+      current.step_is_successful = successful;
+      current.gradient_max_norm = gradientMax;
+      current.step_norm = scale * stepNorm;
+      current.step_size = scale;
+      current.linear_solver_iterations = linearIterations;
+      if (successful)
+        {
+        current.cost_change = cost - candidate;
+        current.cost = candidate;
+        ++summary->num_successful_steps;
+        }
+      else
+        {
+        // Back to the last point, with its correspondences
+        std::copy(previous.begin(), previous.end(), this->offsets);
+        this->Evaluate(gradient, summary);
+        current.cost = cost;
+        ++summary->num_unsuccessful_steps;
+        }
+      current.iteration_time_in_seconds = since(iterationStart);
+      current.cumulative_time_in_seconds = since(start);
+      summary->iterations.push_back(current);
+
+      if (!successful)
+        {
+        summary->termination_type = ceres::CONVERGENCE;
+        summary->message = "The cost did not decrease.";
+        break;
+        }
+      const double before = cost;
+      cost = candidate;
+      if (!NotifyIterationCallbacks(options, current, summary)) break;
+      if (current.cost_change <= options.function_tolerance * before)
+        {
+        summary->termination_type = ceres::CONVERGENCE;
+        summary->message = "Function tolerance reached.";
+        break;
+        }
+      if (current.step_norm <= options.parameter_tolerance * (parameterNorm + options.parameter_tolerance))
+        {
+        summary->termination_type = ceres::CONVERGENCE;
+        summary->message = "Parameter tolerance reached.";
+        break;
+        }
+      }
+
+    finish();
+  }
+
+  size_t GetNumberOfLinearIterations() const { return this->NumberOfLinearIterations; }
+
+  // Bytes of the solver's vectors and tables, at their largest
+  size_t CalculateMemoryEstimate() const
+  {
+    const size_t n = size_t(3) * this->NumberOfFrames * this->NumberOfControlPoints;
+    size_t bytes = sizeof(double) * (3 * n        // gradient, step, previous offsets
+                                   + 4 * n        // conjugate gradient vectors
+                                   + 3 * n);      // inverse diagonal blocks
+    for (unsigned int f = 0; f < this->NumberOfFrames; ++f)
+      {
+      bytes += sizeof(Cell) * this->cells[f].size();
+      bytes += sizeof(Patch) * this->patches[f].size();
+      bytes += sizeof(std::pair<size_t, size_t>) * this->edges[f].size();
+      }
+    return bytes;
+  }
+
+  // Finds the correspondences of the current offsets; returns the cost and
+  // sets the gradient, J^T r, and the preconditioner for the next solve.
+  double Evaluate(std::vector<double> &gradient, ceres::Solver::Summary *summary)
+  {
+    const auto start = std::chrono::steady_clock::now();
+    this->correspondences.Invalidate();
+    this->buffer.Update();
+
+    std::fill(gradient.begin(), gradient.end(), 0.0);
+    this->inverseBlocks.assign(gradient.size() * 3, 0.0);
+    std::vector<double> frameCosts(this->NumberOfFrames, 0.0);
+    const double* X = this->buffer.GetPoint(0, 0);
+
+    ParallelFor(this->NumberOfFrames, this->NumberOfThreads, [&](const size_t begin, const size_t end) {
+      for (unsigned int f = begin; f < end; ++f)
+        {
+        double cost = 0.0;
+        for (const auto &cell : this->cells[f])
+          for (size_t s = 0; s < this->SamplesPerCell; ++s)
+            {
+            const TReal* w = cell.stencils[s];
+            const size_t sample = cell.first + s;
+            const double* surfacePoint = this->correspondences.GetSurfacePoint(f, sample);
+            const double* fixedPoint = this->correspondences.GetCorrespondence(f, sample);
+            double r[3];
+            for (unsigned int d = 0; d < 3; ++d) r[d] = surfacePoint[d] - fixedPoint[d];
+            this->ApplyDerivative(f, sample, r);
+            cost += 0.5 * cell.weight * (r[0] * r[0] + r[1] * r[1] + r[2] * r[2]);
+
+            // J^T r, with blocks w_k Q, and the diagonal blocks w_k^2 Q^T Q
+            this->ApplyDerivative(f, sample, r);
+            double QQ[9];
+            for (unsigned int c = 0; c < 3; ++c)
+              {
+              double e[3] = {0.0, 0.0, 0.0};
+              e[c] = 1.0;
+              this->ApplyDerivative(f, sample, e);
+              this->ApplyDerivative(f, sample, e);
+              for (unsigned int d = 0; d < 3; ++d) QQ[3 * d + c] = e[d];
+              }
+            for (unsigned int k = 0; k < cell.K; ++k)
+              {
+              const size_t u = this->Unknown(f, cell.L[k]);
+              for (unsigned int d = 0; d < 3; ++d) gradient[u + d] += cell.weight * w[k] * r[d];
+              for (unsigned int e = 0; e < 9; ++e) this->inverseBlocks[3 * u + e] += cell.weight * w[k] * w[k] * QQ[e];
+              }
+            }
+        this->ForEachSpatialRow(f, [&](const TPointIdentifier* columns, const TReal* a, unsigned int K, double scale) {
+          double t[3] = {0.0, 0.0, 0.0};
+          for (unsigned int k = 0; k < K; ++k)
+            for (unsigned int d = 0; d < 3; ++d) t[d] += scale * a[k] * X[this->Unknown(f, columns[k]) + d];
+          cost += 0.5 * (t[0] * t[0] + t[1] * t[1] + t[2] * t[2]);
+          for (unsigned int k = 0; k < K; ++k)
+            {
+            const size_t u = this->Unknown(f, columns[k]);
+            for (unsigned int d = 0; d < 3; ++d) gradient[u + d] += scale * a[k] * t[d];
+            for (unsigned int d = 0; d < 3; ++d) this->inverseBlocks[3 * u + 4 * d] += scale * scale * a[k] * a[k];
+            }
+        });
+        frameCosts[f] = cost;
+        }
+    });
+
+    std::vector<double> pointCosts(this->NumberOfControlPoints, 0.0);
+    ParallelFor(this->NumberOfControlPoints, this->NumberOfThreads, [&](const size_t begin, const size_t end) {
+      for (size_t i = begin; i < end; ++i)
+        this->ForEachTemporalRow([&](const unsigned int* frames, const TReal* a, unsigned int K, double scale) {
+          double t[3] = {0.0, 0.0, 0.0};
+          for (unsigned int k = 0; k < K; ++k)
+            for (unsigned int d = 0; d < 3; ++d) t[d] += scale * a[k] * X[this->Unknown(frames[k], i) + d];
+          pointCosts[i] += 0.5 * (t[0] * t[0] + t[1] * t[1] + t[2] * t[2]);
+          for (unsigned int k = 0; k < K; ++k)
+            {
+            const size_t u = this->Unknown(frames[k], i);
+            for (unsigned int d = 0; d < 3; ++d) gradient[u + d] += scale * a[k] * t[d];
+            for (unsigned int d = 0; d < 3; ++d) this->inverseBlocks[3 * u + 4 * d] += scale * scale * a[k] * a[k];
+            }
+        });
+    });
+
+    // Each diagonal block, inverted in place; unconstrained points keep
+    // the identity.
+    ParallelFor(gradient.size() / 3, this->NumberOfThreads, [&](const size_t begin, const size_t end) {
+      for (size_t j = begin; j < end; ++j) InvertSymmetric(this->inverseBlocks.data() + 9 * j);
+    });
+
+    double cost = 0.0;
+    for (const auto c : frameCosts) cost += c;
+    for (const auto c : pointCosts) cost += c;
+    summary->residual_evaluation_time_in_seconds +=
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return cost;
+  }
+
+  // y = J^T J x, with the correspondences of the last evaluation
+  void Multiply(const std::vector<double> &x, std::vector<double> &y) const
+  {
+    std::fill(y.begin(), y.end(), 0.0);
+
+    ParallelFor(this->NumberOfFrames, this->NumberOfThreads, [&](const size_t begin, const size_t end) {
+      for (unsigned int f = begin; f < end; ++f)
+        {
+        for (const auto &cell : this->cells[f])
+          for (size_t s = 0; s < this->SamplesPerCell; ++s)
+            {
+            const TReal* w = cell.stencils[s];
+            double v[3] = {0.0, 0.0, 0.0};
+            for (unsigned int k = 0; k < cell.K; ++k)
+              {
+              const double* xk = x.data() + this->Unknown(f, cell.L[k]);
+              for (unsigned int d = 0; d < 3; ++d) v[d] += w[k] * xk[d];
+              }
+            this->ApplyDerivative(f, cell.first + s, v);
+            this->ApplyDerivative(f, cell.first + s, v);
+            for (unsigned int k = 0; k < cell.K; ++k)
+              {
+              double* yk = y.data() + this->Unknown(f, cell.L[k]);
+              for (unsigned int d = 0; d < 3; ++d) yk[d] += cell.weight * w[k] * v[d];
+              }
+            }
+        this->ForEachSpatialRow(f, [&](const TPointIdentifier* columns, const TReal* a, unsigned int K, double scale) {
+          double t[3] = {0.0, 0.0, 0.0};
+          for (unsigned int k = 0; k < K; ++k)
+            for (unsigned int d = 0; d < 3; ++d) t[d] += scale * a[k] * x[this->Unknown(f, columns[k]) + d];
+          for (unsigned int k = 0; k < K; ++k)
+            for (unsigned int d = 0; d < 3; ++d) y[this->Unknown(f, columns[k]) + d] += scale * a[k] * t[d];
+        });
+        }
+    });
+
+    ParallelFor(this->NumberOfControlPoints, this->NumberOfThreads, [&](const size_t begin, const size_t end) {
+      for (size_t i = begin; i < end; ++i)
+        this->ForEachTemporalRow([&](const unsigned int* frames, const TReal* a, unsigned int K, double scale) {
+          double t[3] = {0.0, 0.0, 0.0};
+          for (unsigned int k = 0; k < K; ++k)
+            for (unsigned int d = 0; d < 3; ++d) t[d] += scale * a[k] * x[this->Unknown(frames[k], i) + d];
+          for (unsigned int k = 0; k < K; ++k)
+            for (unsigned int d = 0; d < 3; ++d) y[this->Unknown(frames[k], i) + d] += scale * a[k] * t[d];
+        });
+    });
+  }
+
+private:
+
+  struct Cell
+  {
+    const TPointIdentifier* L;
+    unsigned int K;
+    size_t first; // First sample
+    double weight; // Loss scale
+    const TReal* const* stencils; // One per sample of the cell
+  };
+
+  struct Patch
+  {
+    const TPointIdentifier* L;
+    unsigned int K;
+    const TReal* B; // 15 x K thin plate operator, row-major
+  };
+
+  // v <- Q v, with Q = t I + (1 - t) n n^T (symmetric) the derivative of a
+  // primary residual with respect to its surface point, as in
+  // CostFunctionBase; the identity for point-to-point residuals.
+  void ApplyDerivative(const unsigned int &f, const size_t &s, double v[3]) const
+  {
+    const double* n = this->correspondences.GetNormal(f, s);
+    if (nullptr == n) return;
+    const double along = (1.0 - this->tangential) * (n[0] * v[0] + n[1] * v[1] + n[2] * v[2]);
+    for (unsigned int d = 0; d < 3; ++d) v[d] = this->tangential * v[d] + along * n[d];
+  }
+
+  // Calls visit(columns, coefficients, K, scale) for every thin plate and
+  // edge length row of frame f; columns index points of the frame.
+  template<typename F>
+  void ForEachSpatialRow(const unsigned int &f, const F &visit) const
+  {
+    for (const auto &patch : this->patches[f])
+      for (unsigned int r = 0; r < 15; ++r)
+        visit(patch.L, patch.B + size_t(patch.K) * r, patch.K, this->thinPlate);
+    static const TReal difference[2] = {1.0, -1.0};
+    for (const auto &edge : this->edges[f])
+      {
+      const TPointIdentifier columns[2] = {TPointIdentifier(edge.second), TPointIdentifier(edge.first)};
+      visit(columns, difference, 2u, this->edgeLength);
+      }
+  }
+
+  // Calls visit(frames, coefficients, K, scale) for the velocity and
+  // acceleration rows of one control point
+  template<typename F>
+  void ForEachTemporalRow(const F &visit) const
+  {
+    const unsigned int T = this->NumberOfFrames;
+    static const TReal velocity[2] = {1.0, -1.0}, acceleration[3] = {1.0, -2.0, 1.0};
+    for (unsigned int f = 0; f < T; ++f)
+      {
+      if (this->velocity > 0.0)
+        {
+        const unsigned int frames[2] = {(f + 1) % T, f};
+        visit(frames, velocity, 2u, this->velocity);
+        }
+      if (this->acceleration > 0.0)
+        {
+        const unsigned int frames[3] = {(f + T - 1) % T, f, (f + 1) % T};
+        visit(frames, acceleration, 3u, this->acceleration);
+        }
+      }
+  }
+
+  size_t Unknown(const unsigned int &f, const size_t &i) const
+    { return 3 * (size_t(f) * this->NumberOfControlPoints + i); }
+
+  // Preconditioned conjugate gradients for J^T J step = -gradient, from 0;
+  // returns the number of iterations.
+  unsigned int SolveNormalEquations(const std::vector<double> &gradient, std::vector<double> &step)
+  {
+    const size_t n = gradient.size();
+    std::vector<double> r(n), z(n), p(n), Ap(n);
+    const auto dot = [](const std::vector<double> &a, const std::vector<double> &b) {
+      double sum = 0.0;
+      for (size_t j = 0; j < a.size(); ++j) sum += a[j] * b[j];
+      return sum;
+    };
+    const auto precondition = [this, n](const std::vector<double> &in, std::vector<double> &out) {
+      for (size_t j = 0; j < n; j += 3)
+        {
+        const double* M = this->inverseBlocks.data() + 3 * j;
+        for (unsigned int d = 0; d < 3; ++d)
+          out[j + d] = M[3 * d] * in[j] + M[3 * d + 1] * in[j + 1] + M[3 * d + 2] * in[j + 2];
+        }
+    };
+
+    std::fill(step.begin(), step.end(), 0.0);
+    for (size_t j = 0; j < n; ++j) r[j] = -gradient[j];
+    const double target = this->LinearSolverTolerance * std::sqrt(dot(r, r));
+    precondition(r, z);
+    p = z;
+    double rz = dot(r, z);
+
+    unsigned int iteration = 0;
+    while (iteration < this->MaximumNumberOfLinearIterations && std::sqrt(dot(r, r)) > target)
+      {
+      this->Multiply(p, Ap);
+      const double pAp = dot(p, Ap);
+      if (!(pAp > 0.0)) break;
+      const double alpha = rz / pAp;
+      for (size_t j = 0; j < n; ++j)
+        {
+        step[j] += alpha * p[j];
+        r[j] -= alpha * Ap[j];
+        }
+      precondition(r, z);
+      const double next = dot(r, z);
+      const double beta = next / rz;
+      rz = next;
+      for (size_t j = 0; j < n; ++j) p[j] = z[j] + beta * p[j];
+      ++iteration;
+      }
+
+    this->NumberOfLinearIterations += iteration;
+    return iteration;
+  }
+
+  // Inverse of a symmetric positive semi-definite 3x3 matrix, in place;
+  // singular blocks are replaced by the identity.
+  static void InvertSymmetric(double* A)
+  {
+    const double c00 = A[4] * A[8] - A[5] * A[7];
+    const double c01 = A[5] * A[6] - A[3] * A[8];
+    const double c02 = A[3] * A[7] - A[4] * A[6];
+    const double det = A[0] * c00 + A[1] * c01 + A[2] * c02;
+    const double trace = A[0] + A[4] + A[8];
+    if (!(det > 1e-12 * trace * trace * trace))
+      {
+      std::fill(A, A + 9, 0.0);
+      A[0] = A[4] = A[8] = (trace > 0.0) ? 3.0 / trace : 1.0;
+      return;
+      }
+    const double inverse[9] = {
+      c00, A[2] * A[7] - A[1] * A[8], A[1] * A[5] - A[2] * A[4],
+      c01, A[0] * A[8] - A[2] * A[6], A[2] * A[3] - A[0] * A[5],
+      c02, A[1] * A[6] - A[0] * A[7], A[0] * A[4] - A[1] * A[3]};
+    for (unsigned int e = 0; e < 9; ++e) A[e] = inverse[e] / det;
+  }
+
+  const TMovingVector movingVector;
+  ControlPointBuffer &buffer;
+  TCorrespondenceEngine &correspondences;
+  double* const offsets;
+
+  const unsigned int NumberOfFrames;
+  const unsigned int NumberOfControlPoints;
+  const unsigned int NumberOfThreads;
+  size_t SamplesPerCell = 1;
+
+  // Square roots of the weights; 0 for terms which are not used
+  const double tangential;
+  double velocity = 0.0;
+  double acceleration = 0.0;
+  double thinPlate = 0.0;
+  double edgeLength = 0.0;
+
+  std::map<unsigned int, std::vector<const TReal*>> stencilTables; // Per valence
+  std::vector<std::vector<Cell>> cells; // Per frame
+  std::vector<std::vector<Patch>> patches; // Per frame
+  std::vector<std::vector<std::pair<size_t, size_t>>> edges; // Per frame; origin, destination
+  std::vector<double> inverseBlocks; // 3x3 per control point and frame
+  size_t NumberOfLinearIterations = 0;
+
+}; // end class
+
+} // namespace sissr
+
+#endif
@@ -3,7 +3,10 @@
 
 // ITK
 #include <itkPointSet.h>
-#include <itkPointsLocator.h>
+
+// SiSSR
+#include <sissrCalculateCellNormals.h>
+#include <sissrFlatKdTree.h>
 
 namespace sissr {
 
@@ -14,15 +17,19 @@ class MeshToKdTree {
     using TCoordinate = typename TMesh::PixelType;
     static constexpr unsigned int Dimension = TMesh::PointDimension;
     using TPointSet = itk::PointSet<TCoordinate, Dimension>;
-    using TLocator = itk::PointsLocator<typename TPointSet::PointsContainer>;
+    using TLocator = FlatKdTree<typename TPointSet::PointsContainer>;
 
-    void Calculate(TMesh* mesh, TLocator* locator) {
+    // Cell midpoints, with the cells' normals.
+    void Calculate(TMesh* mesh, TLocator* locator, const unsigned int &threads = 1) {
 
       const auto pointset = TPointSet::New();
+      const auto normals = TPointSet::PointsContainer::New();
+      const auto cellNormals = CalculateCellNormals(mesh, threads);
 
+      size_t c = 0;
       for (auto it = mesh->GetCells()->Begin();
            it != mesh->GetCells()->End();
-           ++it) {
+           ++it, ++c) {
 
         const auto cell = it.Value();
 
@@ -34,9 +41,14 @@ class MeshToKdTree {
 
         pointset->SetPoint( it.Index(), centroid );
 
+        typename TPointSet::PointType normal;
+        for (unsigned int d = 0; d < Dimension; ++d) normal[d] = cellNormals[3 * c + d];
+        normals->InsertElement( it.Index(), normal );
+
       }
 
       locator->SetPoints( pointset->GetPoints() );
+      locator->SetNormals( normals );
       locator->Initialize();
 
     }
@@ -0,0 +1,27 @@
+#ifndef sissr_MeshToTriangleBVH_h
+#define sissr_MeshToTriangleBVH_h
+
+// SiSSR
+#include <sissrTriangleBVH.h>
+
+namespace sissr {
+
+template<typename TMesh>
+class MeshToTriangleBVH {
+  public:
+
+    using TLocator = TriangleBVH<TMesh>;
+
+    void Calculate(TMesh* mesh, TLocator* locator, const unsigned int &threads = 1) {
+
+      locator->SetMesh( mesh );
+      locator->SetNumberOfThreads( threads );
+      locator->Initialize();
+
+    }
+
+};
+
+}
+
+#endif
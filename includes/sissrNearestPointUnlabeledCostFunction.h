@@ -13,30 +13,20 @@ namespace sissr {
   public:
 
   using Superclass = CostFunctionBase<TFixedMesh, TMovingMesh>;
-  using typename Superclass::TLocatorPointer;
   using typename Superclass::TMovingMeshPointer;
-  using typename Superclass::TMovingContainerPointer;
-  using typename Superclass::TLocator;
-  using typename Superclass::TFixedPoint;
-  using typename Superclass::TMovingPoint;
-  using typename Superclass::TMovingLabel;
+  using typename Superclass::TCorrespondenceEngine;
 
   NearestPointUnlabeledCostFunction(
-    const TLocatorPointer &_locator,
     const TMovingMeshPointer &_moving,
-    const TMovingContainerPointer &_initialPoints,
-    unsigned int _index) :
-    locator(_locator),
-    Superclass(_moving, _initialPoints, _index)
-  {}
-
-  private:
-
-  const TLocatorPointer &locator;
-  TFixedPoint GetClosestPoint(const TMovingPoint &point, const TMovingLabel &label) const {
-    const auto fixedPointID = this->locator->FindClosestPoint(point);
-    const auto fixedPoint = this->locator->GetPoints()->ElementAt(fixedPointID);
-    return fixedPoint;
+    const TCorrespondenceEngine &_correspondences,
+    unsigned int _frame,
+    unsigned int _index,
+    unsigned int _count = 1,
+    double _tangentialWeight = 1.0) :
+    Superclass(_moving, _correspondences, _frame, _index, _count, _tangentialWeight)
+  {
+    itkAssertOrThrowMacro(!_correspondences.GetUseLabels(),
+                          "The correspondence engine must use unlabeled locators.");
   }
 
 };
@@ -2,6 +2,7 @@
 #define sissr_Parameters_h
 
 // STD
+#include <string>
 #include <vector>
 #include <map>
 
@@ -32,6 +33,18 @@ public:
 
 
   bool RegistrationUseLabels = true;
+  bool RegistrationUseTriangles = true; // Closest points on candidate triangles, not cell midpoints
+  bool RegistrationUseDistanceTransform = false; // Closest points from a grid around the triangles
+  double DistanceTransformSpacing = 1.0;
+  double DistanceTransformBandWidth = 4.0;
+  unsigned int CorrespondenceUpdateInterval = 0; // 0: every evaluation; k: every k accepted iterations
+  double ApproximateEpsilon = 0.0; // > 0: approximate closest points until the cost levels off
+  double ApproximateSwitchTolerance = 1e-3;
+  unsigned int PyramidLevels = 0; // > 0: match against decimated candidates first, coarsest first
+  double PyramidSpacing = 0.0; // Finest decimated level's grid; 0: twice the mean candidate edge length
+  double PyramidSwitchTolerance = 1e-3;
+  bool RegistrationUsePointToPlane = false; // Primary residuals along the candidate normals
+  bool RegistrationUseSymmetricResidual = false; // With point-to-plane: along candidate and model normals
   LossScaleFactors RegistrationWeights;
   unsigned int RegistrationSamplingDensity = 2;
 
@@ -41,6 +54,22 @@ public:
   double FunctionTolerance = 1e-6;
   double ParameterTolerance = 1e-8;
   bool DynamicSparsity = false;
+  std::string LinearSolverType = "SPARSE_NORMAL_CHOLESKY"; // A Ceres linear solver name, or AUTO to probe
+  std::string PreconditionerType = "JACOBI";
+  std::string SparseLinearAlgebraLibrary = ""; // A Ceres name; empty: Ceres' default
+  std::string LinearSolverOrdering = "AMD"; // AMD or NESDIS
+  bool UseMixedPrecisionSolves = false;
+  int MaxNumRefinementIterations = 0;
+  unsigned int LinearSolverProbeIterations = 3;
+  unsigned int NumberOfThreads = 0; // 0: use the CPU quota
+  bool BatchPrimaryResiduals = false;
+  bool CollapseLinearRegularizers = true; // One residual block per point or cell for all linear terms
+  bool UseAlternatingSolver = false; // Closest point searches alternated with cached factorization solves
+  bool UseMatrixFreeSolver = false; // Gauss-Newton with conjugate gradients, without a Jacobian
+  unsigned int MatrixFreeLinearIterations = 100;
+  double MatrixFreeLinearTolerance = 1e-3;
+  bool CacheEliminationOrdering = true; // Save fill reducing orderings, and reuse them for the same block structure
+  std::string OrderingCacheDirectory = ""; // Empty: the serialization directory
 
   unsigned int CurrentFrame = 0;
 
@@ -2,23 +2,39 @@
 #define sissr_RegisterMeshToPointSet_h
 
 // STD
+#include <map>
+#include <memory>
+#include <string>
 #include <vector>
 
+// Ceres
+#include <ceres/ceres.h>
+
 // ITK
 #include <itkMesh.h>
 #include <itkLoopSubdivisionSurfaceMesh.h>
-#include <itkPointsLocator.h>
-
 
 // SiSSR
 #include <sissrAccelerationRegularizer.h>
+#include <sissrAlternatingSolver.h>
+#include <sissrCandidateToModelCostFunction.h>
+#include <sissrClosestPointTransform.h>
+#include <sissrControlPointBuffer.h>
+#include <sissrCorrespondenceEngine.h>
+#include <sissrCorrespondenceIterationCallback.h>
 #include <sissrEdgeLengthRegularizer.h>
+#include <sissrFlatKdTree.h>
+#include <sissrLimitSurfaceProjector.h>
+#include <sissrLinearRegularizer.h>
+#include <sissrMatrixFreeSolver.h>
 #include <sissrVelocityRegularizer.h>
 #include <sissrTriangleAspectRatioRegularizer.h>
 #include <sissrThinPlateRegularizer.h>
+#include <sissrTriangleBVH.h>
 #include <sissrLossScaleFactors.h>
 #include <sissrNearestPointLabeledCostFunction.h>
 #include <sissrNearestPointUnlabeledCostFunction.h>
+#include <sissrRelativeCostChangeCallback.h>
 
 namespace sissr {
 
@@ -33,7 +49,34 @@ public:
   double FunctionTolerance = 1e-6; // Default is 1e-6
   double ParameterTolerance = 1e-8; // Default is 1e-8
   bool DynamicSparsity = false;
+  ceres::LinearSolverType LinearSolver = ceres::SPARSE_NORMAL_CHOLESKY;
+  ceres::PreconditionerType Preconditioner = ceres::JACOBI; // Iterative solvers only
+  ceres::SparseLinearAlgebraLibraryType SparseLibrary = ceres::Solver::Options().sparse_linear_algebra_library_type;
+  ceres::LinearSolverOrderingType LinearSolverOrdering = ceres::AMD; // Fill reducing ordering for sparse factorizations
+  bool UseMixedPrecisionSolves = false; // Factorize in single precision, refine in double
+  int MaxNumRefinementIterations = 0; // Iterative refinement steps after each factorization solve
+  bool AutoLinearSolver = false; // Probe the candidate configurations on the problem and keep the fastest
+  unsigned int LinearSolverProbeIterations = 3; // Iterations per probed configuration
+  unsigned int NumberOfThreads = 0; // 0: use the CPU quota
+  bool BatchPrimaryResiduals = false; // One primary residual block per cell
+  bool CollapseLinearRegularizers = true; // false: one residual block per term and point, edge or cell
+  bool UseAlternatingSolver = false; // Alternate closest point searches and solves with one cached factorization
+  std::string OrderingCacheDirectory = ""; // Non-empty: save fill reducing orderings there, and reuse them
+  bool UseMatrixFreeSolver = false; // Gauss-Newton with conjugate gradients, without a Jacobian or factorization
+  unsigned int MatrixFreeLinearIterations = 100; // Conjugate gradient iterations per Gauss-Newton step
+  double MatrixFreeLinearTolerance = 1e-3; // Relative residual at which the conjugate gradients stop
   const bool UseLabels;
+  const bool UseTriangles; // Closest points on candidate triangles rather than on cell midpoints
+  bool UseDistanceTransform = false; // Look closest points up in a grid built from the triangles
+  double DistanceTransformSpacing = 1.0; // Grid spacing, in mesh units
+  double DistanceTransformBandWidth = 4.0; // Distance from the candidates covered by the grid
+  unsigned int CorrespondenceUpdateInterval = 0; // 0: every evaluation; k: every k accepted iterations
+  double ApproximateEpsilon = 0.0; // > 0: solve with (1 + epsilon)-approximate closest points first
+  double ApproximateSwitchTolerance = 1e-3; // Relative cost change below which to switch to exact ones
+  unsigned int PyramidLevels = 0; // > 0: match against this many decimated candidate levels first, coarsest first
+  double PyramidSpacing = 0.0; // Clustering grid of the finest decimated level, doubled per level; 0: twice the mean candidate edge length
+  double PyramidSwitchTolerance = 1e-3; // Relative cost change below which to move to the next finer level
+  PrimaryResidualType PrimaryResidual = PrimaryResidualType::PointToPoint; // Offsets along the candidate normals only are weighted in full
 
   LossScaleFactors RegistrationWeights;
 
@@ -41,13 +84,33 @@ public:
   using TMoving = TMovingMesh;
 
   using TContainer = typename TFixedMesh::PointsContainer;
-  using TLocator = itk::PointsLocator<TContainer>;
+  using TLocator = FlatKdTree<TContainer>;
   using TLocatorVector = std::vector<typename TLocator::Pointer>;
   using TLocatorMapVector = std::vector<std::map<size_t, typename TLocator::Pointer>>;
+  using TTriangleLocator = TriangleBVH<TFixedMesh>;
+  using TTriangleLocatorVector = std::vector<typename TTriangleLocator::Pointer>;
+  using TTriangleLocatorMapVector = std::vector<std::map<size_t, typename TTriangleLocator::Pointer>>;
+  using TTransform = ClosestPointTransform<TFixedMesh>;
+  using TTransformVector = std::vector<typename TTransform::Pointer>;
+  using TTransformMapVector = std::vector<std::map<size_t, typename TTransform::Pointer>>;
 
   using TFixedVector = std::vector<typename TFixed::Pointer>;
   using TMovingVector = std::vector<typename TMoving::Pointer>;
 
+  // Locators for one resolution of the candidates, of the kind selected by
+  // UseLabels and UseTriangles
+  struct CandidateLevel
+  {
+    double Spacing = 0.0; // 0: full resolution
+    size_t NumberOfCells = 0;
+    TLocatorVector locatorVector;
+    TLocatorMapVector locatorMapVector;
+    TTriangleLocatorVector triangleLocatorVector;
+    TTriangleLocatorMapVector triangleLocatorMapVector;
+  };
+
+  using TCorrespondenceEngine = CorrespondenceEngine<TFixed, TMoving>;
+  using TCorrespondenceIterationCallback = CorrespondenceIterationCallback<TCorrespondenceEngine>;
   using TLabeledPrimaryResidual = NearestPointLabeledCostFunction<TFixed, TMoving>;
   using TUnlabeledPrimaryResidual = NearestPointUnlabeledCostFunction<TFixed, TMoving>;
   using TVelocityRegularizer = VelocityRegularizer<TMoving>;
@@ -55,41 +118,64 @@ public:
   using TThinPlateRegularizer = ThinPlateRegularizer<TMoving>;
   using TTriangleAspectRatioRegularizer = TriangleAspectRatioRegularizer<TMoving>;
   using TEdgeLengthRegularizer = EdgeLengthRegularizer<TMoving>;
+  using TProjector = LimitSurfaceProjector<TMoving>;
+  using TProjectorVector = std::vector<std::unique_ptr<TProjector>>;
+  using TCandidateToModelResidual = CandidateToModelCostFunction<TMoving>;
+  using TLinearOperator = LinearRegularizerOperator<TMoving>;
+  using TLinearRegularizer = LinearRegularizer<TMoving>;
   using TParameterVector = std::vector<std::vector<double*>>;
 
   RegisterMeshToPointSet(const TFixedVector &_fixedVector,
                          const TMovingVector &_movingVector,
-                         const bool &_UseLabels);
+                         const bool &_UseLabels,
+                         const bool &_UseTriangles);
 
   TLocatorVector locatorVector;
   TLocatorMapVector locatorMapVector;
+  TTriangleLocatorVector triangleLocatorVector;
+  TTriangleLocatorMapVector triangleLocatorMapVector;
+  TTransformVector transformVector;
+  TTransformMapVector transformMapVector;
+  const TFixedVector fixedVector;
   const TMovingVector movingVector;
 
   void SanityCheck();
+  void InitializeLocators(unsigned int threads);
 
   unsigned int CalculateNumberOfFrames() const;
   unsigned int CalculateNumberOfControlPoints() const;
   unsigned int CalculateNumberOfSurfacePoints() const;
   unsigned int CalculateNumberOfCells() const;
+  unsigned int CalculateSamplesPerPrimaryResidual() const;
 
   const unsigned int NumberOfFrames;
   const unsigned int NumberOfControlPoints;
   const unsigned int NumberOfSurfacePoints;
   const unsigned int NumberOfCells;
 
+  CandidateLevel CalculateCandidateLevel(const TFixedVector &fixed, unsigned int threads) const;
+  std::vector<CandidateLevel> CalculateCandidatePyramid(unsigned int threads) const;
+  void SetCandidateLevel(TCorrespondenceEngine&, const CandidateLevel&) const;
+  void InitializeDistanceTransforms(unsigned int threads);
+  double ProbeLinearSolver(ceres::Problem&, ceres::Solver::Options&, std::vector<double>&, TCorrespondenceEngine&) const;
   void Register();
-  void AddLabeledPrimaryResidual(ceres::Problem&, TParameterVector&);
-  void AddUnlabeledPrimaryResidual(ceres::Problem&, TParameterVector&);
-  void AddVelocityRegularizer(ceres::Problem&, TParameterVector&);
-  void AddAccelerationRegularizer(ceres::Problem&, TParameterVector&);
-  void AddThinPlateRegularizer(ceres::Problem&, TParameterVector&);
-  void AddTriangleAspectRatioRegularizer(ceres::Problem&, TParameterVector&);
-  void AddEdgeLengthRegularizer(ceres::Problem&, TParameterVector&);
+  void AddLabeledPrimaryResidual(ceres::Problem&, TParameterVector&, const TCorrespondenceEngine&);
+  void AddUnlabeledPrimaryResidual(ceres::Problem&, TParameterVector&, const TCorrespondenceEngine&);
+  void AddVelocityRegularizer(ceres::Problem&, TParameterVector&, const ControlPointBuffer&);
+  void AddAccelerationRegularizer(ceres::Problem&, TParameterVector&, const ControlPointBuffer&);
+  void AddThinPlateRegularizer(ceres::Problem&, TParameterVector&, const ControlPointBuffer&);
+  void AddTriangleAspectRatioRegularizer(ceres::Problem&, TParameterVector&, const ControlPointBuffer&);
+  void AddEdgeLengthRegularizer(ceres::Problem&, TParameterVector&, const ControlPointBuffer&);
+  void AddLinearRegularizers(ceres::Problem&, TParameterVector&, const ControlPointBuffer&, TLinearOperator&);
+  void AddCandidateToModelResidual(ceres::Problem&, TParameterVector&, ControlPointBuffer&, TProjectorVector&, unsigned int);
+  size_t UpdateCandidateToModelResidual(ceres::Problem&, TParameterVector&, TProjectorVector&);
 
   std::vector<double>                 costFunctionResiduals;
   std::vector<ceres::ResidualBlockId> costFunctionResidualIDs;
   std::vector<unsigned int>           costFunctionCellIDs;
   std::vector<unsigned int>           costFunctionFrames;
+  ceres::LossFunction* candidateLoss = nullptr; // Owned by the problem
+  std::vector<std::vector<ceres::ResidualBlockId>> candidateResidualIDs; // Per projector and candidate
   std::string summaryString;
 
   std::vector<typename TMoving::PointsContainer::Pointer> initialPointsVector;
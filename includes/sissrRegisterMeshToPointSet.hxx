@@ -4,6 +4,11 @@
 #include <sissrRegisterMeshToPointSet.h>
 
 // STD
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <memory>
+#include <set>
 #include <thread>
 
 // Ceres
@@ -11,11 +16,16 @@
 #include <glog/logging.h>
 
 // SiSSR
+#include <sissrDecimateMesh.h>
+#include <sissrEliminationOrdering.h>
 #include <sissrLabeledMeshToKdTreeMap.h>
+#include <sissrLabeledMeshToTriangleBVHMap.h>
 #include <sissrMeshToKdTree.h>
+#include <sissrMeshToTriangleBVH.h>
 
 // dv-cli
 #include <sissrCalculateBorderCells.h>
+#include <sissrUtils.h>
 
 namespace sissr {
 
@@ -23,33 +33,18 @@ template < typename TFixedMesh, typename TMovingMesh >
 RegisterMeshToPointSet< TFixedMesh, TMovingMesh >
 ::RegisterMeshToPointSet(const TFixedVector &_fixedVector,
                          const TMovingVector &_movingVector,
-                         const bool &_UseLabels) :
+                         const bool &_UseLabels,
+                         const bool &_UseTriangles) :
+  fixedVector(_fixedVector),
   movingVector(_movingVector),
   UseLabels(_UseLabels),
+  UseTriangles(_UseTriangles),
   NumberOfFrames(this->CalculateNumberOfFrames()),
   NumberOfControlPoints(this->CalculateNumberOfControlPoints()),
   NumberOfSurfacePoints(this->CalculateNumberOfSurfacePoints()),
   NumberOfCells(this->CalculateNumberOfCells())
 {
-  if (this->UseLabels) {
-   using TMeshToKdMap = sissr::LabeledMeshToKdTreeMap<TFixedMesh>;
-
-    for (const auto& fixed : _fixedVector) {
-      TMeshToKdMap mesh_to_kd_map;
-      const auto locator_map = mesh_to_kd_map.Calculate(fixed);
-      this->locatorMapVector.emplace_back(locator_map);
-    }
-  } else {
-    using TMeshToKd = sissr::MeshToKdTree<TFixedMesh>;
-
-    for (const auto& fixed : _fixedVector) {
-      TMeshToKd mesh_to_kd;
-      typename TMeshToKd::TLocator::Pointer locator = TMeshToKd::TLocator::New();
-      mesh_to_kd.Calculate(fixed, locator);
-      this->locatorVector.emplace_back(locator);
-    }
-  }
-
+  // The candidates are indexed in Register(), with NumberOfThreads.
   this->SanityCheck();
 }
 
@@ -60,16 +55,20 @@ RegisterMeshToPointSet< TFixedMesh, TMovingMesh >
 {
 
   //
-  // The parameters are all the control points over all the frames
+  // The parameters are all the control points over all the frames.
+  // They are stored contiguously, [frame][point][xyz].
   //
 
+  std::vector<double> parameterStorage(
+    size_t(3) * this->NumberOfFrames * this->NumberOfControlPoints, 0.0);
+
   TParameterVector parameterVector(this->NumberOfFrames);
   for (unsigned int f = 0; f < this->NumberOfFrames; ++f)
     {
     std::vector<double*> parameters(this->NumberOfControlPoints);
     for (unsigned int i = 0; i < this->NumberOfControlPoints; ++i)
       {
-      parameters[i] = new double[3] {0.0, 0.0, 0.0};
+      parameters[i] = parameterStorage.data() + 3 * (size_t(f) * this->NumberOfControlPoints + i);
       }
     parameterVector[f] = parameters;
     }
@@ -81,6 +80,9 @@ RegisterMeshToPointSet< TFixedMesh, TMovingMesh >
 
   std::cout << "Copying initial points...";
 
+  std::vector<double> initialPositions;
+  initialPositions.reserve(parameterStorage.size());
+
   for (auto moving : movingVector)
     {
 
@@ -93,16 +95,97 @@ RegisterMeshToPointSet< TFixedMesh, TMovingMesh >
       initialPoints->InsertElement(it.Index(),it.Value());
       }
 
+    for (unsigned int i = 0; i < this->NumberOfControlPoints; ++i)
+      {
+      const auto point = initialPoints->GetElement(i);
+      for (unsigned int d = 0; d < 3; ++d)
+        {
+        initialPositions.push_back(point[d]);
+        }
+      }
+
     this->initialPointsVector.emplace_back(initialPoints);
     
     }
   std::cout << "done." << std::endl;
 
+  //
+  // Deformed control point positions are updated once per evaluation
+  // point by the buffer, which all cost functions read from.
+  //
+
+  ControlPointBuffer buffer(std::move(initialPositions),
+                            parameterStorage.data(),
+                            this->NumberOfFrames,
+                            this->NumberOfControlPoints);
+
+  // Residual blocks never write to the moving meshes,
+  // so they may be evaluated in parallel.
+  const int threads = (this->NumberOfThreads > 0)
+                    ? this->NumberOfThreads
+                    : sissr::CalculateCPUQuota();
+  std::cout << "Threads: " << threads << std::endl;
+
+  this->InitializeLocators(threads);
+
+  if (this->UseDistanceTransform) {
+    this->InitializeDistanceTransforms(threads);
+  }
+
+  //
+  // Surface points and their closest candidates are found for all samples
+  // at once, whenever the buffer is updated.
+  //
+
+  TCorrespondenceEngine correspondences(this->movingVector, buffer, threads);
+  const auto useFullResolution = [this, &correspondences]() {
+    if (this->UseLabels && this->UseDistanceTransform) {
+      correspondences.SetLocators(this->transformMapVector);
+    } else if (this->UseDistanceTransform) {
+      correspondences.SetLocators(this->transformVector);
+    } else if (this->UseLabels && this->UseTriangles) {
+      correspondences.SetLocators(this->triangleLocatorMapVector);
+    } else if (this->UseLabels) {
+      correspondences.SetLocators(this->locatorMapVector);
+    } else if (this->UseTriangles) {
+      correspondences.SetLocators(this->triangleLocatorVector);
+    } else {
+      correspondences.SetLocators(this->locatorVector);
+    }
+  };
+  useFullResolution();
+
+  // Decimated candidates, coarsest first, to be matched against before the
+  // full resolution ones
+  std::vector<CandidateLevel> pyramid;
+  if (this->PyramidLevels > 0) {
+    std::cout << "Building candidate pyramid..." << std::flush;
+    pyramid = this->CalculateCandidatePyramid(threads);
+    std::cout << "done." << std::endl;
+    size_t cells = 0;
+    for (const auto& fixed : this->fixedVector) cells += fixed->GetNumberOfCells();
+    for (const auto& level : pyramid) {
+      std::cout << "Candidate level (spacing " << level.Spacing << "): " << level.NumberOfCells
+                << " cells, " << 100.0 * level.NumberOfCells / std::max<size_t>(1, cells) << "% of full resolution" << std::endl;
+    }
+    if (!pyramid.empty()) this->SetCandidateLevel(correspondences, pyramid.front());
+  }
+  correspondences.SetUpdateInterval(this->CorrespondenceUpdateInterval);
+  itkAssertOrThrowMacro(PrimaryResidualType::PointToPoint == this->PrimaryResidual || !this->UseDistanceTransform,
+                        "Point-to-plane residuals need triangle or point candidates, not distance transforms.");
+  correspondences.SetPrimaryResidualType(this->PrimaryResidual);
+  correspondences.Update();
+  buffer.AddUpdateCallback([&correspondences]() { correspondences.Update(); });
+
   //
   // Create the problem
   //
 
-  ceres::Problem problem;
+  ceres::Problem::Options problemOptions;
+  problemOptions.evaluation_callback = &buffer;
+  // Candidate residual blocks are built again as their patches change.
+  problemOptions.enable_fast_removal = (this->RegistrationWeights.Candidate > 1e-6);
+  ceres::Problem problem(problemOptions);
 
   //
   // Minimize distance between surface points and boundary candidates
@@ -110,50 +193,317 @@ RegisterMeshToPointSet< TFixedMesh, TMovingMesh >
 
   if (this->RegistrationWeights.Primary > 1e-6) {
     if (this->UseLabels) {
-      this->AddLabeledPrimaryResidual(problem, parameterVector);
+      this->AddLabeledPrimaryResidual(problem, parameterVector, correspondences);
     } else {
-      this->AddUnlabeledPrimaryResidual(problem, parameterVector);
+      this->AddUnlabeledPrimaryResidual(problem, parameterVector, correspondences);
     }
   }
-  if ((this->RegistrationWeights.Velocity > 1e-6) && (this->NumberOfFrames > 1)) {
-    this->AddVelocityRegularizer(problem, parameterVector);
-  }
-  if ((this->RegistrationWeights.Acceleration) > 1e-6 && (this->NumberOfFrames > 2)) {
-    this->AddAccelerationRegularizer(problem, parameterVector);
-  }
-  if (this->RegistrationWeights.ThinPlate > 1e-6) {
-    this->AddThinPlateRegularizer(problem, parameterVector);
+  // The matrix-free solver applies the regularizers itself, so they are
+  // only added for Ceres; the primary blocks are kept for the residuals
+  // evaluated after the solve.
+  itkAssertOrThrowMacro(!(this->UseAlternatingSolver && this->UseMatrixFreeSolver),
+                        "The alternating and matrix-free solvers cannot be used together.");
+  std::string matrixFreeFallback;
+  if (this->RegistrationWeights.TriangleAspectRatio > 1e-6) matrixFreeFallback = "the triangle aspect ratio term";
+  else if (this->RegistrationWeights.Candidate > 1e-6) matrixFreeFallback = "the candidate to model term";
+  const bool matrixFree = this->UseMatrixFreeSolver && matrixFreeFallback.empty();
+
+  // Kept for the solves; its blocks are read by the residual blocks.
+  TLinearOperator linearOperator(this->movingVector);
+  if (!matrixFree && this->CollapseLinearRegularizers) {
+    this->AddLinearRegularizers(problem, parameterVector, buffer, linearOperator);
+  } else if (!matrixFree) {
+    if ((this->RegistrationWeights.Velocity > 1e-6) && (this->NumberOfFrames > 1)) {
+      this->AddVelocityRegularizer(problem, parameterVector, buffer);
+    }
+    if ((this->RegistrationWeights.Acceleration) > 1e-6 && (this->NumberOfFrames > 2)) {
+      this->AddAccelerationRegularizer(problem, parameterVector, buffer);
+    }
+    if (this->RegistrationWeights.ThinPlate > 1e-6) {
+      this->AddThinPlateRegularizer(problem, parameterVector, buffer);
+    }
+    if (this->RegistrationWeights.EdgeLength > 1e-6) {
+      this->AddEdgeLengthRegularizer(problem, parameterVector, buffer);
+    }
   }
   if (this->RegistrationWeights.TriangleAspectRatio > 1e-6) {
-    this->AddTriangleAspectRatioRegularizer(problem, parameterVector);
+    this->AddTriangleAspectRatioRegularizer(problem, parameterVector, buffer);
   }
-  if (this->RegistrationWeights.EdgeLength > 1e-6) {
-    this->AddEdgeLengthRegularizer(problem, parameterVector);
+  // Kept for the solves; they read the buffer and are refined by it.
+  TProjectorVector projectors;
+  size_t candidateResiduals = 0;
+  if (this->RegistrationWeights.Candidate > 1e-6) {
+    this->AddCandidateToModelResidual(problem, parameterVector, buffer, projectors, threads);
+    for (const auto &projector : projectors) candidateResiduals += projector->GetNumberOfCandidates();
   }
 
   ///////////
   // Solve //
   ///////////
 
-  // Processors * Cores * Threads
-  const auto threads = std::thread::hardware_concurrency();
-  std::cout << "Threads: " << threads << std::endl;
-
   ceres::Solver::Options solverOptions;
   solverOptions.minimizer_progress_to_stdout = true;
   solverOptions.max_num_iterations = this->MaximumNumberOfIterations;
   solverOptions.function_tolerance = this->FunctionTolerance;
   solverOptions.parameter_tolerance = this->ParameterTolerance;
   solverOptions.max_solver_time_in_seconds = MaximumSolverTimeInSeconds;
-//  solverOptions.num_threads = threads * 4;
-  solverOptions.linear_solver_type = ceres::SPARSE_NORMAL_CHOLESKY;
-//  solverOptions.dynamic_sparsity = this->DynamicSparsity;
+  solverOptions.num_threads = threads;
+  solverOptions.linear_solver_type = this->LinearSolver;
+  solverOptions.preconditioner_type = this->Preconditioner;
+  solverOptions.sparse_linear_algebra_library_type = this->SparseLibrary;
+  solverOptions.linear_solver_ordering_type = this->LinearSolverOrdering;
+  solverOptions.use_mixed_precision_solves = this->UseMixedPrecisionSolves;
+  solverOptions.max_num_refinement_iterations = this->MaxNumRefinementIterations;
+  solverOptions.dynamic_sparsity = this->DynamicSparsity;
   solverOptions.minimizer_type = ceres::TRUST_REGION;
+
+  // The parameter blocks in the problem, in storage order
+  std::vector<double*> parameterBlocks;
+  for (const auto &parameters : parameterVector) {
+    for (const auto block : parameters) {
+      if (problem.HasParameterBlock(block)) parameterBlocks.push_back(block);
+    }
+  }
+
+  // With fixed correspondences, only the aspect ratio and candidate terms
+  // and point-to-plane residuals are not linear; otherwise each solve below
+  // alternates closest point searches with back-substitutions.
+  std::unique_ptr<AlternatingSolver> alternatingSolver;
+  if (this->UseAlternatingSolver) {
+    std::string reason;
+    if (this->RegistrationWeights.TriangleAspectRatio > 1e-6) reason = "the triangle aspect ratio term";
+    else if (this->RegistrationWeights.Candidate > 1e-6) reason = "the candidate to model term";
+    else if (PrimaryResidualType::PointToPoint != this->PrimaryResidual) reason = "point-to-plane residuals";
+    if (reason.empty()) {
+      // Correspondences are then only searched when invalidated, and their
+      // residual Jacobians (which move with the surface point) are not used.
+      correspondences.SetUpdateInterval(1);
+      alternatingSolver = std::make_unique<AlternatingSolver>(
+        problem, parameterBlocks, [&correspondences]() { correspondences.Invalidate(); });
+      std::cout << "Solver: alternating closest points and cached CHOLMOD factorization" << std::endl;
+    } else {
+      std::cout << "Solver: Ceres, since " << reason << " is not linear" << std::endl;
+    }
+  }
+  // Matrix-free: Gauss-Newton steps by preconditioned conjugate gradients,
+  // with the products by J^T J applied from the meshes and correspondences
+  std::unique_ptr<MatrixFreeSolver<TFixedMesh, TMovingMesh>> matrixFreeSolver;
+  if (matrixFree) {
+    correspondences.SetUpdateInterval(1);
+    matrixFreeSolver = std::make_unique<MatrixFreeSolver<TFixedMesh, TMovingMesh>>(
+      this->movingVector, buffer, correspondences, parameterStorage.data(), this->RegistrationWeights,
+      this->UseLabels ? sissr::CalculateBorderCells<TMovingMesh>(this->movingVector.at(0)) : std::set<unsigned int>(),
+      threads);
+    matrixFreeSolver->MaximumNumberOfLinearIterations = this->MatrixFreeLinearIterations;
+    matrixFreeSolver->LinearSolverTolerance = this->MatrixFreeLinearTolerance;
+    std::cout << "Solver: matrix-free Gauss-Newton, block Jacobi preconditioned conjugate gradients" << std::endl;
+  } else if (this->UseMatrixFreeSolver) {
+    std::cout << "Solver: Ceres, since the matrix-free solver does not support " << matrixFreeFallback << std::endl;
+  }
+  // Each solve starts from the candidates' closest patches; during a solve,
+  // they are only followed within their patches.
+  size_t candidateRebuilds = 0;
+  const auto solve = [this, &problem, &parameterVector, &projectors, &candidateRebuilds,
+                      &alternatingSolver, &matrixFreeSolver](const ceres::Solver::Options &options,
+                                                             ceres::Solver::Summary *summary) {
+    if (!projectors.empty()) {
+      candidateRebuilds += this->UpdateCandidateToModelResidual(problem, parameterVector, projectors);
+    }
+    if (alternatingSolver) {
+      alternatingSolver->Solve(options, summary);
+    } else if (matrixFreeSolver) {
+      matrixFreeSolver->Solve(options, summary);
+    } else {
+      ceres::Solve(options, &problem, summary);
+    }
+  };
+
+  double probeTime = 0.0;
+  if (this->AutoLinearSolver && !alternatingSolver && !matrixFreeSolver) {
+    probeTime = this->ProbeLinearSolver(problem, solverOptions, parameterStorage, correspondences);
+  }
+
+  // The fill reducing ordering depends only on the block structure of the
+  // problem, so it is read from OrderingCacheDirectory if it was computed
+  // there for the same structure before, and saved there otherwise.  Ceres
+  // follows an ordering of many groups only with SuiteSparse and AMD.
+  std::string orderingSource = "none";
+  double orderingTime = 0.0;
+  const bool sparseCholesky = alternatingSolver
+                           || (!matrixFreeSolver
+                               && ceres::SPARSE_NORMAL_CHOLESKY == solverOptions.linear_solver_type
+                               && ceres::SUITE_SPARSE == solverOptions.sparse_linear_algebra_library_type
+                               && ceres::AMD == solverOptions.linear_solver_ordering_type);
+  if (!this->OrderingCacheDirectory.empty() && sparseCholesky && !parameterBlocks.empty()) {
+    const auto orderingStart = std::chrono::steady_clock::now();
+    const auto structure = sissr::CalculateBlockStructure(problem, parameterBlocks);
+    const std::string method = ceres::LinearSolverOrderingTypeToString(solverOptions.linear_solver_ordering_type);
+    const std::string file = sissr::ensureTrailingSlash(this->OrderingCacheDirectory) + "elimination-ordering-"
+                           + sissr::HashBlockStructure(structure, parameterBlocks.size(), method) + ".txt";
+    std::vector<int> ordering;
+    if (sissr::ReadEliminationOrdering(file, parameterBlocks.size(), ordering)) {
+      orderingSource = "cached";
+    } else {
+      ordering = sissr::CalculateEliminationOrdering(structure, parameterBlocks.size(),
+                                                     solverOptions.linear_solver_ordering_type);
+      sissr::WriteEliminationOrdering(file, ordering);
+      orderingSource = "computed";
+    }
+    if (alternatingSolver) {
+      alternatingSolver->SetOrdering(std::move(ordering));
+    } else {
+      // One group per block: Ceres eliminates them in this order.
+      auto groups = std::make_shared<ceres::ParameterBlockOrdering>();
+      for (size_t k = 0; k < ordering.size(); ++k) groups->AddElementToGroup(parameterBlocks[ordering[k]], int(k));
+      solverOptions.linear_solver_ordering = groups;
+    }
+    orderingTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - orderingStart).count();
+    std::cout << "Elimination ordering: " << orderingSource << " (" << file << ") in " << orderingTime << " s" << std::endl;
+  }
+  std::string optionsError;
+  itkAssertOrThrowMacro(solverOptions.IsValid(&optionsError), "Invalid solver options: " + optionsError);
+  std::unique_ptr<TCorrespondenceIterationCallback> correspondenceCallback;
+  if (this->CorrespondenceUpdateInterval > 0 && !alternatingSolver && !matrixFreeSolver) {
+    correspondenceCallback = std::make_unique<TCorrespondenceIterationCallback>(
+      correspondences, this->CorrespondenceUpdateInterval);
+    solverOptions.callbacks.push_back(correspondenceCallback.get());
+  }
+
+  // Against each decimated level in turn, until the cost levels off or the
+  // level's share of the iterations (together, half of them) is used up
+  std::vector<ceres::Solver::Summary> pyramidSummaries;
+  for (size_t l = 0; l < pyramid.size(); ++l) {
+    if (l > 0) this->SetCandidateLevel(correspondences, pyramid[l]);
+
+    ceres::Solver::Options levelOptions = solverOptions;
+    levelOptions.max_num_iterations = std::max(1, this->MaximumNumberOfIterations / int(2 * pyramid.size()));
+    RelativeCostChangeCallback switchCallback(this->PyramidSwitchTolerance);
+    levelOptions.callbacks.push_back(&switchCallback);
+
+    pyramidSummaries.emplace_back();
+    auto &levelSummary = pyramidSummaries.back();
+    solve(levelOptions, &levelSummary);
+    std::cout << levelSummary.BriefReport() << std::endl;
+    std::cout << "Candidate level (spacing " << pyramid[l].Spacing << "): "
+              << levelSummary.iterations.size() - 1 << " iterations, cost "
+              << levelSummary.initial_cost << " -> " << levelSummary.final_cost << std::endl;
+
+    const int used = static_cast<int>(levelSummary.iterations.size()) - 1;
+    solverOptions.max_num_iterations = std::max(1, solverOptions.max_num_iterations - used);
+    solverOptions.max_solver_time_in_seconds =
+      std::max(0.0, solverOptions.max_solver_time_in_seconds - levelSummary.total_time_in_seconds);
+  }
+  if (!pyramid.empty()) useFullResolution();
+  const double pyramidTime = correspondences.GetUpdateTimeInSeconds();
+  const size_t pyramidUpdates = correspondences.GetNumberOfCorrespondenceUpdates();
+
+  // With approximate closest points, until the cost levels off or only the
+  // iterations reserved for the exact polish are left.
+  const bool approximate = (this->ApproximateEpsilon > 0.0);
+  ceres::Solver::Summary approximateSummary;
+  double approximateTime = 0.0;
+  size_t approximateUpdates = 0;
+  if (approximate) {
+    const int iterations = solverOptions.max_num_iterations;
+    const int exactIterations = std::max(1, iterations / 10);
+    ceres::Solver::Options approximateOptions = solverOptions;
+    approximateOptions.max_num_iterations = std::max(0, iterations - exactIterations);
+    RelativeCostChangeCallback switchCallback(this->ApproximateSwitchTolerance);
+    approximateOptions.callbacks.push_back(&switchCallback);
+
+    correspondences.SetApproximation(this->ApproximateEpsilon);
+    solve(approximateOptions, &approximateSummary);
+    std::cout << approximateSummary.FullReport() << std::endl;
+
+    approximateTime = correspondences.GetUpdateTimeInSeconds() - pyramidTime;
+    approximateUpdates = correspondences.GetNumberOfCorrespondenceUpdates() - pyramidUpdates;
+
+    // The exact solve's first evaluation finds exact correspondences.
+    correspondences.SetApproximation(0.0);
+    correspondences.Invalidate();
+
+    const int used = static_cast<int>(approximateSummary.iterations.size()) - 1;
+    solverOptions.max_num_iterations = std::max(exactIterations, iterations - used);
+    solverOptions.max_solver_time_in_seconds =
+      std::max(0.0, solverOptions.max_solver_time_in_seconds - approximateSummary.total_time_in_seconds);
+  }
+
   ceres::Solver::Summary summary;
-  ceres::Solve(solverOptions, &problem, &summary);
+  solve(solverOptions, &summary);
+
+  std::cout << "Primary residual blocks: " << this->costFunctionResidualIDs.size()
+            << (this->BatchPrimaryResiduals ? " (one per cell)" : " (one per sample)")
+            << std::endl;
 
   std::cout << summary.FullReport() << std::endl;
 
+  if (alternatingSolver) {
+    std::cout << "Alternating solver: factorized "
+              << (alternatingSolver->GetKronecker() ? "one scalar system for x, y and z" : "the full system")
+              << " in " << alternatingSolver->GetFactorizationTimeInSeconds() << " s ("
+              << alternatingSolver->GetAnalysisTimeInSeconds() << " s ordering and analysis), "
+              << alternatingSolver->GetNumberOfFactorNonZeros() << " factor nonzeros" << std::endl;
+  }
+
+  if (matrixFreeSolver) {
+    std::cout << "Matrix-free solver: " << matrixFreeSolver->GetNumberOfLinearIterations()
+              << " conjugate gradient iterations, "
+              << matrixFreeSolver->CalculateMemoryEstimate() / (1024.0 * 1024.0) << " MiB of vectors and tables" << std::endl;
+  }
+  const double peakMemory = sissr::CalculatePeakResidentSetSizeInMiB();
+  std::cout << "Peak resident set size: " << peakMemory << " MiB" << std::endl;
+
+  // Estimated from the mean correspondence time per update of each phase
+  double approximateTimeSaved = 0.0, approximateCostDifference = 0.0;
+  if (approximate) {
+    const size_t exactUpdates = correspondences.GetNumberOfCorrespondenceUpdates() - pyramidUpdates - approximateUpdates;
+    const double exactTime = correspondences.GetUpdateTimeInSeconds() - pyramidTime - approximateTime;
+    if (exactUpdates > 0 && approximateUpdates > 0) {
+      approximateTimeSaved = approximateUpdates * (exactTime / exactUpdates - approximateTime / approximateUpdates);
+    }
+    approximateCostDifference = approximateSummary.final_cost - summary.initial_cost;
+    std::cout << "Approximate closest points (epsilon " << this->ApproximateEpsilon << "): "
+              << approximateSummary.iterations.size() - 1 << " iterations, "
+              << approximateTimeSaved << " s saved; cost at the switch "
+              << approximateSummary.final_cost << " approximate, "
+              << summary.initial_cost << " exact" << std::endl;
+  }
+
+  // The summary below covers all phases.
+  const auto prepend = [&summary](const ceres::Solver::Summary &earlier) {
+    summary.preprocessor_time_in_seconds += earlier.preprocessor_time_in_seconds;
+    summary.minimizer_time_in_seconds += earlier.minimizer_time_in_seconds;
+    summary.postprocessor_time_in_seconds += earlier.postprocessor_time_in_seconds;
+    summary.total_time_in_seconds += earlier.total_time_in_seconds;
+    summary.linear_solver_time_in_seconds += earlier.linear_solver_time_in_seconds;
+    summary.residual_evaluation_time_in_seconds += earlier.residual_evaluation_time_in_seconds;
+    summary.jacobian_evaluation_time_in_seconds += earlier.jacobian_evaluation_time_in_seconds;
+    summary.inner_iteration_time_in_seconds += earlier.inner_iteration_time_in_seconds;
+    auto iterations = earlier.iterations;
+    const double elapsed = iterations.empty() ? 0.0 : iterations.back().cumulative_time_in_seconds;
+    for (auto it : summary.iterations) {
+      if (0 == it.iteration) continue; // Same point as the earlier phase's last
+      it.iteration += static_cast<int>(iterations.size()) - 1;
+      it.cumulative_time_in_seconds += elapsed;
+      iterations.push_back(it);
+    }
+    summary.iterations = iterations;
+  };
+  if (approximate) prepend(approximateSummary);
+  size_t pyramidIterations = 0;
+  for (auto it = pyramidSummaries.rbegin(); it != pyramidSummaries.rend(); ++it) {
+    prepend(*it);
+    pyramidIterations += it->iterations.size() - 1;
+  }
+
+  const size_t searched = correspondences.GetNumberOfQueries();
+  const size_t cached = correspondences.GetNumberOfCacheHits();
+  std::cout << "Correspondences: " << correspondences.GetNumberOfCorrespondenceUpdates() << " updates"
+            << " (" << correspondences.GetNumberOfReuses() << " evaluations reused them), "
+            << searched << " searches, " << cached << " cache hits ("
+            << 100.0 * cached / std::max<size_t>(1, searched + cached) << "%), "
+            << summary.iterations.size() << " iterations" << std::endl;
+
   //
   // Serialize summary
   //
@@ -166,6 +516,47 @@ RegisterMeshToPointSet< TFixedMesh, TMovingMesh >
   this->summaryString += "# residual_evaluation_time_in_seconds: " + std::to_string(summary.residual_evaluation_time_in_seconds) + '\n';
   this->summaryString += "# jacobian_evaluation_time_in_seconds: " + std::to_string(summary.jacobian_evaluation_time_in_seconds) + '\n';
   this->summaryString += "# inner_iteration_time_in_seconds: "     + std::to_string(summary.inner_iteration_time_in_seconds)     + '\n';
+  this->summaryString += "# linear_solver_type: "                  + std::string(ceres::LinearSolverTypeToString(solverOptions.linear_solver_type)) + '\n';
+  this->summaryString += "# preconditioner_type: "                 + std::string(ceres::PreconditionerTypeToString(solverOptions.preconditioner_type)) + '\n';
+  this->summaryString += "# sparse_linear_algebra_library: "       + std::string(ceres::SparseLinearAlgebraLibraryTypeToString(solverOptions.sparse_linear_algebra_library_type)) + '\n';
+  this->summaryString += "# use_mixed_precision_solves: "          + std::to_string(solverOptions.use_mixed_precision_solves)    + '\n';
+  this->summaryString += "# elimination_ordering: "                + orderingSource                                              + '\n';
+  this->summaryString += "# elimination_ordering_time_in_seconds: " + std::to_string(orderingTime)                               + '\n';
+  this->summaryString += "# linear_solver_probe_time_in_seconds: " + std::to_string(probeTime)                                   + '\n';
+  this->summaryString += "# alternating_solver: "                  + std::to_string(bool(alternatingSolver))                     + '\n';
+  this->summaryString += "# alternating_factorization_time_in_seconds: " + std::to_string(alternatingSolver ? alternatingSolver->GetFactorizationTimeInSeconds() : 0.0) + '\n';
+  this->summaryString += "# alternating_analysis_time_in_seconds: " + std::to_string(alternatingSolver ? alternatingSolver->GetAnalysisTimeInSeconds() : 0.0) + '\n';
+  this->summaryString += "# alternating_kronecker: "               + std::to_string(alternatingSolver && alternatingSolver->GetKronecker()) + '\n';
+  this->summaryString += "# alternating_factor_nonzeros: "         + std::to_string(alternatingSolver ? alternatingSolver->GetNumberOfFactorNonZeros() : 0) + '\n';
+  this->summaryString += "# matrix_free_solver: "                  + std::to_string(bool(matrixFreeSolver))                      + '\n';
+  this->summaryString += "# matrix_free_linear_iterations: "       + std::to_string(matrixFreeSolver ? matrixFreeSolver->GetNumberOfLinearIterations() : 0) + '\n';
+  this->summaryString += "# matrix_free_memory_in_mib: "           + std::to_string(matrixFreeSolver ? matrixFreeSolver->CalculateMemoryEstimate() / (1024.0 * 1024.0) : 0.0) + '\n';
+  this->summaryString += "# peak_rss_in_mib: "                     + std::to_string(peakMemory)                                  + '\n';
+  this->summaryString += "# use_triangles: "                       + std::to_string(this->UseTriangles)                          + '\n';
+  this->summaryString += "# use_distance_transform: "              + std::to_string(this->UseDistanceTransform)                  + '\n';
+  this->summaryString += "# primary_residual_type: "               + std::to_string(static_cast<int>(this->PrimaryResidual))      + '\n';
+  this->summaryString += "# batch_primary_residuals: "             + std::to_string(this->BatchPrimaryResiduals)                  + '\n';
+  this->summaryString += "# num_primary_residual_blocks: "         + std::to_string(this->costFunctionResidualIDs.size())        + '\n';
+  this->summaryString += "# collapse_linear_regularizers: "        + std::to_string(this->CollapseLinearRegularizers)            + '\n';
+  this->summaryString += "# num_linear_regularizer_blocks: "       + std::to_string(linearOperator.GetNumberOfBlocks())          + '\n';
+  this->summaryString += "# num_candidate_residuals: "             + std::to_string(candidateResiduals)                          + '\n';
+  this->summaryString += "# num_candidate_rebuilds: "              + std::to_string(candidateRebuilds)                           + '\n';
+  this->summaryString += "# num_residual_blocks: "                 + std::to_string(summary.num_residual_blocks)                 + '\n';
+  this->summaryString += "# num_residuals: "                       + std::to_string(summary.num_residuals)                       + '\n';
+  this->summaryString += "# control_point_buffer_updates: "        + std::to_string(buffer.GetNumberOfUpdates())                 + '\n';
+  this->summaryString += "# correspondence_updates: "              + std::to_string(correspondences.GetNumberOfUpdates())        + '\n';
+  this->summaryString += "# correspondence_time_in_seconds: "      + std::to_string(correspondences.GetUpdateTimeInSeconds())    + '\n';
+  this->summaryString += "# correspondence_update_interval: "      + std::to_string(this->CorrespondenceUpdateInterval)          + '\n';
+  this->summaryString += "# correspondence_searches: "             + std::to_string(searched)                                    + '\n';
+  this->summaryString += "# correspondence_cache_hits: "           + std::to_string(cached)                                      + '\n';
+  this->summaryString += "# correspondence_reuses: "               + std::to_string(correspondences.GetNumberOfReuses())         + '\n';
+  this->summaryString += "# num_iterations: "                      + std::to_string(summary.iterations.size())                   + '\n';
+  this->summaryString += "# pyramid_levels: "                      + std::to_string(pyramid.size())                              + '\n';
+  this->summaryString += "# pyramid_iterations: "                  + std::to_string(pyramidIterations)                           + '\n';
+  this->summaryString += "# approximate_epsilon: "                 + std::to_string(this->ApproximateEpsilon)                    + '\n';
+  this->summaryString += "# approximate_iterations: "              + std::to_string(approximate ? approximateSummary.iterations.size() - 1 : 0) + '\n';
+  this->summaryString += "# approximate_time_saved_in_seconds: "   + std::to_string(approximateTimeSaved)                        + '\n';
+  this->summaryString += "# approximate_cost_difference: "         + std::to_string(approximateCostDifference)                   + '\n';
   
   this->summaryString += "Iteration,Cost,CostChange,IterTime,TotalTime,Success\n";
   for (const auto it : summary.iterations)
@@ -178,10 +569,30 @@ RegisterMeshToPointSet< TFixedMesh, TMovingMesh >
     summaryString += std::to_string(it.step_is_successful) + '\n';
     }
 
+  //
+  // Write the solution back into the moving meshes
+  //
+
+  for (unsigned int f = 0; f < this->NumberOfFrames; ++f)
+    {
+    const auto &initialPoints = this->initialPointsVector.at(f);
+    for (unsigned int i = 0; i < this->NumberOfControlPoints; ++i)
+      {
+      auto point = initialPoints->GetElement(i);
+      for (unsigned int d = 0; d < 3; ++d)
+        {
+        point[d] += parameterVector[f][i][d];
+        }
+      this->movingVector.at(f)->SetPoint(i, point);
+      }
+    }
+
   //
   // Evaluate residuals to identify cells which are too coarse
   //
 
+  correspondences.Invalidate();
+  buffer.Update();
   ceres::Problem::EvaluateOptions residualOptions;
   residualOptions.residual_blocks = this->costFunctionResidualIDs;
   double totalCost = 0.0;
@@ -189,31 +600,283 @@ RegisterMeshToPointSet< TFixedMesh, TMovingMesh >
                    &totalCost,
                    &(this->costFunctionResiduals), nullptr, nullptr);
 
-  //
-  // Cleanup
-  //
+}
 
-  for (auto v : parameterVector)
-    {
-    for (auto p : v)
-      {
-      delete[] p;
+template < typename TFixedMesh, typename TMovingMesh >
+typename RegisterMeshToPointSet< TFixedMesh, TMovingMesh >::CandidateLevel
+RegisterMeshToPointSet< TFixedMesh, TMovingMesh >
+::CalculateCandidateLevel(const TFixedVector &fixed, unsigned int threads) const
+{
+  CandidateLevel level;
+  for (const auto& mesh : fixed) level.NumberOfCells += mesh->GetNumberOfCells();
+
+  if (this->UseLabels && this->UseTriangles) {
+    using TMeshToBVHMap = sissr::LabeledMeshToTriangleBVHMap<TFixedMesh>;
+
+    for (const auto& mesh : fixed) {
+      TMeshToBVHMap mesh_to_bvh_map;
+      level.triangleLocatorMapVector.emplace_back(mesh_to_bvh_map.Calculate(mesh, threads));
+    }
+  } else if (this->UseLabels) {
+   using TMeshToKdMap = sissr::LabeledMeshToKdTreeMap<TFixedMesh>;
+
+    for (const auto& mesh : fixed) {
+      TMeshToKdMap mesh_to_kd_map;
+      const auto locator_map = mesh_to_kd_map.Calculate(mesh, threads);
+      level.locatorMapVector.emplace_back(locator_map);
+    }
+  } else if (this->UseTriangles) {
+    using TMeshToBVH = sissr::MeshToTriangleBVH<TFixedMesh>;
+
+    for (const auto& mesh : fixed) {
+      TMeshToBVH mesh_to_bvh;
+      const auto locator = TTriangleLocator::New();
+      mesh_to_bvh.Calculate(mesh, locator, threads);
+      level.triangleLocatorVector.emplace_back(locator);
+    }
+  } else {
+    using TMeshToKd = sissr::MeshToKdTree<TFixedMesh>;
+
+    for (const auto& mesh : fixed) {
+      TMeshToKd mesh_to_kd;
+      typename TMeshToKd::TLocator::Pointer locator = TMeshToKd::TLocator::New();
+      mesh_to_kd.Calculate(mesh, locator, threads);
+      level.locatorVector.emplace_back(locator);
+    }
+  }
+
+  return level;
+}
+
+template < typename TFixedMesh, typename TMovingMesh >
+std::vector<typename RegisterMeshToPointSet< TFixedMesh, TMovingMesh >::CandidateLevel>
+RegisterMeshToPointSet< TFixedMesh, TMovingMesh >
+::CalculateCandidatePyramid(unsigned int threads) const
+{
+  double spacing = this->PyramidSpacing;
+  if (spacing <= 0.0) {
+    double length = 0.0;
+    for (const auto& fixed : this->fixedVector) length += CalculateMeanEdgeLength<TFixedMesh>(fixed);
+    spacing = 2.0 * length / this->fixedVector.size();
+  }
+  itkAssertOrThrowMacro(spacing > 0.0, "The candidate pyramid spacing must be positive.");
+
+  // Labels (or, without labels, frames) with candidates
+  const auto countGroups = [this](const TFixedVector &meshes) {
+    size_t groups = 0;
+    for (const auto& mesh : meshes) {
+      std::set<size_t> labels;
+      for (auto it = mesh->GetCells()->Begin(); it != mesh->GetCells()->End(); ++it) {
+        labels.insert(this->UseLabels ? size_t(mesh->GetCellData()->ElementAt(it.Index())) : 0);
       }
+      groups += labels.size();
     }
+    return groups;
+  };
+  const size_t groups = countGroups(this->fixedVector);
+
+  // Finest first; each level is decimated from the one below it.  Levels
+  // so coarse that all of a label's cells collapse are left out.
+  std::vector<CandidateLevel> pyramid;
+  TFixedVector meshes = this->fixedVector;
+  for (unsigned int l = 0; l < this->PyramidLevels; ++l, spacing *= 2.0) {
+    for (auto& mesh : meshes) mesh = DecimateMesh<TFixedMesh>(mesh, spacing);
+    if (countGroups(meshes) < groups) break;
+    pyramid.emplace_back(this->CalculateCandidateLevel(meshes, threads));
+    pyramid.back().Spacing = spacing;
+  }
 
+  // Coarsest first, in the order they are solved
+  std::reverse(pyramid.begin(), pyramid.end());
+  return pyramid;
 }
 
 template < typename TFixedMesh, typename TMovingMesh >
 void
 RegisterMeshToPointSet< TFixedMesh, TMovingMesh >
-::SanityCheck()
+::SetCandidateLevel(TCorrespondenceEngine& correspondences, const CandidateLevel& level) const
 {
-  itkAssertOrThrowMacro(this->movingVector.size() > 0, "");
+  if (this->UseLabels && this->UseTriangles) {
+    correspondences.SetLocators(level.triangleLocatorMapVector);
+  } else if (this->UseLabels) {
+    correspondences.SetLocators(level.locatorMapVector);
+  } else if (this->UseTriangles) {
+    correspondences.SetLocators(level.triangleLocatorVector);
+  } else {
+    correspondences.SetLocators(level.locatorVector);
+  }
+}
+
+template < typename TFixedMesh, typename TMovingMesh >
+double
+RegisterMeshToPointSet< TFixedMesh, TMovingMesh >
+::ProbeLinearSolver(ceres::Problem& problem,
+                    ceres::Solver::Options& options,
+                    std::vector<double>& parameterStorage,
+                    TCorrespondenceEngine& correspondences) const
+{
+  const auto start = std::chrono::steady_clock::now();
+
+  // Sparse Cholesky with each available library, in double and, where the
+  // library supports it, mixed precision; conjugate gradients on the normal
+  // equations; and, for small problems, dense Cholesky.
+  std::vector<ceres::Solver::Options> candidates;
+  for (const auto library : {ceres::SUITE_SPARSE, ceres::EIGEN_SPARSE, ceres::ACCELERATE_SPARSE}) {
+    if (!ceres::IsSparseLinearAlgebraLibraryTypeAvailable(library)) continue;
+    ceres::Solver::Options candidate = options;
+    candidate.linear_solver_type = ceres::SPARSE_NORMAL_CHOLESKY;
+    candidate.sparse_linear_algebra_library_type = library;
+    candidate.use_mixed_precision_solves = false;
+    candidates.push_back(candidate);
+    if (ceres::SUITE_SPARSE != library) {
+      candidate.use_mixed_precision_solves = true;
+      candidate.max_num_refinement_iterations = std::max(3, options.max_num_refinement_iterations);
+      candidates.push_back(candidate);
+    }
+  }
+  {
+    ceres::Solver::Options candidate = options;
+    candidate.linear_solver_type = ceres::CGNR;
+    candidate.preconditioner_type = ceres::JACOBI;
+    candidate.use_mixed_precision_solves = false;
+    candidates.push_back(candidate);
+  }
+  if (problem.NumParameters() <= 3000) {
+    ceres::Solver::Options candidate = options;
+    candidate.linear_solver_type = ceres::DENSE_NORMAL_CHOLESKY;
+    candidate.use_mixed_precision_solves = false;
+    candidates.push_back(candidate);
+  }
+
+  // Each from the same starting point, with the same correspondences
+  const std::vector<double> initial = parameterStorage;
+  double bestTime = std::numeric_limits<double>::max();
+  const ceres::Solver::Options* best = nullptr;
+  std::cout << "Probing linear solvers (" << this->LinearSolverProbeIterations << " iterations each):" << std::endl;
+  for (auto &candidate : candidates) {
+    std::string error;
+    candidate.max_num_iterations = this->LinearSolverProbeIterations;
+    candidate.minimizer_progress_to_stdout = false;
+    candidate.callbacks.clear();
+    if (!candidate.IsValid(&error)) continue;
+
+    std::copy(initial.begin(), initial.end(), parameterStorage.begin());
+    correspondences.Invalidate();
+    ceres::Solver::Summary summary;
+    ceres::Solve(candidate, &problem, &summary);
+
+    const bool usable = summary.IsSolutionUsable() && ceres::FAILURE != summary.termination_type;
+    std::cout << "  " << ceres::LinearSolverTypeToString(candidate.linear_solver_type)
+              << (ceres::CGNR == candidate.linear_solver_type
+                    ? std::string(", ") + ceres::PreconditionerTypeToString(candidate.preconditioner_type) : "")
+              << (ceres::SPARSE_NORMAL_CHOLESKY == candidate.linear_solver_type
+                    ? std::string(", ") + ceres::SparseLinearAlgebraLibraryTypeToString(candidate.sparse_linear_algebra_library_type) : "")
+              << (candidate.use_mixed_precision_solves ? ", mixed precision" : "")
+              << ": " << summary.total_time_in_seconds << " s, cost " << summary.final_cost
+              << (usable ? "" : " (failed)") << std::endl;
+    if (usable && summary.total_time_in_seconds < bestTime) {
+      bestTime = summary.total_time_in_seconds;
+      best = &candidate;
+    }
+  }
+
+  std::copy(initial.begin(), initial.end(), parameterStorage.begin());
+  correspondences.Invalidate();
+
+  // Otherwise the configured solver is kept.
+  if (nullptr != best) {
+    options.linear_solver_type = best->linear_solver_type;
+    options.preconditioner_type = best->preconditioner_type;
+    options.sparse_linear_algebra_library_type = best->sparse_linear_algebra_library_type;
+    options.use_mixed_precision_solves = best->use_mixed_precision_solves;
+    options.max_num_refinement_iterations = best->max_num_refinement_iterations;
+  }
+
+  const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+  return elapsed.count();
+}
+
+template < typename TFixedMesh, typename TMovingMesh >
+void
+RegisterMeshToPointSet< TFixedMesh, TMovingMesh >
+::InitializeDistanceTransforms(unsigned int threads)
+{
+  itkAssertOrThrowMacro(this->UseTriangles, "The distance transform is built from candidate triangles.");
+
+  const auto create = [this, threads](const typename TTriangleLocator::Pointer &triangles) {
+    const auto transform = TTransform::New();
+    transform->SetTriangles(triangles);
+    transform->SetSpacing(this->DistanceTransformSpacing);
+    transform->SetBandWidth(this->DistanceTransformBandWidth);
+    transform->SetNumberOfThreads(threads);
+    return transform;
+  };
+
+  this->transformVector.clear();
+  this->transformMapVector.clear();
+  std::vector<TTransform*> transforms;
   if (this->UseLabels) {
+    for (const auto &triangleMap : this->triangleLocatorMapVector) {
+      std::map<size_t, typename TTransform::Pointer> transformMap;
+      for (const auto &triangles : triangleMap) {
+        transformMap[triangles.first] = create(triangles.second);
+        transforms.push_back(transformMap[triangles.first]);
+      }
+      this->transformMapVector.emplace_back(transformMap);
+    }
+  } else {
+    for (const auto &triangles : this->triangleLocatorVector) {
+      this->transformVector.emplace_back(create(triangles));
+      transforms.push_back(this->transformVector.back());
+    }
+  }
+
+  size_t bytes = 0;
+  for (const auto &transform : transforms) bytes += transform->CalculateMemoryEstimate();
+  std::cout << "Distance transforms: " << transforms.size()
+            << " grids, spacing " << this->DistanceTransformSpacing
+            << ", band " << this->DistanceTransformBandWidth
+            << ", about " << bytes / (1024.0 * 1024.0) << " MiB..." << std::flush;
+
+  for (const auto &transform : transforms) transform->Initialize();
+  std::cout << "done." << std::endl;
+}
+
+// The full resolution candidates' locators, built once
+template < typename TFixedMesh, typename TMovingMesh >
+void
+RegisterMeshToPointSet< TFixedMesh, TMovingMesh >
+::InitializeLocators(unsigned int threads)
+{
+  if (this->locatorVector.empty() && this->locatorMapVector.empty()
+      && this->triangleLocatorVector.empty() && this->triangleLocatorMapVector.empty()) {
+    std::cout << "Indexing candidates..." << std::flush;
+    CandidateLevel level = this->CalculateCandidateLevel(this->fixedVector, threads);
+    this->locatorVector = std::move(level.locatorVector);
+    this->locatorMapVector = std::move(level.locatorMapVector);
+    this->triangleLocatorVector = std::move(level.triangleLocatorVector);
+    this->triangleLocatorMapVector = std::move(level.triangleLocatorMapVector);
+    std::cout << "done." << std::endl;
+  }
+
+  if (this->UseLabels && this->UseTriangles) {
+    itkAssertOrThrowMacro(this->triangleLocatorMapVector.size() == this->movingVector.size(), "");
+  } else if (this->UseLabels) {
     itkAssertOrThrowMacro(this->locatorMapVector.size() == this->movingVector.size(), "");
+  } else if (this->UseTriangles) {
+    itkAssertOrThrowMacro(this->triangleLocatorVector.size() == this->movingVector.size(), "");
   } else {
     itkAssertOrThrowMacro(this->locatorVector.size() == this->movingVector.size(), "");
   }
+}
+
+template < typename TFixedMesh, typename TMovingMesh >
+void
+RegisterMeshToPointSet< TFixedMesh, TMovingMesh >
+::SanityCheck()
+{
+  itkAssertOrThrowMacro(this->movingVector.size() > 0, "");
+  itkAssertOrThrowMacro(this->fixedVector.size() == this->movingVector.size(), "");
 
   for (const auto& moving : movingVector) {
     for (auto it = moving->GetCellData()->Begin(); it != moving->GetCellData()->End(); ++it) {
@@ -266,10 +929,23 @@ RegisterMeshToPointSet< TFixedMesh, TMovingMesh >
   return n;
 }
 
+template < typename TFixedMesh, typename TMovingMesh >
+unsigned int
+RegisterMeshToPointSet< TFixedMesh, TMovingMesh >
+::CalculateSamplesPerPrimaryResidual() const
+{
+  if (!this->BatchPrimaryResiduals) return 1;
+  const unsigned int n = this->movingVector.front()->GetNumberOfSamplesPerCell();
+  for (const auto v : this->movingVector)
+    itkAssertOrThrowMacro(n == v->GetNumberOfSamplesPerCell(),
+      "Mismatch in number of samples per cell.");
+  return n;
+}
+
 template < typename TFixedMesh, typename TMovingMesh >
 void
 RegisterMeshToPointSet< TFixedMesh, TMovingMesh >
-::AddLabeledPrimaryResidual(ceres::Problem& problem, TParameterVector& parameterVector)
+::AddLabeledPrimaryResidual(ceres::Problem& problem, TParameterVector& parameterVector, const TCorrespondenceEngine& correspondences)
 {
 
   std::cout << "Adding labeled primary residual to problem..." << std::endl;
@@ -289,25 +965,29 @@ RegisterMeshToPointSet< TFixedMesh, TMovingMesh >
 
   const auto border_cells = sissr::CalculateBorderCells<TMovingMesh>(this->movingVector.at(0));
 
+  const unsigned int count = this->CalculateSamplesPerPrimaryResidual();
+
   for (unsigned int frame = 0; frame < this->NumberOfFrames; ++frame)
     {
 
     for (unsigned int index = 0;
          index < this->NumberOfSurfacePoints;
-         ++index)
+         index += count)
       {
 
       ceres::CostFunction* cost_function = new TLabeledPrimaryResidual(
-                                                     this->locatorMapVector.at(frame),
                                                      this->movingVector.at(frame),
-                                                     this->initialPointsVector.at(frame),
-                                                     index
+                                                     correspondences,
+                                                     frame,
+                                                     index,
+                                                     count,
+                                                     this->RegistrationWeights.Tangential
                                                     );
 
       std::vector<double*> params;
 
-      const auto u = this->movingVector.at(frame)->GetSurfaceParameterList().at(index);
-      const auto cellList = this->movingVector.at(frame)->GetPointListForCell(u.first);
+      const auto &u = this->movingVector.at(frame)->GetSurfaceParameter(index);
+      const auto &cellList = this->movingVector.at(frame)->GetPointListForCell(u.first);
       for (const auto &cell : cellList)
         {
         params.push_back(parameterVector.at(frame).at(cell));
@@ -329,9 +1009,9 @@ RegisterMeshToPointSet< TFixedMesh, TMovingMesh >
         costFunctionResidualIDs.emplace_back(id);
       }
 
-      costFunctionFrames.emplace_back(frame);
-      const auto cellID = std::get<0>(movingVector.at(frame)->GetSurfaceParameter(index));
-      costFunctionCellIDs.emplace_back(cellID);
+      // One entry per sample, to match the residuals.
+      costFunctionFrames.insert(costFunctionFrames.end(), count, frame);
+      costFunctionCellIDs.insert(costFunctionCellIDs.end(), count, u.first);
       }
 
 
@@ -342,7 +1022,7 @@ RegisterMeshToPointSet< TFixedMesh, TMovingMesh >
 template < typename TFixedMesh, typename TMovingMesh >
 void
 RegisterMeshToPointSet< TFixedMesh, TMovingMesh >
-::AddUnlabeledPrimaryResidual(ceres::Problem& problem, TParameterVector& parameterVector)
+::AddUnlabeledPrimaryResidual(ceres::Problem& problem, TParameterVector& parameterVector, const TCorrespondenceEngine& correspondences)
 {
 
   std::cout << "Adding unlabeled primary residual to problem..." << std::endl;
@@ -352,25 +1032,29 @@ RegisterMeshToPointSet< TFixedMesh, TMovingMesh >
                                          this->RegistrationWeights.Primary,
                                          ceres::DO_NOT_TAKE_OWNERSHIP);
 
+  const unsigned int count = this->CalculateSamplesPerPrimaryResidual();
+
   for (unsigned int frame = 0; frame < this->NumberOfFrames; ++frame)
     {
 
     for (unsigned int index = 0;
          index < this->NumberOfSurfacePoints;
-         ++index)
+         index += count)
       {
 
       ceres::CostFunction* cost_function = new TUnlabeledPrimaryResidual(
-         this->locatorVector.at(frame),
          this->movingVector.at(frame),
-         this->initialPointsVector.at(frame),
-         index
+         correspondences,
+         frame,
+         index,
+         count,
+         this->RegistrationWeights.Tangential
         );
 
       std::vector<double*> params;
 
-      const auto u = this->movingVector.at(frame)->GetSurfaceParameterList().at(index);
-      const auto cellList = this->movingVector.at(frame)->GetPointListForCell(u.first);
+      const auto &u = this->movingVector.at(frame)->GetSurfaceParameter(index);
+      const auto &cellList = this->movingVector.at(frame)->GetPointListForCell(u.first);
       for (const auto &cell : cellList)
         {
         params.push_back(parameterVector.at(frame).at(cell));
@@ -382,9 +1066,9 @@ RegisterMeshToPointSet< TFixedMesh, TMovingMesh >
                                               );
 
       costFunctionResidualIDs.emplace_back(id);
-      costFunctionFrames.emplace_back(frame);
-      const auto cellID = std::get<0>(movingVector.at(frame)->GetSurfaceParameter(index));
-      costFunctionCellIDs.emplace_back(cellID);
+      // One entry per sample, to match the residuals.
+      costFunctionFrames.insert(costFunctionFrames.end(), count, frame);
+      costFunctionCellIDs.insert(costFunctionCellIDs.end(), count, u.first);
       }
 
 
@@ -395,7 +1079,7 @@ RegisterMeshToPointSet< TFixedMesh, TMovingMesh >
 template < typename TFixedMesh, typename TMovingMesh >
 void
 RegisterMeshToPointSet< TFixedMesh, TMovingMesh >
-::AddVelocityRegularizer(ceres::Problem& problem, TParameterVector& parameterVector)
+::AddVelocityRegularizer(ceres::Problem& problem, TParameterVector& parameterVector, const ControlPointBuffer& buffer)
 {
 
   std::cout << "Adding velocity regularizer to problem..." << std::endl;
@@ -412,8 +1096,7 @@ RegisterMeshToPointSet< TFixedMesh, TMovingMesh >
       {
 
       ceres::CostFunction* cost_function = new TVelocityRegularizer(
-                                                  this->movingVector,
-                                                  this->initialPointsVector,
+                                                  buffer,
                                                   frame,
                                                   index
                                                   );
@@ -438,7 +1121,7 @@ RegisterMeshToPointSet< TFixedMesh, TMovingMesh >
 template < typename TFixedMesh, typename TMovingMesh >
 void
 RegisterMeshToPointSet< TFixedMesh, TMovingMesh >
-::AddAccelerationRegularizer(ceres::Problem& problem, TParameterVector& parameterVector)
+::AddAccelerationRegularizer(ceres::Problem& problem, TParameterVector& parameterVector, const ControlPointBuffer& buffer)
 {
 
   std::cout << "Adding acceleration regularizer to problem..." << std::endl;
@@ -455,8 +1138,7 @@ RegisterMeshToPointSet< TFixedMesh, TMovingMesh >
       {
 
       ceres::CostFunction* cost_function = new TAccelerationRegularizer(
-                                                 this->movingVector,
-                                                 this->initialPointsVector,
+                                                 buffer,
                                                  frame,
                                                  index
                                                  );
@@ -484,7 +1166,7 @@ RegisterMeshToPointSet< TFixedMesh, TMovingMesh >
 template < typename TFixedMesh, typename TMovingMesh >
 void
 RegisterMeshToPointSet< TFixedMesh, TMovingMesh >
-::AddThinPlateRegularizer(ceres::Problem& problem, TParameterVector& parameterVector)
+::AddThinPlateRegularizer(ceres::Problem& problem, TParameterVector& parameterVector, const ControlPointBuffer& buffer)
 {
 
   std::cout << "Adding thin plate regularizer to problem..." << std::endl;
@@ -502,7 +1184,8 @@ RegisterMeshToPointSet< TFixedMesh, TMovingMesh >
 
       ceres::CostFunction* cost_function
         = new TThinPlateRegularizer(this->movingVector.at(frame),
-                                    this->initialPointsVector.at(frame),
+                                    buffer,
+                                    frame,
                                     index);
   
       const auto cellList = this->movingVector.at(frame)->GetPointListForCell(index);
@@ -527,7 +1210,7 @@ RegisterMeshToPointSet< TFixedMesh, TMovingMesh >
 template < typename TFixedMesh, typename TMovingMesh >
 void
 RegisterMeshToPointSet< TFixedMesh, TMovingMesh >
-::AddTriangleAspectRatioRegularizer(ceres::Problem& problem, TParameterVector& parameterVector)
+::AddTriangleAspectRatioRegularizer(ceres::Problem& problem, TParameterVector& parameterVector, const ControlPointBuffer& buffer)
 {
 
   std::cout << "Adding triangle aspect ratio regularizer to problem..." << std::endl;
@@ -546,7 +1229,8 @@ RegisterMeshToPointSet< TFixedMesh, TMovingMesh >
   
       ceres::CostFunction* cost_function
         = new TTriangleAspectRatioRegularizer(this->movingVector.at(frame),
-                                              this->initialPointsVector.at(frame),
+                                              buffer,
+                                              frame,
                                               index);
 
       this->movingVector.at(frame)->GetCell( index, cell );
@@ -571,7 +1255,7 @@ RegisterMeshToPointSet< TFixedMesh, TMovingMesh >
 template < typename TFixedMesh, typename TMovingMesh >
 void
 RegisterMeshToPointSet< TFixedMesh, TMovingMesh >
-::AddEdgeLengthRegularizer(ceres::Problem& problem, TParameterVector& parameterVector)
+::AddEdgeLengthRegularizer(ceres::Problem& problem, TParameterVector& parameterVector, const ControlPointBuffer& buffer)
 {
 
   std::cout << "Adding edge length regularizer to problem..." << std::endl;
@@ -591,7 +1275,8 @@ RegisterMeshToPointSet< TFixedMesh, TMovingMesh >
   
       ceres::CostFunction* cost_function
         = new TEdgeLengthRegularizer(this->movingVector.at(frame),
-                                     this->initialPointsVector.at(frame),
+                                     buffer,
+                                     frame,
                                      i);
 
       std::vector<double*> params;
@@ -616,6 +1301,200 @@ RegisterMeshToPointSet< TFixedMesh, TMovingMesh >
 
   }
 
+template < typename TFixedMesh, typename TMovingMesh >
+void
+RegisterMeshToPointSet< TFixedMesh, TMovingMesh >
+::AddLinearRegularizers(ceres::Problem& problem,
+                        TParameterVector& parameterVector,
+                        const ControlPointBuffer& buffer,
+                        TLinearOperator& linearOperator)
+{
+
+  std::cout << "Adding linear regularizers to problem..." << std::flush;
+
+  // Replaced blocks, for the report
+  size_t separate = 0;
+  const size_t points = size_t(this->NumberOfFrames) * this->NumberOfControlPoints;
+  if ((this->RegistrationWeights.Velocity > 1e-6) && (this->NumberOfFrames > 1)) {
+    linearOperator.AddVelocity(this->RegistrationWeights.Velocity);
+    separate += points;
+  }
+  if ((this->RegistrationWeights.Acceleration) > 1e-6 && (this->NumberOfFrames > 2)) {
+    linearOperator.AddAcceleration(this->RegistrationWeights.Acceleration);
+    separate += points;
+  }
+  if (this->RegistrationWeights.ThinPlate > 1e-6) {
+    linearOperator.AddThinPlate(this->RegistrationWeights.ThinPlate);
+    separate += size_t(this->NumberOfFrames) * this->NumberOfCells;
+  }
+  if (this->RegistrationWeights.EdgeLength > 1e-6) {
+    linearOperator.AddEdgeLength(this->RegistrationWeights.EdgeLength);
+    for (const auto &moving : this->movingVector) separate += moving->GetNumberOfEdges();
+  }
+  linearOperator.Finalize();
+
+  for (size_t b = 0; b < linearOperator.GetNumberOfBlocks(); ++b)
+    {
+
+    ceres::CostFunction* cost_function = new TLinearRegularizer(linearOperator, buffer, b);
+
+    std::vector<double*> params;
+    for (const auto &u : linearOperator.GetBlock(b).columns)
+      {
+      params.push_back(parameterVector.at(u / this->NumberOfControlPoints).at(u % this->NumberOfControlPoints));
+      }
+
+    problem.AddResidualBlock(cost_function, nullptr, params);
+
+    }
+
+  std::cout << linearOperator.GetNumberOfRows() << " rows in "
+            << linearOperator.GetNumberOfBlocks() << " blocks, replacing "
+            << separate << "." << std::endl;
+
+}
+
+template < typename TFixedMesh, typename TMovingMesh >
+void
+RegisterMeshToPointSet< TFixedMesh, TMovingMesh >
+::AddCandidateToModelResidual(ceres::Problem& problem,
+                              TParameterVector& parameterVector,
+                              ControlPointBuffer& buffer,
+                              TProjectorVector& projectors,
+                              unsigned int threads)
+{
+
+  std::cout << "Adding candidate to model residual to problem..." << std::flush;
+
+
+  this->candidateLoss = new ceres::ScaledLoss(nullptr,
+                                              this->RegistrationWeights.Candidate,
+                                              ceres::DO_NOT_TAKE_OWNERSHIP);
+  this->candidateResidualIDs.clear();
+
+  for (unsigned int frame = 0; frame < this->NumberOfFrames; ++frame)
+    {
+
+    // Candidates are the fixed cells' centroids, grouped by label if the
+    // labels are used; 0 stands for all of them.
+    const auto &fixed = this->fixedVector.at(frame);
+    std::map<size_t, std::vector<double>> candidates;
+    for (auto it = fixed->GetCells()->Begin(); it != fixed->GetCells()->End(); ++it)
+      {
+      const size_t label = this->UseLabels ? size_t(fixed->GetCellData()->ElementAt(it.Index())) : 0;
+      auto &points = candidates[label];
+      const unsigned int n = it.Value()->GetNumberOfPoints();
+      double centroid[3] = {0.0, 0.0, 0.0};
+      for (auto id = it.Value()->PointIdsBegin(); id != it.Value()->PointIdsEnd(); ++id)
+        {
+        const auto point = fixed->GetPoint(*id);
+        for (unsigned int d = 0; d < 3; ++d) centroid[d] += point[d] / n;
+        }
+      points.insert(points.end(), centroid, centroid + 3);
+      }
+
+    // Each group projects onto the model cells with the same label.
+    const auto &moving = this->movingVector.at(frame);
+    std::map<size_t, std::vector<typename TMoving::CellIdentifier>> cells;
+    for (auto it = moving->GetCells()->Begin(); it != moving->GetCells()->End(); ++it)
+      {
+      const size_t label = this->UseLabels ? size_t(moving->GetCellData()->ElementAt(it.Index())) : 0;
+      cells[label].push_back(it.Index());
+      }
+
+    for (auto &group : candidates)
+      {
+      if (0 == cells.count(group.first)) continue;
+
+      projectors.emplace_back(std::make_unique<TProjector>(moving, buffer, frame, threads, cells[group.first]));
+      TProjector &projector = *projectors.back();
+      projector.SetCandidates(std::move(group.second));
+      projector.ProjectCandidates();
+      buffer.AddUpdateCallback([&projector]() { projector.Update(); });
+      this->candidateResidualIDs.emplace_back();
+
+      for (size_t j = 0; j < projector.GetNumberOfCandidates(); ++j)
+        {
+
+        ceres::CostFunction* cost_function = new TCandidateToModelResidual(projector, j);
+
+        const auto patch = projector.GetCandidateProjection(j).patch;
+        const auto L = projector.GetControlPoints(patch);
+        std::vector<double*> params;
+        for (unsigned int i = 0; i < projector.GetNumberOfControlPoints(patch); ++i)
+          {
+          params.push_back(parameterVector.at(frame).at(L[i]));
+          }
+
+        this->candidateResidualIDs.back().push_back(problem.AddResidualBlock(
+                                 cost_function,
+                                 this->candidateLoss,
+                                 params
+                                ));
+
+        }
+
+      }
+
+    }
+
+  size_t count = 0;
+  for (const auto &projector : projectors) count += projector->GetNumberOfCandidates();
+  std::cout << count << " candidates." << std::endl;
+
+}
+
+// Projects the candidates onto all patches again, and builds the residual
+// blocks of those whose closest points have moved onto another patch on the
+// new patch's control points.  Blocks which would add control points that
+// are not in the problem yet are kept, with their candidates projected back
+// onto the blocks' patches.  Returns the number of blocks built again.
+template < typename TFixedMesh, typename TMovingMesh >
+size_t
+RegisterMeshToPointSet< TFixedMesh, TMovingMesh >
+::UpdateCandidateToModelResidual(ceres::Problem& problem,
+                                 TParameterVector& parameterVector,
+                                 TProjectorVector& projectors)
+{
+
+  size_t rebuilt = 0;
+  for (size_t p = 0; p < projectors.size(); ++p)
+    {
+    TProjector &projector = *projectors[p];
+    projector.ProjectCandidates();
+    const auto &parameters = parameterVector.at(projector.GetFrame());
+    for (size_t j = 0; j < projector.GetNumberOfCandidates(); ++j)
+      {
+      auto &id = this->candidateResidualIDs[p][j];
+      const auto cost_function =
+        static_cast<const TCandidateToModelResidual*>(problem.GetCostFunctionForResidualBlock(id));
+      const auto patch = projector.GetCandidateProjection(j).patch;
+      if (patch == cost_function->GetPatch()) continue;
+
+      const auto L = projector.GetControlPoints(patch);
+      std::vector<double*> params;
+      for (unsigned int i = 0; i < projector.GetNumberOfControlPoints(patch); ++i)
+        {
+        params.push_back(parameters.at(L[i]));
+        }
+      if (!std::all_of(params.begin(), params.end(),
+                       [&problem](double* block) { return problem.HasParameterBlock(block); }))
+        {
+        projector.ProjectCandidate(j, cost_function->GetPatch());
+        continue;
+        }
+
+      // Added first, so that the problem never drops the shared loss
+      const auto old = id;
+      id = problem.AddResidualBlock(new TCandidateToModelResidual(projector, j), this->candidateLoss, params);
+      problem.RemoveResidualBlock(old);
+      ++rebuilt;
+      }
+    }
+  return rebuilt;
+
+}
+
 } // namespace sissr
 
 #endif
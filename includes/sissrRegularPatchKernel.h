@@ -0,0 +1,166 @@
+#ifndef sissr_RegularPatchKernel_h
+#define sissr_RegularPatchKernel_h
+
+// STD
+#include <cstddef>
+
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+#define SISSR_REGULAR_PATCH_SIMD
+#include <immintrin.h>
+#endif
+
+namespace sissr {
+
+/*
+ Batch evaluation of regular (valence 6) patches, which are plain box
+ splines with 12 control points.
+
+ The weights are transposed so that consecutive samples are contiguous:
+ WT[i * stride + m] is the weight of control point i for sample m.  Each
+ vector lane then evaluates one sample, and the 12 x 3 control point
+ coordinates are broadcast.  The widest instruction set supported by the
+ CPU is chosen once, at first use.
+
+ Results are written as xyz per sample: out[3 * m + d].
+ */
+class RegularPatchKernel
+{
+
+public:
+
+  static constexpr unsigned int K = 12;
+
+  enum class InstructionSet { Scalar, AVX2, AVX512 };
+
+  /* x: the patch's 12 control points, gathered as xyz. */
+  static void EvaluateGathered(const double* WT, size_t stride, size_t count,
+                               const double* x, double* out)
+    {
+    EvaluateGathered(GetInstructionSet(), WT, stride, count, x, out);
+    }
+
+  static void EvaluateGathered(InstructionSet set,
+                               const double* WT, size_t stride, size_t count,
+                               const double* x, double* out)
+    {
+    switch (set)
+      {
+#ifdef SISSR_REGULAR_PATCH_SIMD
+      case InstructionSet::AVX512: EvaluateAVX512(WT, stride, count, x, out); return;
+      case InstructionSet::AVX2:   EvaluateAVX2(WT, stride, count, x, out); return;
+#endif
+      default: EvaluateScalar(WT, stride, count, x, out); return;
+      }
+    }
+
+  /* X: contiguous xyz positions of all control points; L: the patch's 12 IDs. */
+  template<typename TIndex>
+  static void Evaluate(const double* WT, size_t stride, size_t count,
+                       const double* X, const TIndex* L, double* out)
+    {
+    double x[3 * K];
+    for (unsigned int i = 0; i < K; ++i)
+      for (unsigned int d = 0; d < 3; ++d)
+        x[3 * i + d] = X[3 * L[i] + d];
+    EvaluateGathered(WT, stride, count, x, out);
+    }
+
+  /* As above, for several patches sharing the same samples: 12 IDs and
+     3 * count outputs per patch. */
+  template<typename TIndex>
+  static void EvaluatePatches(const double* WT, size_t stride, size_t count,
+                              const double* X, const TIndex* L, size_t numberOfPatches,
+                              double* out)
+    {
+    for (size_t p = 0; p < numberOfPatches; ++p)
+      {
+      Evaluate(WT, stride, count, X, L + K * p, out + 3 * count * p);
+      }
+    }
+
+  static InstructionSet GetInstructionSet()
+    {
+    static const InstructionSet set = DetectInstructionSet();
+    return set;
+    }
+
+  static InstructionSet DetectInstructionSet()
+    {
+#ifdef SISSR_REGULAR_PATCH_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) return InstructionSet::AVX512;
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return InstructionSet::AVX2;
+#endif
+    return InstructionSet::Scalar;
+    }
+
+  static void EvaluateScalar(const double* WT, size_t stride, size_t count,
+                             const double* x, double* out)
+    {
+    for (size_t m = 0; m < count; ++m)
+      {
+      double acc[3] = {0.0, 0.0, 0.0};
+      for (unsigned int i = 0; i < K; ++i)
+        {
+        const double w = WT[i * stride + m];
+        for (unsigned int d = 0; d < 3; ++d) acc[d] += w * x[3 * i + d];
+        }
+      for (unsigned int d = 0; d < 3; ++d) out[3 * m + d] = acc[d];
+      }
+    }
+
+#ifdef SISSR_REGULAR_PATCH_SIMD
+
+  __attribute__((target("avx2,fma")))
+  static void EvaluateAVX2(const double* WT, size_t stride, size_t count,
+                           const double* x, double* out)
+    {
+    size_t m = 0;
+    for (; m + 4 <= count; m += 4)
+      {
+      __m256d acc[3] = {_mm256_setzero_pd(), _mm256_setzero_pd(), _mm256_setzero_pd()};
+      for (unsigned int i = 0; i < K; ++i)
+        {
+        const __m256d w = _mm256_loadu_pd(WT + i * stride + m);
+        for (unsigned int d = 0; d < 3; ++d)
+          acc[d] = _mm256_fmadd_pd(w, _mm256_set1_pd(x[3 * i + d]), acc[d]);
+        }
+      double lanes[3][4];
+      for (unsigned int d = 0; d < 3; ++d) _mm256_storeu_pd(lanes[d], acc[d]);
+      for (unsigned int j = 0; j < 4; ++j)
+        for (unsigned int d = 0; d < 3; ++d)
+          out[3 * (m + j) + d] = lanes[d][j];
+      }
+    EvaluateScalar(WT + m, stride, count - m, x, out + 3 * m);
+    }
+
+  __attribute__((target("avx512f")))
+  static void EvaluateAVX512(const double* WT, size_t stride, size_t count,
+                             const double* x, double* out)
+    {
+    size_t m = 0;
+    for (; m + 8 <= count; m += 8)
+      {
+      __m512d acc[3] = {_mm512_setzero_pd(), _mm512_setzero_pd(), _mm512_setzero_pd()};
+      for (unsigned int i = 0; i < K; ++i)
+        {
+        const __m512d w = _mm512_loadu_pd(WT + i * stride + m);
+        for (unsigned int d = 0; d < 3; ++d)
+          acc[d] = _mm512_fmadd_pd(w, _mm512_set1_pd(x[3 * i + d]), acc[d]);
+        }
+      double lanes[3][8];
+      for (unsigned int d = 0; d < 3; ++d) _mm512_storeu_pd(lanes[d], acc[d]);
+      for (unsigned int j = 0; j < 8; ++j)
+        for (unsigned int d = 0; d < 3; ++d)
+          out[3 * (m + j) + d] = lanes[d][j];
+      }
+    EvaluateAVX2(WT + m, stride, count - m, x, out + 3 * m);
+    }
+
+#endif
+
+};
+
+} // namespace sissr
+
+#endif
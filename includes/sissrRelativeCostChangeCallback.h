@@ -0,0 +1,47 @@
+#ifndef sissr_RelativeCostChangeCallback_h
+#define sissr_RelativeCostChangeCallback_h
+
+// Ceres
+#include <ceres/iteration_callback.h>
+
+// ITK
+#include <itkMacro.h>
+
+namespace sissr {
+
+/*
+ Ends a solve successfully once an accepted step lowers the cost by less than
+ `tolerance` times the cost before it.  Unlike Ceres' own function tolerance,
+ this leaves the problem's termination criteria to a later solve, e.g. the
+ exact polish after an approximate phase.
+ */
+class RelativeCostChangeCallback : public ceres::IterationCallback
+{
+
+public:
+
+  explicit RelativeCostChangeCallback(double _tolerance) :
+    tolerance(_tolerance)
+  {
+    itkAssertOrThrowMacro(this->tolerance >= 0.0, "The tolerance must not be negative.");
+  }
+
+  ceres::CallbackReturnType operator()(const ceres::IterationSummary &summary) override
+  {
+    if (summary.iteration > 0 && summary.step_is_successful
+        && summary.cost_change < this->tolerance * (summary.cost + summary.cost_change))
+      {
+      return ceres::SOLVER_TERMINATE_SUCCESSFULLY;
+      }
+    return ceres::SOLVER_CONTINUE;
+  }
+
+private:
+
+  const double tolerance;
+
+}; // end class
+
+} // namespace sissr
+
+#endif
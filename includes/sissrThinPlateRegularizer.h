@@ -13,6 +13,10 @@
 // VNL
 #include <vnl/vnl_matrix_fixed.h>
 
+// SiSSR
+#include <sissrControlPointBuffer.h>
+#include <sissrValenceKernels.h>
+
 namespace sissr {
 
 template<class TMesh>
@@ -23,12 +27,17 @@ public ceres::CostFunction
   public:
 
   using TReal = typename TMesh::CoordRepType;
+  using TKernels = ValenceKernelTable<typename TMesh::RealType,
+                                     typename TMesh::PointIdentifier,
+                                     TMesh::TMatrices::MinimumValency,
+                                     TMesh::TMatrices::MaximumValency>;
 
   ThinPlateRegularizer(
     const typename TMesh::Pointer
       &_moving,
-    const typename TMesh::PointsContainer::Pointer
-      &_initialPoints,
+    const ControlPointBuffer
+      &_buffer,
+    unsigned int _frame,
     unsigned int _index);
 
   bool Evaluate(const double* const* parameters,
@@ -40,10 +49,16 @@ public ceres::CostFunction
 private:
 
   const typename TMesh::Pointer &moving;
-  const typename TMesh::PointsContainer::Pointer &initialPoints;
+  const ControlPointBuffer &buffer;
 
+  unsigned int frame;
   unsigned int index;
 
+  // Bound at construction from the cell's valence.
+  const vnl_vector<typename TMesh::PointIdentifier> L;
+  const typename TMesh::RealType* B; // 15 x (N+6), row-major
+  typename TKernels::TThinPlateKernel kernel;
+
 }; // end class
 
 } // namespace sissr
@@ -20,19 +20,24 @@ ThinPlateRegularizer<TMesh>
 ::ThinPlateRegularizer(
   const typename TMesh::Pointer
     &_moving,
-  const typename TMesh::PointsContainer::Pointer
-    &_initialPoints,
+  const ControlPointBuffer
+    &_buffer,
+  unsigned int _frame,
   unsigned int _index) :
     moving(_moving),
-    initialPoints(_initialPoints),
-    index(_index)
+    buffer(_buffer),
+    frame(_frame),
+    index(_index),
+    L(this->moving->GetPointListForCell(this->index))
 {
 
+  const unsigned int N = this->moving->GetNForCell(this->index);
+  this->B = this->moving->m_Matrices.GetThinPlateOperatorView(N).data();
+  this->kernel = TKernels::GetThinPlateKernel(N);
+
   // The *parameters* in this case are the point positions.
   // That is, the TP energy is dictated by the point positions.
-  const auto cellList = this->moving->GetPointListForCell(this->index);
-
-  for (size_t i = 0; i < cellList.size(); ++i)
+  for (size_t i = 0; i < this->L.size(); ++i)
     {
     // Each point has an x, y, and z coordinate
     this->mutable_parameter_block_sizes()->push_back(3);
@@ -48,43 +53,22 @@ ThinPlateRegularizer<TMesh>
 template<class TMesh>
 bool
 ThinPlateRegularizer<TMesh>
-::Evaluate(const double* const* parameters,
+::Evaluate(const double* const* /*parameters*/,
            double* residuals,
            double** jacobians) const
 {
 
-  //////////////////////////////////////////////////
-  // Ensure that the point positions are updated. //
-  //////////////////////////////////////////////////
-
-  const auto L =
-    this->moving->GetPointListForCell(index);
-
-  for (size_t i = 0; i < L.size(); ++i)
-    {
-    const auto init = this->initialPoints->ElementAt( L[i] );
-    const auto diff = parameters[i];
-    typename TMesh::PointType current;
-    for (unsigned int d = 0; d < 3; ++d)
-      {
-      current[d] = init[d] + diff[d];
-      }
-    this->moving->SetPoint( L[i], current );
-    }
-
   ///////////////
   // Residuals //
   ///////////////
 
-  const auto residualVector
-    = this->moving->CalculateThinPlateEnergyVectorForCell(this->index);
   // Residuals are organized COLUMNWISE.
   // [xxxxxxxxxxxxxxxyyyyyyyyyyyyyyyzzzzzzzzzzzzzzz]
   // Keep this in mind while calculating the Jacobian, below.
-  for (unsigned int r = 0; r < 45; ++r)
-    {
-    residuals[r] = residualVector.get(r);
-    }
+  this->kernel(this->B,
+               this->buffer.GetPoint(this->frame, 0),
+               this->L.data_block(),
+               residuals);
 
   // Return if Jacobian wasn't requested.
   if (nullptr == jacobians)
@@ -92,16 +76,7 @@ ThinPlateRegularizer<TMesh>
     return true;
     }
 
-  // Set Jacobian to zero.
-
-  const unsigned int N // valency of cell
-    = this->moving->GetNForCell(this->index);
-  const auto M
-    = this->moving->m_Matrices.GetBezierMRoot();
-  const auto P
-    = this->moving->m_Matrices.GetBSplineToBezier(N);
-  const vnl_matrix_fixed<TReal, 15, 15> M_copy(M.data_block());
-  const auto B = M * P;
+  const size_t K = this->L.size();
 
   for (size_t i = 0; i < L.size(); ++i)
     {
@@ -128,7 +103,7 @@ ThinPlateRegularizer<TMesh>
         const unsigned int col = d;
         const unsigned int stride = 3;
         const unsigned int offset = row*stride+col;
-        jacobians[i][offset] = B.get(r,i);
+        jacobians[i][offset] = this->B[K*r+i];
         }
       }
     }
@@ -11,6 +11,9 @@
 // Ceres
 #include <ceres/ceres.h>
 
+// SiSSR
+#include <sissrControlPointBuffer.h>
+
 namespace sissr {
 
 template<class TMesh>
@@ -22,7 +25,8 @@ public:
 
   TriangleAspectRatioRegularizer(
     const typename TMesh::Pointer& _moving,
-    const typename TMesh::PointsContainer::Pointer& _initialPoints,
+    const ControlPointBuffer& _buffer,
+    unsigned int _frame,
     unsigned int _index);
 
   bool Evaluate(const double* const* parameters,
@@ -33,8 +37,9 @@ public:
 
 private:
   const typename TMesh::Pointer& moving;
-  const typename TMesh::PointsContainer::Pointer& initialPoints;
+  const ControlPointBuffer& buffer;
 
+  unsigned int frame;
   unsigned int index;
   std::array<unsigned int, 3> point_indices;
 
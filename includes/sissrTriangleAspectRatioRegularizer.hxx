@@ -12,10 +12,12 @@ namespace sissr {
 template<class TMesh>
 TriangleAspectRatioRegularizer<TMesh>::TriangleAspectRatioRegularizer(
   const typename TMesh::Pointer& _moving,
-  const typename TMesh::PointsContainer::Pointer& _initialPoints,
+  const ControlPointBuffer& _buffer,
+  unsigned int _frame,
   unsigned int _index)
   : moving(_moving)
-  , initialPoints(_initialPoints)
+  , buffer(_buffer)
+  , frame(_frame)
   , index(_index)
 {
   typename TMesh::CellAutoPointer cell;
@@ -32,33 +34,27 @@ TriangleAspectRatioRegularizer<TMesh>::TriangleAspectRatioRegularizer(
 
 template<class TMesh>
 bool
-TriangleAspectRatioRegularizer<TMesh>::Evaluate(const double* const* parameters,
+TriangleAspectRatioRegularizer<TMesh>::Evaluate(const double* const* /*parameters*/,
                                                 double* residuals,
                                                 double** jacobians) const
 {
 
-  //////////////////////////////////////////////////
-  // Ensure that the point positions are updated. //
-  //////////////////////////////////////////////////
+  ///////////////////////////////////////
+  // Point positions, from the buffer. //
+  ///////////////////////////////////////
 
+  std::array<typename TMesh::PointType, 3> points;
   for (unsigned int i = 0; i < this->point_indices.size(); ++i) {
-    const auto init = this->initialPoints->ElementAt(point_indices[i]);
-    typename TMesh::PointType current;
+    const double* point = this->buffer.GetPoint(this->frame, point_indices[i]);
     for (unsigned int d = 0; d < TMesh::PointType::Dimension; ++d) {
-      current[d] = init[d] + parameters[i][d];
+      points[i][d] = point[d];
     }
-    this->moving->SetPoint(this->point_indices[i], current);
   }
 
   /////////////////////////////////////
   // Find largest and smallest edges //
   /////////////////////////////////////
 
-  std::array<typename TMesh::PointType, 3> points;
-  points[0] = this->moving->GetPoint(this->point_indices[0]);
-  points[1] = this->moving->GetPoint(this->point_indices[1]);
-  points[2] = this->moving->GetPoint(this->point_indices[2]);
-
   std::array<double, 3> lengths;
   lengths[0] = points[0].EuclideanDistanceTo(points[1]);
   lengths[1] = points[1].EuclideanDistanceTo(points[2]);
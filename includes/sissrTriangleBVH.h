@@ -0,0 +1,713 @@
+#ifndef sissr_TriangleBVH_h
+#define sissr_TriangleBVH_h
+
+// STD
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+// ITK
+#include <itkObject.h>
+#include <itkObjectFactory.h>
+#include <itkMacro.h>
+
+// SiSSR
+#include <sissrUtils.h>
+
+namespace sissr {
+
+/*
+ Closest point on a triangulated candidate surface, rather than on a point
+ set standing in for it.
+
+ Cells with more than three points are fanned into triangles; cells with
+ fewer are ignored.  SetCells restricts the hierarchy to a subset of the
+ cells, e.g. those of one label.
+
+ The hierarchy is built top down with binned surface area heuristic
+ splits.  Once the upper levels have produced enough independent subtrees,
+ these are built in parallel and spliced into one node array.  Nodes are
+ 32 bytes: a float box, rounded outwards, and either two adjacent children
+ or a contiguous range of triangles.
+
+ Queries visit the nearer child first and skip boxes which are no closer
+ than the best triangle so far.  In a batch of queries, each query starts
+ from its exact distance to the previous query's triangle.
+ */
+template<typename TMesh>
+class TriangleBVH : public itk::Object
+{
+
+public:
+
+  using Self = TriangleBVH;
+  using Superclass = itk::Object;
+  using Pointer = itk::SmartPointer<Self>;
+  using ConstPointer = itk::SmartPointer<const Self>;
+
+  itkNewMacro(Self);
+  itkTypeMacro(TriangleBVH, Object);
+
+  using MeshType = TMesh;
+  using MeshPointer = typename TMesh::Pointer;
+  using CellIdentifier = typename TMesh::CellIdentifier;
+
+  static constexpr unsigned int NumberOfBins = 16;
+  static constexpr unsigned int MaximumLeafSize = 8;
+  static constexpr unsigned int MaximumSurfaceAreaDepth = 64; // Median splits below
+
+  static_assert(3 == TMesh::PointDimension, "TriangleBVH is only implemented for three dimensions.");
+
+  itkSetMacro(NumberOfThreads, unsigned int);
+  itkGetConstMacro(NumberOfThreads, unsigned int);
+
+  void SetMesh(TMesh* mesh)
+    {
+    this->m_Mesh = mesh;
+    this->Modified();
+    }
+
+  TMesh* GetMesh() const
+    { return this->m_Mesh.GetPointer(); }
+
+  // Empty: all cells.
+  void SetCells(std::vector<CellIdentifier> cells)
+    {
+    std::sort(cells.begin(), cells.end());
+    this->m_Cells = std::move(cells);
+    this->Modified();
+    }
+
+  void Initialize();
+
+  /* Writes the closest point on the surface to `point` and returns its cell. */
+  CellIdentifier FindClosestPoint(const double* query, double* point) const;
+
+  /*
+   queries: count xyz triplets, ideally in spatial order; points: count xyz
+   results.  triangles, if not null: the closest triangle of each query, in
+   the hierarchy's order.  gaps, if not null: per query, the distance to the
+   second closest triangle minus the distance to the closest.  A query moved
+   by less than half its gap keeps its closest triangle.  epsilon > 0: each
+   answer is at most 1 + epsilon times as far as the closest point (no gaps
+   then).
+   */
+  void FindClosestPoints(const double* queries, const size_t &count, double* points,
+                         std::uint32_t* triangles = nullptr, double* gaps = nullptr,
+                         const double &epsilon = 0.0) const;
+
+  size_t GetNumberOfTriangles() const
+    { return this->m_CellIds.size(); }
+
+  /* The 9 vertex coordinates of a triangle, in the hierarchy's order. */
+  const double* GetTriangle(const size_t &t) const
+    { return this->m_Vertices.data() + 9 * t; }
+
+  /* The unit normal of a triangle, in the hierarchy's order; zero if degenerate. */
+  const double* GetNormal(const size_t &t) const
+    { return this->m_Normals.data() + 3 * t; }
+
+  /* The closest point to `query` on one triangle, in the hierarchy's order. */
+  void FindClosestPointOnTriangle(const double* query, const std::uint32_t &t, double* point) const
+    { ClosestPointOnTriangle(query, this->GetTriangle(t), point); }
+
+protected:
+
+  TriangleBVH() = default;
+  ~TriangleBVH() override = default;
+
+private:
+
+  struct Node
+  {
+    float lower[3];
+    float upper[3];
+    std::uint32_t index; // Leaf: first triangle; otherwise: left child (right is index + 1)
+    std::uint32_t count; // Leaf: number of triangles; otherwise 0
+  };
+
+  struct Best
+  {
+    double distance = std::numeric_limits<double>::max(); // Squared
+    double point[3] = {0.0, 0.0, 0.0};
+    std::uint32_t triangle = 0;
+    bool useSecond = false;                               // Also find the second closest
+    double second = std::numeric_limits<double>::max();   // Squared
+    double scale = 1.0;                                   // (1 + epsilon)^2, for box distances
+  };
+
+  // Subtree left to be built in parallel, into node `node`
+  struct Task
+  {
+    std::uint32_t node;
+    size_t begin;
+    size_t end;
+    unsigned int depth;
+  };
+
+  struct BuildData
+  {
+    std::vector<double> lower;    // 3 per triangle
+    std::vector<double> upper;    // 3 per triangle
+    std::vector<double> centroid; // 3 per triangle
+    std::vector<std::uint32_t> order;
+  };
+
+  void Build(std::vector<Node> &nodes, const std::uint32_t &node,
+             const size_t &begin, const size_t &end, const unsigned int &depth,
+             BuildData &data, const size_t &grain, std::vector<Task>* tasks) const;
+
+  // First bin of the right child; 0 for a leaf.
+  unsigned int CalculateSurfaceAreaSplit(const size_t &begin, const size_t &end, const unsigned int &axis,
+                                         const double &origin, const double &extent,
+                                         const BuildData &data) const;
+
+  void Search(const double* q, Best &best) const;
+
+  void SearchTriangle(const double* q, const std::uint32_t &t, Best &best) const
+    {
+    double p[3];
+    ClosestPointOnTriangle(q, this->m_Vertices.data() + 9 * size_t(t), p);
+    double dist = 0.0;
+    for (unsigned int d = 0; d < 3; ++d)
+      {
+      const double diff = q[d] - p[d];
+      dist += diff * diff;
+      }
+    if (dist < best.distance)
+      {
+      best.second = best.distance;
+      best.distance = dist;
+      best.triangle = t;
+      for (unsigned int d = 0; d < 3; ++d) best.point[d] = p[d];
+      }
+    else if (best.useSecond && dist < best.second && t != best.triangle)
+      {
+      best.second = dist;
+      }
+    }
+
+  // Squared distance from q to the box of a node
+  double CalculateBoxDistance(const std::uint32_t &node, const double* q) const
+    {
+    double dist = 0.0;
+    for (unsigned int d = 0; d < 3; ++d)
+      {
+      const double below = double(this->m_Nodes[node].lower[d]) - q[d];
+      const double above = q[d] - double(this->m_Nodes[node].upper[d]);
+      const double gap = std::max(0.0, std::max(below, above));
+      dist += gap * gap;
+      }
+    return dist;
+    }
+
+  // Ericson, Real-Time Collision Detection, section 5.1.5.
+  static void ClosestPointOnTriangle(const double* q, const double* v, double* p);
+
+  static unsigned int BinOf(const double &x, const double &origin, const double &scale)
+    {
+    const double b = (x - origin) * scale;
+    return std::min(NumberOfBins - 1, static_cast<unsigned int>(std::max(0.0, b)));
+    }
+
+  static double CalculateHalfArea(const double* lower, const double* upper)
+    {
+    double e[3];
+    for (unsigned int d = 0; d < 3; ++d) e[d] = std::max(0.0, upper[d] - lower[d]);
+    return e[0] * e[1] + e[1] * e[2] + e[2] * e[0];
+    }
+
+  MeshPointer m_Mesh;
+  std::vector<CellIdentifier> m_Cells;
+  unsigned int m_NumberOfThreads = 1;
+
+  std::vector<Node> m_Nodes;
+
+  // Triangles, in leaf order
+  std::vector<double> m_Vertices; // 9 per triangle
+  std::vector<double> m_Normals;  // 3 per triangle
+  std::vector<CellIdentifier> m_CellIds;
+
+};
+
+template<typename TMesh>
+void
+TriangleBVH<TMesh>
+::Initialize()
+{
+
+  itkAssertOrThrowMacro(nullptr != this->m_Mesh, "No mesh was set.");
+
+  // Gather the triangles
+  std::vector<double> vertices;
+  std::vector<CellIdentifier> cellIds;
+  for (auto it = this->m_Mesh->GetCells()->Begin(); it != this->m_Mesh->GetCells()->End(); ++it)
+    {
+    if (!this->m_Cells.empty() && !std::binary_search(this->m_Cells.begin(), this->m_Cells.end(), it.Index()))
+      continue;
+    const auto cell = it.Value();
+    const auto ids = cell->GetPointIds();
+    for (unsigned int k = 2; k < cell->GetNumberOfPoints(); ++k)
+      {
+      for (const auto &id : {ids[0], ids[k - 1], ids[k]})
+        {
+        const auto p = this->m_Mesh->GetPoint(id);
+        for (unsigned int d = 0; d < 3; ++d) vertices.push_back(p[d]);
+        }
+      cellIds.push_back(it.Index());
+      }
+    }
+
+  const size_t n = cellIds.size();
+  itkAssertOrThrowMacro(n > 0, "No triangles were found.");
+  itkAssertOrThrowMacro(n <= std::numeric_limits<std::uint32_t>::max(), "Too many triangles.");
+
+  BuildData data;
+  data.lower.resize(3 * n);
+  data.upper.resize(3 * n);
+  data.centroid.resize(3 * n);
+  data.order.resize(n);
+  std::iota(data.order.begin(), data.order.end(), 0);
+  for (size_t t = 0; t < n; ++t)
+    for (unsigned int d = 0; d < 3; ++d)
+      {
+      const double a = vertices[9 * t + d];
+      const double b = vertices[9 * t + 3 + d];
+      const double c = vertices[9 * t + 6 + d];
+      data.lower[3 * t + d] = std::min({a, b, c});
+      data.upper[3 * t + d] = std::max({a, b, c});
+      data.centroid[3 * t + d] = (a + b + c) / 3.0;
+      }
+
+  // Upper levels serially, down to about four subtrees per thread
+  const unsigned int threads = std::max(1u, this->m_NumberOfThreads);
+  this->m_Nodes.assign(1, Node());
+  std::vector<Task> tasks;
+  const size_t grain = (threads > 1) ? std::max<size_t>(n / (4 * threads), 1024) : n;
+  this->Build(this->m_Nodes, 0, 0, n, 0, data, grain, &tasks);
+
+  // Subtrees in parallel, each into its own array with its root first
+  std::vector<std::vector<Node>> subtrees(tasks.size());
+  ParallelFor(tasks.size(), threads, [&](size_t begin, size_t end)
+    {
+    for (size_t i = begin; i < end; ++i)
+      {
+      subtrees[i].assign(1, Node());
+      this->Build(subtrees[i], 0, tasks[i].begin, tasks[i].end, tasks[i].depth,
+                  data, tasks[i].end - tasks[i].begin, nullptr);
+      }
+    });
+
+  // Splice: a subtree's root replaces its placeholder; the rest is appended
+  for (size_t i = 0; i < tasks.size(); ++i)
+    {
+    const auto &subtree = subtrees[i];
+    const std::uint32_t base = std::uint32_t(this->m_Nodes.size());
+    const auto remap = [base](Node node)
+      {
+      if (0 == node.count) node.index = base + node.index - 1;
+      return node;
+      };
+    this->m_Nodes[tasks[i].node] = remap(subtree[0]);
+    for (size_t j = 1; j < subtree.size(); ++j) this->m_Nodes.push_back(remap(subtree[j]));
+    }
+
+  // Triangles in leaf order
+  this->m_Vertices.resize(9 * n);
+  this->m_CellIds.resize(n);
+  for (size_t j = 0; j < n; ++j)
+    {
+    const size_t t = data.order[j];
+    std::copy(vertices.begin() + 9 * t, vertices.begin() + 9 * t + 9, this->m_Vertices.begin() + 9 * j);
+    this->m_CellIds[j] = cellIds[t];
+    }
+
+  this->m_Normals.assign(3 * n, 0.0);
+  ParallelFor(n, threads, [this](size_t begin, size_t end)
+    {
+    for (size_t t = begin; t < end; ++t)
+      {
+      const double* v = this->GetTriangle(t);
+      double* normal = this->m_Normals.data() + 3 * t;
+      double e1[3], e2[3];
+      for (unsigned int d = 0; d < 3; ++d) e1[d] = v[3 + d] - v[d], e2[d] = v[6 + d] - v[d];
+      normal[0] = e1[1] * e2[2] - e1[2] * e2[1];
+      normal[1] = e1[2] * e2[0] - e1[0] * e2[2];
+      normal[2] = e1[0] * e2[1] - e1[1] * e2[0];
+      const double length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+      if (length > 0.0) for (unsigned int d = 0; d < 3; ++d) normal[d] /= length;
+      }
+    });
+
+}
+
+template<typename TMesh>
+void
+TriangleBVH<TMesh>
+::Build(std::vector<Node> &nodes, const std::uint32_t &node,
+        const size_t &begin, const size_t &end, const unsigned int &depth,
+        BuildData &data, const size_t &grain, std::vector<Task>* tasks) const
+{
+
+  const size_t count = end - begin;
+
+  // Bounds of the triangles and of their centroids
+  double lower[3], upper[3], clower[3], cupper[3];
+  std::fill(lower, lower + 3, std::numeric_limits<double>::max());
+  std::fill(clower, clower + 3, std::numeric_limits<double>::max());
+  std::fill(upper, upper + 3, std::numeric_limits<double>::lowest());
+  std::fill(cupper, cupper + 3, std::numeric_limits<double>::lowest());
+  for (size_t j = begin; j < end; ++j)
+    {
+    const size_t t = data.order[j];
+    for (unsigned int d = 0; d < 3; ++d)
+      {
+      lower[d] = std::min(lower[d], data.lower[3 * t + d]);
+      upper[d] = std::max(upper[d], data.upper[3 * t + d]);
+      clower[d] = std::min(clower[d], data.centroid[3 * t + d]);
+      cupper[d] = std::max(cupper[d], data.centroid[3 * t + d]);
+      }
+    }
+  for (unsigned int d = 0; d < 3; ++d)
+    {
+    float l = float(lower[d]);
+    float u = float(upper[d]);
+    if (double(l) > lower[d]) l = std::nextafter(l, -std::numeric_limits<float>::infinity());
+    if (double(u) < upper[d]) u = std::nextafter(u, std::numeric_limits<float>::infinity());
+    nodes[node].lower[d] = l;
+    nodes[node].upper[d] = u;
+    }
+
+  const auto makeLeaf = [&]()
+    {
+    nodes[node].index = std::uint32_t(begin);
+    nodes[node].count = std::uint32_t(count);
+    };
+
+  if (count <= 2)
+    {
+    makeLeaf();
+    return;
+    }
+
+  // Bin along the widest centroid extent
+  unsigned int axis = 0;
+  for (unsigned int d = 1; d < 3; ++d)
+    if (cupper[d] - clower[d] > cupper[axis] - clower[axis]) axis = d;
+  const double extent = cupper[axis] - clower[axis];
+  if (!(extent > 0.0))
+    {
+    // Coincident centroids cannot be separated
+    makeLeaf();
+    return;
+    }
+
+  size_t mid = begin + count / 2;
+  if (depth >= MaximumSurfaceAreaDepth)
+    {
+    // Keeps the depth, and so the traversal stack, bounded for pathological input
+    std::nth_element(data.order.begin() + begin, data.order.begin() + mid, data.order.begin() + end,
+                     [&data, axis](const std::uint32_t &a, const std::uint32_t &b)
+                     { return data.centroid[3 * a + axis] < data.centroid[3 * b + axis]; });
+    }
+  else
+    {
+    const unsigned int split = this->CalculateSurfaceAreaSplit(begin, end, axis, clower[axis], extent, data);
+    if (0 == split)
+      {
+      makeLeaf();
+      return;
+      }
+    const double scale = NumberOfBins / extent;
+    const auto middle = std::partition(data.order.begin() + begin, data.order.begin() + end,
+                                       [&](const std::uint32_t &t)
+                                       { return BinOf(data.centroid[3 * t + axis], clower[axis], scale) < split; });
+    mid = size_t(middle - data.order.begin());
+    }
+
+  const std::uint32_t left = std::uint32_t(nodes.size());
+  nodes.emplace_back();
+  nodes.emplace_back();
+  nodes[node].index = left;
+  nodes[node].count = 0;
+
+  for (const auto &child : {std::make_pair(left, std::make_pair(begin, mid)),
+                            std::make_pair(left + 1, std::make_pair(mid, end))})
+    {
+    const size_t b = child.second.first;
+    const size_t e = child.second.second;
+    if (nullptr != tasks && e - b <= grain)
+      {
+      tasks->push_back({child.first, b, e, depth + 1});
+      }
+    else
+      {
+      this->Build(nodes, child.first, b, e, depth + 1, data, grain, tasks);
+      }
+    }
+
+}
+
+template<typename TMesh>
+unsigned int
+TriangleBVH<TMesh>
+::CalculateSurfaceAreaSplit(const size_t &begin, const size_t &end, const unsigned int &axis,
+                            const double &origin, const double &extent, const BuildData &data) const
+{
+
+  const size_t count = end - begin;
+  const double scale = NumberOfBins / extent;
+
+  double binLower[NumberOfBins][3], binUpper[NumberOfBins][3];
+  size_t binCount[NumberOfBins] = {};
+  for (unsigned int b = 0; b < NumberOfBins; ++b)
+    {
+    std::fill(binLower[b], binLower[b] + 3, std::numeric_limits<double>::max());
+    std::fill(binUpper[b], binUpper[b] + 3, std::numeric_limits<double>::lowest());
+    }
+  double lower[3], upper[3];
+  std::fill(lower, lower + 3, std::numeric_limits<double>::max());
+  std::fill(upper, upper + 3, std::numeric_limits<double>::lowest());
+  for (size_t j = begin; j < end; ++j)
+    {
+    const size_t t = data.order[j];
+    const unsigned int b = BinOf(data.centroid[3 * t + axis], origin, scale);
+    ++binCount[b];
+    for (unsigned int d = 0; d < 3; ++d)
+      {
+      binLower[b][d] = std::min(binLower[b][d], data.lower[3 * t + d]);
+      binUpper[b][d] = std::max(binUpper[b][d], data.upper[3 * t + d]);
+      lower[d] = std::min(lower[d], data.lower[3 * t + d]);
+      upper[d] = std::max(upper[d], data.upper[3 * t + d]);
+      }
+    }
+
+  // Sweep from the right, then from the left, for the cost of each split
+  double rightCost[NumberOfBins];
+  {
+  double l[3], u[3];
+  std::fill(l, l + 3, std::numeric_limits<double>::max());
+  std::fill(u, u + 3, std::numeric_limits<double>::lowest());
+  size_t c = 0;
+  for (unsigned int b = NumberOfBins - 1; b > 0; --b)
+    {
+    c += binCount[b];
+    for (unsigned int d = 0; d < 3; ++d)
+      {
+      l[d] = std::min(l[d], binLower[b][d]);
+      u[d] = std::max(u[d], binUpper[b][d]);
+      }
+    rightCost[b] = (c > 0) ? c * CalculateHalfArea(l, u) : 0.0;
+    }
+  }
+
+  unsigned int split = 0;
+  double bestCost = std::numeric_limits<double>::max();
+  {
+  double l[3], u[3];
+  std::fill(l, l + 3, std::numeric_limits<double>::max());
+  std::fill(u, u + 3, std::numeric_limits<double>::lowest());
+  size_t c = 0;
+  for (unsigned int b = 0; b + 1 < NumberOfBins; ++b)
+    {
+    c += binCount[b];
+    for (unsigned int d = 0; d < 3; ++d)
+      {
+      l[d] = std::min(l[d], binLower[b][d]);
+      u[d] = std::max(u[d], binUpper[b][d]);
+      }
+    if (0 == c || count == c) continue;
+    const double cost = c * CalculateHalfArea(l, u) + rightCost[b + 1];
+    if (cost < bestCost)
+      {
+      bestCost = cost;
+      split = b + 1;
+      }
+    }
+  }
+
+  // Small sets stay together unless splitting pays for the extra box test
+  if (count <= MaximumLeafSize && bestCost >= count * CalculateHalfArea(lower, upper)) return 0;
+
+  return split;
+
+}
+
+template<typename TMesh>
+typename TriangleBVH<TMesh>::CellIdentifier
+TriangleBVH<TMesh>
+::FindClosestPoint(const double* query, double* point) const
+{
+  itkAssertOrThrowMacro(!this->m_CellIds.empty(), "The hierarchy is empty or was not initialized.");
+
+  Best best;
+  this->Search(query, best);
+  for (unsigned int d = 0; d < 3; ++d) point[d] = best.point[d];
+  return this->m_CellIds[best.triangle];
+}
+
+template<typename TMesh>
+void
+TriangleBVH<TMesh>
+::FindClosestPoints(const double* queries, const size_t &count, double* points,
+                    std::uint32_t* triangles, double* gaps, const double &epsilon) const
+{
+  itkAssertOrThrowMacro(!this->m_CellIds.empty(), "The hierarchy is empty or was not initialized.");
+  itkAssertOrThrowMacro(epsilon >= 0.0, "epsilon must not be negative.");
+  itkAssertOrThrowMacro(0.0 == epsilon || nullptr == gaps, "Gaps are only found by exact searches.");
+
+  std::uint32_t previous = 0;
+  for (size_t i = 0; i < count; ++i)
+    {
+    const double* q = queries + 3 * i;
+    Best best;
+    best.useSecond = (nullptr != gaps);
+    best.scale = (1.0 + epsilon) * (1.0 + epsilon);
+    if (i > 0)
+      {
+      // The previous query's triangle bounds this one
+      this->SearchTriangle(q, previous, best);
+      }
+    this->Search(q, best);
+    for (unsigned int d = 0; d < 3; ++d) points[3 * i + d] = best.point[d];
+    if (nullptr != triangles) triangles[i] = best.triangle;
+    if (nullptr != gaps) gaps[i] = std::sqrt(best.second) - std::sqrt(best.distance);
+    previous = best.triangle;
+    }
+}
+
+template<typename TMesh>
+void
+TriangleBVH<TMesh>
+::Search(const double* q, Best &best) const
+{
+
+  // Node and the squared distance to its box; at most one pending sibling
+  // per level.
+  std::pair<std::uint32_t, double> stack[MaximumSurfaceAreaDepth + 64];
+  unsigned int size = 0;
+  stack[size++] = std::make_pair(std::uint32_t(0), this->CalculateBoxDistance(0, q));
+
+  while (size > 0)
+    {
+    const auto top = stack[--size];
+    if (best.scale * top.second >= (best.useSecond ? best.second : best.distance)) continue;
+    const Node &n = this->m_Nodes[top.first];
+
+    if (n.count > 0)
+      {
+      for (std::uint32_t t = n.index; t < n.index + n.count; ++t) this->SearchTriangle(q, t, best);
+      continue;
+      }
+
+    // Nearer child on top
+    const double left = this->CalculateBoxDistance(n.index, q);
+    const double right = this->CalculateBoxDistance(n.index + 1, q);
+    if (left <= right)
+      {
+      stack[size++] = std::make_pair(n.index + 1, right);
+      stack[size++] = std::make_pair(n.index, left);
+      }
+    else
+      {
+      stack[size++] = std::make_pair(n.index, left);
+      stack[size++] = std::make_pair(n.index + 1, right);
+      }
+    }
+
+}
+
+template<typename TMesh>
+void
+TriangleBVH<TMesh>
+::ClosestPointOnTriangle(const double* q, const double* v, double* p)
+{
+  const double* a = v;
+  const double* b = v + 3;
+  const double* c = v + 6;
+
+  double ab[3], ac[3], ap[3];
+  for (unsigned int d = 0; d < 3; ++d)
+    {
+    ab[d] = b[d] - a[d];
+    ac[d] = c[d] - a[d];
+    ap[d] = q[d] - a[d];
+    }
+  const auto dot = [](const double* x, const double* y) { return x[0] * y[0] + x[1] * y[1] + x[2] * y[2]; };
+  const auto set = [p](const double* x, const double s, const double* e)
+    { for (unsigned int d = 0; d < 3; ++d) p[d] = x[d] + s * e[d]; };
+
+  const double d1 = dot(ab, ap);
+  const double d2 = dot(ac, ap);
+  if (d1 <= 0.0 && d2 <= 0.0) { set(a, 0.0, ab); return; }
+
+  double bp[3];
+  for (unsigned int d = 0; d < 3; ++d) bp[d] = q[d] - b[d];
+  const double d3 = dot(ab, bp);
+  const double d4 = dot(ac, bp);
+  if (d3 >= 0.0 && d4 <= d3) { set(b, 0.0, ab); return; }
+
+  const double vc = d1 * d4 - d3 * d2;
+  if (vc <= 0.0 && d1 >= 0.0 && d3 <= 0.0) { set(a, d1 / (d1 - d3), ab); return; }
+
+  double cp[3];
+  for (unsigned int d = 0; d < 3; ++d) cp[d] = q[d] - c[d];
+  const double d5 = dot(ab, cp);
+  const double d6 = dot(ac, cp);
+  if (d6 >= 0.0 && d5 <= d6) { set(c, 0.0, ab); return; }
+
+  const double vb = d5 * d2 - d1 * d6;
+  if (vb <= 0.0 && d2 >= 0.0 && d6 <= 0.0) { set(a, d2 / (d2 - d6), ac); return; }
+
+  const double va = d3 * d6 - d5 * d4;
+  if (va <= 0.0 && (d4 - d3) >= 0.0 && (d5 - d6) >= 0.0)
+    {
+    double bc[3];
+    for (unsigned int d = 0; d < 3; ++d) bc[d] = c[d] - b[d];
+    set(b, (d4 - d3) / ((d4 - d3) + (d5 - d6)), bc);
+    return;
+    }
+
+  // Degenerate triangles: the closest point on the longest edge
+  if (!(va + vb + vc > 0.0))
+    {
+    const double* e0 = a;
+    const double* e1 = b;
+    double longest = 0.0;
+    for (const auto &edge : {std::make_pair(a, b), std::make_pair(b, c), std::make_pair(c, a)})
+      {
+      double length = 0.0;
+      for (unsigned int d = 0; d < 3; ++d) length += (edge.second[d] - edge.first[d]) * (edge.second[d] - edge.first[d]);
+      if (length >= longest)
+        {
+        longest = length;
+        e0 = edge.first;
+        e1 = edge.second;
+        }
+      }
+    double e[3], eq[3];
+    for (unsigned int d = 0; d < 3; ++d)
+      {
+      e[d] = e1[d] - e0[d];
+      eq[d] = q[d] - e0[d];
+      }
+    const double t = (longest > 0.0) ? std::min(1.0, std::max(0.0, dot(e, eq) / longest)) : 0.0;
+    set(e0, t, e);
+    return;
+    }
+
+  // Inside the face
+  const double denom = 1.0 / (va + vb + vc);
+  const double s = vb * denom;
+  const double t = vc * denom;
+  for (unsigned int d = 0; d < 3; ++d) p[d] = a[d] + s * ab[d] + t * ac[d];
+}
+
+} // namespace sissr
+
+#endif
@@ -7,6 +7,11 @@
 #include <sstream>
 #include <iomanip>
 #include <cmath>
+#include <fstream>
+#include <thread>
+#include <algorithm>
+#include <vector>
+#include <sys/resource.h>
 
 namespace sissr {
 
@@ -35,6 +40,58 @@ inline bool close(T a, T b, T tolerance = T(1e-9)) {
     return std::abs(a - b) <= tolerance;
 }
 
+// Number of CPUs available to this process.  This is the hardware
+// concurrency, limited by the cgroup CPU quota (v2 or v1) if one is set,
+// so that containerized jobs don't oversubscribe their allocation.
+inline unsigned int CalculateCPUQuota() {
+    unsigned int cpus = std::max(1u, std::thread::hardware_concurrency());
+
+    double quota = -1.0;
+    double period = -1.0;
+
+    std::ifstream v2("/sys/fs/cgroup/cpu.max");
+    std::string q;
+    if (v2 >> q >> period && q != "max") {
+        quota = std::stod(q);
+    } else {
+        std::ifstream v1q("/sys/fs/cgroup/cpu/cpu.cfs_quota_us");
+        std::ifstream v1p("/sys/fs/cgroup/cpu/cpu.cfs_period_us");
+        if (!(v1q >> quota && v1p >> period)) quota = -1.0;
+    }
+
+    if (quota > 0.0 && period > 0.0) {
+        const auto limit = static_cast<unsigned int>(std::ceil(quota / period));
+        cpus = std::max(1u, std::min(cpus, limit));
+    }
+
+    return cpus;
+}
+
+// Largest resident set size of this process so far, in MiB.
+inline double CalculatePeakResidentSetSizeInMiB() {
+    struct rusage usage;
+    if (0 != getrusage(RUSAGE_SELF, &usage)) return 0.0;
+    return usage.ru_maxrss / 1024.0; // KiB on Linux
+}
+
+// Calls f(begin, end) on contiguous chunks of [0, n), one chunk per
+// thread; the calling thread takes the first chunk.
+template<typename F>
+inline void ParallelFor(const size_t n, const unsigned int threads, const F &f) {
+    const size_t chunks = std::min<size_t>(std::max(1u, threads), n);
+    if (chunks <= 1) {
+        if (n > 0) f(size_t(0), n);
+        return;
+    }
+    std::vector<std::thread> workers;
+    workers.reserve(chunks - 1);
+    for (size_t c = 1; c < chunks; ++c) {
+        workers.emplace_back([&f, c, n, chunks]() { f(c * n / chunks, (c + 1) * n / chunks); });
+    }
+    f(size_t(0), n / chunks);
+    for (auto &worker : workers) worker.join();
+}
+
 } // namespace sissr
 
 #endif
\ No newline at end of file
@@ -0,0 +1,120 @@
+#ifndef sissr_ValenceKernels_h
+#define sissr_ValenceKernels_h
+
+// STD
+#include <array>
+#include <utility>
+
+// ITK
+#include <itkMacro.h>
+
+namespace sissr {
+
+/*
+ Evaluation kernels for a patch with N+6 control points, with N fixed at
+ compile time so that the gathered control points live in fixed-size stack
+ arrays and the loops have constant trip counts.
+
+ X: contiguous xyz positions of all control points of one frame.
+ L: the patch's N+6 control point IDs, indexing X.
+ */
+template<typename TReal, typename TIndex, unsigned int N>
+struct ValenceKernel
+{
+
+  static constexpr unsigned int K = N + 6;
+
+  /* out = sum_i w[i] * X[L[i]] */
+  static void SurfacePoint(const TReal* w, const double* X, const TIndex* L, double* out)
+  {
+    double x[K][3];
+    for (unsigned int i = 0; i < K; ++i)
+      for (unsigned int d = 0; d < 3; ++d)
+        x[i][d] = X[3 * L[i] + d];
+
+    double acc[3] = {0.0, 0.0, 0.0};
+    for (unsigned int i = 0; i < K; ++i)
+      for (unsigned int d = 0; d < 3; ++d)
+        acc[d] += w[i] * x[i][d];
+
+    for (unsigned int d = 0; d < 3; ++d) out[d] = acc[d];
+  }
+
+  /*
+   residuals = B * X[L], with B the 15 x K (row-major) thin plate operator.
+   The 45 residuals are organized columnwise: 15 x, 15 y, 15 z.
+   */
+  static void ThinPlate(const TReal* B, const double* X, const TIndex* L, double* residuals)
+  {
+    double x[K][3];
+    for (unsigned int i = 0; i < K; ++i)
+      for (unsigned int d = 0; d < 3; ++d)
+        x[i][d] = X[3 * L[i] + d];
+
+    for (unsigned int r = 0; r < 15; ++r)
+      {
+      double acc[3] = {0.0, 0.0, 0.0};
+      for (unsigned int i = 0; i < K; ++i)
+        for (unsigned int d = 0; d < 3; ++d)
+          acc[d] += B[K * r + i] * x[i][d];
+      for (unsigned int d = 0; d < 3; ++d) residuals[15 * d + r] = acc[d];
+      }
+  }
+
+};
+
+/*
+ Table of kernels for MinN <= N <= MaxN, indexed by valence.  Cost functions
+ look up their kernel once, at construction.
+ */
+template<typename TReal, typename TIndex, unsigned int MinN, unsigned int MaxN>
+class ValenceKernelTable
+{
+
+public:
+
+  using TSurfacePointKernel = void (*)(const TReal*, const double*, const TIndex*, double*);
+  using TThinPlateKernel = void (*)(const TReal*, const double*, const TIndex*, double*);
+
+  static TSurfacePointKernel GetSurfacePointKernel(const unsigned int &n)
+    {
+    CheckValence(n);
+    return SurfacePointKernels[n - MinN];
+    }
+
+  static TThinPlateKernel GetThinPlateKernel(const unsigned int &n)
+    {
+    CheckValence(n);
+    return ThinPlateKernels[n - MinN];
+    }
+
+private:
+
+  static constexpr unsigned int Size = MaxN - MinN + 1;
+
+  static void CheckValence(const unsigned int &n)
+    {
+    itkAssertOrThrowMacro(MinN <= n && n <= MaxN,
+                          "No kernel for valence " + std::to_string(n) + ".");
+    }
+
+  template<std::size_t... I>
+  static constexpr std::array<TSurfacePointKernel, Size>
+  MakeSurfacePointKernels(std::index_sequence<I...>)
+    { return {{ &ValenceKernel<TReal, TIndex, MinN + I>::SurfacePoint... }}; }
+
+  template<std::size_t... I>
+  static constexpr std::array<TThinPlateKernel, Size>
+  MakeThinPlateKernels(std::index_sequence<I...>)
+    { return {{ &ValenceKernel<TReal, TIndex, MinN + I>::ThinPlate... }}; }
+
+  static constexpr std::array<TSurfacePointKernel, Size> SurfacePointKernels
+    = MakeSurfacePointKernels(std::make_index_sequence<Size>());
+  static constexpr std::array<TThinPlateKernel, Size> ThinPlateKernels
+    = MakeThinPlateKernels(std::make_index_sequence<Size>());
+
+};
+
+} // namespace sissr
+
+#endif
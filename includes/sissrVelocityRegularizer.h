@@ -8,6 +8,9 @@
 // Ceres
 #include <ceres/ceres.h>
 
+// SiSSR
+#include <sissrControlPointBuffer.h>
+
 namespace sissr {
 
 template<class TMovingMesh>
@@ -15,12 +18,9 @@ class VelocityRegularizer : public ceres::CostFunction
 {
 
 public:
-  VelocityRegularizer(
-    const typename std::vector<typename TMovingMesh::Pointer>& _movingVector,
-    const typename std::vector<typename TMovingMesh::PointsContainer::Pointer>&
-      _initialPointsVector,
-    unsigned int _frame,
-    unsigned int _index);
+  VelocityRegularizer(const ControlPointBuffer& _buffer,
+                      unsigned int _frame,
+                      unsigned int _index);
 
   bool Evaluate(const double* const* parameters,
                 double* residuals,
@@ -33,9 +33,7 @@ private:
   unsigned int GetCurrentFrame() const;
   unsigned int GetNextFrame() const;
 
-  const typename std::vector<typename TMovingMesh::Pointer> movingVector;
-  const typename std::vector<typename TMovingMesh::PointsContainer::Pointer>&
-    initialPointsVector;
+  const ControlPointBuffer& buffer;
 
   const unsigned int frame;
   const unsigned int index;
@@ -5,13 +5,10 @@ namespace sissr {
 
 template<class TMovingMesh>
 VelocityRegularizer<TMovingMesh>::VelocityRegularizer(
-  const typename std::vector<typename TMovingMesh::Pointer>& _movingVector,
-  const typename std::vector<typename TMovingMesh::PointsContainer::Pointer>&
-    _initialPointsVector,
+  const ControlPointBuffer& _buffer,
   unsigned int _frame,
   unsigned int _index)
-  : movingVector(_movingVector)
-  , initialPointsVector(_initialPointsVector)
+  : buffer(_buffer)
   , frame(_frame)
   , index(_index)
 {
@@ -23,7 +20,7 @@ VelocityRegularizer<TMovingMesh>::VelocityRegularizer(
 
 template<class TMovingMesh>
 bool
-VelocityRegularizer<TMovingMesh>::Evaluate(const double* const* parameters,
+VelocityRegularizer<TMovingMesh>::Evaluate(const double* const* /*parameters*/,
                                            double* residuals,
                                            double** jacobians) const
 {
@@ -31,18 +28,8 @@ VelocityRegularizer<TMovingMesh>::Evaluate(const double* const* parameters,
   const auto dim = TMovingMesh::PointType::Dimension;
 
   // Residuals
-  auto p1 = this->initialPointsVector.at(this->GetCurrentFrame())
-              ->ElementAt(this->index);
-  for (unsigned int i = 0; i < dim; ++i)
-    p1[i] += parameters[0][i];
-
-  auto p2 =
-    this->initialPointsVector.at(this->GetNextFrame())->ElementAt(this->index);
-  for (unsigned int i = 0; i < dim; ++i)
-    p2[i] += parameters[1][i];
-
-  this->movingVector.at(this->GetCurrentFrame())->SetPoint(this->index, p1);
-  this->movingVector.at(this->GetNextFrame())->SetPoint(this->index, p2);
+  const double* p1 = this->buffer.GetPoint(this->GetCurrentFrame(), this->index);
+  const double* p2 = this->buffer.GetPoint(this->GetNextFrame(), this->index);
 
   for (unsigned int i = 0; i < dim; ++i) {
     residuals[i] = p2[i] - p1[i];
@@ -62,8 +49,10 @@ VelocityRegularizer<TMovingMesh>::Evaluate(const double* const* parameters,
 
   // Set the relevant Jacobians.
   for (unsigned int i = 0; i < dim; ++i) {
-    jacobians[0][i + i * dim] = -1;
-    jacobians[1][i + i * dim] = 1;
+    if (nullptr != jacobians[0])
+      jacobians[0][i + i * dim] = -1;
+    if (nullptr != jacobians[1])
+      jacobians[1][i + i * dim] = 1;
   }
 
   return true;
@@ -73,7 +62,7 @@ template<class TMovingMesh>
 unsigned int
 VelocityRegularizer<TMovingMesh>::GetNumberOfFrames() const
 {
-  return this->movingVector.size();
+  return this->buffer.GetNumberOfFrames();
 }
 
 template<class TMovingMesh>
@@ -1,6 +1,8 @@
 #include <sissrAlgorithm.h>
 
 // STD
+#include <algorithm>
+#include <cctype>
 #include <filesystem>
 #include <iostream>
 
@@ -136,7 +138,8 @@ Algorithm::Register()
   TRegister registerMesh(
       fixedVector,
       movingVector,
-      parameters.RegistrationUseLabels);
+      parameters.RegistrationUseLabels,
+      parameters.RegistrationUseTriangles);
 
   registerMesh.RegistrationWeights = parameters.RegistrationWeights;
   registerMesh.MaximumNumberOfIterations = parameters.MaximumNumberOfIterations;
@@ -144,6 +147,50 @@ Algorithm::Register()
   registerMesh.FunctionTolerance = parameters.FunctionTolerance;
   registerMesh.ParameterTolerance = parameters.ParameterTolerance;
   registerMesh.DynamicSparsity = parameters.DynamicSparsity;
+  std::string linearSolver = parameters.LinearSolverType;
+  std::transform(linearSolver.begin(), linearSolver.end(), linearSolver.begin(), ::toupper);
+  registerMesh.AutoLinearSolver = ("AUTO" == linearSolver);
+  itkAssertOrThrowMacro(registerMesh.AutoLinearSolver
+                        || ceres::StringToLinearSolverType(linearSolver, &registerMesh.LinearSolver),
+                        "Unknown linear solver type: " + parameters.LinearSolverType);
+  itkAssertOrThrowMacro(ceres::StringToPreconditionerType(parameters.PreconditionerType, &registerMesh.Preconditioner),
+                        "Unknown preconditioner type: " + parameters.PreconditionerType);
+  itkAssertOrThrowMacro(parameters.SparseLinearAlgebraLibrary.empty()
+                        || ceres::StringToSparseLinearAlgebraLibraryType(parameters.SparseLinearAlgebraLibrary,
+                                                                         &registerMesh.SparseLibrary),
+                        "Unknown sparse linear algebra library: " + parameters.SparseLinearAlgebraLibrary);
+  itkAssertOrThrowMacro(ceres::StringToLinearSolverOrderingType(parameters.LinearSolverOrdering,
+                                                                &registerMesh.LinearSolverOrdering),
+                        "Unknown linear solver ordering: " + parameters.LinearSolverOrdering);
+  registerMesh.UseMixedPrecisionSolves = parameters.UseMixedPrecisionSolves;
+  registerMesh.MaxNumRefinementIterations = parameters.MaxNumRefinementIterations;
+  registerMesh.LinearSolverProbeIterations = parameters.LinearSolverProbeIterations;
+  registerMesh.NumberOfThreads = parameters.NumberOfThreads;
+  registerMesh.BatchPrimaryResiduals = parameters.BatchPrimaryResiduals;
+  registerMesh.CollapseLinearRegularizers = parameters.CollapseLinearRegularizers;
+  registerMesh.UseAlternatingSolver = parameters.UseAlternatingSolver;
+  registerMesh.UseMatrixFreeSolver = parameters.UseMatrixFreeSolver;
+  registerMesh.MatrixFreeLinearIterations = parameters.MatrixFreeLinearIterations;
+  registerMesh.MatrixFreeLinearTolerance = parameters.MatrixFreeLinearTolerance;
+  if (parameters.CacheEliminationOrdering) {
+    registerMesh.OrderingCacheDirectory = parameters.OrderingCacheDirectory.empty()
+                                        ? dirStructure.SerializationDirectory
+                                        : parameters.OrderingCacheDirectory;
+  }
+  registerMesh.UseDistanceTransform = parameters.RegistrationUseDistanceTransform;
+  registerMesh.DistanceTransformSpacing = parameters.DistanceTransformSpacing;
+  registerMesh.DistanceTransformBandWidth = parameters.DistanceTransformBandWidth;
+  registerMesh.CorrespondenceUpdateInterval = parameters.CorrespondenceUpdateInterval;
+  registerMesh.ApproximateEpsilon = parameters.ApproximateEpsilon;
+  registerMesh.ApproximateSwitchTolerance = parameters.ApproximateSwitchTolerance;
+  registerMesh.PyramidLevels = parameters.PyramidLevels;
+  registerMesh.PyramidSpacing = parameters.PyramidSpacing;
+  registerMesh.PyramidSwitchTolerance = parameters.PyramidSwitchTolerance;
+  if (parameters.RegistrationUseSymmetricResidual) {
+    registerMesh.PrimaryResidual = sissr::PrimaryResidualType::Symmetric;
+  } else if (parameters.RegistrationUsePointToPlane) {
+    registerMesh.PrimaryResidual = sissr::PrimaryResidualType::PointToPlane;
+  }
 
   registerMesh.Register();
 
@@ -22,6 +22,16 @@ namespace {
       var = d[key.c_str()].GetDouble();
     }
   }
+  void check_and_set_int(const rapidjson::Document& d, int& var, const std::string& key) {
+    if (d.HasMember(key.c_str()) && d[key.c_str()].IsInt()) {
+      var = d[key.c_str()].GetInt();
+    }
+  }
+  void check_and_set_string(const rapidjson::Document& d, std::string& var, const std::string& key) {
+    if (d.HasMember(key.c_str()) && d[key.c_str()].IsString()) {
+      var = d[key.c_str()].GetString();
+    }
+  }
 }
 
 namespace sissr {
@@ -53,6 +63,30 @@ Parameters::SerializeJSON(rapidjson::PrettyWriter<rapidjson::StringBuffer> &writ
 
   writer.Key("RegistrationUseLabels");
   writer.Bool(this->RegistrationUseLabels);
+  writer.Key("RegistrationUseTriangles");
+  writer.Bool(this->RegistrationUseTriangles);
+  writer.Key("RegistrationUseDistanceTransform");
+  writer.Bool(this->RegistrationUseDistanceTransform);
+  writer.Key("DistanceTransformSpacing");
+  writer.Double(this->DistanceTransformSpacing);
+  writer.Key("DistanceTransformBandWidth");
+  writer.Double(this->DistanceTransformBandWidth);
+  writer.Key("CorrespondenceUpdateInterval");
+  writer.Uint(this->CorrespondenceUpdateInterval);
+  writer.Key("ApproximateEpsilon");
+  writer.Double(this->ApproximateEpsilon);
+  writer.Key("ApproximateSwitchTolerance");
+  writer.Double(this->ApproximateSwitchTolerance);
+  writer.Key("PyramidLevels");
+  writer.Uint(this->PyramidLevels);
+  writer.Key("PyramidSpacing");
+  writer.Double(this->PyramidSpacing);
+  writer.Key("PyramidSwitchTolerance");
+  writer.Double(this->PyramidSwitchTolerance);
+  writer.Key("RegistrationUsePointToPlane");
+  writer.Bool(this->RegistrationUsePointToPlane);
+  writer.Key("RegistrationUseSymmetricResidual");
+  writer.Bool(this->RegistrationUseSymmetricResidual);
   writer.Key("RegistrationWeights.Primary");
   writer.Double(this->RegistrationWeights.Primary);
   writer.Key("RegistrationWeights.EdgeWeight");
@@ -67,6 +101,10 @@ Parameters::SerializeJSON(rapidjson::PrettyWriter<rapidjson::StringBuffer> &writ
   writer.Double(this->RegistrationWeights.TriangleAspectRatio);
   writer.Key("RegistrationWeights.EdgeLength");
   writer.Double(this->RegistrationWeights.EdgeLength);
+  writer.Key("RegistrationWeights.Tangential");
+  writer.Double(this->RegistrationWeights.Tangential);
+  writer.Key("RegistrationWeights.Candidate");
+  writer.Double(this->RegistrationWeights.Candidate);
   writer.Key("RegistrationSamplingDensity");
   writer.Uint(this->RegistrationSamplingDensity);
 
@@ -80,6 +118,38 @@ Parameters::SerializeJSON(rapidjson::PrettyWriter<rapidjson::StringBuffer> &writ
   writer.Double(this->ParameterTolerance);
   writer.Key("DynamicSparsity");
   writer.Bool(this->DynamicSparsity);
+  writer.Key("LinearSolverType");
+  writer.String(this->LinearSolverType.c_str());
+  writer.Key("PreconditionerType");
+  writer.String(this->PreconditionerType.c_str());
+  writer.Key("SparseLinearAlgebraLibrary");
+  writer.String(this->SparseLinearAlgebraLibrary.c_str());
+  writer.Key("LinearSolverOrdering");
+  writer.String(this->LinearSolverOrdering.c_str());
+  writer.Key("UseMixedPrecisionSolves");
+  writer.Bool(this->UseMixedPrecisionSolves);
+  writer.Key("MaxNumRefinementIterations");
+  writer.Int(this->MaxNumRefinementIterations);
+  writer.Key("LinearSolverProbeIterations");
+  writer.Uint(this->LinearSolverProbeIterations);
+  writer.Key("NumberOfThreads");
+  writer.Uint(this->NumberOfThreads);
+  writer.Key("BatchPrimaryResiduals");
+  writer.Bool(this->BatchPrimaryResiduals);
+  writer.Key("CollapseLinearRegularizers");
+  writer.Bool(this->CollapseLinearRegularizers);
+  writer.Key("UseAlternatingSolver");
+  writer.Bool(this->UseAlternatingSolver);
+  writer.Key("UseMatrixFreeSolver");
+  writer.Bool(this->UseMatrixFreeSolver);
+  writer.Key("MatrixFreeLinearIterations");
+  writer.Uint(this->MatrixFreeLinearIterations);
+  writer.Key("MatrixFreeLinearTolerance");
+  writer.Double(this->MatrixFreeLinearTolerance);
+  writer.Key("CacheEliminationOrdering");
+  writer.Bool(this->CacheEliminationOrdering);
+  writer.Key("OrderingCacheDirectory");
+  writer.String(this->OrderingCacheDirectory.c_str());
 
   writer.Key("NumberOfSubdivisions");
   writer.Uint(this->NumberOfSubdivisions);
@@ -106,6 +176,18 @@ Parameters::DeserializeJSON(const rapidjson::Document &d)
   check_and_set_uint(d, this->CurrentFrame, "CurrentFrame");
 
   check_and_set_bool(d, this->RegistrationUseLabels, "RegistrationUseLabels");
+  check_and_set_bool(d, this->RegistrationUseTriangles, "RegistrationUseTriangles");
+  check_and_set_bool(d, this->RegistrationUseDistanceTransform, "RegistrationUseDistanceTransform");
+  check_and_set_double(d, this->DistanceTransformSpacing, "DistanceTransformSpacing");
+  check_and_set_double(d, this->DistanceTransformBandWidth, "DistanceTransformBandWidth");
+  check_and_set_uint(d, this->CorrespondenceUpdateInterval, "CorrespondenceUpdateInterval");
+  check_and_set_double(d, this->ApproximateEpsilon, "ApproximateEpsilon");
+  check_and_set_double(d, this->ApproximateSwitchTolerance, "ApproximateSwitchTolerance");
+  check_and_set_uint(d, this->PyramidLevels, "PyramidLevels");
+  check_and_set_double(d, this->PyramidSpacing, "PyramidSpacing");
+  check_and_set_double(d, this->PyramidSwitchTolerance, "PyramidSwitchTolerance");
+  check_and_set_bool(d, this->RegistrationUsePointToPlane, "RegistrationUsePointToPlane");
+  check_and_set_bool(d, this->RegistrationUseSymmetricResidual, "RegistrationUseSymmetricResidual");
   check_and_set_double(d, this->RegistrationWeights.Primary, "RegistrationWeights.Primary");
   check_and_set_double(d, this->RegistrationWeights.EdgeWeight, "RegistrationWeights.EdgeWeight");
   check_and_set_double(d, this->RegistrationWeights.Velocity, "RegistrationWeights.Velocity");
@@ -113,6 +195,8 @@ Parameters::DeserializeJSON(const rapidjson::Document &d)
   check_and_set_double(d, this->RegistrationWeights.ThinPlate, "RegistrationWeights.ThinPlate");
   check_and_set_double(d, this->RegistrationWeights.TriangleAspectRatio, "RegistrationWeights.TriangleAspectRatio");
   check_and_set_double(d, this->RegistrationWeights.EdgeLength, "RegistrationWeights.EdgeLength");
+  check_and_set_double(d, this->RegistrationWeights.Tangential, "RegistrationWeights.Tangential");
+  check_and_set_double(d, this->RegistrationWeights.Candidate, "RegistrationWeights.Candidate");
   check_and_set_uint(d, this->RegistrationSamplingDensity, "RegistrationSamplingDensity");
 
   // Solver parameters - need separate helper for int
@@ -125,6 +209,22 @@ Parameters::DeserializeJSON(const rapidjson::Document &d)
   check_and_set_double(d, this->FunctionTolerance, "FunctionTolerance");
   check_and_set_double(d, this->ParameterTolerance, "ParameterTolerance");
   check_and_set_bool(d, this->DynamicSparsity, "DynamicSparsity");
+  check_and_set_string(d, this->LinearSolverType, "LinearSolverType");
+  check_and_set_string(d, this->PreconditionerType, "PreconditionerType");
+  check_and_set_string(d, this->SparseLinearAlgebraLibrary, "SparseLinearAlgebraLibrary");
+  check_and_set_string(d, this->LinearSolverOrdering, "LinearSolverOrdering");
+  check_and_set_bool(d, this->UseMixedPrecisionSolves, "UseMixedPrecisionSolves");
+  check_and_set_int(d, this->MaxNumRefinementIterations, "MaxNumRefinementIterations");
+  check_and_set_uint(d, this->LinearSolverProbeIterations, "LinearSolverProbeIterations");
+  check_and_set_uint(d, this->NumberOfThreads, "NumberOfThreads");
+  check_and_set_bool(d, this->BatchPrimaryResiduals, "BatchPrimaryResiduals");
+  check_and_set_bool(d, this->CollapseLinearRegularizers, "CollapseLinearRegularizers");
+  check_and_set_bool(d, this->UseAlternatingSolver, "UseAlternatingSolver");
+  check_and_set_bool(d, this->UseMatrixFreeSolver, "UseMatrixFreeSolver");
+  check_and_set_uint(d, this->MatrixFreeLinearIterations, "MatrixFreeLinearIterations");
+  check_and_set_double(d, this->MatrixFreeLinearTolerance, "MatrixFreeLinearTolerance");
+  check_and_set_bool(d, this->CacheEliminationOrdering, "CacheEliminationOrdering");
+  check_and_set_string(d, this->OrderingCacheDirectory, "OrderingCacheDirectory");
 
   check_and_set_uint(d, this->NumberOfSubdivisions, "NumberOfSubdivisions");
 }
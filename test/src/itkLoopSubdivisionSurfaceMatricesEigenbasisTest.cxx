@@ -0,0 +1,84 @@
+// STD
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+#include <utility>
+
+// ITK
+#include <itkLoopSubdivisionSurfaceMatrices.h>
+
+// SiSSR Utils
+#include <sissrUtils.h>
+
+using TReal = double;
+using TMatrices = itk::LoopSubdivisionSurfaceMatrices<TReal, 3, 12>;
+using TParameters = TMatrices::TParameters;
+
+int
+main(int, char**)
+{
+
+  const TMatrices matrices;
+
+  for (unsigned int n = 3; n <= 12; ++n)
+    {
+
+    const unsigned int K = n + 6;
+
+    // Include samples close to the extraordinary vertex, where the
+    // number of required subdivisions is large.
+    const TParameters samples[] = {
+      {0.25, 0.25}, {0.6, 0.1}, {0.1, 0.6}, {0.05, 0.02},
+      {1e-3, 2e-3}, {3e-5, 1e-5}, {0.3, 0.0}, {0.0, 0.3}
+    };
+
+    for (const auto &p : samples)
+      {
+
+      ////////////////////////////////////////////////////
+      // Eigenbasis weights match explicit subdivision. //
+      ////////////////////////////////////////////////////
+
+      const auto expected = matrices.CalculateSurfaceWeightsBySubdivision(n, p);
+
+      TReal w[TMatrices::MaximumValency + 6];
+      TReal ws[TMatrices::MaximumValency + 6];
+      TReal wt[TMatrices::MaximumValency + 6];
+      matrices.EvaluateSurfaceWeights(n, p, w, ws, wt);
+
+      TReal sum = 0.0;
+      for (unsigned int i = 0; i < K; ++i)
+        {
+        assert(sissr::close(w[i], expected[i], 1e-8));
+        sum += w[i];
+        }
+
+      // Affine invariance.
+      assert(sissr::close(sum, 1.0, 1e-8));
+
+      ///////////////////////////////////////////
+      // Derivatives match finite differences. //
+      ///////////////////////////////////////////
+
+      // Scale the step with the distance from the extraordinary vertex.
+      const TReal h = std::min(p.first + p.second, TReal(1)) * 1e-4;
+
+      TReal w_s[TMatrices::MaximumValency + 6];
+      TReal w_t[TMatrices::MaximumValency + 6];
+      matrices.EvaluateSurfaceWeights(n, TParameters(p.first + h, p.second), w_s);
+      matrices.EvaluateSurfaceWeights(n, TParameters(p.first, p.second + h), w_t);
+
+      for (unsigned int i = 0; i < K; ++i)
+        {
+        const TReal tol = 1e-2 * (1.0 + std::abs(ws[i]) + std::abs(wt[i]));
+        assert(sissr::close((w_s[i] - w[i]) / h, ws[i], tol));
+        assert(sissr::close((w_t[i] - w[i]) / h, wt[i], tol));
+        }
+
+      }
+
+    }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,5 @@
+#include <itkLoopSubdivisionSurfacePrecomputedTables.h>
+#include <cstdlib>
+int main() {
+  return EXIT_SUCCESS;
+}
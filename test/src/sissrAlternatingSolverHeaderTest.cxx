@@ -0,0 +1,5 @@
+#include <sissrAlternatingSolver.h>
+#include <cstdlib>
+int main() {
+  return EXIT_SUCCESS;
+}
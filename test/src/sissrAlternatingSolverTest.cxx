@@ -0,0 +1,171 @@
+// STD
+#include <cassert>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+// Ceres
+#include <ceres/ceres.h>
+
+// SiSSR
+#include <sissrAlternatingSolver.h>
+#include <sissrUtils.h>
+
+// r = W (x - c), with W = diag(w): the primary point-to-point residual for
+// w = (1, 1, 1), with the target c held fixed
+class TargetCostFunction : public ceres::SizedCostFunction<3, 3>
+{
+public:
+  TargetCostFunction(const double* _c, const double* _w) :
+    c(_c), w(_w) {}
+
+  bool Evaluate(double const* const* parameters, double* residuals, double** jacobians) const override
+  {
+    for (unsigned int d = 0; d < 3; ++d) residuals[d] = w[d] * (parameters[0][d] - c[d]);
+    if (nullptr != jacobians && nullptr != jacobians[0])
+      for (unsigned int k = 0; k < 9; ++k) jacobians[0][k] = (k % 4) ? 0.0 : w[k / 4];
+    return true;
+  }
+
+private:
+  const double* c;
+  const double* w;
+};
+
+// r = a (x0 - x1): a velocity-like regularizer between two blocks
+class DifferenceCostFunction : public ceres::SizedCostFunction<3, 3, 3>
+{
+public:
+  explicit DifferenceCostFunction(const double _a) : a(_a) {}
+
+  bool Evaluate(double const* const* parameters, double* residuals, double** jacobians) const override
+  {
+    for (unsigned int d = 0; d < 3; ++d) residuals[d] = a * (parameters[0][d] - parameters[1][d]);
+    if (nullptr == jacobians) return true;
+    for (unsigned int b = 0; b < 2; ++b)
+      {
+      if (nullptr == jacobians[b]) continue;
+      for (unsigned int k = 0; k < 9; ++k) jacobians[b][k] = (k % 4) ? 0.0 : (b ? -a : a);
+      }
+    return true;
+  }
+
+private:
+  const double a;
+};
+
+// Primary residuals on every block, and the regularizer between neighbours
+void
+BuildProblem(ceres::Problem &problem,
+             std::vector<double> &x,
+             const std::vector<double> &c,
+             const double* w,
+             const unsigned int numberOfBlocks)
+{
+  for (unsigned int b = 0; b < numberOfBlocks; ++b)
+    problem.AddResidualBlock(new TargetCostFunction(&c[3 * b], w), nullptr, &x[3 * b]);
+  for (unsigned int b = 0; b + 1 < numberOfBlocks; ++b)
+    problem.AddResidualBlock(new DifferenceCostFunction(0.5 + b), nullptr, &x[3 * b], &x[3 * b + 3]);
+}
+
+std::vector<double*>
+Blocks(std::vector<double> &x)
+{
+  std::vector<double*> blocks;
+  for (size_t b = 0; b < x.size() / 3; ++b) blocks.push_back(&x[3 * b]);
+  return blocks;
+}
+
+int
+main(int, char**)
+{
+
+  std::mt19937 gen(0);
+  std::uniform_real_distribution<double> dist(-1.0, 1.0);
+
+  const unsigned int numberOfBlocks = 12;
+  std::vector<double> c(3 * numberOfBlocks), x0(3 * numberOfBlocks);
+  for (auto &v : c) v = dist(gen);
+  for (auto &v : x0) v = dist(gen);
+
+  ceres::Solver::Options options;
+  options.linear_solver_type = ceres::DENSE_QR;
+  options.max_num_iterations = 10;
+  options.function_tolerance = 1e-16;
+  options.gradient_tolerance = 1e-16;
+  options.parameter_tolerance = 1e-16;
+
+  // With the same weights on x, y and z, J is a scalar matrix times the
+  // identity, although Ceres stores each 3x3 block densely, zeros and all;
+  // with different weights it is not.
+  const double isotropic[3] = {1.0, 1.0, 1.0};
+  const double anisotropic[3] = {1.0, 2.0, 3.0};
+  for (const auto w : {isotropic, anisotropic})
+    {
+
+    std::vector<double> expected = x0;
+    ceres::Problem reference;
+    BuildProblem(reference, expected, c, w, numberOfBlocks);
+    ceres::Solver::Summary referenceSummary;
+    ceres::Solve(options, &reference, &referenceSummary);
+
+    std::vector<double> x = x0;
+    ceres::Problem problem;
+    BuildProblem(problem, x, c, w, numberOfBlocks);
+    unsigned int searches = 0;
+    sissr::AlternatingSolver solver(problem, Blocks(x), [&searches]() { ++searches; });
+    ceres::Solver::Summary summary;
+    solver.Solve(options, &summary);
+
+    assert(ceres::FAILURE != summary.termination_type);
+    assert((w == isotropic) == solver.GetKronecker());
+    assert(searches > 0);
+    assert(summary.final_cost <= summary.initial_cost);
+    assert(sissr::close(summary.final_cost, referenceSummary.final_cost, 1e-9));
+    for (size_t k = 0; k < x.size(); ++k)
+      assert(sissr::close(x[k], expected[k], 1e-8));
+
+    }
+
+  // The factorization is reused while the residual blocks stay the same,
+  // and redone once they change.
+  {
+  std::vector<double> x = x0;
+  ceres::Problem problem;
+  BuildProblem(problem, x, c, isotropic, numberOfBlocks);
+  sissr::AlternatingSolver solver(problem, Blocks(x), []() {});
+  ceres::Solver::Summary summary;
+  solver.Solve(options, &summary);
+  assert(1 == solver.GetNumberOfFactorizations());
+  x = x0;
+  solver.Solve(options, &summary);
+  assert(1 == solver.GetNumberOfFactorizations());
+
+  // Close the chain of regularizers into a loop.
+  const auto loop = [numberOfBlocks](ceres::Problem &p, std::vector<double> &v) {
+    return p.AddResidualBlock(new DifferenceCostFunction(2.0), nullptr, &v[3 * (numberOfBlocks - 1)], &v[0]);
+  };
+  const auto id = loop(problem, x);
+  x = x0;
+  solver.Solve(options, &summary);
+  assert(2 == solver.GetNumberOfFactorizations());
+  assert(solver.GetKronecker());
+
+  std::vector<double> expected = x0;
+  ceres::Problem reference;
+  BuildProblem(reference, expected, c, isotropic, numberOfBlocks);
+  loop(reference, expected);
+  ceres::Solver::Summary referenceSummary;
+  ceres::Solve(options, &reference, &referenceSummary);
+  assert(sissr::close(summary.final_cost, referenceSummary.final_cost, 1e-9));
+  for (size_t k = 0; k < x.size(); ++k)
+    assert(sissr::close(x[k], expected[k], 1e-8));
+
+  problem.RemoveResidualBlock(id);
+  solver.Solve(options, &summary);
+  assert(3 == solver.GetNumberOfFactorizations());
+  }
+
+  return EXIT_SUCCESS;
+
+}
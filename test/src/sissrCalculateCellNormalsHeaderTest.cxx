@@ -0,0 +1,5 @@
+#include <sissrCalculateCellNormals.h>
+#include <cstdlib>
+int main() {
+  return EXIT_SUCCESS;
+}
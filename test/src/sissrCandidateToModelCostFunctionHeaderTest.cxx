@@ -0,0 +1,5 @@
+#include <sissrCandidateToModelCostFunction.h>
+#include <cstdlib>
+int main() {
+  return EXIT_SUCCESS;
+}
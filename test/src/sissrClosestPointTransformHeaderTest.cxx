@@ -0,0 +1,5 @@
+#include <sissrClosestPointTransform.h>
+#include <cstdlib>
+int main() {
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,115 @@
+// STD
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+// ITK
+#include <itkMesh.h>
+#include <itkRegularSphereMeshSource.h>
+
+// SiSSR Utils
+#include <sissrUtils.h>
+
+// SiSSR
+#include <sissrClosestPointTransform.h>
+#include <sissrTriangleBVH.h>
+
+using TMesh = itk::Mesh<float, 3>;
+using TSource = itk::RegularSphereMeshSource<TMesh>;
+using TBVH = sissr::TriangleBVH<TMesh>;
+using TTransform = sissr::ClosestPointTransform<TMesh>;
+
+int
+main(int, char**)
+{
+
+  const auto source = TSource::New();
+  TSource::VectorType scale;
+  scale[0] = 50.0, scale[1] = 40.0, scale[2] = 30.0;
+  source->SetScale(scale);
+  source->SetResolution(4);
+  source->Update();
+  const auto mesh = source->GetOutput();
+
+  const auto bvh = TBVH::New();
+  bvh->SetMesh(mesh);
+  bvh->SetNumberOfThreads(4);
+  bvh->Initialize();
+
+  const double spacing = 0.5, band = 3.0;
+  const auto transform = TTransform::New();
+  transform->SetTriangles(bvh);
+  transform->SetSpacing(spacing);
+  transform->SetBandWidth(band);
+  transform->SetNumberOfThreads(4);
+  const auto estimate = transform->CalculateMemoryEstimate();
+  transform->Initialize();
+  assert(transform->GetNumberOfAllocatedBricks() > 0);
+
+  // Queries near the surface, and a few far outside the band
+  std::mt19937 gen(0);
+  std::normal_distribution<double> dist(0.0, 1.0);
+  std::vector<double> queries;
+  for (unsigned int i = 0; i < 2000; ++i)
+    {
+    const double x = dist(gen), y = dist(gen), z = dist(gen);
+    const double r = std::sqrt(x * x + y * y + z * z);
+    const double s = (i % 10) ? 1.0 + 0.02 * dist(gen) : 2.0;
+    queries.push_back(s * 50.0 * x / r);
+    queries.push_back(s * 40.0 * y / r);
+    queries.push_back(s * 30.0 * z / r);
+    }
+  const size_t count = queries.size() / 3;
+
+  std::vector<double> exact(queries.size()), closest(queries.size()), jacobians(9 * count);
+  bvh->FindClosestPoints(queries.data(), count, exact.data());
+  transform->FindClosestPoints(queries.data(), count, closest.data(), jacobians.data());
+
+  double meanError = 0.0;
+  for (size_t i = 0; i < count; ++i)
+    {
+    const double* q = queries.data() + 3 * i;
+    const double* J = jacobians.data() + 9 * i;
+    double error = 0.0, distance = 0.0;
+    for (unsigned int d = 0; d < 3; ++d)
+      {
+      error += std::pow(closest[3 * i + d] - exact[3 * i + d], 2);
+      distance += std::pow(q[d] - exact[3 * i + d], 2);
+      }
+    error = std::sqrt(error);
+    distance = std::sqrt(distance);
+    meanError += error / count;
+
+    // Exact search, and the identity, well outside the band
+    if (distance > band + 2.0 * std::sqrt(3.0) * spacing)
+      {
+      assert(sissr::close(error, 0.0, 1e-9));
+      for (unsigned int e = 0; e < 9; ++e) assert(sissr::close(J[e], (0 == e % 4) ? 1.0 : 0.0, 1e-12));
+      continue;
+      }
+    if (distance > band) continue;
+
+    // Interpolation error is bounded by the grid spacing.
+    assert(error < spacing);
+
+    // Moving along the residual changes it about one for one.
+    if (distance < 1e-3) continue;
+    double n[3], Jn[3] = {0.0, 0.0, 0.0};
+    for (unsigned int d = 0; d < 3; ++d) n[d] = (q[d] - exact[3 * i + d]) / distance;
+    for (unsigned int r = 0; r < 3; ++r)
+      for (unsigned int d = 0; d < 3; ++d)
+        Jn[r] += J[3 * r + d] * n[d];
+    double along = 0.0;
+    for (unsigned int d = 0; d < 3; ++d) along += Jn[d] * n[d];
+    assert(along > 0.5);
+    }
+
+  std::cout << transform->GetNumberOfAllocatedBricks() << " bricks, "
+            << estimate / (1024.0 * 1024.0) << " MiB; "
+            << "mean interpolation error " << meanError << std::endl;
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,5 @@
+#include <sissrControlPointBuffer.h>
+#include <cstdlib>
+int main() {
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,5 @@
+#include <sissrCorrespondenceEngine.h>
+#include <cstdlib>
+int main() {
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,5 @@
+#include <sissrCorrespondenceIterationCallback.h>
+#include <cstdlib>
+int main() {
+  return EXIT_SUCCESS;
+}
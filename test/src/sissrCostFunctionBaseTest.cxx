@@ -0,0 +1,191 @@
+// STD
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+// ITK
+#include <itkMesh.h>
+#include <itkQuadEdgeMeshTraits.h>
+#include <itkRegularSphereMeshSource.h>
+
+// SiSSR Utils
+#include <sissrUtils.h>
+
+// SiSSR
+#include <itkLoopSubdivisionSurfaceMesh.h>
+#include <sissrControlPointBuffer.h>
+#include <sissrCorrespondenceEngine.h>
+#include <sissrNearestPointUnlabeledCostFunction.h>
+#include <sissrTriangleBVH.h>
+
+using TReal = float;
+using TQEMeshTraits = itk::QuadEdgeMeshTraits<TReal, 3, TReal, TReal, TReal, TReal>;
+using TFixedMesh = itk::Mesh<TReal, 3>;
+using TMovingMesh = itk::LoopSubdivisionSurfaceMesh<TReal, 3, TQEMeshTraits>;
+using TFixedSource = itk::RegularSphereMeshSource<TFixedMesh>;
+using TMovingSource = itk::RegularSphereMeshSource<TMovingMesh>;
+using TEngine = sissr::CorrespondenceEngine<TFixedMesh, TMovingMesh>;
+using TCostFunction = sissr::NearestPointUnlabeledCostFunction<TFixedMesh, TMovingMesh>;
+
+int
+main(int, char**)
+{
+
+  std::mt19937 gen(0);
+  std::uniform_real_distribution<double> dist(-0.5, 0.5);
+
+  /////////////////////////////////////////////////////////////
+  // A subdivision sphere inside an ellipsoid of candidates. //
+  // Each triangle of the once split octahedron has at most  //
+  // one extraordinary (valence 4) vertex.                   //
+  /////////////////////////////////////////////////////////////
+
+  const auto movingSource = TMovingSource::New();
+  TMovingSource::VectorType movingScale;
+  movingScale.Fill(10.0);
+  movingSource->SetScale(movingScale);
+  movingSource->SetResolution(1);
+  movingSource->Update();
+  TMovingMesh::Pointer moving = movingSource->GetOutput();
+  for (auto it = moving->GetCells()->Begin(); it != moving->GetCells()->End(); ++it)
+    moving->SetCellData(it.Index(), 1.0f);
+  moving->Setup();
+
+  const auto fixedSource = TFixedSource::New();
+  TFixedSource::VectorType fixedScale;
+  fixedScale[0] = 12.0, fixedScale[1] = 11.0, fixedScale[2] = 9.0;
+  fixedSource->SetScale(fixedScale);
+  fixedSource->SetResolution(3);
+  fixedSource->Update();
+
+  const auto bvh = TEngine::TTriangleLocator::New();
+  bvh->SetMesh(fixedSource->GetOutput());
+  bvh->Initialize();
+
+  const unsigned int numberOfPoints = moving->GetNumberOfPoints();
+  std::vector<double> init;
+  for (unsigned int i = 0; i < numberOfPoints; ++i)
+    for (unsigned int d = 0; d < 3; ++d) init.push_back(moving->GetPoint(i)[d]);
+
+  // Offsets away from zero, so that the surface is not a sphere
+  std::vector<double> offsets(3 * numberOfPoints);
+  for (auto &o : offsets) o = dist(gen);
+
+  sissr::ControlPointBuffer buffer(init, offsets.data(), 1, numberOfPoints);
+  const TEngine::TMovingVector movingVector{moving};
+  TEngine engine(movingVector, buffer, 1);
+  engine.SetLocators(TEngine::TTriangleLocatorVector{bvh});
+  // Correspondences and normals are held fixed as the points move, as they
+  // are while Ceres evaluates the Jacobian.
+  engine.SetUpdateInterval(1);
+  buffer.AddUpdateCallback([&engine]() { engine.Update(); });
+
+  const size_t samples = moving->GetNumberOfSamplesPerCell();
+  const size_t numberOfCells = moving->GetNumberOfCells();
+  const double eps = 1e-3;
+
+  for (const auto type : {sissr::PrimaryResidualType::PointToPoint,
+                          sissr::PrimaryResidualType::PointToPlane,
+                          sissr::PrimaryResidualType::Symmetric})
+    {
+
+    engine.SetPrimaryResidualType(type);
+    engine.Update();
+    const bool projected = (sissr::PrimaryResidualType::PointToPoint != type);
+
+    for (const double weight : {1.0, 0.25, 0.0})
+      {
+      for (size_t c = 0; c < numberOfCells; ++c)
+        {
+
+        const unsigned int index = c * samples;
+        const TCostFunction costFunction(moving, engine, 0, index, samples, weight);
+        const auto &L = moving->GetPointListForCell(moving->GetSurfaceParameter(index).first);
+        const size_t rows = 3 * samples;
+
+        std::vector<double*> parameters;
+        for (size_t i = 0; i < L.size(); ++i) parameters.push_back(&offsets[3 * L[i]]);
+        std::vector<std::vector<double>> jacobianStorage(L.size(), std::vector<double>(3 * rows));
+        std::vector<double*> jacobians;
+        for (auto &j : jacobianStorage) jacobians.push_back(j.data());
+        std::vector<double> residuals(rows), residualsEps(rows);
+
+        const bool evaluated = costFunction.Evaluate(parameters.data(), residuals.data(), jacobians.data());
+        assert(evaluated);
+        (void)evaluated;
+
+        ///////////////////////////////////////////////////////////
+        // r = t e + (1 - t) (n . e) n, with t = sqrt(weight):   //
+        // the offset e itself for t = 1 or without normals, and //
+        // only its component along the normal for t = 0.        //
+        ///////////////////////////////////////////////////////////
+
+        const double t = std::sqrt(weight);
+        for (size_t s = 0; s < samples; ++s)
+          {
+          const double* p = engine.GetSurfacePoint(0, index + s);
+          const double* q = engine.GetCorrespondence(0, index + s);
+          const double* n = engine.GetNormal(0, index + s);
+          assert(projected == (nullptr != n));
+          double e[3], along = 0.0;
+          for (unsigned int d = 0; d < 3; ++d) e[d] = p[d] - q[d];
+          if (projected)
+            {
+            assert(sissr::close(n[0] * n[0] + n[1] * n[1] + n[2] * n[2], 1.0, 1e-9));
+            along = n[0] * e[0] + n[1] * e[1] + n[2] * e[2];
+            }
+          for (unsigned int d = 0; d < 3; ++d)
+            {
+            const double expected = projected ? t * e[d] + (1.0 - t) * along * n[d] : e[d];
+            assert(sissr::close(residuals[3 * s + d], expected, 1e-9));
+            if (1.0 == weight) assert(sissr::close(residuals[3 * s + d], e[d], 1e-9));
+            if (0.0 == weight && projected) assert(sissr::close(residuals[3 * s + d], along * n[d], 1e-9));
+            }
+          }
+
+        ///////////////////////////////////////////////////////
+        // The Jacobian is w P per sample and control point, //
+        // with P = t I + (1 - t) n n^T, and matches forward //
+        // differences.                                      //
+        ///////////////////////////////////////////////////////
+
+        for (size_t i = 0; i < L.size(); ++i)
+          {
+          for (size_t s = 0; s < samples; ++s)
+            {
+            const double w = moving->GetStencil(index + s)[i];
+            const double* n = engine.GetNormal(0, index + s);
+            for (unsigned int r = 0; r < 3; ++r)
+              for (unsigned int k = 0; k < 3; ++k)
+                {
+                const double identity = (r == k) ? 1.0 : 0.0;
+                const double P = projected ? t * identity + (1.0 - t) * n[r] * n[k] : identity;
+                assert(sissr::close(jacobians[i][9 * s + 3 * r + k], w * P, 1e-9));
+                }
+            }
+
+          for (unsigned int d = 0; d < 3; ++d)
+            {
+            offsets[3 * L[i] + d] += eps;
+            buffer.Update();
+            costFunction.Evaluate(parameters.data(), residualsEps.data(), nullptr);
+            offsets[3 * L[i] + d] -= eps;
+            buffer.Update();
+            for (size_t r = 0; r < rows; ++r)
+              {
+              const double fd = (residualsEps[r] - residuals[r]) / eps;
+              assert(sissr::close(jacobians[i][3 * r + d], fd, 1e-6));
+              }
+            }
+          }
+
+        }
+      }
+
+    }
+
+  return EXIT_SUCCESS;
+
+}
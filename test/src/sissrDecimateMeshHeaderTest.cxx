@@ -0,0 +1,5 @@
+#include <sissrDecimateMesh.h>
+#include <cstdlib>
+int main() {
+  return EXIT_SUCCESS;
+}
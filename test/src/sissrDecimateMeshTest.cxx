@@ -0,0 +1,92 @@
+// STD
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <set>
+
+// ITK
+#include <itkMesh.h>
+#include <itkRegularSphereMeshSource.h>
+
+// SiSSR
+#include <sissrDecimateMesh.h>
+
+using TMesh = itk::Mesh<float, 3>;
+using TSource = itk::RegularSphereMeshSource<TMesh>;
+
+int
+main(int, char**)
+{
+
+  const auto source = TSource::New();
+  TSource::VectorType scale;
+  scale[0] = 50.0, scale[1] = 40.0, scale[2] = 30.0;
+  source->SetScale(scale);
+  source->SetResolution(5);
+  source->Update();
+  const auto mesh = source->GetOutput();
+
+  // Two labels, split at z = 0
+  for (auto it = mesh->GetCells()->Begin(); it != mesh->GetCells()->End(); ++it)
+    {
+    const auto p = mesh->GetPoint(it.Value()->GetPointIds()[0]);
+    mesh->SetCellData(it.Index(), (p[2] < 0.0) ? 1.0f : 2.0f);
+    }
+
+  const double length = sissr::CalculateMeanEdgeLength<TMesh>(mesh);
+  assert(length > 0.0);
+
+  size_t previous = mesh->GetNumberOfCells();
+  for (const double factor : {2.0, 4.0, 8.0})
+    {
+
+    const double spacing = factor * length;
+    const auto decimated = sissr::DecimateMesh<TMesh>(mesh, spacing);
+
+    // Coarser with the spacing
+    assert(decimated->GetNumberOfCells() > 0);
+    assert(decimated->GetNumberOfCells() < previous);
+    previous = decimated->GetNumberOfCells();
+
+    // Each point is the mean of points within one grid cell, so lies within
+    // a grid cell's diagonal of the input points.
+    for (auto it = decimated->GetPoints()->Begin(); it != decimated->GetPoints()->End(); ++it)
+      {
+      double closest = std::numeric_limits<double>::max();
+      for (auto jt = mesh->GetPoints()->Begin(); jt != mesh->GetPoints()->End(); ++jt)
+        {
+        closest = std::min(closest, double(it.Value().EuclideanDistanceTo(jt.Value())));
+        }
+      assert(closest <= std::sqrt(3.0) * spacing);
+      }
+
+    // Triangles, neither degenerate nor repeated within a label; both
+    // labels are kept.
+    std::set<std::pair<float, std::array<TMesh::PointIdentifier, 3>>> seen;
+    std::set<float> labels;
+    for (auto it = decimated->GetCells()->Begin(); it != decimated->GetCells()->End(); ++it)
+      {
+      assert(3 == it.Value()->GetNumberOfPoints());
+      const auto ids = it.Value()->GetPointIds();
+      std::array<TMesh::PointIdentifier, 3> triangle = {ids[0], ids[1], ids[2]};
+      std::sort(triangle.begin(), triangle.end());
+      assert(triangle[0] != triangle[1] && triangle[1] != triangle[2]);
+      const float label = decimated->GetCellData()->ElementAt(it.Index());
+      const bool unique = seen.emplace(label, triangle).second;
+      assert(unique);
+      (void)unique;
+      labels.insert(label);
+      }
+    assert(2 == labels.size());
+
+    std::cout << "Spacing " << spacing << ": " << decimated->GetNumberOfCells() << " of "
+              << mesh->GetNumberOfCells() << " cells" << std::endl;
+
+    }
+
+  return EXIT_SUCCESS;
+}
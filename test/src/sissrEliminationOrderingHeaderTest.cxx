@@ -0,0 +1,5 @@
+#include <sissrEliminationOrdering.h>
+#include <cstdlib>
+int main() {
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,140 @@
+// STD
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <numeric>
+#include <string>
+#include <vector>
+
+// Ceres
+#include <ceres/ceres.h>
+
+// SiSSR
+#include <sissrEliminationOrdering.h>
+
+// r = x0 - x1
+class DifferenceCostFunction : public ceres::SizedCostFunction<3, 3, 3>
+{
+public:
+  bool Evaluate(double const* const* parameters, double* residuals, double** jacobians) const override
+  {
+    for (unsigned int d = 0; d < 3; ++d) residuals[d] = parameters[0][d] - parameters[1][d];
+    if (nullptr == jacobians) return true;
+    for (unsigned int b = 0; b < 2; ++b)
+      {
+      if (nullptr == jacobians[b]) continue;
+      for (unsigned int k = 0; k < 9; ++k) jacobians[b][k] = (k % 4) ? 0.0 : (b ? -1.0 : 1.0);
+      }
+    return true;
+  }
+};
+
+void
+WriteText(const std::string &fileName, const std::string &text)
+{
+  std::ofstream stream(fileName);
+  stream << text;
+}
+
+int
+main(int, char**)
+{
+
+  const unsigned int numberOfBlocks = 10;
+  std::vector<double> x(3 * numberOfBlocks, 0.0);
+  std::vector<double*> blocks;
+  for (unsigned int b = 0; b < numberOfBlocks; ++b) blocks.push_back(&x[3 * b]);
+
+  // A chain of differences, and the same chain in another problem
+  ceres::Problem problem, same;
+  for (unsigned int b = 0; b + 1 < numberOfBlocks; ++b)
+    {
+    problem.AddResidualBlock(new DifferenceCostFunction, nullptr, blocks[b], blocks[b + 1]);
+    same.AddResidualBlock(new DifferenceCostFunction, nullptr, blocks[b], blocks[b + 1]);
+    }
+
+  const auto structure = sissr::CalculateBlockStructure(problem, blocks);
+  assert(numberOfBlocks - 1 == structure.size());
+  for (unsigned int b = 0; b + 1 < numberOfBlocks; ++b)
+    assert((std::vector<int>{int(b), int(b + 1)}) == structure[b]);
+
+  /////////////////////////////////////////////////////////
+  // The hash is stable, and changes with the structure. //
+  /////////////////////////////////////////////////////////
+
+  const auto hash = sissr::HashBlockStructure(structure, numberOfBlocks, "AMD");
+  assert(16 == hash.size());
+  assert(hash == sissr::HashBlockStructure(structure, numberOfBlocks, "AMD"));
+  assert(hash == sissr::HashBlockStructure(sissr::CalculateBlockStructure(same, blocks), numberOfBlocks, "AMD"));
+  assert(hash != sissr::HashBlockStructure(structure, numberOfBlocks, "NESDIS"));
+  assert(hash != sissr::HashBlockStructure(structure, numberOfBlocks + 1, "AMD"));
+
+  problem.AddResidualBlock(new DifferenceCostFunction, nullptr, blocks[numberOfBlocks - 1], blocks[0]);
+  const auto loop = sissr::CalculateBlockStructure(problem, blocks);
+  assert(hash != sissr::HashBlockStructure(loop, numberOfBlocks, "AMD"));
+
+  auto swapped = structure;
+  std::swap(swapped[0][0], swapped[0][1]);
+  assert(hash != sissr::HashBlockStructure(swapped, numberOfBlocks, "AMD"));
+
+  ////////////////////////////////////
+  // The ordering is a permutation. //
+  ////////////////////////////////////
+
+  const auto ordering = sissr::CalculateEliminationOrdering(loop, numberOfBlocks, ceres::AMD);
+  assert(numberOfBlocks == ordering.size());
+  auto sorted = ordering;
+  std::sort(sorted.begin(), sorted.end());
+  std::vector<int> identity(numberOfBlocks);
+  std::iota(identity.begin(), identity.end(), 0);
+  assert(identity == sorted);
+
+  ////////////////////////////////////////////////////
+  // Orderings are read back as written; others are //
+  // rejected and leave the output alone.           //
+  ////////////////////////////////////////////////////
+
+  const auto directory = std::filesystem::temp_directory_path() / ("sissrEliminationOrderingTest-" + hash);
+  const auto fileName = (directory / "ordering.txt").string();
+  sissr::WriteEliminationOrdering(fileName, ordering);
+
+  std::vector<int> read;
+  assert(sissr::ReadEliminationOrdering(fileName, numberOfBlocks, read));
+  assert(ordering == read);
+
+  // Written again in place, through a temporary file which is not left behind
+  auto reversed = ordering;
+  std::reverse(reversed.begin(), reversed.end());
+  sissr::WriteEliminationOrdering(fileName, reversed);
+  assert(sissr::ReadEliminationOrdering(fileName, numberOfBlocks, read));
+  assert(reversed == read);
+  const auto files = std::distance(std::filesystem::directory_iterator(directory), std::filesystem::directory_iterator());
+  assert(1 == files);
+
+  const std::vector<int> sentinel{-1};
+  const auto rejected = [&](const std::string &text, const size_t n) {
+    WriteText(fileName, text);
+    read = sentinel;
+    return !sissr::ReadEliminationOrdering(fileName, n, read) && sentinel == read;
+  };
+  assert(rejected("3\n0\n1\n2\n", 4));      // Another number of blocks
+  assert(rejected("3\n0\n1\n", 3));         // Truncated
+  assert(rejected("3\n0\n1\n1\n", 3));      // Repeated block
+  assert(rejected("3\n0\n1\n3\n", 3));      // Out of range
+  assert(rejected("3\n0\n-1\n2\n", 3));     // Negative
+  assert(rejected("3\n0\nx\n2\n", 3));      // Not a number
+  assert(rejected("3\n0\n1\n2\n3\n", 3));   // Trailing entries
+  assert(rejected("", 3));                  // Empty
+  assert(!sissr::ReadEliminationOrdering((directory / "none.txt").string(), 3, read));
+
+  WriteText(fileName, "3\n2\n0\n1\n");
+  assert(sissr::ReadEliminationOrdering(fileName, 3, read));
+  assert((std::vector<int>{2, 0, 1}) == read);
+
+  std::filesystem::remove_all(directory);
+
+  return EXIT_SUCCESS;
+
+}
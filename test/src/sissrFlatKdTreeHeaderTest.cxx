@@ -0,0 +1,5 @@
+#include <sissrFlatKdTree.h>
+#include <cstdlib>
+int main() {
+  return EXIT_SUCCESS;
+}
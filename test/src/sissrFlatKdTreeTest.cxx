@@ -0,0 +1,179 @@
+// STD
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <vector>
+
+// ITK
+#include <itkPointSet.h>
+#include <itkPointsLocator.h>
+
+// SiSSR Utils
+#include <sissrUtils.h>
+
+// SiSSR
+#include <sissrFlatKdTree.h>
+
+using TPointSet = itk::PointSet<float, 3>;
+using TContainer = TPointSet::PointsContainer;
+using TPoint = TPointSet::PointType;
+using TLocator = itk::PointsLocator<TContainer>;
+using TTree = sissr::FlatKdTree<TContainer>;
+
+int
+main(int, char**)
+{
+
+  std::mt19937 gen(0);
+  std::uniform_real_distribution<float> dist(-50.0, 50.0);
+
+  const auto random_point = [&gen, &dist](const float scale)
+    {
+    TPoint p;
+    for (unsigned int d = 0; d < 3; ++d) p[d] = scale * dist(gen);
+    return p;
+    };
+
+  for (const unsigned int numberOfPoints : {1, 2, 9, 1000, 100000})
+    {
+
+    const auto pointset = TPointSet::New();
+    for (unsigned int i = 0; i < numberOfPoints; ++i)
+      {
+      pointset->SetPoint(i, random_point(1.0));
+      }
+
+    // The same points as one label's range of a shared container, as in
+    // sissr::LabeledMeshToKdTreeMap, between other labels' points.
+    const unsigned int first = 17;
+    const auto shared = TPointSet::New();
+    for (unsigned int i = 0; i < first; ++i) shared->SetPoint(i, random_point(1.0));
+    for (unsigned int i = 0; i < numberOfPoints; ++i) shared->SetPoint(first + i, pointset->GetPoint(i));
+    for (unsigned int i = 0; i < first; ++i) shared->SetPoint(first + numberOfPoints + i, random_point(1.0));
+
+    const auto locator = TLocator::New();
+    locator->SetPoints(pointset->GetPoints());
+    locator->Initialize();
+
+    std::vector<TPoint> queries;
+    for (unsigned int i = 0; i < 10000; ++i)
+      {
+      // Some queries fall outside the bounding box.
+      queries.push_back(random_point(1.2));
+      }
+
+    for (const bool quantize : {false, true})
+      {
+
+      const auto tree = TTree::New();
+      tree->SetUseQuantization(quantize);
+      tree->SetPoints(pointset->GetPoints());
+      tree->Initialize();
+      assert(numberOfPoints == tree->GetNumberOfPoints());
+
+      const auto range = TTree::New();
+      range->SetUseQuantization(quantize);
+      range->SetPoints(shared->GetPoints());
+      range->SetRange(first, first + numberOfPoints);
+      range->Initialize();
+      assert(numberOfPoints == range->GetNumberOfPoints());
+
+      /////////////////////////////////////////////
+      // At least as close as the ITK locator's. //
+      /////////////////////////////////////////////
+
+      for (const auto &q : queries)
+        {
+        const auto expected = pointset->GetPoints()->ElementAt(locator->FindClosestPoint(q));
+        const auto actual = tree->GetPoints()->ElementAt(tree->FindClosestPoint(q));
+        assert(q.SquaredEuclideanDistanceTo(actual) <= q.SquaredEuclideanDistanceTo(expected));
+
+        const auto id = range->FindClosestPoint(q);
+        assert(id >= first && id < first + numberOfPoints);
+        assert(q.SquaredEuclideanDistanceTo(range->GetPoints()->ElementAt(id)) <= q.SquaredEuclideanDistanceTo(expected));
+        }
+
+      //////////////////////////////////////////////////////////
+      // Batches match a brute force search, in ids and gaps, //
+      // and approximate answers are within (1 + epsilon)^2   //
+      // of the closest squared distance.                     //
+      //////////////////////////////////////////////////////////
+
+      const size_t count = queries.size();
+      std::vector<double> coordinates;
+      for (const auto &q : queries)
+        for (unsigned int d = 0; d < 3; ++d) coordinates.push_back(q[d]);
+
+      // Only a few queries for the larger sets: each scans all the points.
+      const size_t checked = (numberOfPoints <= 1000) ? count : 200;
+      const double epsilon = 0.25;
+
+      for (const auto &index : {tree, range})
+        {
+        std::vector<TTree::PointIdentifier> ids(count), approximate(count);
+        std::vector<double> gaps(count);
+        index->FindClosestPoints(coordinates.data(), count, ids.data(), gaps.data());
+        index->FindClosestPoints(coordinates.data(), count, approximate.data(), nullptr, epsilon);
+
+        const unsigned int begin = (index == range) ? first : 0;
+        for (size_t i = 0; i < checked; ++i)
+          {
+          const auto &q = queries[i];
+          double expected = std::numeric_limits<double>::max();
+          double second = std::numeric_limits<double>::max();
+          TTree::PointIdentifier id = 0;
+          for (unsigned int j = begin; j < begin + numberOfPoints; ++j)
+            {
+            const double d2 = q.SquaredEuclideanDistanceTo(index->GetPoints()->ElementAt(j));
+            second = std::min(second, std::max(expected, d2));
+            if (d2 < expected) id = j;
+            expected = std::min(expected, d2);
+            }
+
+          const double actual = q.SquaredEuclideanDistanceTo(index->GetPoints()->ElementAt(ids[i]));
+          assert(ids[i] >= begin && ids[i] < begin + numberOfPoints);
+          assert(sissr::close(actual, expected, 1e-12 * (1.0 + expected)));
+          if (second > expected) assert(id == ids[i]);
+          if (std::numeric_limits<double>::max() == second)
+            assert(gaps[i] > 1e100);
+          else
+            assert(sissr::close(gaps[i], std::sqrt(second) - std::sqrt(expected), 1e-6));
+
+          const double approximated = q.SquaredEuclideanDistanceTo(index->GetPoints()->ElementAt(approximate[i]));
+          assert(approximate[i] >= begin && approximate[i] < begin + numberOfPoints);
+          assert(approximated <= (1.0 + epsilon) * (1.0 + epsilon) * expected + 1e-9 * (1.0 + expected));
+          }
+        }
+
+      ///////////////
+      // Benchmark //
+      ///////////////
+
+      const auto time = [&queries](const auto &index)
+        {
+        volatile size_t checksum = 0;
+        const auto start = std::chrono::steady_clock::now();
+        for (const auto &q : queries) checksum = checksum + index->FindClosestPoint(q);
+        const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        return elapsed.count() / queries.size();
+        };
+
+      const auto itkTime = time(locator);
+      const auto treeTime = time(tree);
+
+      std::cout << numberOfPoints << " points"
+                << (quantize ? " (quantized)" : "")
+                << ": itk::PointsLocator " << itkTime << " ns/query, "
+                << "sissr::FlatKdTree " << treeTime << " ns/query" << std::endl;
+
+      }
+
+    }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,5 @@
+#include <sissrLabeledMeshToTriangleBVHMap.h>
+#include <cstdlib>
+int main() {
+  return EXIT_SUCCESS;
+}
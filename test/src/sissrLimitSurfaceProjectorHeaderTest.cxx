@@ -0,0 +1,5 @@
+#include <sissrLimitSurfaceProjector.h>
+#include <cstdlib>
+int main() {
+  return EXIT_SUCCESS;
+}
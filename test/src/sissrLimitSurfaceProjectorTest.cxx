@@ -0,0 +1,190 @@
+// STD
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+
+// ITK
+#include <itkQuadEdgeMeshTraits.h>
+#include <itkRegularSphereMeshSource.h>
+
+// SiSSR Utils
+#include <sissrUtils.h>
+
+// SiSSR
+#include <itkLoopSubdivisionSurfaceMesh.h>
+#include <sissrCandidateToModelCostFunction.h>
+#include <sissrControlPointBuffer.h>
+#include <sissrLimitSurfaceProjector.h>
+
+using TReal = float;
+using TQEMeshTraits = itk::QuadEdgeMeshTraits<TReal, 3, TReal, TReal, TReal, TReal>;
+using TMesh = itk::LoopSubdivisionSurfaceMesh<TReal, 3, TQEMeshTraits>;
+using TSource = itk::RegularSphereMeshSource<TMesh>;
+using TProjector = sissr::LimitSurfaceProjector<TMesh>;
+using TCostFunction = sissr::CandidateToModelCostFunction<TMesh>;
+
+// Closest point to q, by searching each patch on its own
+TProjector::Projection
+FindClosestPointByPatch(const TMesh::Pointer &mesh, const sissr::ControlPointBuffer &buffer, const double* q)
+{
+  TProjector::Projection best;
+  for (auto it = mesh->GetCells()->Begin(); it != mesh->GetCells()->End(); ++it)
+    {
+    const TProjector single(mesh, buffer, 0, 1, {it.Index()});
+    TProjector::Projection projection;
+    single.FindClosestPoints(q, 1, &projection);
+    if (projection.distance < best.distance) best = projection;
+    }
+  return best;
+}
+
+int
+main(int, char**)
+{
+
+  /////////////////////////////////////////////////////////////
+  // A subdivision sphere, each triangle of which has at     //
+  // most one extraordinary (valence 4) vertex, and one      //
+  // candidate outside it, above a cell near the equator.    //
+  /////////////////////////////////////////////////////////////
+
+  const auto source = TSource::New();
+  TSource::VectorType scale;
+  scale.Fill(10.0);
+  source->SetScale(scale);
+  source->SetResolution(1);
+  source->Update();
+  TMesh::Pointer mesh = source->GetOutput();
+  for (auto it = mesh->GetCells()->Begin(); it != mesh->GetCells()->End(); ++it)
+    mesh->SetCellData(it.Index(), 1.0f);
+  mesh->Setup();
+
+  const unsigned int numberOfPoints = mesh->GetNumberOfPoints();
+  std::vector<double> init;
+  for (unsigned int i = 0; i < numberOfPoints; ++i)
+    for (unsigned int d = 0; d < 3; ++d) init.push_back(mesh->GetPoint(i)[d]);
+  std::vector<double> offsets(init.size(), 0.0);
+  sissr::ControlPointBuffer buffer(init, offsets.data(), 1, numberOfPoints);
+
+  double q[3] = {0.0, 0.0, 0.0};
+  double equator = -1.0;
+  for (auto it = mesh->GetCells()->Begin(); it != mesh->GetCells()->End(); ++it)
+    {
+    double centroid[3] = {0.0, 0.0, 0.0};
+    for (auto id = it.Value()->PointIdsBegin(); id != it.Value()->PointIdsEnd(); ++id)
+      for (unsigned int d = 0; d < 3; ++d) centroid[d] += init[3 * (*id) + d] / 3.0;
+    const double norm = std::sqrt(centroid[0] * centroid[0] + centroid[1] * centroid[1] + centroid[2] * centroid[2]);
+    const double radial = std::sqrt(centroid[0] * centroid[0] + centroid[1] * centroid[1]) / norm;
+    if (radial <= equator) continue;
+    equator = radial;
+    for (unsigned int d = 0; d < 3; ++d) q[d] = 12.0 * centroid[d] / norm;
+    }
+
+  TProjector projector(mesh, buffer, 0, 2);
+  projector.SetCandidates({q[0], q[1], q[2]});
+  projector.ProjectCandidates();
+  buffer.AddUpdateCallback([&projector]() { projector.Update(); });
+
+  /////////////////////////////////////////////////////////
+  // The hierarchy finds the closest of all the patches. //
+  /////////////////////////////////////////////////////////
+
+  const auto first = projector.GetCandidateProjection(0);
+  const auto expected = FindClosestPointByPatch(mesh, buffer, q);
+  assert(sissr::close(first.distance, expected.distance, 1e-6));
+  assert(first.distance > 0.0);
+  assert(first.distance < 4.0 * 4.0);
+
+  const TCostFunction costFunction(projector, 0);
+  assert(first.patch == costFunction.GetPatch());
+  assert(projector.GetNumberOfControlPoints(first.patch) == costFunction.parameter_block_sizes().size());
+
+  ////////////////////////////////////////////////////////////
+  // Rotating the control points by 60 degrees about z      //
+  // moves the candidate's closest point onto another       //
+  // patch.  Refining within the patch, as during a solve,  //
+  // stays on its border; projecting again finds the new    //
+  // patch.                                                 //
+  ////////////////////////////////////////////////////////////
+
+  const double angle = M_PI / 3.0;
+  for (unsigned int i = 0; i < numberOfPoints; ++i)
+    {
+    const double* x = &init[3 * i];
+    offsets[3 * i + 0] = std::cos(angle) * x[0] - std::sin(angle) * x[1] - x[0];
+    offsets[3 * i + 1] = std::sin(angle) * x[0] + std::cos(angle) * x[1] - x[1];
+    }
+  buffer.Update();
+
+  const auto rotated = FindClosestPointByPatch(mesh, buffer, q);
+
+  const auto refined = projector.GetCandidateProjection(0);
+  assert(first.patch == refined.patch);
+  assert(refined.distance > rotated.distance + 1.0);
+
+  projector.ProjectCandidates();
+  const auto moved = projector.GetCandidateProjection(0);
+  assert(first.patch != moved.patch);
+  assert(sissr::close(moved.distance, rotated.distance, 1e-6));
+
+  ////////////////////////////////////////////////////////////
+  // The residual block built on the first patch no longer  //
+  // evaluates; one built again on the new patch does, and  //
+  // its Jacobian holds the weights, which reproduce the    //
+  // point.  Projected back onto the first patch, the       //
+  // candidate's first block evaluates again.               //
+  ////////////////////////////////////////////////////////////
+
+  const auto check = [&](const TCostFunction &cost, const TProjector::Projection &projection)
+    {
+    const auto C = projector.GetControlPoints(projection.patch);
+    const unsigned int count = projector.GetNumberOfControlPoints(projection.patch);
+    assert(count == cost.parameter_block_sizes().size());
+    const auto w = projector.GetCandidateWeights(0);
+    double sum = 0.0, point[3] = {0.0, 0.0, 0.0};
+    for (unsigned int k = 0; k < count; ++k)
+      {
+      sum += w[k];
+      for (unsigned int d = 0; d < 3; ++d) point[d] += w[k] * buffer.GetPoint(0, C[k])[d];
+      }
+    assert(sissr::close(sum, 1.0, 1e-5));
+    for (unsigned int d = 0; d < 3; ++d)
+      assert(sissr::close(point[d], projection.point[d], 1e-4));
+
+    std::vector<std::vector<double>> jacobianStorage(count, std::vector<double>(9, -1.0));
+    std::vector<double*> jacobians;
+    for (auto &j : jacobianStorage) jacobians.push_back(j.data());
+    double residuals[3];
+    const bool evaluated = cost.Evaluate(nullptr, residuals, jacobians.data());
+    assert(evaluated);
+    (void)evaluated;
+    for (unsigned int d = 0; d < 3; ++d)
+      assert(sissr::close(residuals[d], projection.point[d] - q[d], 1e-9));
+    for (unsigned int i = 0; i < count; ++i)
+      for (unsigned int r = 0; r < 3; ++r)
+        for (unsigned int c = 0; c < 3; ++c)
+          assert(sissr::close(jacobians[i][3 * r + c], (r == c) ? w[i] : 0.0, 1e-12));
+    };
+
+  double residuals[3];
+  const bool stale = !costFunction.Evaluate(nullptr, residuals, nullptr);
+  assert(stale);
+  (void)stale;
+
+  const TCostFunction rebuilt(projector, 0);
+  assert(moved.patch == rebuilt.GetPatch());
+  check(rebuilt, moved);
+
+  projector.ProjectCandidate(0, first.patch);
+  const auto back = projector.GetCandidateProjection(0);
+  assert(first.patch == back.patch);
+  assert(back.distance > rotated.distance + 1.0);
+  const bool staleAgain = !rebuilt.Evaluate(nullptr, residuals, nullptr);
+  assert(staleAgain);
+  (void)staleAgain;
+  check(costFunction, back);
+
+  return EXIT_SUCCESS;
+
+}
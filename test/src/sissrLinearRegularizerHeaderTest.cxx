@@ -0,0 +1,5 @@
+#include <sissrLinearRegularizer.h>
+#include <cstdlib>
+int main() {
+  return EXIT_SUCCESS;
+}
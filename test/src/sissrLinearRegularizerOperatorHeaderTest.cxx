@@ -0,0 +1,5 @@
+#include <sissrLinearRegularizerOperator.h>
+#include <cstdlib>
+int main() {
+  return EXIT_SUCCESS;
+}
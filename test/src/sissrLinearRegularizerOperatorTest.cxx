@@ -0,0 +1,219 @@
+// STD
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+// ITK
+#include <itkQuadEdgeMeshTraits.h>
+#include <itkRegularSphereMeshSource.h>
+
+// Ceres
+#include <ceres/ceres.h>
+
+// SiSSR Utils
+#include <sissrUtils.h>
+
+// SiSSR
+#include <itkLoopSubdivisionSurfaceMesh.h>
+#include <sissrAccelerationRegularizer.h>
+#include <sissrControlPointBuffer.h>
+#include <sissrEdgeLengthRegularizer.h>
+#include <sissrLinearRegularizer.h>
+#include <sissrLinearRegularizerOperator.h>
+#include <sissrThinPlateRegularizer.h>
+#include <sissrVelocityRegularizer.h>
+
+using TReal = float;
+using TQEMeshTraits = itk::QuadEdgeMeshTraits<TReal, 3, TReal, TReal, TReal, TReal>;
+using TMesh = itk::LoopSubdivisionSurfaceMesh<TReal, 3, TQEMeshTraits>;
+using TSource = itk::RegularSphereMeshSource<TMesh>;
+using TOperator = sissr::LinearRegularizerOperator<TMesh>;
+
+struct Weights
+{
+  double Velocity, Acceleration, ThinPlate, EdgeLength;
+};
+
+struct Evaluation
+{
+  double cost = 0.0;
+  std::vector<double> residuals, gradient;
+  std::vector<double> JTJ; // Dense, n x n
+};
+
+Evaluation
+Evaluate(ceres::Problem &problem, const std::vector<double*> &blocks)
+{
+  ceres::Problem::EvaluateOptions options;
+  options.parameter_blocks = blocks;
+  Evaluation e;
+  ceres::CRSMatrix J;
+  problem.Evaluate(options, &e.cost, &e.residuals, &e.gradient, &J);
+  const size_t n = J.num_cols;
+  e.JTJ.assign(n * n, 0.0);
+  for (int r = 0; r < J.num_rows; ++r)
+    for (int a = J.rows[r]; a < J.rows[r + 1]; ++a)
+      for (int b = J.rows[r]; b < J.rows[r + 1]; ++b)
+        e.JTJ[J.cols[a] * n + J.cols[b]] += J.values[a] * J.values[b];
+  std::sort(e.residuals.begin(), e.residuals.end());
+  return e;
+}
+
+int
+main(int, char**)
+{
+
+  std::mt19937 gen(0);
+  std::uniform_real_distribution<double> dist(-1.0, 1.0);
+
+  /////////////////////////////////////////////////////////////
+  // Three frames of a subdivision sphere, each triangle of  //
+  // which has at most one extraordinary (valence 4) vertex. //
+  /////////////////////////////////////////////////////////////
+
+  const unsigned int numberOfFrames = 3;
+  std::vector<TMesh::Pointer> meshes;
+  for (unsigned int f = 0; f < numberOfFrames; ++f)
+    {
+    const auto source = TSource::New();
+    TSource::VectorType scale;
+    scale.Fill(10.0);
+    source->SetScale(scale);
+    source->SetResolution(1);
+    source->Update();
+    TMesh::Pointer mesh = source->GetOutput();
+    for (auto it = mesh->GetCells()->Begin(); it != mesh->GetCells()->End(); ++it)
+      mesh->SetCellData(it.Index(), 1.0f);
+    mesh->Setup();
+    meshes.push_back(mesh);
+    }
+  const unsigned int numberOfPoints = meshes.front()->GetNumberOfPoints();
+  const unsigned int numberOfCells = meshes.front()->GetNumberOfCells();
+
+  std::vector<double> init;
+  for (const auto &mesh : meshes)
+    for (unsigned int i = 0; i < numberOfPoints; ++i)
+      for (unsigned int d = 0; d < 3; ++d) init.push_back(mesh->GetPoint(i)[d]);
+
+  // Offsets which differ between frames, so that every term is nonzero
+  std::vector<double> offsets(init.size());
+  for (auto &o : offsets) o = dist(gen);
+  sissr::ControlPointBuffer buffer(init, offsets.data(), numberOfFrames, numberOfPoints);
+
+  std::vector<double*> blocks;
+  for (size_t u = 0; u < size_t(numberOfFrames) * numberOfPoints; ++u) blocks.push_back(&offsets[3 * u]);
+  const auto block = [&blocks, numberOfPoints](const unsigned int frame, const size_t point) {
+    return blocks[size_t(frame) * numberOfPoints + point];
+  };
+
+  // Each term alone, to check its weight, then all of them together
+  const std::vector<Weights> configurations = {
+    {2.0, 0.0, 0.0, 0.0},
+    {0.0, 0.5, 0.0, 0.0},
+    {0.0, 0.0, 3.0, 0.0},
+    {0.0, 0.0, 0.0, 0.25},
+    {2.0, 0.5, 3.0, 0.25},
+  };
+
+  for (const auto &weights : configurations)
+    {
+
+    ///////////////////////////////////////////////////////////
+    // The separate terms, weighted by loss functions, as in //
+    // RegisterMeshToPointSet.                               //
+    ///////////////////////////////////////////////////////////
+
+    ceres::Problem::Options problemOptions;
+    problemOptions.evaluation_callback = &buffer;
+    ceres::Problem separate(problemOptions);
+
+    if (weights.Velocity > 0.0)
+      {
+      const auto loss = new ceres::ScaledLoss(nullptr, weights.Velocity, ceres::TAKE_OWNERSHIP);
+      for (unsigned int f = 0; f < numberOfFrames; ++f)
+        for (unsigned int i = 0; i < numberOfPoints; ++i)
+          separate.AddResidualBlock(new sissr::VelocityRegularizer<TMesh>(buffer, f, i), loss,
+                                    std::vector<double*>{block(f, i), block((f + 1) % numberOfFrames, i)});
+      }
+    if (weights.Acceleration > 0.0)
+      {
+      const auto loss = new ceres::ScaledLoss(nullptr, weights.Acceleration, ceres::TAKE_OWNERSHIP);
+      for (unsigned int f = 0; f < numberOfFrames; ++f)
+        for (unsigned int i = 0; i < numberOfPoints; ++i)
+          separate.AddResidualBlock(new sissr::AccelerationRegularizer<TMesh>(buffer, f, i), loss,
+                                    std::vector<double*>{block((f + numberOfFrames - 1) % numberOfFrames, i),
+                                                         block(f, i),
+                                                         block((f + 1) % numberOfFrames, i)});
+      }
+    if (weights.ThinPlate > 0.0)
+      {
+      const auto loss = new ceres::ScaledLoss(nullptr, weights.ThinPlate, ceres::TAKE_OWNERSHIP);
+      for (unsigned int f = 0; f < numberOfFrames; ++f)
+        for (unsigned int c = 0; c < numberOfCells; ++c)
+          {
+          std::vector<double*> parameters;
+          for (const auto &i : meshes[f]->GetPointListForCell(c)) parameters.push_back(block(f, i));
+          separate.AddResidualBlock(new sissr::ThinPlateRegularizer<TMesh>(meshes[f], buffer, f, c), loss, parameters);
+          }
+      }
+    if (weights.EdgeLength > 0.0)
+      {
+      const auto loss = new ceres::ScaledLoss(nullptr, weights.EdgeLength, ceres::TAKE_OWNERSHIP);
+      for (unsigned int f = 0; f < numberOfFrames; ++f)
+        for (size_t e = 0; e < meshes[f]->GetNumberOfEdges(); ++e)
+          separate.AddResidualBlock(new sissr::EdgeLengthRegularizer<TMesh>(meshes[f], buffer, f, e), loss,
+                                    std::vector<double*>{block(f, meshes[f]->GetEdge(e)->GetOrigin()),
+                                                         block(f, meshes[f]->GetEdge(e)->GetDestination())});
+      }
+
+    ///////////////////////////////////////////////////////////
+    // The same terms as one operator, with the square roots //
+    // of the weights folded into its rows.                  //
+    ///////////////////////////////////////////////////////////
+
+    TOperator linearOperator(meshes);
+    if (weights.Velocity > 0.0) linearOperator.AddVelocity(weights.Velocity);
+    if (weights.Acceleration > 0.0) linearOperator.AddAcceleration(weights.Acceleration);
+    if (weights.ThinPlate > 0.0) linearOperator.AddThinPlate(weights.ThinPlate);
+    if (weights.EdgeLength > 0.0) linearOperator.AddEdgeLength(weights.EdgeLength);
+    linearOperator.Finalize();
+    assert(linearOperator.GetNumberOfUnknowns() == blocks.size());
+
+    ceres::Problem collapsed(problemOptions);
+    for (size_t b = 0; b < linearOperator.GetNumberOfBlocks(); ++b)
+      {
+      std::vector<double*> parameters;
+      for (const auto &u : linearOperator.GetBlock(b).columns) parameters.push_back(blocks[u]);
+      collapsed.AddResidualBlock(new sissr::LinearRegularizer<TMesh>(linearOperator, buffer, b), nullptr, parameters);
+      }
+
+    assert(3 * linearOperator.GetNumberOfRows() == size_t(separate.NumResiduals()));
+    assert(separate.NumResiduals() == collapsed.NumResiduals());
+
+    //////////////////////////////////////////////////////////
+    // The residuals agree up to their order, and so do the //
+    // cost, the gradient and J^T J.  The separate terms    //
+    // read the control points in single precision.         //
+    //////////////////////////////////////////////////////////
+
+    const auto expected = Evaluate(separate, blocks);
+    const auto actual = Evaluate(collapsed, blocks);
+
+    const double tolerance = 1e-4;
+    assert(expected.cost > 0.0);
+    assert(sissr::close(actual.cost, expected.cost, tolerance * expected.cost));
+    for (size_t r = 0; r < expected.residuals.size(); ++r)
+      assert(sissr::close(actual.residuals[r], expected.residuals[r], tolerance * (1.0 + std::abs(expected.residuals[r]))));
+    for (size_t k = 0; k < expected.gradient.size(); ++k)
+      assert(sissr::close(actual.gradient[k], expected.gradient[k], tolerance * (1.0 + std::abs(expected.gradient[k]))));
+    for (size_t k = 0; k < expected.JTJ.size(); ++k)
+      assert(sissr::close(actual.JTJ[k], expected.JTJ[k], tolerance * (1.0 + std::abs(expected.JTJ[k]))));
+
+    }
+
+  return EXIT_SUCCESS;
+
+}
@@ -0,0 +1,5 @@
+#include <sissrMatrixFreeSolver.h>
+#include <cstdlib>
+int main() {
+  return EXIT_SUCCESS;
+}
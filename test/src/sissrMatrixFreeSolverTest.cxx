@@ -0,0 +1,263 @@
+// STD
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+#include <random>
+#include <set>
+#include <vector>
+
+// ITK
+#include <itkMesh.h>
+#include <itkQuadEdgeMeshTraits.h>
+#include <itkRegularSphereMeshSource.h>
+
+// Ceres
+#include <ceres/ceres.h>
+
+// Eigen
+#include <Eigen/Dense>
+
+// SiSSR Utils
+#include <sissrUtils.h>
+
+// SiSSR
+#include <itkLoopSubdivisionSurfaceMesh.h>
+#include <sissrAccelerationRegularizer.h>
+#include <sissrControlPointBuffer.h>
+#include <sissrCorrespondenceEngine.h>
+#include <sissrEdgeLengthRegularizer.h>
+#include <sissrLossScaleFactors.h>
+#include <sissrMatrixFreeSolver.h>
+#include <sissrNearestPointUnlabeledCostFunction.h>
+#include <sissrThinPlateRegularizer.h>
+#include <sissrTriangleBVH.h>
+#include <sissrVelocityRegularizer.h>
+
+using TReal = float;
+using TQEMeshTraits = itk::QuadEdgeMeshTraits<TReal, 3, TReal, TReal, TReal, TReal>;
+using TFixedMesh = itk::Mesh<TReal, 3>;
+using TMovingMesh = itk::LoopSubdivisionSurfaceMesh<TReal, 3, TQEMeshTraits>;
+using TFixedSource = itk::RegularSphereMeshSource<TFixedMesh>;
+using TMovingSource = itk::RegularSphereMeshSource<TMovingMesh>;
+using TEngine = sissr::CorrespondenceEngine<TFixedMesh, TMovingMesh>;
+using TSolver = sissr::MatrixFreeSolver<TFixedMesh, TMovingMesh>;
+using TPrimaryResidual = sissr::NearestPointUnlabeledCostFunction<TFixedMesh, TMovingMesh>;
+
+// Largest absolute difference, relative to the largest absolute value
+double
+RelativeError(const Eigen::VectorXd &actual, const Eigen::VectorXd &expected)
+{
+  return (actual - expected).lpNorm<Eigen::Infinity>() / (1.0 + expected.lpNorm<Eigen::Infinity>());
+}
+
+int
+main(int, char**)
+{
+
+  std::mt19937 gen(0);
+  std::uniform_real_distribution<double> dist(-0.5, 0.5);
+
+  /////////////////////////////////////////////////////////////
+  // Three frames of a subdivision sphere, each triangle of  //
+  // which has at most one extraordinary (valence 4) vertex, //
+  // inside ellipsoids of candidates which differ by frame.  //
+  /////////////////////////////////////////////////////////////
+
+  const unsigned int numberOfFrames = 3;
+  TSolver::TMovingVector movingVector;
+  TEngine::TTriangleLocatorVector locators;
+  std::vector<TFixedMesh::Pointer> fixedVector;
+  for (unsigned int f = 0; f < numberOfFrames; ++f)
+    {
+    const auto movingSource = TMovingSource::New();
+    TMovingSource::VectorType movingScale;
+    movingScale.Fill(10.0);
+    movingSource->SetScale(movingScale);
+    movingSource->SetResolution(1);
+    movingSource->Update();
+    TMovingMesh::Pointer moving = movingSource->GetOutput();
+    for (auto it = moving->GetCells()->Begin(); it != moving->GetCells()->End(); ++it)
+      moving->SetCellData(it.Index(), 1.0f);
+    moving->Setup();
+    movingVector.push_back(moving);
+
+    const auto fixedSource = TFixedSource::New();
+    TFixedSource::VectorType fixedScale;
+    fixedScale[0] = 12.0 + f, fixedScale[1] = 11.0, fixedScale[2] = 9.0 - f;
+    fixedSource->SetScale(fixedScale);
+    fixedSource->SetResolution(3);
+    fixedSource->Update();
+    fixedVector.push_back(fixedSource->GetOutput());
+
+    const auto bvh = TEngine::TTriangleLocator::New();
+    bvh->SetMesh(fixedVector.back());
+    bvh->Initialize();
+    locators.push_back(bvh);
+    }
+
+  const unsigned int numberOfPoints = movingVector.front()->GetNumberOfPoints();
+  const unsigned int numberOfCells = movingVector.front()->GetNumberOfCells();
+  const unsigned int samples = movingVector.front()->GetNumberOfSamplesPerCell();
+  const unsigned int numberOfSamples = movingVector.front()->GetSurfaceParameterList().size();
+
+  std::vector<double> init;
+  for (const auto &moving : movingVector)
+    for (unsigned int i = 0; i < numberOfPoints; ++i)
+      for (unsigned int d = 0; d < 3; ++d) init.push_back(moving->GetPoint(i)[d]);
+
+  std::vector<double> start(init.size());
+  for (auto &o : start) o = dist(gen);
+  std::vector<double> offsets = start;
+  const size_t n = offsets.size();
+
+  sissr::ControlPointBuffer buffer(init, offsets.data(), numberOfFrames, numberOfPoints);
+  TEngine engine(movingVector, buffer, 1);
+  engine.SetLocators(locators);
+  buffer.AddUpdateCallback([&engine]() { engine.Update(); });
+
+  std::vector<double*> blocks;
+  for (size_t u = 0; u < n / 3; ++u) blocks.push_back(&offsets[3 * u]);
+  const auto block = [&blocks, numberOfPoints](const unsigned int frame, const size_t point) {
+    return blocks[size_t(frame) * numberOfPoints + point];
+  };
+
+  const sissr::LossScaleFactors weights(1.0, 1.0, 0.5, 0.25, 0.1, 0.0, 0.05, 0.1);
+
+  for (const auto type : {sissr::PrimaryResidualType::PointToPoint,
+                          sissr::PrimaryResidualType::PointToPlane,
+                          sissr::PrimaryResidualType::Symmetric})
+    {
+
+    std::copy(start.begin(), start.end(), offsets.begin());
+    engine.SetPrimaryResidualType(type);
+    // Correspondences are searched only when invalidated, as in
+    // RegisterMeshToPointSet for the matrix-free solver.
+    engine.SetUpdateInterval(1);
+    engine.Update();
+
+    ////////////////////////////////////////////////////
+    // The same terms as Ceres residual blocks, as in //
+    // RegisterMeshToPointSet.                        //
+    ////////////////////////////////////////////////////
+
+    ceres::Problem::Options problemOptions;
+    problemOptions.evaluation_callback = &buffer;
+    ceres::Problem problem(problemOptions);
+
+    const auto primaryLoss = new ceres::ScaledLoss(nullptr, weights.Primary, ceres::TAKE_OWNERSHIP);
+    const auto velocityLoss = new ceres::ScaledLoss(nullptr, weights.Velocity, ceres::TAKE_OWNERSHIP);
+    const auto accelerationLoss = new ceres::ScaledLoss(nullptr, weights.Acceleration, ceres::TAKE_OWNERSHIP);
+    const auto thinPlateLoss = new ceres::ScaledLoss(nullptr, weights.ThinPlate, ceres::TAKE_OWNERSHIP);
+    const auto edgeLengthLoss = new ceres::ScaledLoss(nullptr, weights.EdgeLength, ceres::TAKE_OWNERSHIP);
+    for (unsigned int f = 0; f < numberOfFrames; ++f)
+      {
+      const auto &moving = movingVector[f];
+      for (unsigned int index = 0; index < numberOfSamples; index += samples)
+        {
+        std::vector<double*> parameters;
+        for (const auto &i : moving->GetPointListForCell(moving->GetSurfaceParameter(index).first))
+          parameters.push_back(block(f, i));
+        problem.AddResidualBlock(new TPrimaryResidual(movingVector[f], engine, f, index, samples, weights.Tangential),
+                                 primaryLoss, parameters);
+        }
+      for (unsigned int i = 0; i < numberOfPoints; ++i)
+        {
+        problem.AddResidualBlock(new sissr::VelocityRegularizer<TMovingMesh>(buffer, f, i), velocityLoss,
+                                 std::vector<double*>{block(f, i), block((f + 1) % numberOfFrames, i)});
+        problem.AddResidualBlock(new sissr::AccelerationRegularizer<TMovingMesh>(buffer, f, i), accelerationLoss,
+                                 std::vector<double*>{block((f + numberOfFrames - 1) % numberOfFrames, i),
+                                                      block(f, i),
+                                                      block((f + 1) % numberOfFrames, i)});
+        }
+      for (unsigned int c = 0; c < numberOfCells; ++c)
+        {
+        std::vector<double*> parameters;
+        for (const auto &i : moving->GetPointListForCell(c)) parameters.push_back(block(f, i));
+        problem.AddResidualBlock(new sissr::ThinPlateRegularizer<TMovingMesh>(movingVector[f], buffer, f, c),
+                                 thinPlateLoss, parameters);
+        }
+      for (size_t e = 0; e < moving->GetNumberOfEdges(); ++e)
+        problem.AddResidualBlock(new sissr::EdgeLengthRegularizer<TMovingMesh>(movingVector[f], buffer, f, e),
+                                 edgeLengthLoss,
+                                 std::vector<double*>{block(f, moving->GetEdge(e)->GetOrigin()),
+                                                      block(f, moving->GetEdge(e)->GetDestination())});
+      }
+
+    TSolver solver(movingVector, buffer, engine, offsets.data(), weights, std::set<unsigned int>(), 1);
+    solver.MaximumNumberOfLinearIterations = 1000;
+    solver.LinearSolverTolerance = 1e-12;
+
+    /////////////////////////////////////////////////////////
+    // The cost and gradient match Ceres', and so do the   //
+    // products with J^T J, for the correspondences of the //
+    // start.  The regularizers of Ceres read the control  //
+    // points in single precision.                         //
+    /////////////////////////////////////////////////////////
+
+    ceres::Solver::Summary summary;
+    std::vector<double> gradient(n);
+    const double cost = solver.Evaluate(gradient, &summary);
+
+    ceres::Problem::EvaluateOptions evaluateOptions;
+    evaluateOptions.parameter_blocks = blocks;
+    double expectedCost = 0.0;
+    std::vector<double> expectedGradient;
+    ceres::CRSMatrix crs;
+    problem.Evaluate(evaluateOptions, &expectedCost, nullptr, &expectedGradient, &crs);
+    Eigen::MatrixXd J = Eigen::MatrixXd::Zero(crs.num_rows, crs.num_cols);
+    for (int r = 0; r < crs.num_rows; ++r)
+      for (int k = crs.rows[r]; k < crs.rows[r + 1]; ++k) J(r, crs.cols[k]) = crs.values[k];
+    const Eigen::MatrixXd JTJ = J.transpose() * J;
+    const Eigen::VectorXd g = Eigen::Map<const Eigen::VectorXd>(expectedGradient.data(), n);
+
+    assert(expectedCost > 0.0);
+    assert(sissr::close(cost, expectedCost, 1e-4 * expectedCost));
+    assert(RelativeError(Eigen::Map<const Eigen::VectorXd>(gradient.data(), n), g) < 1e-4);
+
+    for (unsigned int trial = 0; trial < 3; ++trial)
+      {
+      std::vector<double> x(n), y(n);
+      for (auto &v : x) v = dist(gen);
+      solver.Multiply(x, y);
+      const Eigen::VectorXd expected = JTJ * Eigen::Map<const Eigen::VectorXd>(x.data(), n);
+      assert(RelativeError(Eigen::Map<const Eigen::VectorXd>(y.data(), n), expected) < 1e-4);
+      }
+
+    //////////////////////////////////////////////////////////
+    // One step is the Gauss-Newton step of Ceres' Jacobian //
+    // and lowers the cost at least as far as one step of   //
+    // Ceres, since the new correspondences can only be     //
+    // closer.  Only point-to-point residuals are           //
+    // guaranteed not to grow with them.                    //
+    //////////////////////////////////////////////////////////
+
+    if (sissr::PrimaryResidualType::PointToPoint != type) continue;
+
+    const Eigen::VectorXd dx = -JTJ.ldlt().solve(g);
+
+    ceres::Solver::Options options;
+    options.max_num_iterations = 1;
+    solver.Solve(options, &summary);
+    assert(2u == summary.iterations.size());
+    assert(summary.iterations.back().step_is_successful);
+    assert(1.0 == summary.iterations.back().step_size);
+    assert(summary.final_cost < summary.initial_cost);
+    Eigen::VectorXd taken(n);
+    for (size_t j = 0; j < n; ++j) taken[j] = offsets[j] - start[j];
+    assert(RelativeError(taken, dx) < 1e-3);
+
+    std::copy(start.begin(), start.end(), offsets.begin());
+    engine.Invalidate();
+    options.linear_solver_type = ceres::DENSE_QR;
+    ceres::Solver::Summary ceresSummary;
+    ceres::Solve(options, &problem, &ceresSummary);
+    assert(ceresSummary.final_cost < ceresSummary.initial_cost);
+    assert(sissr::close(summary.initial_cost, ceresSummary.initial_cost, 1e-4 * ceresSummary.initial_cost));
+    assert(summary.final_cost <= ceresSummary.final_cost * (1.0 + 1e-4));
+
+    }
+
+  return EXIT_SUCCESS;
+
+}
@@ -0,0 +1,5 @@
+#include <sissrMeshToTriangleBVH.h>
+#include <cstdlib>
+int main() {
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,5 @@
+#include <sissrRegularPatchKernel.h>
+#include <cstdlib>
+int main() {
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,73 @@
+// STD
+#include <cassert>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+// SiSSR
+#include <sissrRegularPatchKernel.h>
+#include <sissrUtils.h>
+
+using TKernel = sissr::RegularPatchKernel;
+using TSet = TKernel::InstructionSet;
+
+int
+main(int, char**)
+{
+
+  std::mt19937 gen(0);
+  std::uniform_real_distribution<double> dist(-1.0, 1.0);
+
+  // Odd sample counts exercise the scalar tails of the vector paths.
+  for (const size_t count : {1, 3, 4, 7, 8, 13, 21, 36})
+    {
+
+    const size_t stride = count + 5;
+    std::vector<double> WT(TKernel::K * stride);
+    for (auto &w : WT) w = dist(gen);
+
+    const unsigned int numberOfPoints = 20;
+    std::vector<double> X(3 * numberOfPoints);
+    for (auto &x : X) x = dist(gen);
+
+    const unsigned int L[2 * TKernel::K] = {
+      0, 2, 4, 6, 8, 10, 12, 14, 16, 18, 1, 3,
+      5, 7, 9, 11, 13, 15, 17, 19, 0, 1, 2, 3
+    };
+
+    std::vector<double> out(2 * 3 * count);
+    TKernel::EvaluatePatches(WT.data(), stride, count, X.data(), L, 2, out.data());
+
+    // Compare with a direct evaluation on each available instruction set.
+    const TSet sets[] = {TSet::Scalar, TSet::AVX2, TSet::AVX512};
+    for (const auto &set : sets)
+      {
+      if (int(set) > int(TKernel::GetInstructionSet())) continue;
+      for (unsigned int p = 0; p < 2; ++p)
+        {
+        double x[3 * TKernel::K];
+        for (unsigned int i = 0; i < TKernel::K; ++i)
+          for (unsigned int d = 0; d < 3; ++d)
+            x[3 * i + d] = X[3 * L[TKernel::K * p + i] + d];
+
+        std::vector<double> result(3 * count);
+        TKernel::EvaluateGathered(set, WT.data(), stride, count, x, result.data());
+
+        for (size_t m = 0; m < count; ++m)
+          {
+          for (unsigned int d = 0; d < 3; ++d)
+            {
+            double expected = 0.0;
+            for (unsigned int i = 0; i < TKernel::K; ++i)
+              expected += WT[i * stride + m] * x[3 * i + d];
+            assert(sissr::close(result[3 * m + d], expected, 1e-12));
+            assert(sissr::close(out[3 * (count * p + m) + d], expected, 1e-12));
+            }
+          }
+        }
+      }
+
+    }
+
+  return EXIT_SUCCESS;
+}
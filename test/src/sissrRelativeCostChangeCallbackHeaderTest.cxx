@@ -0,0 +1,5 @@
+#include <sissrRelativeCostChangeCallback.h>
+#include <cstdlib>
+int main() {
+  return EXIT_SUCCESS;
+}
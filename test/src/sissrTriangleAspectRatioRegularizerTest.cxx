@@ -9,6 +9,7 @@
 #include <sissrUtils.h>
 
 // SiSSR
+#include <sissrControlPointBuffer.h>
 #include <sissrTriangleAspectRatioRegularizer.h>
 
 using TMesh = itk::Mesh<double, 3>;
@@ -50,26 +51,27 @@ main(int, char**)
   // Set up cost function. //
   ///////////////////////////
 
-  const auto init = TMesh::PointsContainer::New();
+  std::vector<double> init;
   for (auto it = mesh->GetPoints()->Begin(); it != mesh->GetPoints()->End();
        ++it) {
-    init->InsertElement(it.Index(), it.Value());
+    for (unsigned int d = 0; d < 3; ++d)
+      init.push_back(it.Value()[d]);
   }
 
-  ceres::CostFunction* reg = new TReg(mesh, init, 0);
-
   //////////////////////////
   // Allocate parameters. //
   //////////////////////////
 
+  std::vector<double> offsets(9, 0.0);
   std::vector<double*> parameters;
   for (unsigned int i = 0; i < 3; ++i) {
-    parameters.push_back(new double[3]);
-    parameters[i][0] = 0.0;
-    parameters[i][1] = 0.0;
-    parameters[i][2] = 0.0;
+    parameters.push_back(offsets.data() + 3 * i);
   }
 
+  sissr::ControlPointBuffer buffer(init, offsets.data(), 1, 3);
+
+  ceres::CostFunction* reg = new TReg(mesh, buffer, 0, 0);
+
   double residuals[1] = { 0.0 };
   double residuals_eps[1] = { 0.0 };
 
@@ -83,6 +85,7 @@ main(int, char**)
   // Ensure that residuals are near zero to start. //
   ///////////////////////////////////////////////////
 
+  buffer.PrepareForEvaluation(false, true);
   reg->Evaluate(parameters.data(), residuals, nullptr);
   assert(sissr::close(residuals[0], 0.0));
 
@@ -97,6 +100,7 @@ main(int, char**)
       ceres::VectorRef(parameters[2], 3).setZero();
 
       parameters[p][d] = eps;
+      buffer.PrepareForEvaluation(true, true);
 
       reg->Evaluate(parameters.data(), residuals_eps, jacobians);
 
@@ -0,0 +1,5 @@
+#include <sissrTriangleBVH.h>
+#include <cstdlib>
+int main() {
+  return EXIT_SUCCESS;
+}
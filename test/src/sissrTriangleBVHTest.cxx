@@ -0,0 +1,189 @@
+// STD
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <vector>
+
+// ITK
+#include <itkMesh.h>
+#include <itkRegularSphereMeshSource.h>
+
+// SiSSR Utils
+#include <sissrUtils.h>
+
+// SiSSR
+#include <sissrMeshToKdTree.h>
+#include <sissrTriangleBVH.h>
+
+using TMesh = itk::Mesh<float, 3>;
+using TSource = itk::RegularSphereMeshSource<TMesh>;
+using TBVH = sissr::TriangleBVH<TMesh>;
+using TMeshToKdTree = sissr::MeshToKdTree<TMesh>;
+
+int
+main(int, char**)
+{
+
+  std::mt19937 gen(0);
+  std::normal_distribution<double> dist(0.0, 1.0);
+
+  for (const unsigned int resolution : {1, 3, 5})
+    {
+
+    const auto source = TSource::New();
+    TSource::VectorType scale;
+    scale[0] = 50.0, scale[1] = 40.0, scale[2] = 30.0;
+    source->SetScale(scale);
+    source->SetResolution(resolution);
+    source->Update();
+    const auto mesh = source->GetOutput();
+
+    // Queries scattered about the surface
+    std::vector<double> queries;
+    for (unsigned int i = 0; i < 5000; ++i)
+      {
+      const double x = dist(gen), y = dist(gen), z = dist(gen);
+      const double r = std::sqrt(x * x + y * y + z * z);
+      const double s = 1.0 + 0.1 * dist(gen);
+      queries.push_back(s * 50.0 * x / r);
+      queries.push_back(s * 40.0 * y / r);
+      queries.push_back(s * 30.0 * z / r);
+      }
+    const size_t count = queries.size() / 3;
+
+    const auto bvh = TBVH::New();
+    bvh->SetMesh(mesh);
+    bvh->SetNumberOfThreads(4);
+    bvh->Initialize();
+    assert(mesh->GetNumberOfCells() == bvh->GetNumberOfTriangles());
+
+    // Unit normals, perpendicular to their triangles
+    for (size_t t = 0; t < bvh->GetNumberOfTriangles(); ++t)
+      {
+      const double* v = bvh->GetTriangle(t);
+      const double* n = bvh->GetNormal(t);
+      assert(sissr::close(n[0] * n[0] + n[1] * n[1] + n[2] * n[2], 1.0, 1e-12));
+      for (unsigned int k = 1; k < 3; ++k)
+        {
+        double dot = 0.0;
+        for (unsigned int d = 0; d < 3; ++d) dot += n[d] * (v[3 * k + d] - v[d]);
+        assert(sissr::close(dot, 0.0, 1e-9));
+        }
+      }
+
+    std::vector<double> closest(queries.size()), gaps(count);
+    bvh->FindClosestPoints(queries.data(), count, closest.data(), nullptr, gaps.data());
+
+    const auto squared_distance = [](const double* a, const double* b)
+      {
+      double d2 = 0.0;
+      for (unsigned int d = 0; d < 3; ++d) d2 += (a[d] - b[d]) * (a[d] - b[d]);
+      return d2;
+      };
+
+    /////////////////////////////////////////////////////////////
+    // Matches a brute force search over single-triangle trees //
+    /////////////////////////////////////////////////////////////
+
+    // Only for the smaller meshes: each tree scans the whole mesh.
+    std::vector<TBVH::Pointer> triangles;
+    for (auto it = mesh->GetCells()->Begin();
+         mesh->GetNumberOfCells() <= 2048 && it != mesh->GetCells()->End();
+         ++it)
+      {
+      const auto triangle = TBVH::New();
+      triangle->SetMesh(mesh);
+      triangle->SetCells({it.Index()});
+      triangle->Initialize();
+      triangles.push_back(triangle);
+      }
+
+    for (size_t i = 0; !triangles.empty() && i < std::min<size_t>(count, 200); ++i)
+      {
+      double expected = std::numeric_limits<double>::max();
+      double second = std::numeric_limits<double>::max();
+      for (const auto &triangle : triangles)
+        {
+        double p[3];
+        triangle->FindClosestPoint(queries.data() + 3 * i, p);
+        const double d2 = squared_distance(queries.data() + 3 * i, p);
+        second = std::min(second, std::max(expected, d2));
+        expected = std::min(expected, d2);
+        }
+      const double actual = squared_distance(queries.data() + 3 * i, closest.data() + 3 * i);
+      assert(sissr::close(actual, expected, 1e-9 * (1.0 + expected)));
+
+      // The gap to the second closest triangle
+      assert(sissr::close(gaps[i], std::sqrt(second) - std::sqrt(expected), 1e-6));
+
+      // Batch and single queries agree.
+      double p[3];
+      bvh->FindClosestPoint(queries.data() + 3 * i, p);
+      assert(sissr::close(squared_distance(queries.data() + 3 * i, p), actual, 1e-9 * (1.0 + actual)));
+      }
+
+    ///////////////////////////////////////////////////////
+    // At least as close as the cell midpoint kd-tree's. //
+    ///////////////////////////////////////////////////////
+
+    const auto tree = TMeshToKdTree::TLocator::New();
+    TMeshToKdTree().Calculate(mesh, tree);
+
+    std::vector<TMeshToKdTree::TLocator::PointIdentifier> ids(count);
+    tree->FindClosestPoints(queries.data(), count, ids.data());
+
+    double treeMean = 0.0, bvhMean = 0.0;
+    for (size_t i = 0; i < count; ++i)
+      {
+      const auto &m = tree->GetPoints()->ElementAt(ids[i]);
+      const double midpoint[3] = {m[0], m[1], m[2]};
+      const double treeDistance = squared_distance(queries.data() + 3 * i, midpoint);
+      const double bvhDistance = squared_distance(queries.data() + 3 * i, closest.data() + 3 * i);
+      // The midpoints are stored in single precision.
+      assert(bvhDistance <= treeDistance + 1e-4 * (1.0 + treeDistance));
+      treeMean += std::sqrt(treeDistance) / count;
+      bvhMean += std::sqrt(bvhDistance) / count;
+      }
+
+    ////////////////////////////////////////////////////////
+    // Approximate answers are within 1 + epsilon of exact //
+    ////////////////////////////////////////////////////////
+
+    const double epsilon = 0.25;
+    std::vector<double> approximate(queries.size());
+    bvh->FindClosestPoints(queries.data(), count, approximate.data(), nullptr, nullptr, epsilon);
+    for (size_t i = 0; i < count; ++i)
+      {
+      const double exactDistance = std::sqrt(squared_distance(queries.data() + 3 * i, closest.data() + 3 * i));
+      const double approximateDistance = std::sqrt(squared_distance(queries.data() + 3 * i, approximate.data() + 3 * i));
+      assert(approximateDistance <= (1.0 + epsilon) * exactDistance + 1e-9);
+      }
+
+    ///////////////
+    // Benchmark //
+    ///////////////
+
+    const auto time = [count](const auto &f)
+      {
+      const auto start = std::chrono::steady_clock::now();
+      f();
+      const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+      return elapsed.count() / count;
+      };
+
+    const auto treeTime = time([&]() { tree->FindClosestPoints(queries.data(), count, ids.data()); });
+    const auto bvhTime = time([&]() { bvh->FindClosestPoints(queries.data(), count, closest.data()); });
+
+    std::cout << mesh->GetNumberOfCells() << " triangles: "
+              << "midpoint kd-tree " << treeTime << " ns/query, mean distance " << treeMean << "; "
+              << "sissr::TriangleBVH " << bvhTime << " ns/query, mean distance " << bvhMean << std::endl;
+
+    }
+
+  return EXIT_SUCCESS;
+}
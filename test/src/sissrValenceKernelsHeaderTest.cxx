@@ -0,0 +1,5 @@
+#include <sissrValenceKernels.h>
+#include <cstdlib>
+int main() {
+  return EXIT_SUCCESS;
+}